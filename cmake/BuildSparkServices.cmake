@@ -1,27 +1,35 @@
-# Copyright (c) 2021 Ember
+# Copyright (c) 2021 - 2022 Ember
 #
 # This Source Code Form is subject to the terms of the Mozilla Public
 # License, v. 2.0. If a copy of the MPL was not distributed with this
 # file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
+# Generates <schema>_dispatch.h for each schema from the binary schema
+# produced by flatc, so schema_target must be the target that produces them
 function(build_spark_services
-         definition_dirs
+         schemas
+         bfbs_dir
          output_dir
          target_name
+         schema_target
          fverbosity)
 
-    # concat the paths into a format usable by the tool
-    foreach(dir ${definition_dirs})
-        set(definition_dir_str \"${dir}\" ${definition_dir_str})
-    endforeach()
+    set(generated_files "")
+
+    foreach(schema ${schemas})
+        get_filename_component(filename ${schema} NAME_WE)
+        set(generated ${output_dir}/${filename}_dispatch.h)
 
-    add_custom_command(
-        OUTPUT  "test.h"
-        COMMAND sparkc -s "Test.bfbs" -o ${output_dir} --fverbosity ${fverbosity}
-        DEPENDS sparkc
-        COMMENT "Generating Spark service stubs..."
-    )
+        add_custom_command(
+            OUTPUT  ${generated}
+            COMMAND sparkc -s ${bfbs_dir}/${filename}.bfbs -o ${output_dir} --fverbosity ${fverbosity}
+            DEPENDS sparkc ${schema_target} ${schema}
+            COMMENT "Generating Spark dispatch tables for ${filename}..."
+        )
+
+        list(APPEND generated_files ${generated})
+    endforeach()
 
-    add_custom_target(${target_name} DEPENDS sparkc ${additional_dependencies})
+    add_custom_target(${target_name} DEPENDS sparkc ${generated_files})
 
 endfunction()
\ No newline at end of file
@@ -17,9 +17,9 @@ namespace ember {
 Service::Service(Sessions& sessions, spark::Service& spark, spark::ServiceDiscovery& discovery,
                  log::Logger* logger)
                  : sessions_(sessions), spark_(spark), discovery_(discovery), logger_(logger) {
-	REGISTER(em::account::Opcode::CMSG_ACCOUNT_LOOKUP, em::account::LookupID, Service::account_lookup);
-	REGISTER(em::account::Opcode::CMSG_SESSION_LOOKUP, em::account::SessionLookup, Service::locate_session);
-	REGISTER(em::account::Opcode::CMSG_REGISTER_SESSION, em::account::RegisterSession, Service::register_session);
+	handlers_.add<em::account::Opcode::CMSG_ACCOUNT_LOOKUP, &Service::account_lookup>(this);
+	handlers_.add<em::account::Opcode::CMSG_SESSION_LOOKUP, &Service::locate_session>(this);
+	handlers_.add<em::account::Opcode::CMSG_REGISTER_SESSION, &Service::register_session>(this);
 
 	spark_.dispatcher()->register_handler(this, em::Service::ACCOUNT, spark::EventDispatcher::Mode::SERVER);
 	discovery_.register_service(em::Service::ACCOUNT);
@@ -33,23 +33,17 @@ Service::~Service() {
 void Service::on_message(const spark::Link& link, const spark::Message& message) {
 	LOG_TRACE(logger_) << __func__ << LOG_ASYNC;
 
-	auto handler = handlers_.find(static_cast<messaging::account::Opcode>(message.opcode));
+	const auto result = handlers_.dispatch(link, message);
 
-	if(handler == handlers_.end()) {
+	if(result == em::account::DispatchTable::Result::UNHANDLED) {
 		LOG_WARN_FILTER(logger_, LF_SPARK)
 			<< "Unhandled message received from "
 			<< link.description << LOG_ASYNC;
-		return;
-	}
-
-	if(!handler->second.verify(message)) {
+	} else if(result == em::account::DispatchTable::Result::BAD_MESSAGE) {
 		LOG_WARN_FILTER(logger_, LF_SPARK)
 			<< "[spark] Bad message received from "
 			<< link.description << LOG_ASYNC;
-		return;
 	}
-
-	handler->second.handle(link, message);
 }
 
 void Service::on_link_up(const spark::Link& link) {
@@ -60,16 +54,16 @@ void Service::on_link_down(const spark::Link& link) {
 	LOG_INFO(logger_) << "Link down: " << link.description << LOG_ASYNC;
 }
 
-void Service::register_session(const spark::Link& link, const spark::Message& message) {
+void Service::register_session(const spark::Link& link, const spark::Message& message,
+                               const em::account::RegisterSession& msg) {
 	LOG_TRACE(logger_) << __func__ << LOG_ASYNC;
 
-	auto msg = flatbuffers::GetRoot<em::account::RegisterSession>(message.data);
 	auto status = em::account::Status::OK;
 	
-	if(msg->key() && msg->account_id()) {
-		Botan::BigInt key(msg->key()->data(), msg->key()->size());
+	if(msg.key() && msg.account_id()) {
+		Botan::BigInt key(msg.key()->data(), msg.key()->size());
 
-		if(!sessions_.register_session(msg->account_id(), key)) {
+		if(!sessions_.register_session(msg.account_id(), key)) {
 			status = em::account::Status::ALREADY_LOGGED_IN;
 		}
 	} else {
@@ -79,14 +73,14 @@ void Service::register_session(const spark::Link& link, const spark::Message& me
 	send_register_reply(link, status, message.token);
 }
 
-void Service::locate_session(const spark::Link& link, const spark::Message& message) {
+void Service::locate_session(const spark::Link& link, const spark::Message& message,
+                             const em::account::SessionLookup& msg) {
 	LOG_TRACE(logger_) << __func__ << LOG_ASYNC;
 
-	auto msg = flatbuffers::GetRoot<em::account::SessionLookup>(message.data);
 	auto session = std::optional<Botan::BigInt>();
 	
-	if(msg->account_id()) {
-		session = sessions_.lookup_session(msg->account_id());
+	if(msg.account_id()) {
+		session = sessions_.lookup_session(msg.account_id());
 	}
 
 	send_locate_reply(link, session, message.token);
@@ -97,7 +91,7 @@ void Service::send_register_reply(const spark::Link& link, em::account::Status s
 	LOG_TRACE(logger_) << __func__ << LOG_ASYNC;
 
 	auto opcode = std::to_underlying(em::account::Opcode::SMSG_REGISTER_SESSION);
-	auto fbb = std::make_shared<flatbuffers::FlatBufferBuilder>();
+	auto fbb = spark::make_buffer();
 	em::account::SessionResponseBuilder rb(*fbb);
 	rb.add_status(status);
 	fbb->Finish(rb.Finish()); // check this
@@ -105,12 +99,12 @@ void Service::send_register_reply(const spark::Link& link, em::account::Status s
 	spark_.send(link, opcode, fbb);
 }
 
-void Service::account_lookup(const spark::Link& link, const spark::Message& message) {
+void Service::account_lookup(const spark::Link& link, const spark::Message& message,
+                             const em::account::LookupID& msg) {
 	LOG_TRACE(logger_) << __func__ << LOG_ASYNC;
 
 	auto opcode = std::to_underlying(em::account::Opcode::SMSG_ACCOUNT_LOOKUP);
-	auto msg = flatbuffers::GetRoot<em::account::LookupID>(message.data);
-	auto fbb = std::make_shared<flatbuffers::FlatBufferBuilder>();
+	auto fbb = spark::make_buffer();
 
 	em::account::LookupIDResponseBuilder klb(*fbb);
 	klb.add_status(em::account::Status::OK);
@@ -126,7 +120,7 @@ void Service::send_locate_reply(const spark::Link& link, const std::optional<Bot
 	LOG_TRACE(logger_) << __func__ << LOG_ASYNC;
 
 	auto opcode = std::to_underlying(em::account::Opcode::SMSG_SESSION_LOOKUP);
-	auto fbb = std::make_shared<flatbuffers::FlatBufferBuilder>();
+	auto fbb = spark::make_buffer();
 
 	if(key) {
 		auto encoded_key = Botan::BigInt::encode(*key);
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2015, 2016 Ember
+ * Copyright (c) 2015 - 2022 Ember
  *
  * This Source Code Form is subject to the terms of the Mozilla Public
  * License, v. 2.0. If a copy of the MPL was not distributed with this
@@ -9,9 +9,8 @@
 #pragma once
 
 #include "Sessions.h"
-#include "Account_generated.h"
+#include "Account_dispatch.h"
 #include <spark/Service.h>
-#include <spark/Helpers.h>
 #include <logger/Logging.h>
 #include <optional>
 #include <cstdint>
@@ -23,13 +22,16 @@ class Service final : public spark::EventHandler {
 	spark::Service& spark_;
 	spark::ServiceDiscovery& discovery_;
 	log::Logger* logger_;
-	std::unordered_map<messaging::account::Opcode, spark::LocalDispatcher> handlers_;
+	messaging::account::DispatchTable handlers_;
 
-	void register_session(const spark::Link& link, const spark::Message& message);
-	void locate_session(const spark::Link& link, const spark::Message& message);
+	void register_session(const spark::Link& link, const spark::Message& message,
+	                      const messaging::account::RegisterSession& msg);
+	void locate_session(const spark::Link& link, const spark::Message& message,
+	                    const messaging::account::SessionLookup& msg);
 	void send_locate_reply(const spark::Link& link, const std::optional<Botan::BigInt>& key,
 	                       const spark::Beacon& token);
-	void account_lookup(const spark::Link& link, const spark::Message& message);
+	void account_lookup(const spark::Link& link, const spark::Message& message,
+	                    const messaging::account::LookupID& msg);
 	void send_register_reply(const spark::Link& link, messaging::account::Status status,
 	                         const spark::Beacon& token);
 
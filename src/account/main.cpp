@@ -136,6 +136,11 @@ po::variables_map parse_arguments(int argc, const char* argv[]) {
 		("file_log.midnight_rotate", po::bool_switch()->required())
 		("file_log.log_timestamp", po::bool_switch()->required())
 		("file_log.log_severity", po::bool_switch()->required())
+		("file_log.fsync_severity", po::value<std::string>()->default_value("none"))
+		("file_log.compress", po::value<bool>()->default_value(false))
+		("file_log.retain_files", po::value<std::uint32_t>()->default_value(0))
+		("file_log.retain_days", po::value<std::uint32_t>()->default_value(0))
+		("file_log.retain_size", po::value<std::uint32_t>()->default_value(0))
 		("database.config_path", po::value<std::string>()->required())
 		("database.min_connections", po::value<unsigned short>()->required())
 		("database.max_connections", po::value<unsigned short>()->required())
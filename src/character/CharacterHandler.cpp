@@ -8,13 +8,36 @@
 
 #include "CharacterHandler.h"
 #include "FilterTypes.h"
+#include <shared/metrics/Metrics.h>
 #include <shared/util/Utility.h>
 #include <shared/util/UTF8.h>
 #include <shared/threading/ThreadPool.h>
 #include <boost/assert.hpp>
+#include <chrono>
 
 namespace ember {
 
+/*
+ * The timing covers the whole task, every database round trip it makes
+ * included. Returns false if the blocking queue is full, in which case the
+ * caller has to fail the request itself.
+ */
+template<typename Work>
+bool CharacterHandler::run_query(const char* key, Work work) const {
+	const auto queued = pool_.run_blocking([=, this] {
+		const auto start = std::chrono::steady_clock::now();
+		work();
+		const auto elapsed = std::chrono::steady_clock::now() - start;
+		metrics_.timing(key, std::chrono::duration_cast<std::chrono::milliseconds>(elapsed));
+	});
+
+	if(!queued) {
+		LOG_WARN(logger_) << "Blocking queue full, rejected " << key << LOG_ASYNC;
+	}
+
+	return queued;
+}
+
 void CharacterHandler::create(std::uint32_t account_id, std::uint32_t realm_id,
                               const messaging::character::CharacterTemplate& options,
                               ResultCB callback) const {
@@ -38,35 +61,48 @@ void CharacterHandler::create(std::uint32_t account_id, std::uint32_t realm_id,
 	character.flags = Character::Flags::NONE;
 	character.first_login = true;
 
+	// validation and the DBC lookups are CPU work, only the queries need the blocking lane
 	pool_.run([=, this] {
-		do_create(account_id, realm_id, character, callback);
+		prepare_create(account_id, realm_id, character, callback);
 	});
 }
 
 void CharacterHandler::restore(std::uint64_t id, ResultCB callback) const {
 	LOG_TRACE(logger_) << __func__ << LOG_ASYNC;
 
-	pool_.run([=, this] {
+	const auto queued = run_query("character.db.restore", [=, this] {
 		do_restore(id, callback);
 	});
+
+	if(!queued) {
+		callback(protocol::Result::RESPONSE_FAILURE);
+	}
 }
 
 void CharacterHandler::erase(std::uint32_t account_id, std::uint32_t realm_id,
                              std::uint64_t character_id, ResultCB callback) const {
 	LOG_TRACE(logger_) << __func__ << LOG_ASYNC;
 
-	pool_.run([=, this] {
+	const auto queued = run_query("character.db.erase", [=, this] {
 		do_erase(account_id, realm_id, character_id, callback);
 	});
+
+	if(!queued) {
+		callback(protocol::Result::CHAR_DELETE_FAILED);
+	}
 }
 
 void CharacterHandler::enumerate(std::uint32_t account_id, std::uint32_t realm_id,
                                  EnumResultCB callback) const {
 	LOG_TRACE(logger_) << __func__ << LOG_ASYNC;
 
-	pool_.run([=, this] {
+	const auto queued = run_query("character.db.enumerate", [=, this] {
 		do_enumerate(account_id, realm_id, callback);
 	});
+
+	if(!queued) {
+		callback(std::optional<std::vector<Character>>());
+	}
 }
 
 void CharacterHandler::rename(std::uint32_t account_id, std::uint64_t character_id,
@@ -74,12 +110,12 @@ void CharacterHandler::rename(std::uint32_t account_id, std::uint64_t character_
 	LOG_TRACE(logger_) << __func__ << LOG_ASYNC;
 
 	pool_.run([=, this] {
-		do_rename(account_id, character_id, name, callback);
+		prepare_rename(account_id, character_id, name, callback);
 	});
 }
 
-void CharacterHandler::do_create(std::uint32_t account_id, std::uint32_t realm_id,
-                                 Character character, const ResultCB& callback) const try {
+void CharacterHandler::prepare_create(std::uint32_t account_id, std::uint32_t realm_id,
+                                      Character character, const ResultCB& callback) const {
 	LOG_TRACE(logger_) << __func__ << LOG_ASYNC;
 
 	// class, race and visual customisation validation
@@ -100,50 +136,7 @@ void CharacterHandler::do_create(std::uint32_t account_id, std::uint32_t realm_i
 
 	character.name = util::utf8::name_format(character.name, std::locale());
 
-	const std::optional<Character>& res = dao_.character(character.name, realm_id);
-
-	if(res) {
-		callback(protocol::Result::CHAR_CREATE_NAME_IN_USE);
-		return;
-	}
-
-	// query database for further validation steps
-	const auto& characters = dao_.characters(account_id);
-
-	if(characters.size() >= MAX_CHARACTER_SLOTS_ACCOUNT) {
-		callback(protocol::Result::CHAR_CREATE_ACCOUNT_LIMIT);
-		return;
-	}
-
-	auto realm_chars = std::count_if(characters.begin(), characters.end(), [&](auto& c) {
-		return c.realm_id == realm_id;
-	});
-
-	if(static_cast<std::size_t>(realm_chars) >= MAX_CHARACTER_SLOTS_SERVER) {
-		callback(protocol::Result::CHAR_CREATE_SERVER_LIMIT);
-		return;
-	}
-
-	// PvP faction check
-	auto faction_group = dbc_.chr_races[character.race]->faction->faction_group_id;
-
-	auto it = std::find_if_not(characters.begin(), characters.end(), [&](auto& c) {
-		return faction_group == dbc_.chr_races[c.race]->faction->faction_group_id;
-	});
-
-	if(it != characters.end() /* && pvp_server */) { // todo, add check to make sure it's a PvP server
-		auto current = pvp_faction(*dbc_.chr_races[characters.front().race]->faction);
-		auto opposing = pvp_faction(*dbc_.chr_races[character.race]->faction);
-
-		LOG_DEBUG(logger_) << "Cannot create " << opposing->internal_name
-			<< " characters with existing " << current->internal_name
-			<< " characters on a PvP realm" << LOG_ASYNC;
-
-		callback(protocol::Result::CHAR_CREATE_PVP_TEAMS_VIOLATION);
-		return;
-	}
-
-	// everything looks good - populate the character data and create it
+	// populate the character data, it only gets saved once the database checks pass
 	const dbc::ChrRaces* race = dbc_.chr_races[character.race];
 	const dbc::ChrClasses* class_ = dbc_.chr_classes[character.class_];
 
@@ -214,6 +207,84 @@ void CharacterHandler::do_create(std::uint32_t account_id, std::uint32_t realm_i
 		<< zone->area->area_name.en_gb << (subzone ? ", " : " ") << (subzone ? subzone : " ")
 		<< LOG_ASYNC;
 
+	const auto queued = run_query("character.db.create", [=, this] {
+		do_create(account_id, realm_id, character, callback);
+	});
+
+	if(!queued) {
+		callback(protocol::Result::CHAR_CREATE_ERROR);
+	}
+}
+
+void CharacterHandler::prepare_rename(std::uint32_t account_id, std::uint64_t character_id,
+                                      const utf8_string& name, const RenameCB& callback) const {
+	LOG_TRACE(logger_) << __func__ << LOG_ASYNC;
+
+	auto result = validate_name(name);
+
+	if(result != protocol::Result::CHAR_NAME_SUCCESS) {
+		callback(result, std::nullopt);
+		return;
+	}
+
+	const auto formatted = util::utf8::name_format(name, std::locale());
+
+	const auto queued = run_query("character.db.rename", [=, this] {
+		do_rename(account_id, character_id, formatted, callback);
+	});
+
+	if(!queued) {
+		callback(protocol::Result::CHAR_NAME_FAILURE, std::nullopt);
+	}
+}
+
+void CharacterHandler::do_create(std::uint32_t account_id, std::uint32_t realm_id,
+                                 Character character, const ResultCB& callback) const try {
+	LOG_TRACE(logger_) << __func__ << LOG_ASYNC;
+
+	const std::optional<Character>& res = dao_.character(character.name, realm_id);
+
+	if(res) {
+		callback(protocol::Result::CHAR_CREATE_NAME_IN_USE);
+		return;
+	}
+
+	// query database for further validation steps
+	const auto& characters = dao_.characters(account_id);
+
+	if(characters.size() >= MAX_CHARACTER_SLOTS_ACCOUNT) {
+		callback(protocol::Result::CHAR_CREATE_ACCOUNT_LIMIT);
+		return;
+	}
+
+	auto realm_chars = std::count_if(characters.begin(), characters.end(), [&](auto& c) {
+		return c.realm_id == realm_id;
+	});
+
+	if(static_cast<std::size_t>(realm_chars) >= MAX_CHARACTER_SLOTS_SERVER) {
+		callback(protocol::Result::CHAR_CREATE_SERVER_LIMIT);
+		return;
+	}
+
+	// PvP faction check
+	auto faction_group = dbc_.chr_races[character.race]->faction->faction_group_id;
+
+	auto it = std::find_if_not(characters.begin(), characters.end(), [&](auto& c) {
+		return faction_group == dbc_.chr_races[c.race]->faction->faction_group_id;
+	});
+
+	if(it != characters.end() /* && pvp_server */) { // todo, add check to make sure it's a PvP server
+		auto current = pvp_faction(*dbc_.chr_races[characters.front().race]->faction);
+		auto opposing = pvp_faction(*dbc_.chr_races[character.race]->faction);
+
+		LOG_DEBUG(logger_) << "Cannot create " << opposing->internal_name
+			<< " characters with existing " << current->internal_name
+			<< " characters on a PvP realm" << LOG_ASYNC;
+
+		callback(protocol::Result::CHAR_CREATE_PVP_TEAMS_VIOLATION);
+		return;
+	}
+
 	dao_.create(character);
 	callback(protocol::Result::CHAR_CREATE_SUCCESS);
 } catch(dal::exception& e) {
@@ -288,14 +359,7 @@ void CharacterHandler::do_rename(std::uint32_t account_id, std::uint64_t charact
 		return;
 	}
 
-	auto result = validate_name(name);
-
-	if(result != protocol::Result::CHAR_NAME_SUCCESS) {
-		callback(result, std::nullopt);
-		return;
-	}
-
-	character->name = util::utf8::name_format(name, std::locale());
+	character->name = name;
 
 	const std::optional<Character>& match = dao_.character(character->name, character->realm_id);
 
@@ -304,7 +368,7 @@ void CharacterHandler::do_rename(std::uint32_t account_id, std::uint64_t charact
 		return;
 	}
 	
-	LOG_DEBUG(logger_) << "Renaming " << character->name << " => " << name << ", #"
+	LOG_DEBUG(logger_) << "Renaming " << character->internal_name << " => " << name << ", #"
 		<< character->id << LOG_ASYNC;
 
 	character->internal_name = character->name;
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2016 - 2021 Ember
+ * Copyright (c) 2016 - 2022 Ember
  *
  * This Source Code Form is subject to the terms of the Mozilla Public
  * License, v. 2.0. If a copy of the MPL was not distributed with this
@@ -27,6 +27,7 @@
 namespace ember {
 
 class ThreadPool;
+class Metrics;
 
 class CharacterHandler {
 	typedef std::function<void(protocol::Result)> ResultCB;
@@ -47,6 +48,7 @@ class CharacterHandler {
 	const std::locale locale_;
 
 	ThreadPool& pool_;
+	Metrics& metrics_;
 	log::Logger* logger_;
 
 	protocol::Result validate_name(const std::string& name) const;
@@ -56,8 +58,19 @@ class CharacterHandler {
 	void populate_skills(Character& character, const dbc::CharStartSkills& skills) const;
 	const dbc::FactionGroup* pvp_faction(const dbc::FactionTemplate& fac_template) const;
 
+	/** CPU-bound steps run on the pool's interactive lane before the queries **/
+
+	void prepare_create(std::uint32_t account_id, std::uint32_t realm_id,
+	                    Character character, const ResultCB& callback) const;
+
+	void prepare_rename(std::uint32_t account_id, std::uint64_t character_id,
+	                    const utf8_string& name, const RenameCB& callback) const;
+
 	/** I/O heavy functions run async in a thread pool **/
 
+	template<typename Work>
+	bool run_query(const char* key, Work work) const;
+
 	void do_create(std::uint32_t account_id, std::uint32_t realm_id,
 	               Character character, const ResultCB& callback) const;
 
@@ -78,11 +91,12 @@ public:
 	                 std::vector<util::pcre::Result> reserved_names,
 	                 std::vector<util::pcre::Result> spam_names,
 	                 const dbc::Storage& dbc, const dal::CharacterDAO& dao,
-	                 ThreadPool& pool, const std::locale& locale, log::Logger* logger)
+	                 ThreadPool& pool, Metrics& metrics, const std::locale& locale,
+	                 log::Logger* logger)
 	                 : profane_names_(std::move(profane_names)),
 	                   reserved_names_(std::move(reserved_names)),
 	                   spam_names_(std::move(spam_names)),
-	                   dbc_(dbc), dao_(dao), pool_(pool), locale_(locale),
+	                   dbc_(dbc), dao_(dao), pool_(pool), metrics_(metrics), locale_(locale),
 	                   logger_(logger) {}
 
 	void create(std::uint32_t account_id, std::uint32_t realm_id,
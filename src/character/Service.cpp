@@ -20,10 +20,10 @@ Service::Service(dal::CharacterDAO& character_dao, const CharacterHandler& handl
                  spark::ServiceDiscovery& discovery, log::Logger* logger)
                  : character_dao_(character_dao), handler_(handler), spark_(spark),
                    discovery_(discovery), logger_(logger) {
-	REGISTER(em::character::Opcode::CMSG_CHAR_CREATE, em::character::Create, Service::create_character);
-	REGISTER(em::character::Opcode::CMSG_CHAR_DELETE, em::character::Delete, Service::delete_character);
-	REGISTER(em::character::Opcode::CMSG_CHAR_RENAME, em::character::Rename, Service::rename_character);
-	REGISTER(em::character::Opcode::CMSG_CHAR_ENUM, em::character::Retrieve, Service::retrieve_characters);
+	handlers_.add<em::character::Opcode::CMSG_CHAR_CREATE, &Service::create_character>(this);
+	handlers_.add<em::character::Opcode::CMSG_CHAR_DELETE, &Service::delete_character>(this);
+	handlers_.add<em::character::Opcode::CMSG_CHAR_RENAME, &Service::rename_character>(this);
+	handlers_.add<em::character::Opcode::CMSG_CHAR_ENUM, &Service::retrieve_characters>(this);
 
 	spark_.dispatcher()->register_handler(this, em::Service::CHARACTER, spark::EventDispatcher::Mode::SERVER);
 	discovery_.register_service(em::Service::CHARACTER);
@@ -45,32 +45,26 @@ void Service::on_link_down(const spark::Link& link) {
 void Service::on_message(const spark::Link& link, const spark::Message& message) {
 	LOG_TRACE(logger_) << __func__ << LOG_ASYNC;
 
-	auto handler = handlers_.find(static_cast<messaging::character::Opcode>(message.opcode));
+	const auto result = handlers_.dispatch(link, message);
 
-	if(handler == handlers_.end()) {
+	if(result == em::character::DispatchTable::Result::UNHANDLED) {
 		LOG_WARN_FILTER(logger_, LF_SPARK)
 			<< "Unhandled message received from "
 			<< link.description << LOG_ASYNC;
-		return;
-	}
-
-	if(!handler->second.verify(message)) {
+	} else if(result == em::character::DispatchTable::Result::BAD_MESSAGE) {
 		LOG_WARN_FILTER(logger_, LF_SPARK)
 			<< "[spark] Bad message received from "
 			<< link.description << LOG_ASYNC;
-		return;
 	}
-
-	handler->second.handle(link, message);
 }
 
-void Service::retrieve_characters(const spark::Link& link, const spark::Message& message) {
+void Service::retrieve_characters(const spark::Link& link, const spark::Message& message,
+                                  const em::character::Retrieve& msg) {
 	LOG_TRACE(logger_) << __func__ << LOG_ASYNC;
 
-	auto msg = flatbuffers::GetRoot<em::character::Retrieve>(message.data);
 	auto token = message.token;
 
-	handler_.enumerate(msg->account_id(), msg->realm_id(), [this, link, token](const auto& chars) {
+	handler_.enumerate(msg.account_id(), msg.realm_id(), [this, link, token](const auto& chars) {
 		if(chars) {
 			send_character_list(link, token, em::character::Status::OK, *chars);
 		} else {
@@ -79,13 +73,13 @@ void Service::retrieve_characters(const spark::Link& link, const spark::Message&
 	});
 }
 
-void Service::create_character(const spark::Link& link, const spark::Message& message) {
+void Service::create_character(const spark::Link& link, const spark::Message& message,
+                               const em::character::Create& msg) {
 	LOG_TRACE(logger_) << __func__ << LOG_ASYNC;
 
 	auto token = message.token;
-	auto msg = flatbuffers::GetRoot<em::character::Create>(message.data);
 
-	if(!msg->character()) {
+	if(!msg.character()) {
 		LOG_WARN(logger_) << "Illformed create request from " << link.description << LOG_ASYNC;
 
 		send_response(link, token, em::character::Status::ILLFORMED_MESSAGE,
@@ -93,7 +87,7 @@ void Service::create_character(const spark::Link& link, const spark::Message& me
 		return;
 	}
 
-	handler_.create(msg->account_id(), msg->realm_id(), *msg->character(), [&, link, token](auto res) {
+	handler_.create(msg.account_id(), msg.realm_id(), *msg.character(), [&, link, token](auto res) {
 		LOG_DEBUG(logger_) << "Create response code: " << protocol::to_string(res) << LOG_ASYNC;
 		send_response(link, token, messaging::character::Status::OK, res);
 	});
@@ -105,7 +99,7 @@ void Service::send_character_list(const spark::Link& link, const spark::Beacon&
 	LOG_TRACE(logger_) << __func__ << LOG_ASYNC;
 
 	auto opcode = std::to_underlying(em::character::Opcode::SMSG_CHAR_ENUM);
-	auto fbb = std::make_shared<flatbuffers::FlatBufferBuilder>();
+	auto fbb = spark::make_buffer();
 
 	std::vector<flatbuffers::Offset<em::character::Character>> chars;
 
@@ -151,7 +145,7 @@ void Service::send_rename_response(const spark::Link& link, const spark::Beacon&
 	LOG_TRACE(logger_) << __func__ << LOG_ASYNC;
 
 	auto opcode = std::to_underlying(em::character::Opcode::SMSG_CHAR_RENAME);
-	auto fbb = std::make_shared<flatbuffers::FlatBufferBuilder>();
+	auto fbb = spark::make_buffer();
 	em::character::RenameResponseBuilder rb(*fbb);
 	rb.add_status(messaging::character::Status::OK);
 	rb.add_result(static_cast<std::uint32_t>(result));
@@ -172,7 +166,7 @@ void Service::send_response(const spark::Link& link, const spark::Beacon& token,
 	LOG_TRACE(logger_) << __func__ << LOG_ASYNC;
 
 	auto opcode = std::to_underlying(em::character::Opcode::SMSG_CHAR_RESPONSE);
-	auto fbb = std::make_shared<flatbuffers::FlatBufferBuilder>();
+	auto fbb = spark::make_buffer();
 	em::character::CreateResponseBuilder rb(*fbb);
 
 	rb.add_status(status);
@@ -182,25 +176,25 @@ void Service::send_response(const spark::Link& link, const spark::Beacon& token,
 	spark_.send(link, opcode, fbb, token);
 }
 
-void Service::delete_character(const spark::Link& link, const spark::Message& message) {
+void Service::delete_character(const spark::Link& link, const spark::Message& message,
+                               const em::character::Delete& msg) {
 	LOG_TRACE(logger_) << __func__ << LOG_ASYNC;
 
 	auto token = message.token;
-	auto msg = flatbuffers::GetRoot<em::character::Delete>(message.data);
 
-	handler_.erase(msg->account_id(), msg->realm_id(), msg->character_id(), [&, link, token](auto res) {
+	handler_.erase(msg.account_id(), msg.realm_id(), msg.character_id(), [&, link, token](auto res) {
 		LOG_DEBUG(logger_) << "Deletion response code: " << protocol::to_string(res) << LOG_ASYNC;
-		send_response(link, message.token, messaging::character::Status::OK, res);
+		send_response(link, token, messaging::character::Status::OK, res);
 	});
 }
 
-void Service::rename_character(const spark::Link& link, const spark::Message& message) {
+void Service::rename_character(const spark::Link& link, const spark::Message& message,
+                               const em::character::Rename& msg) {
 	LOG_TRACE(logger_) << __func__ << LOG_ASYNC;
 
-	auto msg = flatbuffers::GetRoot<em::character::Rename>(message.data);
 	auto token = message.token;
 
-	if(!msg->name() || !msg->account_id() || !msg->character_id()) {
+	if(!msg.name() || !msg.account_id() || !msg.character_id()) {
 		LOG_WARN(logger_) << "Illformed rename request from " << link.description << LOG_ASYNC;
 
 		send_response(link, token, messaging::character::Status::ILLFORMED_MESSAGE,
@@ -208,7 +202,7 @@ void Service::rename_character(const spark::Link& link, const spark::Message& me
 		return;
 	}
 
-	handler_.rename(msg->account_id(), msg->character_id(), msg->name()->str(),
+	handler_.rename(msg.account_id(), msg.character_id(), msg.name()->str(),
 	               [&, link, token](auto res, auto character) {
 		LOG_DEBUG(logger_) << "Rename response code: " << protocol::to_string(res) << LOG_ASYNC;
 		send_rename_response(link, token, res, std::move(character));
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2016 - 2019 Ember
+ * Copyright (c) 2016 - 2022 Ember
  *
  * This Source Code Form is subject to the terms of the Mozilla Public
  * License, v. 2.0. If a copy of the MPL was not distributed with this
@@ -8,9 +8,8 @@
 
 #pragma once
 
-#include "Character_generated.h"
+#include "Character_dispatch.h"
 #include <protocol/ResultCodes.h>
-#include <spark/Helpers.h>
 #include <spark/Service.h>
 #include <logger/Logging.h>
 #include <shared/database/objects/Character.h>
@@ -26,13 +25,17 @@ class Service final : public spark::EventHandler {
 	dal::CharacterDAO& character_dao_;
 	spark::Service& spark_;
 	spark::ServiceDiscovery& discovery_;
-	std::unordered_map<messaging::character::Opcode, spark::LocalDispatcher> handlers_;
+	messaging::character::DispatchTable handlers_;
 	log::Logger* logger_;
 
-	void retrieve_characters(const spark::Link& link, const spark::Message& message);
-	void create_character(const spark::Link& link, const spark::Message& message);
-	void rename_character(const spark::Link& link, const spark::Message& message);
-	void delete_character(const spark::Link& link, const spark::Message& message);
+	void retrieve_characters(const spark::Link& link, const spark::Message& message,
+	                         const messaging::character::Retrieve& msg);
+	void create_character(const spark::Link& link, const spark::Message& message,
+	                      const messaging::character::Create& msg);
+	void rename_character(const spark::Link& link, const spark::Message& message,
+	                      const messaging::character::Rename& msg);
+	void delete_character(const spark::Link& link, const spark::Message& message,
+	                      const messaging::character::Delete& msg);
 
 	void send_character_list(const spark::Link& link, const spark::Beacon& token, 
 	                         messaging::character::Status status,
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2016 - 2019 Ember
+ * Copyright (c) 2016 - 2022 Ember
  *
  * This Source Code Form is subject to the terms of the Mozilla Public
  * License, v. 2.0. If a copy of the MPL was not distributed with this
@@ -17,6 +17,10 @@
 #include <logger/Logging.h>
 #include <shared/Banner.h>
 #include <shared/database/daos/CharacterDAO.h>
+#include <shared/metrics/MetricsExporter.h>
+#include <shared/metrics/MetricsImpl.h>
+#include <shared/metrics/MetricsPoll.h>
+#include <shared/metrics/PoolMetrics.h>
 #include <shared/threading/ThreadPool.h>
 #include <shared/Version.h>
 #include <shared/util/LogConfig.h>
@@ -143,23 +147,55 @@ int launch(const po::variables_map& args, log::Logger* logger) try {
 	auto mcast_group = args["spark.multicast_group"].as<std::string>();
 	auto mcast_iface = args["spark.multicast_interface"].as<std::string>();
 	auto mcast_port = args["spark.multicast_port"].as<std::uint16_t>();
+	auto transport = args["spark.transport"].as<std::string>() == "v2"?
+		spark::Transport::V2 : spark::Transport::V1;
 	auto spark_filter = log::Filter(ember::FilterType::LF_SPARK);
 
 	boost::asio::io_context service;
 	boost::asio::signal_set signals(service, SIGINT, SIGTERM);
 
-	ThreadPool thread_pool(concurrency);
+	// Start metrics service
+	auto metrics = std::make_unique<Metrics>();
+
+	if(args["metrics.enabled"].as<bool>()) {
+		LOG_INFO(logger) << "Starting metrics service..." << LOG_SYNC;
+		metrics = std::make_unique<MetricsImpl>(
+			service, args["metrics.statsd_host"].as<std::string>(),
+			args["metrics.statsd_port"].as<std::uint16_t>()
+		);
+	}
+
+	if(const auto port = args["metrics.prometheus_port"].as<std::uint16_t>()) {
+		LOG_INFO(logger) << "Starting metrics exporter..." << LOG_SYNC;
+		metrics = std::make_unique<MetricsExporter>(
+			service, args["metrics.prometheus_interface"].as<std::string>(), port, std::move(metrics)
+		);
+	}
+
+	util::LogMetrics log_metrics(*logger, *metrics);
+
+	ThreadPool thread_pool(concurrency, max_conns);
 	ember::CharacterHandler handler(std::move(profanity), std::move(reserved), std::move(spam),
-	                                dbc_store, *character_dao, thread_pool, temp, logger);
+	                                dbc_store, *character_dao, thread_pool, *metrics, temp, logger);
 
-	spark::Service spark("character", service, s_address, s_port, logger);
+	spark::Service spark("character", service, s_address, s_port, logger, transport,
+	                     spark::CompressionPolicy::supported(), {}, metrics.get());
 	spark::ServiceDiscovery discovery(service, s_address, s_port, mcast_iface, mcast_group,
 	                               mcast_port, logger);
 
 	ember::Service char_service(*character_dao, handler, spark, discovery, logger);
+
+	// Start metrics polling
+	MetricsPoll poller(service, *metrics);
+	PoolMetrics pool_metrics(thread_pool);
+
+	poller.add_source([&pool_metrics](Metrics& metrics) {
+		pool_metrics.report(metrics);
+	}, 5s);
 	
 	signals.async_wait([&](const boost::system::error_code& error, int signal) {
 		LOG_INFO(logger) << APP_NAME << " shutting down..." << LOG_SYNC;
+		poller.shutdown();
 		discovery.shutdown();
 		spark.shutdown();
 		thread_pool.shutdown();
@@ -197,6 +233,7 @@ po::variables_map parse_arguments(int argc, const char* argv[]) {
 		("spark.multicast_interface", po::value<std::string>()->required())
 		("spark.multicast_group", po::value<std::string>()->required())
 		("spark.multicast_port", po::value<std::uint16_t>()->required())
+		("spark.transport", po::value<std::string>()->default_value("v1"))
 		("console_log.verbosity", po::value<std::string>()->required())
 		("console_log.filter-mask", po::value<std::uint32_t>()->default_value(0))
 		("console_log.colours", po::value<bool>()->required())
@@ -214,12 +251,19 @@ po::variables_map parse_arguments(int argc, const char* argv[]) {
 		("file_log.midnight_rotate", po::value<bool>()->required())
 		("file_log.log_timestamp", po::value<bool>()->required())
 		("file_log.log_severity", po::value<bool>()->required())
+		("file_log.fsync_severity", po::value<std::string>()->default_value("none"))
+		("file_log.compress", po::value<bool>()->default_value(false))
+		("file_log.retain_files", po::value<std::uint32_t>()->default_value(0))
+		("file_log.retain_days", po::value<std::uint32_t>()->default_value(0))
+		("file_log.retain_size", po::value<std::uint32_t>()->default_value(0))
 		("database.config_path", po::value<std::string>()->required())
 		("database.min_connections", po::value<unsigned short>()->required())
 		("database.max_connections", po::value<unsigned short>()->required())
 		("metrics.enabled", po::value<bool>()->required())
 		("metrics.statsd_host", po::value<std::string>()->required())
 		("metrics.statsd_port", po::value<std::uint16_t>()->required())
+		("metrics.prometheus_interface", po::value<std::string>()->default_value("127.0.0.1"))
+		("metrics.prometheus_port", po::value<std::uint16_t>()->default_value(0))
 		("monitor.enabled", po::value<bool>()->required())
 		("monitor.interface", po::value<std::string>()->required())
 		("monitor.port", po::value<std::uint16_t>()->required());
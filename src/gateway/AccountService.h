@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2015 - 2019 Ember
+ * Copyright (c) 2015 - 2022 Ember
  *
  * This Source Code Form is subject to the terms of the Mozilla Public
  * License, v. 2.0. If a copy of the MPL was not distributed with this
@@ -9,7 +9,9 @@
 #pragma once
 
 #include "Account_generated.h"
+#include <spark/Coroutine.h>
 #include <spark/Service.h>
+#include <spark/LoadBalancer.h>
 #include <spark/ServiceDiscovery.h>
 #include <logger/Logging.h>
 #include <shared/util/UTF8String.h>
@@ -24,27 +26,19 @@ namespace ember {
 class AccountService final : public spark::EventHandler {
 public:
 	typedef std::function<void(messaging::account::Status)> RegisterCB;
-	typedef std::function<void(messaging::account::Status, Botan::BigInt)> SessionLocateCB;
-	typedef std::function<void(messaging::account::Status, std::uint32_t)> IDLocateCB;
 
 private:
 	spark::Service& spark_;
 	spark::ServiceDiscovery& s_disc_;
 	log::Logger* logger_;
 	std::unique_ptr<spark::ServiceListener> listener_;
-	spark::Link link_;
+	spark::LoadBalancer balancer_;
 	
 	void service_located(const messaging::multicast::LocateResponse* message);
 
 	void handle_register_reply(const spark::Link& link, std::optional<spark::Message>& root,
 	                           const RegisterCB& cb) const;
 
-	void handle_locate_reply(const spark::Link& link, std::optional<spark::Message>& root,
-	                         const SessionLocateCB& cb) const;
-
-	void handle_id_locate_reply(const spark::Link& link, std::optional<spark::Message>& root,
-	                            const IDLocateCB& cb) const;
-
 public:
 	AccountService(spark::Service& spark, spark::ServiceDiscovery& s_disc, log::Logger* logger);
 	~AccountService();
@@ -53,8 +47,9 @@ public:
 	void on_link_up(const spark::Link& link) override;
 	void on_link_down(const spark::Link& link) override;
 
-	void locate_session(std::uint32_t account_id, SessionLocateCB cb) const;
-	void locate_account_id(const utf8_string& username, IDLocateCB cb) const;
+	// awaitable, see spark/Coroutine.h
+	spark::BalancedCall<messaging::account::SessionResponse> locate_session(std::uint32_t account_id) const;
+	spark::BalancedCall<messaging::account::LookupIDResponse> locate_account_id(const utf8_string& username) const;
 };
 
 } // ember
\ No newline at end of file
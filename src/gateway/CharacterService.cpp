@@ -7,7 +7,7 @@
  */
 
 #include "CharacterService.h"
-#include <spark/Helpers.h>
+#include <spark/DispatchTable.h>
 #include <boost/uuid/uuid.hpp>
 #include <utility>
 
@@ -17,7 +17,8 @@ namespace ember {
 
 CharacterService::CharacterService(spark::Service& spark, spark::ServiceDiscovery& s_disc,
                                    const Config& config, log::Logger* logger)
-                                   : spark_(spark), s_disc_(s_disc), config_(config), logger_(logger) {
+                                   : spark_(spark), s_disc_(s_disc), logger_(logger),
+                                     balancer_(spark, em::Service::CHARACTER, logger), config_(config) {
 	spark_.dispatcher()->register_handler(this, em::Service::CHARACTER,
 	                                      spark::EventDispatcher::Mode::CLIENT);
 	listener_ = std::move(s_disc_.listener(messaging::Service::CHARACTER,
@@ -31,21 +32,20 @@ CharacterService::~CharacterService() {
 
 void CharacterService::on_message(const spark::Link& link, const spark::Message& message) {
 	// we only care about tracked messages at the moment
-	LOG_WARN(logger_) << "Character service received unhandled message" << LOG_ASYNC;
+	LOG_WARN(logger_) << "Character service received unhandled message"_lit << LOG_ASYNC;
 }
 
 void CharacterService::on_link_up(const spark::Link& link) {
-	LOG_INFO(logger_) << "Link up: " << link.description << LOG_ASYNC;
-	link_ = link;
+	LOG_INFO(logger_) << "Link up: "_lit << link.description << LOG_ASYNC;
 }
 
 void CharacterService::on_link_down(const spark::Link& link) {
-	LOG_INFO(logger_) << "Link down: " << link.description << LOG_ASYNC;
+	LOG_INFO(logger_) << "Link down: "_lit << link.description << LOG_ASYNC;
 }
 
 void CharacterService::service_located(const messaging::multicast::LocateResponse* message) {
-	LOG_DEBUG(logger_) << "Located character service at " << message->ip()->str() 
-	                   << ":" << message->port() << LOG_ASYNC;
+	LOG_DEBUG(logger_) << "Located character service at "_lit << message->ip()->str() 
+	                   << ":"_lit << message->port() << LOG_ASYNC;
 	spark_.connect(message->ip()->str(), message->port());
 }
 
@@ -54,7 +54,7 @@ void CharacterService::handle_reply(const spark::Link& link,
                                     const ResponseCB& cb) const {
 	LOG_TRACE(logger_) << __func__ << LOG_ASYNC;
 
-	if(!message || !spark::Service::verify<em::character::CreateResponse>(*message)) {
+	if(!message || !spark::verify<em::character::CreateResponse>(link, *message)) {
 		cb(em::character::Status::SERVER_LINK_ERROR, protocol::Result::RESPONSE_FAILURE);
 		return;
 	}
@@ -68,7 +68,7 @@ void CharacterService::handle_rename_reply(const spark::Link& link,
                                            const RenameCB& cb) const {
 	LOG_TRACE(logger_) << __func__ << LOG_ASYNC;
 
-	if(!message || !spark::Service::verify<em::character::RenameResponse>(*message)) {
+	if(!message || !spark::verify<em::character::RenameResponse>(link, *message)) {
 		cb(em::character::Status::SERVER_LINK_ERROR, protocol::Result::CHAR_NAME_FAILURE, 0, "");
 		return;
 	}
@@ -90,7 +90,7 @@ void CharacterService::handle_retrieve_reply(const spark::Link& link,
                                              const RetrieveCB& cb) const {
 	LOG_TRACE(logger_) << __func__ << LOG_ASYNC;
 
-	if(!message || !spark::Service::verify<em::character::RetrieveResponse>(*message)) {
+	if(!message || !spark::verify<em::character::RetrieveResponse>(link, *message)) {
 		cb(em::character::Status::SERVER_LINK_ERROR, {});
 		return;
 	}
@@ -137,7 +137,7 @@ void CharacterService::create_character(std::uint32_t account_id, const Characte
                                         ResponseCB cb) const {
 	LOG_TRACE(logger_) << __func__ << LOG_ASYNC;
 
-	auto fbb = std::make_shared<flatbuffers::FlatBufferBuilder>();
+	auto fbb = spark::make_buffer();
 	const auto opcode = std::to_underlying(em::character::Opcode::CMSG_CHAR_CREATE);
 
 	em::character::CharacterTemplateBuilder cbb(*fbb);
@@ -158,9 +158,9 @@ void CharacterService::create_character(std::uint32_t account_id, const Characte
 	msg.add_realm_id(config_.realm->id);
 	msg.Finish();
 
-	if(spark_.send(link_, opcode, fbb, [this, cb](auto link, auto message) {
+	if(!spark::Service::accepted(balancer_.send(account_id, opcode, fbb, [this, cb](auto link, auto message) {
 		handle_reply(link, message, cb);
-	}) != spark::Service::Result::OK) {
+	}, spark::LoadBalancer::Resend::NEVER))) {
 		cb(em::character::Status::SERVER_LINK_ERROR, {});
 	}
 }
@@ -171,7 +171,7 @@ void CharacterService::rename_character(std::uint32_t account_id, std::uint64_t
 
 
 	const auto opcode = std::to_underlying(em::character::Opcode::CMSG_CHAR_RENAME);
-	auto fbb = std::make_shared<flatbuffers::FlatBufferBuilder>();
+	auto fbb = spark::make_buffer();
 	auto fb_name = fbb->CreateString(name);
 
 	em::character::RenameBuilder msg(*fbb);
@@ -181,9 +181,9 @@ void CharacterService::rename_character(std::uint32_t account_id, std::uint64_t
 	msg.add_name(fb_name);
 	msg.Finish();
 
-	if(spark_.send(link_, opcode, fbb, [this, cb](auto link, auto message) {
+	if(!spark::Service::accepted(balancer_.send(account_id, opcode, fbb, [this, cb](auto link, auto message) {
 		handle_rename_reply(link, message, cb);
-	}) != spark::Service::Result::OK) {
+	}, spark::LoadBalancer::Resend::NEVER))) {
 		cb(em::character::Status::SERVER_LINK_ERROR, protocol::Result::CHAR_NAME_FAILURE, 0, "");
 	}
 }
@@ -191,16 +191,16 @@ void CharacterService::retrieve_characters(std::uint32_t account_id, RetrieveCB
 	LOG_TRACE(logger_) << __func__ << LOG_ASYNC;
 
 	const auto opcode = std::to_underlying(em::character::Opcode::CMSG_CHAR_ENUM);
-	auto fbb = std::make_shared<flatbuffers::FlatBufferBuilder>();
+	auto fbb = spark::make_buffer();
 
 	em::character::RetrieveBuilder msg(*fbb);
 	msg.add_account_id(account_id);
 	msg.add_realm_id(config_.realm->id);
 	msg.Finish();
 
-	if(spark_.send(link_, opcode, fbb, [this, cb](auto link, auto message) {
+	if(!spark::Service::accepted(balancer_.send(account_id, opcode, fbb, [this, cb](auto link, auto message) {
 		handle_retrieve_reply(link, message, cb);
-	}) != spark::Service::Result::OK) {
+	}))) {
 		cb(em::character::Status::SERVER_LINK_ERROR, {});
 	}
 }
@@ -210,7 +210,7 @@ void CharacterService::delete_character(std::uint32_t account_id, std::uint64_t
 	LOG_TRACE(logger_) << __func__ << LOG_ASYNC;
 
 	const auto opcode = std::to_underlying(em::character::Opcode::CMSG_CHAR_DELETE);
-	auto fbb = std::make_shared<flatbuffers::FlatBufferBuilder>();
+	auto fbb = spark::make_buffer();
 
 	em::character::DeleteBuilder msg(*fbb);
 	msg.add_account_id (account_id);
@@ -218,9 +218,9 @@ void CharacterService::delete_character(std::uint32_t account_id, std::uint64_t
 	msg.add_realm_id(config_.realm->id);
 	msg.Finish();
 
-	if(spark_.send(link_, opcode, fbb, [this, cb](auto link, auto message) {
+	if(!spark::Service::accepted(balancer_.send(account_id, opcode, fbb, [this, cb](auto link, auto message) {
 		handle_reply(link, message, cb);
-	}) != spark::Service::Result::OK) {
+	}, spark::LoadBalancer::Resend::NEVER))) {
 		cb(em::character::Status::SERVER_LINK_ERROR, {});
 	}
 }
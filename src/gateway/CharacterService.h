@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2016 - 2019 Ember
+ * Copyright (c) 2016 - 2022 Ember
  *
  * This Source Code Form is subject to the terms of the Mozilla Public
  * License, v. 2.0. If a copy of the MPL was not distributed with this
@@ -12,6 +12,7 @@
 #include "Services_generated.h"
 #include "Character_generated.h"
 #include <spark/Service.h>
+#include <spark/LoadBalancer.h>
 #include <spark/ServiceDiscovery.h>
 #include <protocol/ResultCodes.h>
 #include <logger/Logging.h>
@@ -37,7 +38,7 @@ private:
 	spark::ServiceDiscovery& s_disc_;
 	log::Logger* logger_;
 	std::unique_ptr<spark::ServiceListener> listener_;
-	spark::Link link_;
+	spark::LoadBalancer balancer_;
 	const Config& config_;
 	
 	void service_located(const messaging::multicast::LocateResponse* message);
@@ -147,7 +147,7 @@ void ClientConnection::start() {
 
 void ClientConnection::stop() {
 	LOG_DEBUG_FILTER(logger_, LF_NETWORK)
-		<< "Closing connection to " << remote_address() << LOG_ASYNC;
+		<< "Closing connection to "_lit << remote_address() << LOG_ASYNC;
 
 	handler_.stop();
 	boost::system::error_code ec; // we don't care about any errors
@@ -233,8 +233,8 @@ void ClientConnection::async_shutdown(std::shared_ptr<ClientConnection> client)
 	client->terminate();
 
 	boost::asio::post(client->socket_.get_executor(), [client]() {
-		LOG_TRACE_FILTER_GLOB(LF_NETWORK) << "Handler for " << client->remote_address()
-			<< " destroyed" << LOG_ASYNC;
+		LOG_TRACE_FILTER_GLOB(LF_NETWORK) << "Handler for "_lit << client->remote_address()
+			<< " destroyed"_lit << LOG_ASYNC;
 	});
 }
 
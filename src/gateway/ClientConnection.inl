@@ -14,7 +14,7 @@
 
 template<typename PacketT>
 void ClientConnection::send(const PacketT& packet) {
-	LOG_TRACE_FILTER(logger_, LF_NETWORK) << remote_address() << " <- "
+	LOG_TRACE_FILTER(logger_, LF_NETWORK) << remote_address() << " <- "_lit
 		<< protocol::to_string(packet.opcode) << LOG_ASYNC;
 
 	spark::BinaryStream stream(*outbound_back_);
@@ -15,10 +15,34 @@
 #include "ClientLogHelper.h"
 #include <protocol/Packets.h>
 #include <spark/buffers/BinaryStream.h>
+#include <shared/metrics/Metrics.h>
+#include <chrono>
+#include <string>
+#include <unordered_map>
 #include <utility>
 
 namespace ember {
 
+namespace {
+
+// built once so handling a packet never has to put a metrics key together
+const auto handler_keys = [] {
+	std::unordered_map<std::uint32_t, std::string> keys;
+
+	for(const auto& [opcode, name] : protocol::ClientOpcode_enum_names) {
+		keys.emplace(opcode, "gateway.handler." + name);
+	}
+
+	return keys;
+}();
+
+const char* handler_key(const protocol::ClientOpcode opcode) {
+	const auto it = handler_keys.find(std::to_underlying(opcode));
+	return it == handler_keys.end()? "gateway.handler.unknown" : it->second.c_str();
+}
+
+} // unnamed
+
 void ClientHandler::start() {
 	Locator::dispatcher()->register_handler(this);
 	enter_states[context_.state](context_);
@@ -38,7 +62,7 @@ void ClientHandler::handle_message(spark::BinaryStream& stream) {
 	stream >> opcode_;
 
 	CLIENT_TRACE_FILTER(logger_, LF_NETWORK, context_)
-		<< " -> " << protocol::to_string(opcode_) << LOG_ASYNC;
+		<< " -> "_lit << protocol::to_string(opcode_) << LOG_ASYNC;
 
 	// handle ping & keep-alive as special cases
 	switch(opcode_) {
@@ -51,7 +75,15 @@ void ClientHandler::handle_message(spark::BinaryStream& stream) {
 			break;
 	}
 
-	update_packet[context_.state](context_, opcode_);
+	const auto opcode = opcode_;
+	const auto start = std::chrono::steady_clock::now();
+	update_packet[context_.state](context_, opcode);
+
+	if(auto metrics = Locator::metrics()) {
+		const auto elapsed = std::chrono::steady_clock::now() - start;
+		metrics->timing(handler_key(opcode),
+			std::chrono::duration_cast<std::chrono::microseconds>(elapsed));
+	}
 }
 
 void ClientHandler::handle_event(const Event* event) {
@@ -64,8 +96,8 @@ void ClientHandler::handle_event(std::unique_ptr<const Event> event) {
 
 void ClientHandler::state_update(ClientState new_state) {
 	CLIENT_DEBUG_FILTER(logger_, LF_NETWORK, context_)
-		<< "State change, " << ClientState_to_string(context_.state)
-		<< " => " << ClientState_to_string(new_state) << LOG_SYNC;
+		<< "State change, "_lit << ClientState_to_string(context_.state)
+		<< " => "_lit << ClientState_to_string(new_state) << LOG_SYNC;
 
 	context_.prev_state = context_.state;
 	context_.state = new_state;
@@ -74,10 +106,11 @@ void ClientHandler::state_update(ClientState new_state) {
 }
 
 void ClientHandler::packet_skip(spark::BinaryStream& stream) {
-	CLIENT_DEBUG_FILTER(logger_, LF_NETWORK, context_)
-		<< ClientState_to_string(context_.state) << " skipping "
+	LOG_LIMIT_FILTER(logger_, DEBUG, LF_NETWORK, 10, 50)
+		<< client_identify()
+		<< ClientState_to_string(context_.state) << " skipping "_lit
 		<< protocol::to_string(opcode_)
-		<< " (" << std::to_underlying(opcode_) << ")" << LOG_ASYNC;
+		<< " ("_lit << std::to_underlying(opcode_) << ")"_lit << LOG_ASYNC;
 
 	stream.skip(stream.read_limit() - stream.total_read());
 }
@@ -29,24 +29,25 @@ bool ClientHandler::packet_deserialise(PacketT& packet, spark::BinaryStream& str
 		* occurs. Don't try to recover.
 		*/
 		if(state == spark::BinaryStream::State::READ_LIMIT_ERR) {
-			LOG_DEBUG_FILTER(logger_, LF_NETWORK)
-				<< "Deserialisation of "
+			// a misbehaving client can send these as fast as we can read them
+			LOG_LIMIT_FILTER(logger_, DEBUG, LF_NETWORK, 10, 50)
+				<< "Deserialisation of "_lit
 				<< protocol::to_string(packet.opcode)
-				<< " failed, skipping any remaining data" << LOG_ASYNC;
+				<< " failed, skipping any remaining data"_lit << LOG_ASYNC;
 
 			stream.skip(stream.read_limit() - stream.total_read());
 		} else if(state == spark::BinaryStream::State::BUFF_LIMIT_ERR) {
 			LOG_ERROR_FILTER(logger_, LF_NETWORK)
-				<< "Message framing lost at "
+				<< "Message framing lost at "_lit
 				<< protocol::to_string(packet.opcode)
-				<< " from " << client_identify() << LOG_ASYNC;
+				<< " from "_lit << client_identify() << LOG_ASYNC;
 
 			close();
 		} else {
 			LOG_ERROR_FILTER(logger_, LF_NETWORK)
-				<< "Deserialisation failed but stream has not errored for "
+				<< "Deserialisation failed but stream has not errored for "_lit
 				<< protocol::to_string(packet.opcode)
-				<< " from " << client_identify() << LOG_ASYNC;
+				<< " from "_lit << client_identify() << LOG_ASYNC;
 
 			close();
 		}
@@ -55,10 +56,10 @@ bool ClientHandler::packet_deserialise(PacketT& packet, spark::BinaryStream& str
 	}
 
 	if(stream.read_limit() != stream.total_read()) {
-		LOG_DEBUG_FILTER(logger_, LF_NETWORK)
-			<< "Skipping superfluous stream data in message "
+		LOG_LIMIT_FILTER(logger_, DEBUG, LF_NETWORK, 10, 50)
+			<< "Skipping superfluous stream data in message "_lit
 			<< protocol::to_string(packet.opcode)
-			<< " from " << client_identify() << LOG_ASYNC;
+			<< " from "_lit << client_identify() << LOG_ASYNC;
 
 		stream.skip(stream.read_limit() - stream.total_read());
 	}
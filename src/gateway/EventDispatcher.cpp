@@ -20,7 +20,7 @@ void EventDispatcher::post_event(const ClientUUID& client, std::unique_ptr<Event
 
 	// bad service index encoded in the UUID
 	if(service == nullptr) {
-		LOG_ERROR_GLOB << "Invalid service index, " << client.service() << LOG_ASYNC;
+		LOG_ERROR_GLOB << "Invalid service index, "_lit << client.service() << LOG_ASYNC;
 		return;
 	}
 
@@ -28,7 +28,7 @@ void EventDispatcher::post_event(const ClientUUID& client, std::unique_ptr<Event
 		const auto handler = handlers_.find(client);
 
 		if(handler == handlers_.end()) {
-			LOG_DEBUG_GLOB << "Client disconnected, event discarded" << LOG_ASYNC;
+			LOG_DEBUG_GLOB << "Client disconnected, event discarded"_lit << LOG_ASYNC;
 			return;
 		}
 
@@ -36,6 +36,22 @@ void EventDispatcher::post_event(const ClientUUID& client, std::unique_ptr<Event
 	});
 }
 
+/*
+ * Runs the coroutine on the client's io_context. It may outlive the client,
+ * so it should only reach the client through events posted to it.
+ */
+void EventDispatcher::spawn(const ClientUUID& client, spark::Task task) const {
+	auto service = pool_.get_service(client.service());
+
+	// bad service index encoded in the UUID
+	if(service == nullptr) {
+		LOG_ERROR_GLOB << "Invalid service index, "_lit << client.service() << LOG_ASYNC;
+		return;
+	}
+
+	spark::spawn(*service, std::move(task));
+}
+
 /*
  * This function is intended only for broadcasts of a single event to a
  * large number of clients. The goal here is to minimise the number of
@@ -83,7 +99,7 @@ void EventDispatcher::broadcast_event(std::vector<ClientUUID> clients,
 				const auto handler = handlers_.find(*it++);
 
 				if(handler == handlers_.end()) {
-					LOG_DEBUG_GLOB << "Client disconnected, event discarded" << LOG_ASYNC;
+					LOG_DEBUG_GLOB << "Client disconnected, event discarded"_lit << LOG_ASYNC;
 					continue;
 				}
 
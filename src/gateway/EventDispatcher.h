@@ -12,6 +12,7 @@
 #include "ClientHandler.h"
 #include <shared/threading/ServicePool.h>
 #include <shared/ClientUUID.h>
+#include <spark/Coroutine.h>
 #include <concepts>
 #include <memory>
 #include <unordered_map>
@@ -33,14 +34,14 @@ public:
 
 		// bad service index encoded in the UUID
 		if(service == nullptr) {
-			LOG_ERROR_GLOB << "Invalid service index, " << client.service() << LOG_ASYNC;
+			LOG_ERROR_GLOB << "Invalid service index, "_lit << client.service() << LOG_ASYNC;
 			return;
 		}
 
 		service->post([client, work] {
 			// client disconnected, nothing to do here
 			if(!handlers_.contains(client)) {
-				LOG_DEBUG_GLOB << "Client disconnected, work discarded" << LOG_ASYNC;
+				LOG_DEBUG_GLOB << "Client disconnected, work discarded"_lit << LOG_ASYNC;
 				return;
 			}
 
@@ -53,7 +54,7 @@ public:
 
 		// bad service index encoded in the UUID
 		if(service == nullptr) {
-			LOG_ERROR_GLOB << "Invalid service index, " << client.service() << LOG_ASYNC;
+			LOG_ERROR_GLOB << "Invalid service index, "_lit << client.service() << LOG_ASYNC;
 			return;
 		}
 
@@ -62,7 +63,7 @@ public:
 
 			// client disconnected, nothing to do here
 			if(handler == handlers_.end()) {
-				LOG_DEBUG_GLOB << "Client disconnected, event discarded" << LOG_ASYNC;
+				LOG_DEBUG_GLOB << "Client disconnected, event discarded"_lit << LOG_ASYNC;
 				return;
 			}
 
@@ -71,6 +72,7 @@ public:
 	}
 
 	void post_event(const ClientUUID& client, std::unique_ptr<Event> event) const;
+	void spawn(const ClientUUID& client, spark::Task task) const;
 	void broadcast_event(std::vector<ClientUUID> clients, std::shared_ptr<const Event> event) const;
 	void register_handler(ClientHandler* handler);
 	void remove_handler(ClientHandler* handler);
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2016 Ember
+ * Copyright (c) 2016 - 2022 Ember
  *
  * This Source Code Form is subject to the terms of the Mozilla Public
  * License, v. 2.0. If a copy of the MPL was not distributed with this
@@ -16,5 +16,6 @@ AccountService* Locator::account_;
 RealmService* Locator::realm_;
 RealmQueue* Locator::queue_;
 Config* Locator::config_;
+Metrics* Locator::metrics_;
 
 } // ember
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2016 Ember
+ * Copyright (c) 2016 - 2022 Ember
  *
  * This Source Code Form is subject to the terms of the Mozilla Public
  * License, v. 2.0. If a copy of the MPL was not distributed with this
@@ -15,6 +15,7 @@ class CharacterService;
 class AccountService;
 class RealmService;
 class RealmQueue;
+class Metrics;
 struct Config;
 
 class Locator {
@@ -24,9 +25,11 @@ class Locator {
 	static RealmService* realm_;
 	static RealmQueue* queue_;
 	static Config* config_;
+	static Metrics* metrics_;
 
 public:
 	static void set(Config* config) { config_ = config; }
+	static void set(Metrics* metrics) { metrics_ = metrics; }
 	static void set(RealmQueue* queue) { queue_ = queue; }
 	static void set(RealmService* realm) { realm_ = realm; }
 	static void set(AccountService* account) { account_ = account; }
@@ -34,6 +37,7 @@ public:
 	static void set(EventDispatcher* dispatcher) { dispatcher_ = dispatcher; }
 
 	static Config* config() { return config_; }
+	static Metrics* metrics() { return metrics_; }
 	static RealmQueue* queue() { return queue_; }
 	static RealmService* realm() { return realm_; }
 	static AccountService* account() { return account_; }
@@ -48,10 +48,10 @@ class NetworkListener {
 
 				if(ec) {
 					LOG_DEBUG_FILTER(logger_, LF_NETWORK)
-						<< "Aborted connection, remote peer disconnected" << LOG_ASYNC;
+						<< "Aborted connection, remote peer disconnected"_lit << LOG_ASYNC;
 				} else {
 					LOG_DEBUG_FILTER(logger_, LF_NETWORK)
-						<< "Accepted connection " << ep.address().to_string() << LOG_ASYNC;
+						<< "Accepted connection "_lit << ep.address().to_string() << LOG_ASYNC;
 
 					auto client = std::make_unique<ClientConnection>(
 						sessions_, std::move(socket_), ep,
@@ -16,7 +16,7 @@ namespace ember {
 RealmService::RealmService(Realm realm, spark::Service& spark, spark::ServiceDiscovery& discovery,
                            log::Logger* logger)
                            : realm_(realm), spark_(spark), discovery_(discovery), logger_(logger) {
-	REGISTER(em::realm::Opcode::CMSG_REALM_STATUS, em::realm::RequestRealmStatus, RealmService::send_status);
+	handlers_.add<em::realm::Opcode::CMSG_REALM_STATUS, &RealmService::send_status>(this);
 
 	spark_.dispatcher()->register_handler(this, em::Service::GATEWAY, spark::EventDispatcher::Mode::SERVER);
 	discovery_.register_service(em::Service::GATEWAY);
@@ -28,23 +28,17 @@ RealmService::~RealmService() {
 }
 
 void RealmService::on_message(const spark::Link& link, const spark::Message& message) {
-	const auto handler = handlers_.find(static_cast<messaging::realm::Opcode>(message.opcode));
+	const auto result = handlers_.dispatch(link, message);
 
-	if(handler == handlers_.end()) {
+	if(result == em::realm::DispatchTable::Result::UNHANDLED) {
 		LOG_WARN_FILTER(logger_, LF_SPARK)
-			<< "[spark] Unhandled message received from "
+			<< "[spark] Unhandled message received from "_lit
 			<< link.description << LOG_ASYNC;
-		return;
-	}
-
-	if(!handler->second.verify(message)) {
+	} else if(result == em::realm::DispatchTable::Result::BAD_MESSAGE) {
 		LOG_WARN_FILTER(logger_, LF_SPARK)
-			<< "[spark] Bad message received from "
+			<< "[spark] Bad message received from "_lit
 			<< link.description << LOG_ASYNC;
-		return;
 	}
-
-	handler->second.handle(link, message);
 }
 
 void RealmService::set_online() {
@@ -57,15 +51,16 @@ void RealmService::set_offline() {
 	broadcast_status();
 }
 
-void RealmService::send_status(const spark::Link& link, const spark::Message& message) const {
+void RealmService::send_status(const spark::Link& link, const spark::Message& message,
+                               const em::realm::RequestRealmStatus& /*request*/) const {
 	LOG_TRACE(logger_) << __func__ << LOG_ASYNC;
 	const auto opcode = std::to_underlying(em::realm::Opcode::SMSG_REALM_STATUS);
 	auto fbb = build_status();
 	spark_.send(link, opcode, fbb, message.token);
 }
 
-std::shared_ptr<flatbuffers::FlatBufferBuilder> RealmService::build_status() const {
-	auto fbb = std::make_shared<flatbuffers::FlatBufferBuilder>();
+spark::BufferHandle RealmService::build_status() const {
+	auto fbb = spark::make_buffer();
 
 	auto fb_name = fbb->CreateString(realm_.name);
 	auto fb_ip = fbb->CreateString(realm_.ip);
@@ -90,11 +85,11 @@ void RealmService::broadcast_status() const {
 }
 
 void RealmService::on_link_up(const spark::Link& link) { 
-	LOG_DEBUG(logger_) << "Link up: " << link.description << LOG_ASYNC;
+	LOG_DEBUG(logger_) << "Link up: "_lit << link.description << LOG_ASYNC;
 }
 
 void RealmService::on_link_down(const spark::Link& link) {
-	LOG_DEBUG(logger_) << "Link down: " << link.description << LOG_ASYNC;
+	LOG_DEBUG(logger_) << "Link down: "_lit << link.description << LOG_ASYNC;
 }
 
 } // ember
\ No newline at end of file
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2015, 2016 Ember
+ * Copyright (c) 2015 - 2022 Ember
  *
  * This Source Code Form is subject to the terms of the Mozilla Public
  * License, v. 2.0. If a copy of the MPL was not distributed with this
@@ -8,12 +8,11 @@
 
 #pragma once
 
-#include "RealmStatus_generated.h"
+#include "RealmStatus_dispatch.h"
 #include <shared/Realm.h>
 #include <spark/Service.h>
 #include <spark/Common.h>
 #include <spark/ServiceDiscovery.h>
-#include <spark/Helpers.h>
 #include <logger/Logging.h>
 #include <memory>
 
@@ -24,11 +23,12 @@ class RealmService final : public spark::EventHandler {
 	spark::Service& spark_;
 	spark::ServiceDiscovery& discovery_;
 	log::Logger* logger_;
-	std::unordered_map<messaging::realm::Opcode, spark::LocalDispatcher> handlers_;
+	messaging::realm::DispatchTable handlers_;
 	
-	std::shared_ptr<flatbuffers::FlatBufferBuilder> build_status() const;
+	spark::BufferHandle build_status() const;
 	void broadcast_status() const;
-	void send_status(const spark::Link& link, const spark::Message& message) const;
+	void send_status(const spark::Link& link, const spark::Message& message,
+	                 const messaging::realm::RequestRealmStatus& request) const;
 
 public:
 	RealmService(Realm realm, spark::Service& spark, spark::ServiceDiscovery& discovery, log::Logger* logger);
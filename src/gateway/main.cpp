@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2015 - 2020 Ember
+ * Copyright (c) 2015 - 2022 Ember
  *
  * This Source Code Form is subject to the terms of the Mozilla Public
  * License, v. 2.0. If a copy of the MPL was not distributed with this
@@ -28,6 +28,8 @@
 #include <dbcreader/DBCReader.h>
 #include <shared/database/daos/RealmDAO.h>
 #include <shared/database/daos/UserDAO.h>
+#include <shared/metrics/MetricsExporter.h>
+#include <shared/metrics/MetricsImpl.h>
 #include <shared/threading/ServicePool.h>
 #include <shared/util/xoroshiro128plus.h>
 #include <boost/asio.hpp>
@@ -77,10 +79,10 @@ int main(int argc, const char* argv[]) try {
 
 	auto logger = util::init_logging(args);
 	log::set_global_logger(logger.get());
-	LOG_INFO(logger) << "Logger configured successfully" << LOG_SYNC;
+	LOG_INFO(logger) << "Logger configured successfully"_lit << LOG_SYNC;
 
 	const auto ret = launch(args, logger.get());
-	LOG_INFO(logger) << APP_NAME << " terminated" << LOG_SYNC;
+	LOG_INFO(logger) << APP_NAME << " terminated"_lit << LOG_SYNC;
 	return ret;
 } catch(const std::exception& e) {
 	std::cerr << e.what();
@@ -91,38 +93,38 @@ namespace ember {
 
 int launch(const po::variables_map& args, log::Logger* logger) try {
 #ifdef DEBUG_NO_THREADS
-	LOG_WARN(logger) << "Compiled with DEBUG_NO_THREADS!" << LOG_SYNC;
+	LOG_WARN(logger) << "Compiled with DEBUG_NO_THREADS!"_lit << LOG_SYNC;
 #endif
 
-	LOG_INFO(logger) << "Seeding xorshift RNG..." << LOG_SYNC;
+	LOG_INFO(logger) << "Seeding xorshift RNG..."_lit << LOG_SYNC;
 	Botan::AutoSeeded_RNG rng;
 	rng.randomize((std::uint8_t*)ember::rng::xorshift::seed, sizeof(ember::rng::xorshift::seed));
 
-	LOG_INFO(logger) << "Loading DBC data..." << LOG_SYNC;
+	LOG_INFO(logger) << "Loading DBC data..."_lit << LOG_SYNC;
 	dbc::DiskLoader loader(args["dbc.path"].as<std::string>(), [&](auto message) {
 		LOG_DEBUG(logger) << message << LOG_SYNC;
 	});
 
 	auto dbc_store = loader.load({"AddonData", "Cfg_Categories"});
 
-	LOG_INFO(logger) << "Resolving DBC references..." << LOG_SYNC;
+	LOG_INFO(logger) << "Resolving DBC references..."_lit << LOG_SYNC;
 	dbc::link(dbc_store);
 
-	LOG_INFO(logger) << "Initialising database driver..." << LOG_SYNC;
+	LOG_INFO(logger) << "Initialising database driver..."_lit << LOG_SYNC;
 	auto db_config_path = args["database.config_path"].as<std::string>();
 	auto driver(ember::drivers::init_db_driver(db_config_path));
 
-	LOG_INFO(logger) << "Initialising database connection pool..." << LOG_SYNC;
+	LOG_INFO(logger) << "Initialising database connection pool..."_lit << LOG_SYNC;
 	ep::Pool<decltype(driver), ep::CheckinClean, ep::ExponentialGrowth> pool(driver, 1, 1, 30s);
 	
 	pool.logging_callback([logger](auto severity, auto message) {
 		pool_log_callback(severity, message, logger);
 	});
 
-	LOG_INFO(logger) << "Initialising DAOs..." << LOG_SYNC;
+	LOG_INFO(logger) << "Initialising DAOs..."_lit << LOG_SYNC;
 	auto realm_dao = ember::dal::realm_dao(pool);
 
-	LOG_INFO(logger) << "Retrieving realm information..."<< LOG_SYNC;
+	LOG_INFO(logger) << "Retrieving realm information..."_lit<< LOG_SYNC;
 	auto realm = realm_dao->get_realm(args["realm.id"].as<unsigned int>());
 	
 	if(!realm) {
@@ -132,8 +134,8 @@ int launch(const po::variables_map& args, log::Logger* logger) try {
 	// Validate category & region
 	auto cat_name = category_name(*realm, dbc_store.cfg_categories);
 
-	LOG_INFO(logger) << "Serving as gateway for " << realm->name
-	                 << " (" << cat_name << ")" << LOG_SYNC;
+	LOG_INFO(logger) << "Serving as gateway for "_lit << realm->name
+	                 << " ("_lit << cat_name << ")"_lit << LOG_SYNC;
 
 	util::set_window_title(std::string(APP_NAME) + " - " + realm->name);
 
@@ -151,23 +153,46 @@ int launch(const po::variables_map& args, log::Logger* logger) try {
 	}
 
 	// Start ASIO service pool
-	LOG_INFO(logger) << "Starting service pool with " << concurrency << " threads..." << LOG_SYNC;
+	LOG_INFO(logger) << "Starting service pool with "_lit << concurrency << " threads..."_lit << LOG_SYNC;
 	ServicePool service_pool(concurrency);
 
-	LOG_INFO(logger) << "Starting event dispatcher..." << LOG_SYNC;
+	LOG_INFO(logger) << "Starting event dispatcher..."_lit << LOG_SYNC;
 	EventDispatcher dispatcher(service_pool);
 
-	LOG_INFO(logger) << "Starting Spark service..." << LOG_SYNC;
+	LOG_INFO(logger) << "Starting Spark service..."_lit << LOG_SYNC;
 	auto s_address = args["spark.address"].as<std::string>();
 	auto s_port = args["spark.port"].as<std::uint16_t>();
 	auto mcast_group = args["spark.multicast_group"].as<std::string>();
 	auto mcast_iface = args["spark.multicast_interface"].as<std::string>();
 	auto mcast_port = args["spark.multicast_port"].as<std::uint16_t>();
+	auto transport = args["spark.transport"].as<std::string>() == "v2"?
+		spark::Transport::V2 : spark::Transport::V1;
 	auto spark_filter = log::Filter(FilterType::LF_SPARK);
 
 	auto& service = service_pool.get_service();
 
-	spark::Service spark("gateway-" + realm->name, service, s_address, s_port, logger);
+	// Start metrics service
+	auto metrics = std::make_unique<Metrics>();
+
+	if(args["metrics.enabled"].as<bool>()) {
+		LOG_INFO(logger) << "Starting metrics service..."_lit << LOG_SYNC;
+		metrics = std::make_unique<MetricsImpl>(
+			service, args["metrics.statsd_host"].as<std::string>(),
+			args["metrics.statsd_port"].as<std::uint16_t>()
+		);
+	}
+
+	if(const auto port = args["metrics.prometheus_port"].as<std::uint16_t>()) {
+		LOG_INFO(logger) << "Starting metrics exporter..."_lit << LOG_SYNC;
+		metrics = std::make_unique<MetricsExporter>(
+			service, args["metrics.prometheus_interface"].as<std::string>(), port, std::move(metrics)
+		);
+	}
+
+	util::LogMetrics log_metrics(*logger, *metrics);
+
+	spark::Service spark("gateway-" + realm->name, service, s_address, s_port, logger, transport,
+	                     spark::CompressionPolicy::supported(), {}, metrics.get());
 	spark::ServiceDiscovery discovery(service, s_address, s_port, mcast_iface, mcast_group,
 	                                  mcast_port, logger);
 
@@ -183,13 +208,14 @@ int launch(const po::variables_map& args, log::Logger* logger) try {
 	Locator::set(&acct_svc);
 	Locator::set(&char_svc);
 	Locator::set(&config);
+	Locator::set(metrics.get());
 	
 	// Start network listener
 	auto interface = args["network.interface"].as<std::string>();
 	auto port = args["network.port"].as<std::uint16_t>();
 	auto tcp_no_delay = args["network.tcp_no_delay"].as<bool>();
 
-	LOG_INFO(logger) << "Starting network service on " << interface << ":" << port << LOG_SYNC;
+	LOG_INFO(logger) << "Starting network service on "_lit << interface << ":"_lit << port << LOG_SYNC;
 
 	NetworkListener server(service_pool, interface, port, tcp_no_delay, logger);
 
@@ -197,18 +223,18 @@ int launch(const po::variables_map& args, log::Logger* logger) try {
 	boost::asio::signal_set signals(wait_svc, SIGINT, SIGTERM);
 
 	signals.async_wait([&](const boost::system::error_code& error, int signal) {
-		LOG_DEBUG(logger) << "Received signal " << signal << LOG_SYNC;
+		LOG_DEBUG(logger) << "Received signal "_lit << signal << LOG_SYNC;
 	});
 
 	service.dispatch([&, logger]() {
 		realm_svc.set_online();
-		LOG_INFO(logger) << APP_NAME << " started successfully" << LOG_SYNC;
+		LOG_INFO(logger) << APP_NAME << " started successfully"_lit << LOG_SYNC;
 	});
 
 	service_pool.run();
 	wait_svc.run();
 
-	LOG_INFO(logger) << APP_NAME << " shutting down..." << LOG_SYNC;
+	LOG_INFO(logger) << APP_NAME << " shutting down..."_lit << LOG_SYNC;
 	return EXIT_SUCCESS;
 } catch(const std::exception& e) {
 	LOG_FATAL(logger) << e.what() << LOG_SYNC;
@@ -250,10 +276,14 @@ po::variables_map parse_arguments(int argc, const char* argv[]) {
 		("spark.multicast_interface", po::value<std::string>()->required())
 		("spark.multicast_group", po::value<std::string>()->required())
 		("spark.multicast_port", po::value<std::uint16_t>()->required())
+		("spark.transport", po::value<std::string>()->default_value("v1"))
 		("network.interface", po::value<std::string>()->required())
 		("network.port", po::value<std::uint16_t>()->required())
 		("network.tcp_no_delay", po::value<bool>()->required())
 		("network.compression", po::value<std::uint8_t>()->required())
+		("logging.capture", po::value<std::string>()->default_value("text"))
+		("logging.overflow", po::value<std::string>()->default_value("severity"))
+		("logging.overflow_threshold", po::value<std::string>()->default_value("warning"))
 		("console_log.verbosity", po::value<std::string>()->required())
 		("console_log.filter-mask", po::value<std::uint32_t>()->default_value(0))
 		("console_log.colours", po::value<bool>()->required())
@@ -262,6 +292,8 @@ po::variables_map parse_arguments(int argc, const char* argv[]) {
 		("remote_log.service_name", po::value<std::string>()->required())
 		("remote_log.host", po::value<std::string>()->required())
 		("remote_log.port", po::value<std::uint16_t>()->required())
+		("remote_log.transport", po::value<std::string>()->default_value("udp"))
+		("remote_log.own_thread", po::value<bool>()->default_value(false))
 		("file_log.verbosity", po::value<std::string>()->required())
 		("file_log.filter-mask", po::value<std::uint32_t>()->default_value(0))
 		("file_log.path", po::value<std::string>()->default_value("gateway.log"))
@@ -271,10 +303,17 @@ po::variables_map parse_arguments(int argc, const char* argv[]) {
 		("file_log.midnight_rotate", po::value<bool>()->required())
 		("file_log.log_timestamp", po::value<bool>()->required())
 		("file_log.log_severity", po::value<bool>()->required())
+		("file_log.fsync_severity", po::value<std::string>()->default_value("none"))
+		("file_log.compress", po::value<bool>()->default_value(false))
+		("file_log.retain_files", po::value<std::uint32_t>()->default_value(0))
+		("file_log.retain_days", po::value<std::uint32_t>()->default_value(0))
+		("file_log.retain_size", po::value<std::uint32_t>()->default_value(0))
 		("database.config_path", po::value<std::string>()->required())
 		("metrics.enabled", po::value<bool>()->required())
 		("metrics.statsd_host", po::value<std::string>()->required())
 		("metrics.statsd_port", po::value<std::uint16_t>()->required())
+		("metrics.prometheus_interface", po::value<std::string>()->default_value("127.0.0.1"))
+		("metrics.prometheus_port", po::value<std::uint16_t>()->default_value(0))
 		("monitor.enabled", po::value<bool>()->required())
 		("monitor.interface", po::value<std::string>()->required())
 		("monitor.port", po::value<std::uint16_t>()->required());
@@ -322,7 +361,7 @@ void pool_log_callback(ep::Severity severity, std::string_view message, log::Log
 			LOG_FATAL_FILTER(logger, LF_DB_CONN_POOL) << message << LOG_ASYNC;
 			break;
 		default:
-			LOG_ERROR_FILTER(logger, LF_DB_CONN_POOL) << "Unhandled pool log callback severity" << LOG_ASYNC;
+			LOG_ERROR_FILTER(logger, LF_DB_CONN_POOL) << "Unhandled pool log callback severity"_lit << LOG_ASYNC;
 			LOG_ERROR_FILTER(logger, LF_DB_CONN_POOL) << message << LOG_ASYNC;
 	}
 }
@@ -337,7 +376,7 @@ unsigned int check_concurrency(log::Logger* logger) {
 
 	if(!concurrency) {
 		concurrency = 2;
-		LOG_WARN(logger) << "Unable to determine concurrency level" << LOG_SYNC;
+		LOG_WARN(logger) << "Unable to determine concurrency level"_lit << LOG_SYNC;
 	}
 
 #ifdef DEBUG_NO_THREADS
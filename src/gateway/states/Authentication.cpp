@@ -18,6 +18,7 @@
 #include <protocol/Opcodes.h>
 #include <protocol/PacketHeaders.h>
 #include <protocol/Packets.h>
+#include <spark/Coroutine.h>
 #include <spark/buffers/Buffer.h>
 #include <shared/util/EnumHelper.h>
 #include <shared/util/xoroshiro128plus.h>
@@ -45,8 +46,7 @@ void handle_queue_success(ClientContext& ctx);
 void auth_success(ClientContext& ctx);
 void auth_queue(ClientContext& ctx);
 void prove_session(ClientContext& ctx, const Botan::BigInt& key);
-void fetch_session_key(ClientContext& ctx, std::uint32_t account_id);
-void fetch_account_id(ClientContext& ctx, const std::string& username);
+spark::Task fetch_session_key(ClientUUID uuid, std::string username);
 void handle_timeout(ClientContext& ctx);
 void send_addon_data(ClientContext& ctx);
 
@@ -74,7 +74,7 @@ void handle_authentication(ClientContext& ctx) {
 		return;
 	}
 
-	CLIENT_DEBUG_GLOB(ctx) << "Received session proof for "
+	CLIENT_DEBUG_GLOB(ctx) << "Received session proof for "_lit
 		<< auth_ctx.packet->username << LOG_ASYNC;
 	
 	if(auth_ctx.packet->build == 0) {
@@ -82,18 +82,69 @@ void handle_authentication(ClientContext& ctx) {
 	}
 
 	auth_state(ctx, State::IN_PROGRESS);
-	fetch_account_id(ctx, auth_ctx.packet->username);
+
+	const auto& uuid = ctx.handler->uuid();
+	Locator::dispatcher()->spawn(uuid, fetch_session_key(uuid, auth_ctx.packet->username));
 }
 
-void fetch_account_id(ClientContext& ctx, const std::string& username) {
+/*
+ * Looks up the account ID and then its session key, posting each result to
+ * the client as it arrives. Both lookups are idempotent, so they're sent
+ * again if the link to the account server goes down before it replies.
+ */
+spark::Task fetch_session_key(const ClientUUID uuid, const std::string username) {
 	LOG_TRACE_FILTER_GLOB(LF_NETWORK) << __func__ << LOG_ASYNC;
 
-	const auto& uuid = ctx.handler->uuid();
+	constexpr auto MAX_ATTEMPTS = 3;
+	const auto account = Locator::account();
+	const auto dispatcher = Locator::dispatcher();
+
+	spark::Response<em::account::LookupIDResponse> id;
+
+	for(auto attempt = 0; attempt < MAX_ATTEMPTS; ++attempt) {
+		id = co_await account->locate_account_id(username);
+
+		if(id.status() != spark::CallStatus::LINK_DOWN) {
+			break;
+		}
+	}
+
+	if(!id) {
+		dispatcher->post_event(uuid, AccountIDResponse(em::account::Status::SERVER_LINK_ERROR, 0));
+		co_return;
+	}
+
+	const auto account_id = id->account_id();
+	dispatcher->post_event(uuid, AccountIDResponse(em::account::Status::OK, account_id));
+
+	// an unknown account fails authentication, so there's no key to fetch
+	if(!account_id) {
+		co_return;
+	}
+
+	spark::Response<em::account::SessionResponse> session;
 
-	Locator::account()->locate_account_id(username, [uuid](auto status, auto id) {
-		AccountIDResponse event(std::move(status), id);
-		Locator::dispatcher()->post_event(uuid, event);
-	});
+	for(auto attempt = 0; attempt < MAX_ATTEMPTS; ++attempt) {
+		session = co_await account->locate_session(account_id);
+
+		if(session.status() != spark::CallStatus::LINK_DOWN) {
+			break;
+		}
+	}
+
+	if(!session) {
+		dispatcher->post_event(uuid, SessionKeyResponse(em::account::Status::SERVER_LINK_ERROR, 0));
+		co_return;
+	}
+
+	const auto key = session->key();
+	Botan::BigInt decoded;
+
+	if(key) {
+		decoded = Botan::BigInt::decode(key->data(), key->size());
+	}
+
+	dispatcher->post_event(uuid, SessionKeyResponse(session->status(), std::move(decoded)));
 }
 
 void handle_account_id(ClientContext& ctx, const AccountIDResponse* event) {
@@ -103,45 +154,34 @@ void handle_account_id(ClientContext& ctx, const AccountIDResponse* event) {
 
 	if(event->status != em::account::Status::OK) {
 		CLIENT_ERROR_FILTER_GLOB(LF_NETWORK, ctx)
-			<< "Account server returned "
+			<< "Account server returned "_lit
 			<< util::fb_status(event->status, em::account::EnumNamesStatus())
-			<< " for " << auth_ctx.packet->username << " lookup" << LOG_ASYNC;
+			<< " for "_lit << auth_ctx.packet->username << " lookup"_lit << LOG_ASYNC;
 
 		auth_state(ctx, State::FAILED);
 		ctx.handler->close();
 		return;
 	}
 
+	// the session key lookup follows on from the same coroutine
 	if(event->account_id) {
 		auth_ctx.account_id = event->account_id;
-		fetch_session_key(ctx, event->account_id);
 	} else {
 		CLIENT_DEBUG_FILTER_GLOB(LF_NETWORK, ctx)
-			<< "Account ID lookup for failed for "
+			<< "Account ID lookup for failed for "_lit
 			<< auth_ctx.packet->username << LOG_ASYNC;
 		auth_state(ctx, State::FAILED);
 		ctx.handler->close();
 	}
 }
 
-void fetch_session_key(ClientContext& ctx, const std::uint32_t account_id) {
-	LOG_TRACE_FILTER_GLOB(LF_NETWORK) << __func__ << LOG_ASYNC;
-
-	const auto& uuid = ctx.handler->uuid();
-
-	Locator::account()->locate_session(account_id, [uuid](auto status, auto key) {
-		SessionKeyResponse event(status, key);
-		Locator::dispatcher()->post_event(uuid, event);
-	});
-}
-
 void handle_session_key(ClientContext& ctx, const SessionKeyResponse* event) {
 	const auto& auth_ctx = std::get<Context>(ctx.state_ctx);
 
 	CLIENT_DEBUG_FILTER_GLOB(LF_NETWORK, ctx)
-		<< "Account server returned "
+		<< "Account server returned "_lit
 		<< util::fb_status(event->status, em::account::EnumNamesStatus())
-		<< " for " << auth_ctx.packet->username << LOG_ASYNC;
+		<< " for "_lit << auth_ctx.packet->username << LOG_ASYNC;
 
 	if(event->status == em::account::Status::OK) {
 		prove_session(ctx, event->key);
@@ -174,7 +214,7 @@ void prove_session(ClientContext& ctx, const Botan::BigInt& key) {
 	hasher->final(hash.data());
 
 	if(hash != packet->digest) {
-		CLIENT_DEBUG_GLOB(ctx) << "Received bad digest for " << packet->username << LOG_ASYNC;
+		CLIENT_DEBUG_GLOB(ctx) << "Received bad digest for "_lit << packet->username << LOG_ASYNC;
 		auth_state(ctx, State::FAILED);
 		ctx.handler->close(); // key mismatch, client can't decrypt response
 		return;
@@ -213,15 +253,15 @@ void send_addon_data(ClientContext& ctx) {
 
 	// todo, use AddonData.dbc
 	for(const auto& addon : addons) {
-		CLIENT_DEBUG_GLOB(ctx) << "Addon: " << addon.name << ", Key version: " << addon.key_version
-			<< ", CRC: " << addon.crc << ", URL CRC: " << addon.update_url_crc << LOG_ASYNC;
+		CLIENT_DEBUG_GLOB(ctx) << "Addon: "_lit << addon.name << ", Key version: "_lit << addon.key_version
+			<< ", CRC: "_lit << addon.crc << ", URL CRC: "_lit << addon.update_url_crc << LOG_ASYNC;
 
 		protocol::server::AddonInfo::AddonData data;
 		data.type = protocol::server::AddonInfo::AddonData::Type::BLIZZARD;
 		data.update_available_flag = 0; // URL must be present for this to work (check URL CRC)
 
 		if(addon.key_version != 0 && addon.crc != 0x4C1C776D) { // todo, define?
-			CLIENT_DEBUG_GLOB(ctx) << "Repairing " << addon.name << LOG_ASYNC;
+			CLIENT_DEBUG_GLOB(ctx) << "Repairing "_lit << addon.name << LOG_ASYNC;
 			data.key_version = 1;
 		} else {
 			data.key_version = 0;
@@ -249,7 +289,7 @@ void auth_queue(ClientContext& ctx) {
 	);
 
 	auth_state(ctx, State::IN_QUEUE);
-	CLIENT_DEBUG_GLOB(ctx) << "added to queue" << LOG_ASYNC;
+	CLIENT_DEBUG_GLOB(ctx) << "added to queue"_lit << LOG_ASYNC;
 }
 
 void auth_success(ClientContext& ctx) {
@@ -259,7 +299,7 @@ void auth_success(ClientContext& ctx) {
 	send_addon_data(ctx);
 	auth_state(ctx, State::SUCCESS);
 	ctx.handler->state_update(ClientState::CHARACTER_LIST);
-	CLIENT_DEBUG_GLOB(ctx) << "authenticated" << LOG_ASYNC;
+	CLIENT_DEBUG_GLOB(ctx) << "authenticated"_lit << LOG_ASYNC;
 }
 
 void send_auth_result(ClientContext& ctx, protocol::Result result) {
@@ -285,7 +325,7 @@ void handle_queue_success(ClientContext& ctx) {
 }
 
 void handle_timeout(ClientContext& ctx) {
-	CLIENT_DEBUG_GLOB(ctx) << "Authentication timed out" << LOG_ASYNC;
+	CLIENT_DEBUG_GLOB(ctx) << "Authentication timed out"_lit << LOG_ASYNC;
 	ctx.handler->close();
 }
 
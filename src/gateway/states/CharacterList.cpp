@@ -214,7 +214,7 @@ void player_login(ClientContext& ctx) {
 }
 
 void handle_timeout(ClientContext& ctx) {
-	CLIENT_DEBUG_GLOB(ctx) << "Character list timed out" << LOG_ASYNC;
+	CLIENT_DEBUG_GLOB(ctx) << "Character list timed out"_lit << LOG_ASYNC;
 	ctx.handler->close();
 }
 
@@ -27,9 +27,9 @@ void handle_packet(ClientContext& ctx, protocol::ClientOpcode opcode) {
 		auto& [op, route] = *it;
 		route_packet(ctx, opcode, route);
 	} else {
-		CLIENT_DEBUG_FILTER_GLOB(LF_NETWORK, ctx) << "Unroutable message, "
-			<< protocol::to_string(opcode) << " (" << std::to_underlying(opcode) << ")"
-			<< " from " << ctx.client_id->username << LOG_ASYNC;
+		CLIENT_DEBUG_FILTER_GLOB(LF_NETWORK, ctx) << "Unroutable message, "_lit
+			<< protocol::to_string(opcode) << " ("_lit << std::to_underlying(opcode) << ")"_lit
+			<< " from "_lit << ctx.client_id->username << LOG_ASYNC;
 	}
 }
 
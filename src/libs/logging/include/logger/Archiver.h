@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include <shared/metrics/Metrics.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <cstddef>
+#include <cstdint>
+
+namespace ember::log {
+
+// zero for any of these means no limit
+struct Retention {
+	std::size_t max_files = 0;
+	std::chrono::hours max_age { 0 };
+	std::uintmax_t max_size = 0; // bytes, across all rotated files
+
+	bool enabled() const {
+		return max_files || max_age.count() || max_size;
+	}
+};
+
+/*
+ * Takes rotated log files off the logging worker's hands. A low priority
+ * thread, started on first use, gzips each file and then removes the oldest
+ * rotated files until the retention policy is met.
+ *
+ * Compression in progress at shutdown is abandoned, leaving the original
+ * file in place.
+ */
+class Archiver final {
+	static constexpr std::size_t CHUNK_SIZE = 256 * 1024;
+
+	std::mutex lock_;
+	std::condition_variable cond_;
+	std::deque<std::string> pending_;   // guarded by lock_
+	std::deque<std::string> archived_;  // archive thread only, oldest first
+	std::thread thread_;
+	std::atomic_bool stop_ { false };
+	std::atomic<Metrics*> metrics_;
+
+	bool compress_ = false;
+	Retention retention_;
+
+	void run();
+	void process(const std::string& path);
+	bool deflate(const std::string& in, const std::string& out);
+	void apply_retention();
+
+public:
+	Archiver();
+	~Archiver();
+
+	void compress(bool enable);
+	void retention(const Retention& retention);
+	void metrics(Metrics* metrics);
+	Metrics& metrics();
+
+	void track(std::string path);
+	void archive(std::string path);
+
+	Archiver(const Archiver&) = delete;
+	Archiver& operator=(const Archiver&) = delete;
+};
+
+} //log, ember
\ No newline at end of file
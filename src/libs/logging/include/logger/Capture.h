@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace ember::log {
+
+/*
+ * TEXT formats each argument into the record on the logging thread.
+ * BINARY only copies the raw arguments into the record, leaving the
+ * conversion to text to the worker thread.
+ */
+enum class Capture { TEXT, BINARY };
+
+/*
+ * A string literal. The consteval constructor rejects anything that isn't
+ * a constant expression, so binary capture can record the pointer rather
+ * than copying the text - it acts as a static ID for the format string
+ * or call site.
+ *
+ * A plain literal streamed into a log record decays to const char* and is
+ * copied like any other string, as overload resolution always prefers the
+ * decay. Suffix it with _lit, e.g. << "[spark] Link up"_lit, to have it
+ * recorded by pointer instead.
+ */
+struct Literal {
+	const char* str;
+	std::size_t length;
+
+	template<std::size_t size>
+	consteval Literal(const char (&str)[size]) : str(str), length(size - 1) {}
+
+	consteval Literal(const char* str, const std::size_t length) : str(str), length(length) {}
+};
+
+inline namespace literals {
+
+consteval Literal operator""_lit(const char* str, const std::size_t length) {
+	return { str, length };
+}
+
+} // literals
+
+namespace detail {
+
+enum class Arg : std::uint8_t {
+	SIGNED, UNSIGNED, FLOAT, DOUBLE, BOOL, STRING, LITERAL
+};
+
+// converts a binary captured record to text, appending it to out
+void decode(const std::vector<char>& record, std::vector<char>& out);
+
+} // detail
+
+} //log, ember
+
+namespace ember {
+
+// lets anything in the ember namespace use the suffix without a using-directive
+using namespace log::literals;
+
+} // ember
\ No newline at end of file
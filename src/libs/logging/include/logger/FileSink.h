@@ -9,14 +9,17 @@
 #pragma once
 
 #include <logger/Sink.h>
+#include <logger/Archiver.h>
 #include <logger/FileWrapper.h>
 #include <logger/Utility.h>
+#include <array>
 #include <memory>
 #include <string>
 #include <utility>
 #include <vector>
 #include <cstdio>
 #include <cstdint>
+#include <ctime>
 
 namespace ember::log {
 
@@ -36,14 +39,27 @@ private:
 	bool midnight_rotate_ = false;
 	int last_mday_ = detail::current_time().tm_mday;
 	std::string time_format_ = "[%d/%m/%Y %H:%M:%S] ";
+	Severity sync_severity_ = Severity::DISABLED;
+
+	// records are formatted into here so each batch goes out in a single write
+	std::vector<char> buffer_;
+
+	// the timestamp prefix only changes once a second
+	std::time_t cached_second_ = -1;
+	std::tm cached_time_ {};
+	std::string cached_stamp_;
+	std::array<std::string, 7> severities_;
+
+	Archiver archiver_;
 
 	void open(Mode mode = Mode::TRUNCATE);
 	void rotate();
 	void rotate_check(std::size_t buffer_size, const std::tm& curr_time);
 	void format_file_name();
-	bool file_exists(const std::string& name);
 	void set_initial_rotation();
-	std::string generate_record_detail(Severity severity, const std::tm& curr_time);
+	const std::tm& current_time();
+	void append(Severity severity, const std::vector<char>& record);
+	void commit(bool flush, bool sync);
 
 public:
 	FileSink(Severity severity, Filter filter, std::string file_name, Mode mode);
@@ -54,6 +70,10 @@ public:
 	void midnight_rotate(bool enable) { midnight_rotate_ = enable; }
 	void size_limit(std::uintmax_t megabytes);
 	void time_format(const std::string& format);
+	void sync_severity(Severity severity) { sync_severity_ = severity; }
+	void compress(bool enable) { archiver_.compress(enable); }
+	void retention(const Retention& retention) { archiver_.retention(retention); }
+	void metrics(Metrics* metrics) override { archiver_.metrics(metrics); }
 	void write(Severity severity, Filter type, const std::vector<char>& record, bool flush) override;
 	void batch_write(const std::vector<std::pair<RecordDetail, std::vector<char>>>& records) override;
 };
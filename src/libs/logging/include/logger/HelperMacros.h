@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2015 - 2020 Ember
+ * Copyright (c) 2015 - 2022 Ember
  *
  * This Source Code Form is subject to the terms of the Mozilla Public
  * License, v. 2.0. If a copy of the MPL was not distributed with this
@@ -9,6 +9,7 @@
 #pragma once
 
 #include <logger/Severity.h>
+#include <logger/RateLimit.h>
 
 #if !NO_LOGGING && !NO_TRACE_LOGGING
 #define LOG_TRACE(logger) \
@@ -168,6 +169,45 @@ if(logger->severity() <= ember::log::Severity::WARN) { \
 #define LOG_FATAL_FILTER_GLOB(filter) \
 	LOG_FATAL_FILTER(ember::log::get_logger(), filter)
 
+/*
+ * Rate limited and sampled variants, taking the severity's name, e.g.
+ * LOG_LIMIT(logger, WARN, 10, 50). The limiter lives in a static at the call
+ * site and is only consulted once the record would otherwise be logged, so
+ * suppressed records cost no formatting. The logging worker periodically
+ * logs how many records each site has suppressed.
+ *
+ * The rate, burst and sampling arguments must be constant expressions.
+ */
+#define LOG_LIMIT_FILTER(logger, sev, type, per_second, burst) \
+	if(static constinit ember::log::RateLimit log_site_(ember::log::Severity::sev, type, __FILE__, __LINE__, per_second, burst); \
+	   ember::log::detail::compiled_in(ember::log::Severity::sev) \
+	   && logger->severity() <= ember::log::Severity::sev && !(logger->filter() & type) && log_site_.allow()) { \
+		*logger << ember::log::Severity::sev << ember::log::Filter(type)
+
+#define LOG_SAMPLE_FILTER(logger, sev, type, n) \
+	if(static constinit ember::log::Sampler log_site_(ember::log::Severity::sev, type, __FILE__, __LINE__, n); \
+	   ember::log::detail::compiled_in(ember::log::Severity::sev) \
+	   && logger->severity() <= ember::log::Severity::sev && !(logger->filter() & type) && log_site_.allow()) { \
+		*logger << ember::log::Severity::sev << ember::log::Filter(type)
+
+#define LOG_LIMIT(logger, sev, per_second, burst) \
+	LOG_LIMIT_FILTER(logger, sev, 0, per_second, burst)
+
+#define LOG_SAMPLE(logger, sev, n) \
+	LOG_SAMPLE_FILTER(logger, sev, 0, n)
+
+#define LOG_LIMIT_GLOB(sev, per_second, burst) \
+	LOG_LIMIT(ember::log::get_logger(), sev, per_second, burst)
+
+#define LOG_SAMPLE_GLOB(sev, n) \
+	LOG_SAMPLE(ember::log::get_logger(), sev, n)
+
+#define LOG_LIMIT_FILTER_GLOB(sev, filter, per_second, burst) \
+	LOG_LIMIT_FILTER(ember::log::get_logger(), sev, filter, per_second, burst)
+
+#define LOG_SAMPLE_FILTER_GLOB(sev, filter, n) \
+	LOG_SAMPLE_FILTER(ember::log::get_logger(), sev, filter, n)
+
 #define LOG_ASYNC ember::log::flush; }
 #define LOG_SYNC  ember::log::flush_sync; }
 
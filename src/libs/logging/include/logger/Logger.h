@@ -9,14 +9,32 @@
 #pragma once 
 
 #include <logger/Severity.h>
+#include <logger/Capture.h>
 #include <memory>
+#include <cstdint>
 #include <string>
 #include <string_view>
 
+namespace ember {
+
+class Metrics;
+
+} // ember
+
 namespace ember::log {
 
 class Sink;
 
+/*
+ * What a thread does when its record queue is full. BLOCK waits for the
+ * worker to make room, DROP_NEWEST discards the record and DROP_BY_SEVERITY
+ * discards records below the given threshold, blocking for the rest.
+ * DROP_BY_SEVERITY with a WARN threshold is the default, so a slow sink
+ * can't stall a network thread over an info record. Drops are counted and
+ * reported through the sinks.
+ */
+enum class Overflow { BLOCK, DROP_NEWEST, DROP_BY_SEVERITY };
+
 class Logger final {
 	class impl;
 	std::unique_ptr<impl> pimpl_;
@@ -40,9 +58,15 @@ public:
 	Logger& operator <<(const std::string& data);
 	Logger& operator <<(const std::string_view data);
 	Logger& operator <<(const char* data);
+	Logger& operator <<(Literal data);
 	void add_sink(std::unique_ptr<Sink> sink);
 	Severity severity();
 	Filter filter();
+	void capture(Capture mode);
+	Capture capture();
+	void overflow(Overflow policy, Severity threshold = Severity::WARN);
+	std::uint64_t dropped();
+	void metrics(Metrics* metrics);
 	void finalise();
 	void finalise_sync();
 
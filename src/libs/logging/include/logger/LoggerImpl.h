@@ -9,14 +9,19 @@
 #pragma once
 
 #include <logger/HelperMacros.h>
+#include <logger/Capture.h>
 #include <logger/Worker.h>
 #include <logger/Sink.h>
 #include <logger/Severity.h>
 #include <logger/Logger.h>
 #include <logger/concurrentqueue.h>
 #include <algorithm>
+#include <atomic>
+#include <charconv>
 #include <iterator>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <vector>
 #include <memory>
 #include <unordered_map>
@@ -27,6 +32,7 @@
 #include <condition_variable>
 #include <thread>
 #include <cstddef>
+#include <cstdint>
 #include <cstring>
 
 namespace ember::log {
@@ -36,6 +42,7 @@ class Logger::impl final {
 
 	Severity severity_ = Severity::DISABLED;
 	Filter filter_ = Filter(0);
+	std::atomic<Capture> capture_ { Capture::TEXT };
 	std::vector<std::unique_ptr<Sink>> sinks_;
 	Worker worker_;
 
@@ -43,18 +50,22 @@ class Logger::impl final {
 	static thread_local std::binary_semaphore sem_;
 
 	void finalise() {
-		buffer_.second.push_back('\n');
-		worker_.queue_.enqueue(std::move(buffer_));
-		worker_.signal();
+		if(!buffer_.first.binary) {
+			buffer_.second.push_back('\n');
+		}
+
+		worker_.enqueue(buffer_);
 		buffer_.second.reserve(128);
 	}
 
 	void finalise_sync() {
-		buffer_.second.push_back('\n');
+		if(!buffer_.first.binary) {
+			buffer_.second.push_back('\n');
+		}
+
 		auto r = std::make_tuple<RecordDetail, std::vector<char>, std::binary_semaphore*>
 					(std::move(buffer_.first), std::move(buffer_.second), &sem_);
-		worker_.queue_sync_.enqueue(std::move(r));
-		worker_.signal();
+		worker_.enqueue_sync(std::move(r));
 		buffer_.second.reserve(128);
 		sem_.acquire();
 	}
@@ -72,10 +83,53 @@ public:
 #endif
 	}
 
+	template<typename ...Ts>
+	void encode(const detail::Arg type, const Ts&... data) {
+		auto& buffer = buffer_.second;
+		auto offset = buffer.size();
+		buffer.resize(offset + sizeof(type) + (sizeof(data) + ...));
+		buffer[offset++] = static_cast<char>(type);
+		((std::memcpy(buffer.data() + offset, &data, sizeof(data)), offset += sizeof(data)), ...);
+	}
+
 	template<typename T>
-	void copy_to_stream(T& data) {
-		std::string conv = std::to_string(data);
-		std::copy(conv.begin(), conv.end(), std::back_inserter(buffer_.second));
+	void copy_to_stream(const T data) {
+		if(buffer_.first.binary) {
+			if constexpr(std::is_same_v<T, bool>) {
+				encode(detail::Arg::BOOL, data);
+			} else if constexpr(std::is_same_v<T, float>) {
+				encode(detail::Arg::FLOAT, data);
+			} else if constexpr(std::is_same_v<T, double>) {
+				encode(detail::Arg::DOUBLE, data);
+			} else if constexpr(std::is_signed_v<T>) {
+				encode(detail::Arg::SIGNED, static_cast<std::int64_t>(data));
+			} else {
+				encode(detail::Arg::UNSIGNED, static_cast<std::uint64_t>(data));
+			}
+
+			return;
+		}
+
+		if constexpr(std::is_same_v<T, bool>) {
+			buffer_.second.push_back(data? '1' : '0');
+		} else {
+			// enough for the longest shortest-form double
+			auto& buffer = buffer_.second;
+			const auto offset = buffer.size();
+			buffer.resize(offset + 32);
+			const auto [end, ec] = std::to_chars(buffer.data() + offset, buffer.data() + buffer.size(), data);
+			buffer.resize(end - buffer.data());
+		}
+	}
+
+	void copy_to_stream(const char* data, const std::size_t length) {
+		if(buffer_.first.binary) {
+			const auto size = static_cast<std::uint32_t>(length);
+			encode(detail::Arg::STRING, size);
+			buffer_.second.insert(buffer_.second.end(), data, data + size);
+		} else {
+			buffer_.second.insert(buffer_.second.end(), data, data + length);
+		}
 	}
 
 	impl& operator <<(impl& (*m)(impl&)) {
@@ -86,6 +140,7 @@ public:
 	impl& operator <<(Severity severity) {
 		buffer_.first.type = 1; // first bit represents the misc. record type
 		buffer_.first.severity = severity;
+		buffer_.first.binary = capture_.load(std::memory_order_relaxed) == Capture::BINARY;
 		return *this;
 	}
 
@@ -140,17 +195,27 @@ public:
 	}
 
 	impl& operator <<(const std::string& data) {
-		std::copy(data.begin(), data.end(), std::back_inserter(buffer_.second));
+		copy_to_stream(data.data(), data.size());
 		return *this;
 	}
 
 	impl& operator <<(const std::string_view data) {
-		std::copy(data.begin(), data.end(), std::back_inserter(buffer_.second));
+		copy_to_stream(data.data(), data.size());
 		return *this;
 	}
 
 	impl& operator <<(const char* data) {
-		std::copy(data, data + std::strlen(data), std::back_inserter(buffer_.second));
+		copy_to_stream(data, std::strlen(data));
+		return *this;
+	}
+
+	impl& operator <<(const Literal data) {
+		if(buffer_.first.binary) {
+			encode(detail::Arg::LITERAL, data.str, data.length);
+		} else {
+			buffer_.second.insert(buffer_.second.end(), data.str, data.str + data.length);
+		}
+
 		return *this;
 	}
 
@@ -162,6 +227,29 @@ public:
 		return filter_;
 	}
 
+	void capture(const Capture mode) {
+		capture_.store(mode, std::memory_order_relaxed);
+	}
+
+	Capture capture() {
+		return capture_.load(std::memory_order_relaxed);
+	}
+
+	void overflow(const Overflow policy, const Severity threshold) {
+		worker_.overflow(policy, threshold);
+	}
+
+	std::uint64_t dropped() {
+		return worker_.dropped();
+	}
+
+	// sinks must only store the pointer atomically, the worker may be using them
+	void metrics(Metrics* metrics) {
+		for(auto& sink : sinks_) {
+			sink->metrics(metrics);
+		}
+	}
+
 	void add_sink(std::unique_ptr<Sink> sink) {
 		if(sink->severity() < severity_) {
 			severity_ = sink->severity();
@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include <logger/Severity.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace ember::log {
+
+/*
+ * State for a single rate limited or sampled logging statement, held in a
+ * static at the call site (see HelperMacros.h). Sites register themselves
+ * the first time they suppress a record so the logging worker can
+ * periodically summarise how many records each has held back.
+ */
+class CallSite {
+	static std::atomic<CallSite*> sites_;
+	static std::atomic_bool pending_;
+
+	const Severity severity_;
+	const std::uint_fast32_t filter_;
+	const char* const file_;
+	const int line_;
+	std::atomic<std::uint64_t> suppressed_ { 0 };
+	std::atomic_bool registered_ { false };
+	CallSite* next_ = nullptr;
+
+	void link();
+
+protected:
+	constexpr CallSite(Severity severity, std::uint_fast32_t filter, const char* file, int line)
+		: severity_(severity), filter_(filter), file_(file), line_(line) {}
+
+	void suppress() {
+		suppressed_.fetch_add(1, std::memory_order_relaxed);
+
+		if(!registered_.load(std::memory_order_relaxed) && !registered_.exchange(true)) {
+			link();
+		}
+
+		// checked first to avoid every suppressed call writing to the same cache line
+		if(!pending_.load(std::memory_order_relaxed)) {
+			pending_.store(true, std::memory_order_release);
+		}
+	}
+
+public:
+	// whether any site has suppressed records since the last summary
+	static bool pending() {
+		return pending_.load(std::memory_order_acquire);
+	}
+
+	// clears the pending flag and returns the first registered site
+	static CallSite* collect();
+
+	CallSite* next() const { return next_; }
+	std::uint64_t take_suppressed() { return suppressed_.exchange(0, std::memory_order_relaxed); }
+	Severity severity() const { return severity_; }
+	Filter filter() const { return Filter(filter_); }
+	const char* file() const { return file_; }
+	int line() const { return line_; }
+
+	CallSite(const CallSite&) = delete;
+	CallSite& operator=(const CallSite&) = delete;
+};
+
+/*
+ * Token bucket allowing per_second records on average with bursts of up to
+ * burst records. Implemented as a GCRA so the whole bucket is one atomic.
+ */
+class RateLimit final : public CallSite {
+	const std::int64_t interval_;  // nanoseconds per token
+	const std::int64_t tolerance_; // how far ahead of the clock the bucket may run
+	std::atomic<std::int64_t> tat_ { 0 }; // theoretical arrival time of the next record
+
+public:
+	constexpr RateLimit(Severity severity, std::uint_fast32_t filter, const char* file, int line,
+	                    unsigned int per_second, unsigned int burst)
+		: CallSite(severity, filter, file, line),
+		  interval_(1'000'000'000 / std::max(per_second, 1u)),
+		  tolerance_(interval_ * std::max(burst, 1u)) {}
+
+	bool allow() {
+		const std::int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+
+		auto tat = tat_.load(std::memory_order_relaxed);
+
+		while(true) {
+			const auto next = std::max(tat, now) + interval_;
+
+			if(next - now > tolerance_) {
+				suppress();
+				return false;
+			}
+
+			if(tat_.compare_exchange_weak(tat, next, std::memory_order_relaxed)) {
+				return true;
+			}
+		}
+	}
+};
+
+// allows the first of every n records through
+class Sampler final : public CallSite {
+	const std::uint64_t n_;
+	std::atomic<std::uint64_t> count_ { 0 };
+
+public:
+	constexpr Sampler(Severity severity, std::uint_fast32_t filter, const char* file, int line,
+	                  std::uint64_t n)
+		: CallSite(severity, filter, file, line), n_(std::max<std::uint64_t>(n, 1)) {}
+
+	bool allow() {
+		if(count_.fetch_add(1, std::memory_order_relaxed) % n_ == 0) {
+			return true;
+		}
+
+		suppress();
+		return false;
+	}
+};
+
+namespace detail {
+
+// lets the rate limited macros honour the NO_*_LOGGING switches
+constexpr bool compiled_in(const Severity severity) {
+	switch(severity) {
+#if !NO_LOGGING && !NO_TRACE_LOGGING
+		case Severity::TRACE:
+#endif
+#if !NO_LOGGING && !NO_DEBUG_LOGGING
+		case Severity::DEBUG:
+#endif
+#if !NO_LOGGING && !NO_INFO_LOGGING
+		case Severity::INFO:
+#endif
+#if !NO_LOGGING && !NO_WARN_LOGGING
+		case Severity::WARN:
+#endif
+#if !NO_LOGGING && !NO_ERROR_LOGGING
+		case Severity::ERROR_:
+#endif
+#if !NO_LOGGING && !NO_FATAL_LOGGING
+		case Severity::FATAL:
+#endif
+			return true;
+		default:
+			return false;
+	}
+}
+
+} // detail
+
+} //log, ember
\ No newline at end of file
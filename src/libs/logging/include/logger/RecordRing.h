@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include <logger/Severity.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <vector>
+#include <cstddef>
+
+namespace ember::log {
+
+using Record = std::pair<RecordDetail, std::vector<char>>;
+
+/*
+ * Bounded single producer, single consumer queue of records. Each thread
+ * that logs gets its own ring, so producers never contend with each other
+ * and only the worker thread consumes.
+ */
+class RecordRing final {
+	static constexpr std::size_t CACHE_LINE = 64;
+
+	std::unique_ptr<Record[]> slots_;
+	const std::size_t mask_;
+
+	alignas(CACHE_LINE) std::atomic<std::size_t> head_ { 0 };
+	alignas(CACHE_LINE) std::atomic<std::size_t> tail_ { 0 };
+
+public:
+	// capacity must be a power of two
+	explicit RecordRing(const std::size_t capacity)
+		: slots_(std::make_unique<Record[]>(capacity)), mask_(capacity - 1) { }
+
+	/*
+	 * Producer only. Returns false if the ring is full, otherwise the record
+	 * is moved into the ring and published by the release store to tail.
+	 */
+	bool push(Record& record) {
+		const auto tail = tail_.load(std::memory_order_relaxed);
+
+		if(tail - head_.load(std::memory_order_acquire) > mask_) {
+			return false;
+		}
+
+		slots_[tail & mask_] = std::move(record);
+		tail_.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer only. Moves up to max records onto the end of out.
+	std::size_t pop(std::vector<Record>& out, const std::size_t max) {
+		const auto head = head_.load(std::memory_order_relaxed);
+		const auto count = std::min(tail_.load(std::memory_order_acquire) - head, max);
+
+		for(std::size_t i = 0; i < count; ++i) {
+			out.emplace_back(std::move(slots_[(head + i) & mask_]));
+		}
+
+		head_.store(head + count, std::memory_order_release);
+		return count;
+	}
+
+	bool empty() const {
+		return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+	}
+};
+
+} //log, ember
\ No newline at end of file
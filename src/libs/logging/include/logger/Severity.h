@@ -21,6 +21,7 @@ BOOST_STRONG_TYPEDEF(std::uint_fast32_t, Filter);
 struct RecordDetail {
 	Severity severity;
 	Filter type;
+	bool binary = false; // record holds captured arguments rather than text
 };
 
 } //log, ember
\ No newline at end of file
@@ -12,6 +12,12 @@
 #include <utility>
 #include <vector>
 
+namespace ember {
+
+class Metrics;
+
+} // ember
+
 namespace ember::log {
 
 class Sink {
@@ -28,6 +34,7 @@ public:
 	void filter(const Filter& filter) { filter_ = filter; }
 	virtual void write(Severity severity, Filter type, const std::vector<char>& record, bool flush) = 0;
 	virtual void batch_write(const std::vector<std::pair<RecordDetail, std::vector<char>>>& records) = 0;
+	virtual void metrics(Metrics* /*metrics*/) {}
 	virtual ~Sink() = default;
 };
 
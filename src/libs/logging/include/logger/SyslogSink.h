@@ -1,5 +1,5 @@
 ﻿/*
- * Copyright (c) 2015, 2016 Ember
+ * Copyright (c) 2015 - 2022 Ember
  *
  * This Source Code Form is subject to the terms of the Mozilla Public
  * License, v. 2.0. If a copy of the MPL was not distributed with this
@@ -22,6 +22,9 @@ class SyslogSink : public Sink {
 	std::unique_ptr<impl> pimpl_;
 
 public:	
+	// UDP sends one message per datagram (RFC 5426), TCP uses octet counting (RFC 6587)
+	enum class Transport { UDP, TCP };
+
 	enum class Facility : std::uint8_t {
 		KERNEL, USER_LEVEL, MAIL_SYSTEM, SYSTEM_DAEMON,
 		SECURITY_AND_AUTH, SYSLOGD_INTERNAL, LINE_PRINTER_SUBSYSTEM,
@@ -32,9 +35,19 @@ public:
 		LOCAL_USE_6, LOCAL_USE_7
 	};
 
+	/*
+	 * With own_thread, records are only queued by the logging worker and
+	 * sent from a thread belonging to the sink, so a slow collector can't
+	 * hold up the other sinks. TCP always uses its own thread, which gives
+	 * up on a connect or write after a timeout and abandons one in progress
+	 * when the sink is destroyed, so a stalled collector can't hang shutdown.
+	 */
 	SyslogSink(log::Severity severity, Filter filter, std::string host, unsigned int port,
-	           Facility facility, std::string tag);
+	           Facility facility, std::string tag, Transport transport = Transport::UDP,
+	           bool own_thread = false);
 	~SyslogSink();
+
+	std::uint64_t dropped() const;
 	void write(log::Severity severity, Filter type, const std::vector<char>& record, bool flush) override;
 	void batch_write(const std::vector<std::pair<log::RecordDetail, std::vector<char>>>& records) override;
 };
@@ -20,6 +20,7 @@ namespace detail {
 
 std::string severity_string(Severity severity);
 std::tm current_time();
+std::tm local_time(std::time_t time);
 std::string put_time(const std::tm& time, const std::string& format);
 
 }} //detail, log, ember
\ No newline at end of file
@@ -9,9 +9,12 @@
 #pragma once
 
 #include <logger/Sink.h>
+#include <logger/RecordRing.h>
 #include <logger/concurrentqueue.h>
 #include <logger/Logger.h>
+#include <shared/metrics/ThreadShards.h>
 #include <atomic>
+#include <chrono>
 #include <vector>
 #include <mutex>
 #include <thread>
@@ -20,34 +23,81 @@
 #include <string>
 #include <tuple>
 #include <condition_variable>
+#include <cstddef>
+#include <cstdint>
 
 namespace ember::log {
 
+/*
+ * Records are queued on per-thread rings, registered with the worker the
+ * first time a thread logs. The worker drains them round-robin in batches,
+ * spinning for a while once they're empty before parking. Producers only
+ * pay for a wakeup when the worker is parked.
+ *
+ * Before writing a sync record, every ring is drained completely, so the
+ * records its thread queued ahead of it always reach the sinks first.
+ *
+ * Records held back by rate limited call sites are summarised every
+ * SUMMARY_INTERVAL, waking the worker if needed.
+ */
 class Worker final {
-	moodycamel::ConcurrentQueue<std::pair<RecordDetail, std::vector<char>>> queue_;
-	moodycamel::ConcurrentQueue<std::tuple<RecordDetail, std::vector<char>, std::binary_semaphore*>> queue_sync_;
-	std::vector<std::pair<RecordDetail, std::vector<char>>> dequeued_;
+public:
+	static constexpr std::size_t RING_CAPACITY = 4096; // records per thread
+	static constexpr std::size_t BATCH_SIZE = 256;     // records per ring, per pass, unless syncing
+	static constexpr std::size_t SPIN_LIMIT = 2000;    // empty passes before parking
+	static constexpr std::chrono::seconds SUMMARY_INTERVAL { 5 };
+
+private:
+	using SyncRecord = std::tuple<RecordDetail, std::vector<char>, std::binary_semaphore*>;
+
+	ThreadShards<RecordRing> rings_;
+	moodycamel::ConcurrentQueue<SyncRecord> queue_sync_;
+	std::vector<SyncRecord> dequeued_sync_;
+	std::vector<Record> dequeued_;
+	std::vector<char> scratch_;
 	std::vector<std::unique_ptr<Sink>>& sinks_;
 	std::binary_semaphore sem_;
 	std::thread thread_;
 	std::atomic_bool stop_ { false };
+	std::atomic_bool sleeping_ { false };
 
-	void process_outstanding();
-	void process_outstanding_sync();
-	void run();
+	std::atomic<Overflow> overflow_ { Overflow::DROP_BY_SEVERITY };
+	std::atomic<Severity> drop_below_ { Severity::WARN };
+	std::atomic<std::uint64_t> dropped_ { 0 };
+	std::uint64_t dropped_reported_ = 0;
+	std::chrono::steady_clock::time_point summarised_;
 
-	friend class Logger;
+	void overflow(RecordRing& ring, Record& record);
+	void format(RecordDetail& detail, std::vector<char>& record);
+	void report_dropped();
+	void report_suppressed(bool force);
+	bool process_outstanding(std::size_t batch = BATCH_SIZE);
+	bool process_outstanding_sync();
+	bool pending();
+	void park();
+	void run();
 
 public:
-	Worker(std::vector<std::unique_ptr<Sink>>& sinks) : sinks_(sinks), sem_(0) {}
+	Worker(std::vector<std::unique_ptr<Sink>>& sinks);
 	~Worker();
 
 	void start();
 	void stop();
-	inline void signal() { 
-		sem_.release();
+	void enqueue(Record& record);
+	void enqueue_sync(SyncRecord record);
+	void overflow(Overflow policy, Severity threshold);
+	std::uint64_t dropped() const;
+
+	inline void wake() {
 #ifdef DEBUG_NO_THREADS
 		run();
+#else
+		// pairs with the fence in park, either we see it sleeping or it sees our record
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		if(sleeping_.load(std::memory_order_relaxed) && sleeping_.exchange(false)) {
+			sem_.release();
+		}
 #endif
 	}
 };
@@ -0,0 +1,240 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <logger/Archiver.h>
+#include <logger/FileWrapper.h>
+#include <algorithm>
+#include <filesystem>
+#include <system_error>
+#include <utility>
+#include <vector>
+#include <cstdio>
+#include <zlib.h>
+
+#ifdef _WIN32
+	#include <Windows.h>
+#elif defined __linux__
+	#include <sys/resource.h>
+	#include <sys/syscall.h>
+	#include <unistd.h>
+#endif
+
+namespace ember::log {
+
+namespace fs = std::filesystem;
+namespace sc = std::chrono;
+
+namespace {
+
+void lower_priority() {
+#ifdef _WIN32
+	SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_LOWEST);
+#elif defined __linux__
+	// applies to the calling thread only on Linux
+	setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), 19);
+#endif
+}
+
+} // unnamed
+
+Archiver::Archiver() : metrics_(&Metrics::null()) {}
+
+Archiver::~Archiver() {
+	{
+		std::lock_guard<std::mutex> guard(lock_);
+		stop_ = true;
+	}
+
+	cond_.notify_one();
+
+	if(thread_.joinable()) {
+		thread_.join();
+	}
+}
+
+void Archiver::compress(const bool enable) {
+	std::lock_guard<std::mutex> guard(lock_);
+	compress_ = enable;
+}
+
+void Archiver::retention(const Retention& retention) {
+	std::lock_guard<std::mutex> guard(lock_);
+	retention_ = retention;
+}
+
+void Archiver::metrics(Metrics* metrics) {
+	metrics_ = metrics? metrics : &Metrics::null();
+}
+
+Metrics& Archiver::metrics() {
+	return *metrics_;
+}
+
+// rotated files left over from a previous run, processed along with the next rotation
+void Archiver::track(std::string path) {
+	std::lock_guard<std::mutex> guard(lock_);
+	pending_.emplace_back(std::move(path));
+}
+
+void Archiver::archive(std::string path) {
+	{
+		std::lock_guard<std::mutex> guard(lock_);
+
+		if(!compress_ && !retention_.enabled()) {
+			return;
+		}
+
+		pending_.emplace_back(std::move(path));
+
+		if(!thread_.joinable()) {
+			thread_ = std::thread(&Archiver::run, this);
+		}
+	}
+
+	cond_.notify_one();
+}
+
+void Archiver::run() {
+	lower_priority();
+
+	while(true) {
+		std::string path;
+
+		{
+			std::unique_lock<std::mutex> guard(lock_);
+			cond_.wait(guard, [&] { return stop_ || !pending_.empty(); });
+
+			if(stop_) {
+				return;
+			}
+
+			path = std::move(pending_.front());
+			pending_.pop_front();
+		}
+
+		process(path);
+	}
+}
+
+void Archiver::process(const std::string& path) {
+	bool compress = false;
+
+	{
+		std::lock_guard<std::mutex> guard(lock_);
+		compress = compress_;
+	}
+
+	if(compress && !path.ends_with(".gz")) {
+		const auto start = sc::steady_clock::now();
+		const auto compressed = path + ".gz";
+
+		if(deflate(path, compressed)) {
+			std::error_code ec;
+			fs::remove(path, ec);
+			archived_.emplace_back(compressed);
+			metrics().timing("logging.rotation.compress",
+			                 sc::duration_cast<sc::milliseconds>(sc::steady_clock::now() - start));
+		} else {
+			archived_.emplace_back(path);
+			metrics().increment("logging.rotation.compress_failed");
+		}
+	} else {
+		archived_.emplace_back(path);
+	}
+
+	apply_retention();
+}
+
+bool Archiver::deflate(const std::string& in, const std::string& out) {
+	File input(in, "rb");
+
+	if(!input.handle()) {
+		return false;
+	}
+
+	gzFile gz = gzopen(out.c_str(), "wb6");
+
+	if(!gz) {
+		return false;
+	}
+
+	std::vector<char> buffer(CHUNK_SIZE);
+	bool complete = false;
+
+	while(!stop_) {
+		const auto read = std::fread(buffer.data(), 1, buffer.size(), input);
+
+		if(read && gzwrite(gz, buffer.data(), static_cast<unsigned int>(read)) != static_cast<int>(read)) {
+			break;
+		}
+
+		if(read < buffer.size()) {
+			complete = !std::ferror(input);
+			break;
+		}
+	}
+
+	if(gzclose(gz) != Z_OK) {
+		complete = false;
+	}
+
+	if(!complete) {
+		std::error_code ec;
+		fs::remove(out, ec);
+	}
+
+	return complete;
+}
+
+void Archiver::apply_retention() {
+	Retention retention;
+
+	{
+		std::lock_guard<std::mutex> guard(lock_);
+		retention = retention_;
+	}
+
+	if(!retention.enabled()) {
+		return;
+	}
+
+	std::uintmax_t total = 0;
+
+	for(const auto& path : archived_) {
+		std::error_code ec;
+		const auto size = fs::file_size(path, ec);
+		total += ec? 0 : size;
+	}
+
+	while(!archived_.empty()) {
+		const auto& oldest = archived_.front();
+		std::error_code ec;
+
+		const auto modified = fs::last_write_time(oldest, ec);
+		const auto expired = !ec && retention.max_age.count()
+			&& fs::file_time_type::clock::now() - modified > retention.max_age;
+
+		if(!ec && !expired
+		   && (!retention.max_files || archived_.size() <= retention.max_files)
+		   && (!retention.max_size || total <= retention.max_size)) {
+			break;
+		}
+
+		const auto size = fs::file_size(oldest, ec);
+		total -= ec? 0 : std::min(size, total);
+
+		// errors mean it's already gone, which is just as good
+		if(fs::remove(oldest, ec)) {
+			metrics().increment("logging.rotation.removed");
+		}
+
+		archived_.pop_front();
+	}
+}
+
+} //log, ember
\ No newline at end of file
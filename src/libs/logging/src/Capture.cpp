@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <logger/Capture.h>
+#include <charconv>
+#include <cstring>
+
+namespace ember::log::detail {
+
+namespace {
+
+// enough for the longest shortest-form double, e.g. -2.2250738585072014e-308
+constexpr std::size_t MAX_CHARS = 32;
+
+template<typename T>
+bool read(const std::vector<char>& record, std::size_t& offset, T& value) {
+	if(record.size() - offset < sizeof(T)) {
+		return false;
+	}
+
+	std::memcpy(&value, record.data() + offset, sizeof(T));
+	offset += sizeof(T);
+	return true;
+}
+
+template<typename T>
+bool format(const std::vector<char>& record, std::size_t& offset, std::vector<char>& out) {
+	T value;
+
+	if(!read(record, offset, value)) {
+		return false;
+	}
+
+	const auto start = out.size();
+	out.resize(start + MAX_CHARS);
+	const auto [end, ec] = std::to_chars(out.data() + start, out.data() + out.size(), value);
+	out.resize(end - out.data());
+	return true;
+}
+
+} // unnamed
+
+void decode(const std::vector<char>& record, std::vector<char>& out) {
+	std::size_t offset = 0;
+	bool valid = true;
+
+	while(valid && offset < record.size()) {
+		const auto type = static_cast<Arg>(record[offset++]);
+
+		switch(type) {
+			case Arg::SIGNED:
+				valid = format<std::int64_t>(record, offset, out);
+				break;
+			case Arg::UNSIGNED:
+				valid = format<std::uint64_t>(record, offset, out);
+				break;
+			case Arg::FLOAT:
+				valid = format<float>(record, offset, out);
+				break;
+			case Arg::DOUBLE:
+				valid = format<double>(record, offset, out);
+				break;
+			case Arg::BOOL: {
+				bool value = false;
+
+				if((valid = read(record, offset, value))) {
+					out.push_back(value? '1' : '0');
+				}
+				break;
+			}
+			case Arg::STRING: {
+				std::uint32_t length = 0;
+				valid = read(record, offset, length) && record.size() - offset >= length;
+
+				if(valid) {
+					out.insert(out.end(), record.data() + offset, record.data() + offset + length);
+					offset += length;
+				}
+				break;
+			}
+			case Arg::LITERAL: {
+				const char* str = nullptr;
+				std::size_t length = 0;
+				valid = read(record, offset, str) && read(record, offset, length);
+
+				if(valid) {
+					out.insert(out.end(), str, str + length);
+				}
+				break;
+			}
+			default:
+				valid = false;
+		}
+	}
+}
+
+} //detail, log, ember
\ No newline at end of file
@@ -9,10 +9,20 @@
 #include <logger/FileSink.h>
 #include <logger/Exception.h>
 #include <algorithm>
+#include <charconv>
+#include <chrono>
 #include <filesystem>
 #include <iterator>
 #include <limits>
+#include <string_view>
 #include <utility>
+#include <vector>
+
+#if _MSC_VER
+	#include <io.h>
+#else
+	#include <unistd.h>
+#endif
 
 #pragma warning(push)
 #pragma warning(disable: 4996)
@@ -20,6 +30,22 @@
 namespace ember::log {
 
 namespace fs = std::filesystem;
+namespace sc = std::chrono;
+
+namespace {
+
+constexpr std::size_t INITIAL_BUFFER = 64 * 1024;
+constexpr std::size_t MAX_RETAINED_BUFFER = 1024 * 1024;
+
+int sync_file(std::FILE* file) {
+#if _MSC_VER
+	return _commit(_fileno(file));
+#else
+	return fsync(fileno(file));
+#endif
+}
+
+} // unnamed
 
 FileSink::FileSink(Severity severity, Filter filter, std::string file_name, Mode mode)
                    : Sink(severity, filter), file_name_format_(std::move(file_name)) {
@@ -39,6 +65,11 @@ FileSink::FileSink(Severity severity, Filter filter, std::string file_name, Mode
 		current_size_ = size;
 	}
 
+	for(std::size_t i = 0; i < severities_.size(); ++i) {
+		severities_[i] = detail::severity_string(static_cast<Severity>(i));
+	}
+
+	buffer_.reserve(INITIAL_BUFFER);
 	open(mode);
 	set_initial_rotation();
 }
@@ -50,26 +81,70 @@ FileSink::~FileSink() {
 	}
 }
 
-bool FileSink::file_exists(const std::string& name) try {
-	return fs::exists(fs::path(name));
-} catch(std::filesystem::filesystem_error& e) {
-	throw exception(e.what());
-}
-
-void FileSink::set_initial_rotation() {
+/*
+ * Retention removes the oldest rotated files first, so the indices left over
+ * from a previous run needn't start at zero. Every one of them is tracked and
+ * rotation carries on after the highest, so nothing gets written over.
+ */
+void FileSink::set_initial_rotation() try {
 	constexpr auto max = std::numeric_limits<decltype(rotations_)>::max();
 
-	while(file_exists(file_name_ + std::to_string(rotations_)) && rotations_ < max) {
-		++rotations_;
+	const fs::path path(file_name_);
+	const auto prefix = path.filename().string();
+	const auto dir = path.has_parent_path()? path.parent_path() : fs::path(".");
+	std::vector<std::pair<decltype(rotations_), std::string>> rotated;
+
+	for(const auto& entry : fs::directory_iterator(dir)) {
+		const auto name = entry.path().filename().string();
+
+		if(!name.starts_with(prefix)) {
+			continue;
+		}
+
+		const std::string_view suffix = std::string_view(name).substr(prefix.size());
+		std::string_view digits = suffix;
+
+		if(digits.ends_with(".gz")) {
+			digits.remove_suffix(3);
+		}
+
+		// only the names rotate() gives out, <name>N or <name>N.gz
+		if(digits.empty() || (digits.size() > 1 && digits.front() == '0')) {
+			continue;
+		}
+
+		decltype(rotations_) index = 0;
+		const auto end = digits.data() + digits.size();
+		const auto [ptr, ec] = std::from_chars(digits.data(), end, index);
+
+		if(ec != std::errc() || ptr != end) {
+			continue;
+		}
+
+		rotated.emplace_back(index, file_name_ + std::string(suffix));
 	}
 
-	if(rotations_ == max) {
-		throw exception("Unable to set initial log rotation count. How did this happen?");
+	// oldest first, as the archiver expects
+	std::sort(rotated.begin(), rotated.end());
+
+	for(auto& [index, name] : rotated) {
+		archiver_.track(std::move(name));
 	}
+
+	if(!rotated.empty()) {
+		if(rotated.back().first == max) {
+			throw exception("Unable to set initial log rotation count. How did this happen?");
+		}
+
+		rotations_ = rotated.back().first + 1;
+	}
+} catch(const fs::filesystem_error& e) {
+	throw exception(e.what());
 }
 
 void FileSink::time_format(const std::string& format) {
 	time_format_ = format;
+	cached_second_ = -1;
 }
 
 void FileSink::format_file_name() {
@@ -93,7 +168,10 @@ void FileSink::size_limit(std::uintmax_t megabytes) {
 	max_size_ = megabytes * 1024 * 1024;
 }
 
+// anything beyond renaming the file is left to the archiver's thread
 void FileSink::rotate() {
+	const auto start = sc::steady_clock::now();
+
 	if(file_->close() != 0) {
 		throw exception("Unable to close log file during rotation - buffered messages may have been lost");
 	}
@@ -109,26 +187,56 @@ void FileSink::rotate() {
 	
 	format_file_name();
 	open();
+	archiver_.archive(std::move(rotated_name));
+	archiver_.metrics().timing("logging.rotation.rotate",
+	                           sc::duration_cast<sc::milliseconds>(sc::steady_clock::now() - start));
 }
 
-std::string FileSink::generate_record_detail(Severity severity, const std::tm& curr_time) {
-	std::string prepend;
+const std::tm& FileSink::current_time() {
+	const auto now = sc::system_clock::to_time_t(sc::system_clock::now());
+
+	if(now != cached_second_) {
+		cached_second_ = now;
+		cached_time_ = detail::local_time(now);
+		cached_stamp_ = detail::put_time(cached_time_, time_format_);
+	}
 
+	return cached_time_;
+}
+
+void FileSink::append(Severity severity, const std::vector<char>& record) {
 	if(log_date_) {
-		prepend = std::move(detail::put_time(curr_time, time_format_));
+		buffer_.insert(buffer_.end(), cached_stamp_.begin(), cached_stamp_.end());
 	}
 
 	if(log_severity_) {
-		std::string sev = detail::severity_string(severity);
+		const auto& prefix = severities_[static_cast<std::size_t>(severity)];
+		buffer_.insert(buffer_.end(), prefix.begin(), prefix.end());
+	}
 
-		if(!log_date_) {
-			prepend = std::move(sev);
-		} else {
-			prepend.append(sev);
-		}
+	buffer_.insert(buffer_.end(), record.begin(), record.end());
+}
+
+void FileSink::commit(bool flush, bool sync) {
+	if(!std::fwrite(buffer_.data(), buffer_.size(), 1, *file_)) {
+		throw exception("Unable to write log records to file");
+	}
+
+	current_size_ += buffer_.size();
+
+	if((flush || sync) && std::fflush(*file_) != 0) {
+		throw exception("Unable to flush log records to file");
 	}
 
-	return prepend;
+	if(sync && sync_file(*file_) != 0) {
+		throw exception("Unable to sync log file");
+	}
+
+	// don't hang on to the memory from a burst
+	if(buffer_.capacity() > MAX_RETAINED_BUFFER) {
+		buffer_ = std::vector<char>();
+		buffer_.reserve(INITIAL_BUFFER);
+	}
 }
 
 void FileSink::rotate_check(std::size_t buffer_size, const std::tm& curr_time) {
@@ -139,77 +247,41 @@ void FileSink::rotate_check(std::size_t buffer_size, const std::tm& curr_time) {
 	}
 }
 
+// the whole batch is written out in one go, so rotation is only checked once
 void FileSink::batch_write(const std::vector<std::pair<RecordDetail, std::vector<char>>>& records) {
-	std::tm curr_time = detail::current_time();
-	std::size_t size = 0;
-	Severity severity = this->severity();
-	Filter filter = this->filter();
-	bool matches = false;
+	const Severity severity = this->severity();
+	const Filter filter = this->filter();
+	const std::tm& curr_time = current_time();
+	bool sync = false;
 
-	for(auto&& [detail, data] : records) {
-		if(severity <= detail.severity && !(filter & detail.type)) {
-			size += data.size();
-			matches = true;
-		}
-	}
-
-	if(!matches) {
-		return;
-	}
-
-	std::vector<char> buffer;
-	buffer.reserve(size + (20 * records.size()));
+	buffer_.clear();
 
 	for(auto&& [detail, data] : records) {
 		if(severity <= detail.severity && !(filter & detail.type)) {
-			std::string prepend = std::move(generate_record_detail(detail.severity, curr_time));
-			std::copy(prepend.begin(), prepend.end(), std::back_inserter(buffer));
-			std::copy(data.begin(), data.end(), std::back_inserter(buffer));
+			append(detail.severity, data);
+			sync |= detail.severity >= sync_severity_;
 		}
 	}
 
-	std::size_t buffer_size = buffer.size();
-	rotate_check(buffer_size, curr_time);
-
-	if(!std::fwrite(buffer.data(), buffer_size, 1, *file_)) {
-		throw exception("Unable to write log record batch to file");
+	if(buffer_.empty()) {
+		return;
 	}
 
-	current_size_ += buffer_size;
+	rotate_check(buffer_.size(), curr_time);
+	commit(false, sync);
 }
 
-
 void FileSink::write(Severity severity, Filter type, const std::vector<char>& record, bool flush) {
 	if(this->severity() > severity || (this->filter() & type)) {
 		return;
 	}
 
-	std::tm curr_time = detail::current_time();
-	std::string prepend = std::move(generate_record_detail(severity, curr_time));
-	std::size_t prep_size = prepend.size();
-	std::size_t rec_size = record.size();
-
-	rotate_check(prep_size + rec_size, curr_time);
-
-	std::size_t count = 0;
-
-	if(prep_size) {
-		count += std::fwrite(prepend.c_str(), prep_size, 1, *file_);
-	}
-
-	count += std::fwrite(record.data(), rec_size, 1, *file_);
-
-	if ((prep_size && count != 2) || (!prep_size && !count)) {
-		throw exception("Unable to write log record to file");
-	}
-
-	current_size_ += (static_cast<std::uintmax_t>(prep_size) + rec_size);
+	const std::tm& curr_time = current_time();
 
-	if(flush) {
-		if(std::fflush(*file_) != 0) {
-			throw exception("Unable to flush log record to file");
-		}
-	}
+	buffer_.clear();
+	append(severity, record);
+	rotate_check(buffer_.size(), curr_time);
+	commit(flush, severity >= sync_severity_);
 }
 
 } //log, ember
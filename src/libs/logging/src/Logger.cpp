@@ -34,6 +34,26 @@ Filter Logger::filter() {
 	return pimpl_->filter();
 }
 
+void Logger::capture(const Capture mode) {
+	pimpl_->capture(mode);
+}
+
+Capture Logger::capture() {
+	return pimpl_->capture();
+}
+
+void Logger::overflow(const Overflow policy, const Severity threshold) {
+	pimpl_->overflow(policy, threshold);
+}
+
+std::uint64_t Logger::dropped() {
+	return pimpl_->dropped();
+}
+
+void Logger::metrics(Metrics* metrics) {
+	pimpl_->metrics(metrics);
+}
+
 Logger& Logger::operator <<(Logger& (*m)(Logger&)) {
 	return (*m)(*this);
 }
@@ -108,6 +128,11 @@ Logger& Logger::operator <<(const char* data) {
 	return *this;
 }
 
+Logger& Logger::operator <<(const Literal data) {
+	*pimpl_ << data;
+	return *this;
+}
+
 Logger& flush(Logger& out) {
 	out.finalise();
 	return out;
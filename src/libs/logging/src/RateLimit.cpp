@@ -0,0 +1,27 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <logger/RateLimit.h>
+
+namespace ember::log {
+
+std::atomic<CallSite*> CallSite::sites_ { nullptr };
+std::atomic_bool CallSite::pending_ { false };
+
+// sites are statics, so once linked they're never removed
+void CallSite::link() {
+	next_ = sites_.load(std::memory_order_relaxed);
+	while(!sites_.compare_exchange_weak(next_, this, std::memory_order_release, std::memory_order_relaxed));
+}
+
+CallSite* CallSite::collect() {
+	pending_.exchange(false, std::memory_order_acquire);
+	return sites_.load(std::memory_order_acquire);
+}
+
+} //log, ember
\ No newline at end of file
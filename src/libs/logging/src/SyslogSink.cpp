@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2015, 2016 Ember
+ * Copyright (c) 2015 - 2022 Ember
  *
  * This Source Code Form is subject to the terms of the Mozilla Public
  * License, v. 2.0. If a copy of the MPL was not distributed with this
@@ -12,8 +12,27 @@
 #include <logger/Exception.h>
 #include <boost/asio.hpp>
 #include <boost/assert.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include <ctime>
+
+#ifdef _WIN32
+	#include <process.h>
+#else
+	#include <unistd.h>
+#endif
 
 namespace bai = boost::asio::ip;
+namespace sc = std::chrono;
 
 #undef ERROR
 
@@ -24,39 +43,105 @@ class SyslogSink::impl : public Sink {
 		EMERGENCY, ALERT, CRITICAL, ERROR_, WARNING, NOTICE, INFORMATIONAL, DEBUG
 	};
 
+	static constexpr std::size_t MAX_PENDING = 1024 * 1024; // bytes of formatted messages
+	static constexpr std::size_t MAX_GATHER = 64;           // messages per TCP write
+	static constexpr auto RETRY_INTERVAL = sc::seconds(1);
+	static constexpr auto IO_TIMEOUT = sc::seconds(5);        // per TCP connect or write
+	static constexpr auto SHUTDOWN_TIMEOUT = sc::seconds(1);  // for the final flush
+	static constexpr auto STOP_POLL = sc::milliseconds(50);   // how quickly a stop interrupts I/O
+
 	boost::asio::io_context service_;
-	bai::udp::socket socket_;
+	bai::udp::socket udp_;
+	bai::tcp::socket tcp_;
+	bai::tcp::resolver::results_type tcp_endpoints_;
+	const Transport transport_;
 	std::string host_;
-	std::string tag_; 
+	std::string tag_;
+	std::string proc_id_;
 	Facility facility_;
 
-	std::string month_map(int month);
+	std::time_t cached_second_ = -1;
+	std::string cached_stamp_;
+	std::string header_; // reused while formatting
+
+	std::mutex lock_;
+	std::condition_variable cond_;
+	std::deque<std::string> pending_; // guarded by lock_
+	std::size_t pending_bytes_ = 0;   // guarded by lock_
+	std::atomic<std::uint64_t> dropped_ { 0 };
+	std::atomic_bool stop_ { false };
+	std::thread thread_;
+	sc::steady_clock::time_point drain_deadline_ = sc::steady_clock::time_point::max(); // sink thread only
+
 	SyslogSeverity severity_map(Severity severity);
+	void format(Severity severity, const std::vector<char>& record, std::deque<std::string>& out);
+	void enqueue(std::deque<std::string>& messages);
+	bool send_pending();
+	bool complete(sc::steady_clock::time_point deadline);
+	std::deque<std::string>::iterator send_udp(std::deque<std::string>& messages);
+	std::deque<std::string>::iterator send_tcp(std::deque<std::string>& messages);
+	void run();
 
 public:
 	impl(Severity severity, Filter filter, const std::string& host, unsigned int port,
-	     Facility facility, std::string tag);
+	     Facility facility, std::string tag, Transport transport, bool own_thread);
+	~impl();
+
 	void write(Severity severity, Filter type, const std::vector<char>& record, bool flush);
 	void batch_write(const std::vector<std::pair<RecordDetail, std::vector<char>>>& record);
+	std::uint64_t dropped() const;
 };
 
 SyslogSink::impl::impl(Severity severity, Filter filter, const std::string& host, unsigned int port,
-                       Facility facility, std::string tag) try
-                       : Sink(severity, filter), socket_(service_), host_(bai::host_name()),
-                         tag_(std::move(tag)) {
+                       Facility facility, std::string tag, Transport transport, bool own_thread) try
+                       : Sink(severity, filter), udp_(service_), tcp_(service_), transport_(transport),
+                         host_(bai::host_name()), tag_(std::move(tag)) {
 	facility_ = facility;
 
-	if(tag.size() > 32) {
+	if(tag_.size() > 32) {
 		throw exception("Syslog tag size must be 32 characters or less");
 	}
 
-	bai::udp::resolver resolver(service_);
-	bai::udp::resolver::query query(host, std::to_string(port));
-	boost::asio::connect(socket_, resolver.resolve(query));
+#ifdef _WIN32
+	proc_id_ = std::to_string(_getpid());
+#else
+	proc_id_ = std::to_string(getpid());
+#endif
+
+	if(transport_ == Transport::TCP) {
+		// connecting is left to the sink's thread so an absent collector doesn't stall startup
+		bai::tcp::resolver resolver(service_);
+		tcp_endpoints_ = resolver.resolve(host, std::to_string(port));
+		own_thread = true;
+	} else {
+		bai::udp::resolver resolver(service_);
+		boost::asio::connect(udp_, resolver.resolve(host, std::to_string(port)));
+
+		// when sending from the logging worker, a full socket buffer must not block it
+		if(!own_thread) {
+			udp_.non_blocking(true);
+		}
+	}
+
+	if(own_thread) {
+		thread_ = std::thread(&impl::run, this);
+	}
 } catch(const std::exception& e) {
 	throw exception(e.what());
 }
 
+SyslogSink::impl::~impl() {
+	if(thread_.joinable()) {
+		{
+			std::lock_guard<std::mutex> guard(lock_);
+			stop_ = true;
+		}
+
+		cond_.notify_one();
+		thread_.join();
+	}
+}
+
 auto SyslogSink::impl::severity_map(Severity severity) -> SyslogSeverity {
 	switch(severity) {
 		case Severity::FATAL:
@@ -76,63 +161,260 @@ auto SyslogSink::impl::severity_map(Severity severity) -> SyslogSeverity {
 	}
 }
 
-std::string SyslogSink::impl::month_map(int month) {
-	switch(month) {
-		case 0: return "Jan";
-		case 1: return "Feb";
-		case 2: return "Mar";
-		case 3: return "Apr";
-		case 4: return "May";
-		case 5: return "Jun";
-		case 6: return "Jul";
-		case 7: return "Aug";
-		case 8: return "Sept";
-		case 9: return "Oct";
-		case 10: return "Nov";
-		case 11: return "Dec";
-		default: BOOST_ASSERT_MSG(false,
-		"SyslogSink encountered an unknown month value. Only Earth is supported.");
-			return "err";
+/*
+ * RFC 5424 - <PRI>1 TIMESTAMP HOSTNAME APP-NAME PROCID MSGID SD MSG
+ * The timestamp is UTC with millisecond precision, the seconds part of which
+ * is only formatted when it changes.
+ */
+void SyslogSink::impl::format(Severity severity, const std::vector<char>& record,
+                              std::deque<std::string>& out) {
+	const auto now = sc::system_clock::now();
+	const auto seconds = sc::system_clock::to_time_t(now);
+
+	if(seconds != cached_second_) {
+		std::tm time;
+
+#if _MSC_VER && !__INTEL_COMPILER
+		gmtime_s(&time, &seconds);
+#else
+		gmtime_r(&seconds, &time);
+#endif
+
+		char buffer[32];
+		std::strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%S", &time);
+		cached_stamp_ = buffer;
+		cached_second_ = seconds;
 	}
+
+	const auto millis = sc::duration_cast<sc::milliseconds>(now.time_since_epoch()).count() % 1000;
+	const int priority = (static_cast<int>(facility_) * 8)
+	                     + static_cast<std::uint8_t>(severity_map(severity));
+
+	char fraction[8];
+	std::snprintf(fraction, sizeof(fraction), ".%03dZ ", static_cast<int>(millis));
+
+	header_.clear();
+	header_.append("<").append(std::to_string(priority)).append(">1 ");
+	header_.append(cached_stamp_).append(fraction);
+	header_.append(host_).append(" ").append(tag_).append(" ").append(proc_id_).append(" - - ");
+
+	// records come with a trailing newline, which isn't part of the message
+	auto length = record.size();
+
+	if(length && record[length - 1] == '\n') {
+		--length;
+	}
+
+	std::string message;
+
+	if(transport_ == Transport::TCP) {
+		message.append(std::to_string(header_.size() + length)).append(" ");
+	}
+
+	message.reserve(message.size() + header_.size() + length);
+	message.append(header_);
+	message.append(record.data(), length);
+	out.emplace_back(std::move(message));
 }
 
-void SyslogSink::impl::write(Severity severity, Filter type, const std::vector<char>& record, bool flush) {
-	if(this->severity() >= severity || (this->filter() & type)) {
-		return;
+// the newest messages are dropped once the retry buffer is full
+void SyslogSink::impl::enqueue(std::deque<std::string>& messages) {
+	{
+		std::lock_guard<std::mutex> guard(lock_);
+
+		for(auto& message : messages) {
+			if(pending_bytes_ + message.size() > MAX_PENDING) {
+				dropped_.fetch_add(1, std::memory_order_relaxed);
+				continue;
+			}
+
+			pending_bytes_ += message.size();
+			pending_.emplace_back(std::move(message));
+		}
+	}
+
+	if(thread_.joinable()) {
+		cond_.notify_one();
+	} else {
+		send_pending();
 	}
-	
-	int priority_val = (static_cast<int>(facility_) * 8)
-	                    + static_cast<std::uint8_t>(severity_map(severity));
-	std::string priority = "<" + std::to_string(priority_val) + ">";
+}
+
+/*
+ * Sends as much as the transport will take right now, putting anything left
+ * back on the front of the queue for the next attempt. Returns false if
+ * messages had to be held back.
+ */
+bool SyslogSink::impl::send_pending() {
+	std::deque<std::string> sending;
 
-	std::tm time = detail::current_time();
-	std::stringstream stream;
-	stream << month_map(time.tm_mon) << ((time.tm_mday < 10)? "  " : " " ) << time.tm_mday
-	       << " " << time.tm_hour << ":" << time.tm_min << ":" << ((time.tm_sec < 10) ? "0" : "")
-	       << time.tm_sec << " " << host_ << " ";
+	{
+		std::lock_guard<std::mutex> guard(lock_);
+		sending.swap(pending_);
+	}
 
-	const std::string& header = stream.str();
-	std::vector<boost::asio::const_buffer> segments;
-	segments.emplace_back(priority.data(), priority.size());
-	segments.emplace_back(header.data(), header.size());
-	segments.emplace_back(tag_.data(), tag_.size());
-	segments.emplace_back(": ", 2);
-	segments.emplace_back(record.data(), record.size());
+	const auto unsent = transport_ == Transport::TCP? send_tcp(sending) : send_udp(sending);
+	std::size_t sent_bytes = 0;
 
-	boost::system::error_code err; //ignoring any send errors
-	socket_.send(segments, 0, err);
+	for(auto it = sending.begin(); it != unsent; ++it) {
+		sent_bytes += it->size();
+	}
+
+	std::lock_guard<std::mutex> guard(lock_);
+	pending_bytes_ -= sent_bytes;
+	pending_.insert(pending_.begin(), std::make_move_iterator(unsent),
+	                std::make_move_iterator(sending.end()));
+	return unsent == sending.end();
+}
+
+auto SyslogSink::impl::send_udp(std::deque<std::string>& messages) -> std::deque<std::string>::iterator {
+	auto it = messages.begin();
+
+	for(; it != messages.end(); ++it) {
+		boost::system::error_code ec;
+		udp_.send(boost::asio::buffer(*it), 0, ec);
+
+		if(ec == boost::asio::error::would_block || ec == boost::asio::error::try_again) {
+			break;
+		}
+
+		// other errors, such as an unreachable collector, just lose the message
+		if(ec) {
+			dropped_.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	return it;
+}
+
+/*
+ * Runs the TCP operation just started on the sink's own context. If it
+ * hasn't finished by the deadline, or the sink is stopped while it's
+ * waiting, the socket is closed to abort it. Once the final flush has
+ * started, a stop no longer aborts anything, but the flush has its own
+ * deadline.
+ */
+bool SyslogSink::impl::complete(const sc::steady_clock::time_point deadline) {
+	const auto limit = std::min(deadline, drain_deadline_);
+	service_.restart();
+
+	while(!service_.stopped()) {
+		const auto now = sc::steady_clock::now();
+
+		if(now >= limit || (stop_ && drain_deadline_ == sc::steady_clock::time_point::max())) {
+			boost::system::error_code ec;
+			tcp_.close(ec);
+			service_.run(); // the aborted handler still has to run
+			return false;
+		}
+
+		service_.run_for(std::min<sc::steady_clock::duration>(limit - now, STOP_POLL));
+	}
+
+	return true;
+}
+
+auto SyslogSink::impl::send_tcp(std::deque<std::string>& messages) -> std::deque<std::string>::iterator {
+	boost::system::error_code ec;
+
+	if(!tcp_.is_open()) {
+		boost::asio::async_connect(tcp_, tcp_endpoints_, [&](const boost::system::error_code& error, const auto&) {
+			ec = error;
+		});
+
+		if(!complete(sc::steady_clock::now() + IO_TIMEOUT) || ec) {
+			tcp_.close(ec);
+			return messages.begin();
+		}
+	}
+
+	std::vector<boost::asio::const_buffer> buffers;
+	buffers.reserve(MAX_GATHER);
+	auto it = messages.begin();
+
+	while(it != messages.end()) {
+		auto end = it;
+		buffers.clear();
+
+		for(; end != messages.end() && buffers.size() < MAX_GATHER; ++end) {
+			buffers.emplace_back(boost::asio::buffer(*end));
+		}
+
+		boost::asio::async_write(tcp_, buffers, [&](const boost::system::error_code& error, std::size_t) {
+			ec = error;
+		});
+
+		// a partial write may mean the collector sees some messages twice after reconnecting
+		if(!complete(sc::steady_clock::now() + IO_TIMEOUT) || ec) {
+			tcp_.close(ec);
+			break;
+		}
+
+		it = end;
+	}
+
+	return it;
+}
+
+void SyslogSink::impl::run() {
+	while(true) {
+		{
+			std::unique_lock<std::mutex> guard(lock_);
+			cond_.wait(guard, [&] { return stop_ || !pending_.empty(); });
+
+			if(stop_) {
+				break;
+			}
+		}
+
+		if(!send_pending()) {
+			std::unique_lock<std::mutex> guard(lock_);
+			cond_.wait_for(guard, RETRY_INTERVAL, [&] { return stop_.load(); });
+		}
+	}
+
+	// last chance for anything logged during shutdown, without waiting on a connection
+	if(transport_ == Transport::UDP || tcp_.is_open()) {
+		drain_deadline_ = sc::steady_clock::now() + SHUTDOWN_TIMEOUT;
+		send_pending();
+	}
+}
+
+// records are handed to the transport or sink thread as they arrive, there's nothing to flush
+void SyslogSink::impl::write(Severity severity, Filter type, const std::vector<char>& record,
+                             [[maybe_unused]] bool flush) {
+	if(this->severity() > severity || (this->filter() & type)) {
+		return;
+	}
+
+	std::deque<std::string> messages;
+	format(severity, record, messages);
+	enqueue(messages);
 }
 
 void SyslogSink::impl::batch_write(const std::vector<std::pair<RecordDetail, std::vector<char>>>& records) {
+	std::deque<std::string> messages;
+
 	for(auto& [detail, data] : records) {
-		write(detail.severity, detail.type, data, false);
+		if(this->severity() <= detail.severity && !(this->filter() & detail.type)) {
+			format(detail.severity, data, messages);
+		}
 	}
+
+	if(!messages.empty()) {
+		enqueue(messages);
+	}
+}
+
+std::uint64_t SyslogSink::impl::dropped() const {
+	return dropped_.load(std::memory_order_relaxed);
 }
 
 SyslogSink::SyslogSink(Severity severity, Filter filter, std::string host, unsigned int port,
-                       Facility facility, std::string tag)
+                       Facility facility, std::string tag, Transport transport, bool own_thread)
                        : Sink(severity, filter),
-                         pimpl_(std::make_unique<impl>(severity, filter, std::move(host), port, facility, std::move(tag))) {}
+                         pimpl_(std::make_unique<impl>(severity, filter, std::move(host), port, facility,
+                                                       std::move(tag), transport, own_thread)) {}
 
 SyslogSink::~SyslogSink() = default;
 
@@ -144,4 +426,8 @@ void SyslogSink::batch_write(const std::vector<std::pair<RecordDetail, std::vect
 	pimpl_->batch_write(records);
 }
 
+std::uint64_t SyslogSink::dropped() const {
+	return pimpl_->dropped();
+}
+
 } //log, ember
@@ -20,8 +20,11 @@ namespace detail {
 namespace sc = std::chrono;
 
 std::tm current_time() {
+	return local_time(sc::system_clock::to_time_t(sc::system_clock::now()));
+}
+
+std::tm local_time(const std::time_t sys_time) {
 	std::tm time;
-	auto sys_time = sc::system_clock::to_time_t(sc::system_clock::now());
 
 #if _MSC_VER && !__INTEL_COMPILER
 	localtime_s(&time, &sys_time);
@@ -7,34 +7,177 @@
  */
 
 #include <logger/Worker.h>
+#include <logger/Capture.h>
+#include <logger/RateLimit.h>
+#include <algorithm>
 #include <iterator>
+#include <string>
+#include <string_view>
+#include <utility>
 
 namespace ember::log {
 
+Worker::Worker(std::vector<std::unique_ptr<Sink>>& sinks)
+               : sinks_(sinks), sem_(0) {}
+
 Worker::~Worker() {
 	if(!stop_) {
 		stop();
 	}
 }
 
-void Worker::process_outstanding_sync() {
-	std::tuple<RecordDetail, std::vector<char>, std::binary_semaphore*> item;
+void Worker::enqueue(Record& record) {
+	auto& ring = rings_.local(RING_CAPACITY);
+
+	if(!ring.push(record)) {
+		overflow(ring, record);
+	}
+
+	record.second.clear();
+	wake();
+}
+
+void Worker::enqueue_sync(SyncRecord record) {
+	queue_sync_.enqueue(std::move(record));
+	wake();
+}
+
+void Worker::overflow(RecordRing& ring, Record& record) {
+	const auto policy = overflow_.load(std::memory_order_relaxed);
+
+	if(policy == Overflow::DROP_NEWEST || stop_
+	   || (policy == Overflow::DROP_BY_SEVERITY
+	       && record.first.severity < drop_below_.load(std::memory_order_relaxed))) {
+		dropped_.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	while(!ring.push(record)) {
+		wake();
+		std::this_thread::yield();
+	}
+}
+
+void Worker::overflow(const Overflow policy, const Severity threshold) {
+	drop_below_.store(threshold, std::memory_order_relaxed);
+	overflow_.store(policy, std::memory_order_relaxed);
+}
+
+std::uint64_t Worker::dropped() const {
+	return dropped_.load(std::memory_order_relaxed);
+}
+
+// converts binary captured records to text before they're handed to the sinks
+void Worker::format(RecordDetail& detail, std::vector<char>& record) {
+	if(!detail.binary) {
+		return;
+	}
+
+	scratch_.clear();
+	detail::decode(record, scratch_);
+	scratch_.push_back('\n');
+	record.swap(scratch_);
+	detail.binary = false;
+}
+
+void Worker::report_dropped() {
+	const auto dropped = dropped_.load(std::memory_order_relaxed);
+
+	if(dropped == dropped_reported_) {
+		return;
+	}
+
+	const auto message = std::to_string(dropped - dropped_reported_)
+		+ " log record(s) dropped, queue full\n";
+	dropped_reported_ = dropped;
+
+	RecordDetail detail{ Severity::WARN, Filter(1) };
+	dequeued_.emplace_back(detail, std::vector<char>(message.begin(), message.end()));
+}
+
+void Worker::report_suppressed(const bool force) {
+	if(!force && !CallSite::pending()) {
+		return;
+	}
+
+	const auto now = std::chrono::steady_clock::now();
+
+	if(!force && now - summarised_ < SUMMARY_INTERVAL) {
+		return;
+	}
+
+	summarised_ = now;
+
+	for(auto site = CallSite::collect(); site; site = site->next()) {
+		const auto suppressed = site->take_suppressed();
+
+		if(!suppressed) {
+			continue;
+		}
+
+		std::string_view file(site->file());
+		file.remove_prefix(file.find_last_of("/\\") + 1);
+
+		std::string message("suppressed ");
+		message.append(std::to_string(suppressed)).append(" similar message(s) from ");
+		message.append(file).append(":").append(std::to_string(site->line())).append("\n");
+
+		RecordDetail detail{ site->severity(), site->filter() };
+		dequeued_.emplace_back(detail, std::vector<char>(message.begin(), message.end()));
+	}
+}
+
+/*
+ * Taking the sync records first means anything their threads queued before
+ * them is already visible in the rings, so draining the rings completely
+ * gets those records out ahead of them.
+ */
+bool Worker::process_outstanding_sync() {
+	SyncRecord item;
 
 	while(queue_sync_.try_dequeue(item)) {
+		dequeued_sync_.emplace_back(std::move(item));
+	}
+
+	if(dequeued_sync_.empty()) {
+		return false;
+	}
+
+	process_outstanding(RING_CAPACITY);
+
+	for(auto& [detail, data, sem] : dequeued_sync_) {
+		format(detail, data);
+
 		for(auto& s : sinks_) {
-			s->write(std::get<0>(item).severity, std::get<0>(item).type, std::get<1>(item), true);
+			s->write(detail.severity, detail.type, data, true);
 		}
-		std::get<2>(item)->release();
+
+		sem->release();
 	}
+
+	dequeued_sync_.clear();
+	return true;
 }
 
-void Worker::process_outstanding() {
-	if(!queue_.try_dequeue_bulk(std::back_inserter(dequeued_), queue_.size_approx())) {
-		return;
+bool Worker::process_outstanding(const std::size_t batch) {
+	// a thread that has exited can't add any more, so its ring is emptied before being dropped
+	rings_.collect([&](RecordRing& ring, const bool orphaned) {
+		ring.pop(dequeued_, orphaned? RING_CAPACITY : batch);
+	});
+
+	report_dropped();
+	report_suppressed(false);
+
+	if(dequeued_.empty()) {
+		return false;
 	}
-		
+
 	std::size_t records = dequeued_.size();
 
+	for(auto& [detail, data] : dequeued_) {
+		format(detail, data);
+	}
+
 	if(records < 5) {
 		for(auto& s : sinks_) {
 			for(auto& [detail, data] : dequeued_) {
@@ -52,17 +195,63 @@ void Worker::process_outstanding() {
 	if(dequeued_.capacity() > 100 && records < 100) {
 		dequeued_.shrink_to_fit();
 	}
+
+	return true;
+}
+
+bool Worker::pending() {
+	if(queue_sync_.size_approx()) {
+		return true;
+	}
+
+	return rings_.any_of([](const RecordRing& ring) {
+		return !ring.empty();
+	});
+}
+
+void Worker::park() {
+	sleeping_.store(true);
+
+	// pairs with the fence in wake, either the producer sees us sleeping or we see its record
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	if(!stop_ && !pending()) {
+		if(!CallSite::pending()) {
+			sem_.acquire();
+			return;
+		}
+
+		// suppressed records are waiting on a summary, so only sleep until it's due
+		if(sem_.try_acquire_for(SUMMARY_INTERVAL)) {
+			return;
+		}
+	}
+
+	// a producer that saw the flag has already released, take it back
+	if(!sleeping_.exchange(false)) {
+		sem_.acquire();
+	}
 }
 
 void Worker::run() {
 #ifndef DEBUG_NO_THREADS
+	std::size_t idle = 0;
+
 	while(!stop_) {
-#endif
-		sem_.acquire();
-		process_outstanding();
-		process_outstanding_sync();
-#ifndef DEBUG_NO_THREADS
+		const bool processed = process_outstanding();
+
+		if(process_outstanding_sync() || processed) {
+			idle = 0;
+		} else if(++idle < SPIN_LIMIT) {
+			std::this_thread::yield();
+		} else {
+			park();
+			idle = 0;
+		}
 	}
+#else
+	process_outstanding();
+	process_outstanding_sync();
 #endif
 }
 
@@ -73,8 +262,15 @@ void Worker::start() {
 void Worker::stop() {
 	if(thread_.joinable()) {
 		stop_ = true;
-		sem_.release();
+
+		if(sleeping_.exchange(false)) {
+			sem_.release();
+		}
+
 		thread_.join();
+
+		while(process_outstanding());
+		report_suppressed(true);
 		process_outstanding();
 		process_outstanding_sync();
 	}
@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <shared/metrics/Histogram.h>
+#include <bit>
+#include <cmath>
+
+namespace ember {
+
+namespace {
+
+constexpr std::size_t HALF_BUCKETS = Histogram::SUB_BUCKETS / 2;
+
+} // unnamed
+
+std::size_t Histogram::index(const std::uint32_t value) {
+	if(value < SUB_BUCKETS) {
+		return value;
+	}
+
+	const std::size_t shift = std::bit_width(value) - SUB_BUCKET_BITS;
+	return SUB_BUCKETS + (shift - 1) * HALF_BUCKETS + ((value >> shift) - HALF_BUCKETS);
+}
+
+std::uint64_t Histogram::lowest(const std::size_t index) {
+	if(index < SUB_BUCKETS) {
+		return index;
+	}
+
+	const auto shift = (index - SUB_BUCKETS) / HALF_BUCKETS + 1;
+	const std::uint64_t base = (index - SUB_BUCKETS) % HALF_BUCKETS + HALF_BUCKETS;
+	return base << shift;
+}
+
+std::uint64_t Histogram::highest(const std::size_t index) {
+	if(index < SUB_BUCKETS) {
+		return index;
+	}
+
+	const auto shift = (index - SUB_BUCKETS) / HALF_BUCKETS + 1;
+	return lowest(index) + (1ull << shift) - 1;
+}
+
+void Histogram::Snapshot::merge(const Histogram& histogram) {
+	for(std::size_t i = 0; i < BUCKETS; ++i) {
+		counts[i] += histogram.buckets_[i].load(std::memory_order_relaxed);
+	}
+
+	sum += histogram.sum_.load(std::memory_order_relaxed);
+}
+
+std::uint64_t Histogram::Snapshot::count() const {
+	std::uint64_t total = 0;
+
+	for(const auto count : counts) {
+		total += count;
+	}
+
+	return total;
+}
+
+// the highest value in the bucket the quantile falls into, so never an underestimate
+std::uint64_t Histogram::Snapshot::value_at(const double quantile) const {
+	const auto total = count();
+
+	if(!total) {
+		return 0;
+	}
+
+	const auto rank = static_cast<std::uint64_t>(std::ceil(quantile * total));
+	std::uint64_t seen = 0;
+
+	for(std::size_t i = 0; i < BUCKETS; ++i) {
+		seen += counts[i];
+
+		if(seen && seen >= rank) {
+			return highest(i);
+		}
+	}
+
+	return highest(BUCKETS - 1);
+}
+
+} // ember
\ No newline at end of file
@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace ember {
+
+/*
+ * HDR-style log-linear histogram. Values below SUB_BUCKETS are recorded
+ * exactly. Beyond that, each power of two is split into SUB_BUCKETS / 2
+ * buckets, so a bucket is never wider than ~3% of the values it holds.
+ *
+ * Recording is a pair of relaxed atomic increments, so a histogram can be
+ * read while it's being written to. Readers take a Snapshot, which can
+ * also be used to merge several histograms.
+ */
+class Histogram final {
+public:
+	static constexpr std::size_t SUB_BUCKET_BITS = 6;
+	static constexpr std::size_t SUB_BUCKETS = 1u << SUB_BUCKET_BITS;
+	static constexpr std::size_t BUCKETS = SUB_BUCKETS + (32 - SUB_BUCKET_BITS) * (SUB_BUCKETS / 2);
+
+	struct Snapshot {
+		std::array<std::uint64_t, BUCKETS> counts {};
+		std::uint64_t sum = 0;
+
+		void merge(const Histogram& histogram);
+		std::uint64_t count() const;
+		std::uint64_t value_at(double quantile) const;
+	};
+
+	static std::size_t index(std::uint32_t value);
+	static std::uint64_t lowest(std::size_t index);
+	static std::uint64_t highest(std::size_t index);
+
+	void record(std::uint32_t value) {
+		buckets_[index(value)].fetch_add(1, std::memory_order_relaxed);
+		sum_.fetch_add(value, std::memory_order_relaxed);
+	}
+
+private:
+	std::array<std::atomic<std::uint64_t>, BUCKETS> buckets_ {};
+	std::atomic<std::uint64_t> sum_ { 0 };
+};
+
+} // ember
\ No newline at end of file
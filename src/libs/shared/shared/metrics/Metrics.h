@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2015 - 2018 Ember
+ * Copyright (c) 2015 - 2022 Ember
  *
  * This Source Code Form is subject to the terms of the Mozilla Public
  * License, v. 2.0. If a copy of the MPL was not distributed with this
@@ -20,9 +20,20 @@ public:
 
 	virtual void increment(const char* key, std::intmax_t value = 1) { }
 	virtual void timing(const char* key, const std::chrono::milliseconds& value) { }
+
+	// for timings that are often under a millisecond, a key should only be recorded in one unit
+	virtual void timing(const char* key, const std::chrono::microseconds& value) {
+		timing(key, std::chrono::duration_cast<std::chrono::milliseconds>(value));
+	}
 	virtual void gauge(const char* key, std::uintmax_t value, Adjustment adjustment = Adjustment::NONE) { }
 	virtual void set(const char* key, std::intmax_t value) { }
 	virtual ~Metrics() = default;
+
+	// discards everything, for components that weren't given anywhere to report to
+	static Metrics& null() {
+		static Metrics metrics;
+		return metrics;
+	}
 };
 
 } // ember
\ No newline at end of file
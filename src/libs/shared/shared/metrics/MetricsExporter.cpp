@@ -0,0 +1,350 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <shared/metrics/MetricsExporter.h>
+#include <shared/metrics/Histogram.h>
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <functional>
+#include <istream>
+#include <limits>
+#include <map>
+#include <utility>
+
+namespace ember {
+
+namespace bai = boost::asio::ip;
+
+namespace {
+
+struct Counter {
+	std::atomic<std::intmax_t> value { 0 };
+};
+
+// Prometheus names are limited to [a-zA-Z_:][a-zA-Z0-9_:]*
+std::string metric_name(const std::string& key) {
+	std::string name(key);
+
+	std::replace_if(name.begin(), name.end(), [](const char c) {
+		return !((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+		         || (c >= '0' && c <= '9') || c == '_' || c == ':');
+	}, '_');
+
+	if(name.empty() || (name.front() >= '0' && name.front() <= '9')) {
+		name.insert(name.begin(), '_');
+	}
+
+	return name;
+}
+
+// units is the number of recorded units in a second
+void append_seconds(std::string& out, const double value, const double units) {
+	char buffer[32];
+	const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value / units);
+	out.append(buffer, result.ptr);
+}
+
+template<typename Rep>
+std::uint32_t clamp_timing(const Rep count) {
+	return static_cast<std::uint32_t>(
+		std::clamp<Rep>(count, 0, std::numeric_limits<std::uint32_t>::max()));
+}
+
+struct Bound {
+	std::uint64_t microseconds;
+	const char* label;
+};
+
+// every histogram lists the same buckets on every scrape, so series never come and go
+constexpr std::array<Bound, 19> BOUNDS {{
+	{ 50, "0.00005" }, { 100, "0.0001" }, { 250, "0.00025" }, { 500, "0.0005" },
+	{ 1'000, "0.001" }, { 2'500, "0.0025" }, { 5'000, "0.005" }, { 10'000, "0.01" },
+	{ 25'000, "0.025" }, { 50'000, "0.05" }, { 100'000, "0.1" }, { 250'000, "0.25" },
+	{ 500'000, "0.5" }, { 1'000'000, "1" }, { 2'500'000, "2.5" }, { 5'000'000, "5" },
+	{ 10'000'000, "10" }, { 30'000'000, "30" }, { 60'000'000, "60" }
+}};
+
+/*
+ * The fine histogram buckets are folded into the fixed bounds. A bucket only
+ * counts towards a bound once its highest value is within it, so a value
+ * close to a bound may be counted in the next one up, never the one below.
+ */
+void append_histograms(std::string& out, const std::map<std::string, Histogram::Snapshot>& histograms,
+                       const double units) {
+	for(const auto& [key, snapshot] : histograms) {
+		const auto name = metric_name(key) + "_seconds";
+		out.append("# TYPE ").append(name).append(" histogram\n");
+		std::uint64_t cumulative = 0;
+		std::size_t i = 0;
+
+		for(const auto& bound : BOUNDS) {
+			const auto limit = static_cast<double>(bound.microseconds) * units / 1000000.0;
+
+			for(; i < snapshot.counts.size() && Histogram::highest(i) <= limit; ++i) {
+				cumulative += snapshot.counts[i];
+			}
+
+			out.append(name).append("_bucket{le=\"").append(bound.label).append("\"} ");
+			out.append(std::to_string(cumulative)).append("\n");
+		}
+
+		for(; i < snapshot.counts.size(); ++i) {
+			cumulative += snapshot.counts[i];
+		}
+
+		out.append(name).append("_bucket{le=\"+Inf\"} ").append(std::to_string(cumulative)).append("\n");
+		out.append(name).append("_sum ");
+		append_seconds(out, static_cast<double>(snapshot.sum), units);
+		out.append("\n");
+		out.append(name).append("_count ").append(std::to_string(cumulative)).append("\n");
+	}
+}
+
+} // unnamed
+
+struct MetricsExporter::Shard {
+	std::mutex lock;
+	SlotMap<std::unique_ptr<Counter>> counters;
+	SlotMap<std::unique_ptr<Histogram>> histograms;
+	SlotMap<std::unique_ptr<Histogram>> fine_histograms; // microseconds
+	SlotMap<std::atomic<std::intmax_t>*> gauges; // owning thread only
+};
+
+struct MetricsExporter::Totals {
+	std::map<std::string, std::intmax_t> counters;
+	std::map<std::string, Histogram::Snapshot> histograms;
+	std::map<std::string, Histogram::Snapshot> fine_histograms;
+
+	// shard.lock must be held by the caller
+	void add(const Shard& shard) {
+		for(const auto& [key, counter] : shard.counters) {
+			counters[key] += counter->value.load(std::memory_order_relaxed);
+		}
+
+		for(const auto& [key, histogram] : shard.histograms) {
+			histograms[key].merge(*histogram);
+		}
+
+		for(const auto& [key, histogram] : shard.fine_histograms) {
+			fine_histograms[key].merge(*histogram);
+		}
+	}
+};
+
+struct MetricsExporter::Connection {
+	bai::tcp::socket socket;
+	boost::asio::steady_timer deadline;
+	boost::asio::streambuf request { MAX_REQUEST };
+	std::string response;
+
+	explicit Connection(bai::tcp::socket socket)
+		: socket(std::move(socket)), deadline(this->socket.get_executor()) {}
+};
+
+MetricsExporter::MetricsExporter(boost::asio::io_context& service, const std::string& interface,
+                                 std::uint16_t port, std::unique_ptr<Metrics> forward)
+                                 : forward_(forward? std::move(forward) : std::make_unique<Metrics>()),
+                                   retired_(std::make_unique<Totals>()),
+                                   strand_(service.get_executor()),
+                                   acceptor_(strand_, bai::tcp::endpoint(bai::make_address(interface), port)),
+                                   signals_(service, SIGINT, SIGTERM) {
+	signals_.async_wait(boost::asio::bind_executor(strand_, std::bind(&MetricsExporter::shutdown, this)));
+	accept();
+}
+
+MetricsExporter::~MetricsExporter() {
+	boost::system::error_code ec;
+	signals_.cancel(ec);
+	acceptor_.close(ec);
+}
+
+void MetricsExporter::shutdown() {
+	boost::system::error_code ec; // we don't care about any errors
+	acceptor_.close(ec);
+}
+
+std::uint16_t MetricsExporter::port() const {
+	return acceptor_.local_endpoint().port();
+}
+
+void MetricsExporter::increment(const char* key, std::intmax_t value) {
+	auto& shard = shards_.local();
+	slot(shard.counters, shard.lock, key).value.fetch_add(value, std::memory_order_relaxed);
+	forward_->increment(key, value);
+}
+
+void MetricsExporter::timing(const char* key, const std::chrono::milliseconds& value) {
+	auto& shard = shards_.local();
+	slot(shard.histograms, shard.lock, key).record(clamp_timing(value.count()));
+	forward_->timing(key, value);
+}
+
+void MetricsExporter::timing(const char* key, const std::chrono::microseconds& value) {
+	auto& shard = shards_.local();
+	slot(shard.fine_histograms, shard.lock, key).record(clamp_timing(value.count()));
+	forward_->timing(key, value);
+}
+
+std::atomic<std::intmax_t>& MetricsExporter::gauge_slot(const char* key) {
+	auto& shard = shards_.local();
+
+	if(auto it = shard.gauges.find(std::string_view(key)); it != shard.gauges.end()) {
+		return *it->second;
+	}
+
+	std::lock_guard<std::mutex> guard(gauges_lock_);
+	auto it = gauges_.find(std::string_view(key));
+
+	if(it == gauges_.end()) {
+		it = gauges_.emplace(key, std::make_unique<std::atomic<std::intmax_t>>(0)).first;
+	}
+
+	shard.gauges.emplace(key, it->second.get());
+	return *it->second;
+}
+
+void MetricsExporter::gauge(const char* key, std::uintmax_t value, Adjustment adjustment) {
+	auto& gauge = gauge_slot(key);
+	const auto signed_value = static_cast<std::intmax_t>(value);
+
+	switch(adjustment) {
+		case Adjustment::POSITIVE:
+			gauge.fetch_add(signed_value, std::memory_order_relaxed);
+			break;
+		case Adjustment::NEGATIVE:
+			gauge.fetch_sub(signed_value, std::memory_order_relaxed);
+			break;
+		case Adjustment::NONE:
+			gauge.store(signed_value, std::memory_order_relaxed);
+			break;
+	}
+
+	forward_->gauge(key, value, adjustment);
+}
+
+void MetricsExporter::set(const char* key, std::intmax_t value) {
+	forward_->set(key, value);
+}
+
+std::string MetricsExporter::scrape() {
+	std::map<std::string, std::intmax_t> gauges;
+	std::unique_lock<std::mutex> retired_guard(retired_lock_);
+	auto totals = *retired_;
+
+	// an exited thread's shard is visited for the last time here, so it's kept in the running totals
+	shards_.collect([&](Shard& shard, const bool orphaned) {
+		std::lock_guard<std::mutex> guard(shard.lock);
+		totals.add(shard);
+
+		if(orphaned) {
+			retired_->add(shard);
+		}
+	});
+
+	retired_guard.unlock();
+	const auto& [counters, histograms, fine_histograms] = totals;
+
+	{
+		std::lock_guard<std::mutex> guard(gauges_lock_);
+
+		for(const auto& [key, gauge] : gauges_) {
+			gauges.emplace(key, gauge->load(std::memory_order_relaxed));
+		}
+	}
+
+	std::string out;
+
+	for(const auto& [key, value] : counters) {
+		const auto name = metric_name(key) + "_total";
+		out.append("# TYPE ").append(name).append(" counter\n");
+		out.append(name).append(" ").append(std::to_string(value)).append("\n");
+	}
+
+	for(const auto& [key, value] : gauges) {
+		const auto name = metric_name(key);
+		out.append("# TYPE ").append(name).append(" gauge\n");
+		out.append(name).append(" ").append(std::to_string(value)).append("\n");
+	}
+
+	append_histograms(out, histograms, 1000.0);
+	append_histograms(out, fine_histograms, 1000000.0);
+
+	return out;
+}
+
+void MetricsExporter::accept() {
+	acceptor_.async_accept(boost::asio::bind_executor(strand_,
+		[this](const boost::system::error_code& ec, bai::tcp::socket socket) {
+			if(ec == boost::asio::error::operation_aborted || !acceptor_.is_open()) {
+				return;
+			}
+
+			if(!ec) {
+				respond(std::make_shared<Connection>(std::move(socket)));
+			}
+
+			accept();
+		}
+	));
+}
+
+/*
+ * Just enough HTTP/1.1 for scrapers, one request per connection. Requests
+ * larger than MAX_REQUEST fail the read and anything that hasn't finished
+ * within REQUEST_TIMEOUT is closed, so a stalled client can't hold on to
+ * its connection. The socket was accepted on the strand, so the handlers
+ * below and the deadline's never run concurrently.
+ */
+void MetricsExporter::respond(std::shared_ptr<Connection> connection) {
+	connection->deadline.expires_after(REQUEST_TIMEOUT);
+
+	connection->deadline.async_wait([connection](const boost::system::error_code& ec) {
+		if(ec != boost::asio::error::operation_aborted) {
+			boost::system::error_code ignored;
+			connection->socket.close(ignored);
+		}
+	});
+
+	boost::asio::async_read_until(connection->socket, connection->request, "\r\n\r\n",
+		[this, connection](const boost::system::error_code& ec, std::size_t) {
+			if(ec) {
+				connection->deadline.cancel();
+				return;
+			}
+
+			std::istream stream(&connection->request);
+			std::string method, target;
+			stream >> method >> target;
+
+			auto& response = connection->response;
+
+			if(method == "GET" && (target == "/metrics" || target.starts_with("/metrics?"))) {
+				const auto body = scrape();
+				response = "HTTP/1.1 200 OK\r\n"
+				           "Content-Type: text/plain; version=0.0.4\r\n"
+				           "Content-Length: " + std::to_string(body.size()) + "\r\n"
+				           "Connection: close\r\n\r\n" + body;
+			} else {
+				response = "HTTP/1.1 404 Not Found\r\n"
+				           "Content-Length: 0\r\n"
+				           "Connection: close\r\n\r\n";
+			}
+
+			boost::asio::async_write(connection->socket, boost::asio::buffer(response),
+				[connection](const boost::system::error_code&, std::size_t) {
+					boost::system::error_code ec;
+					connection->socket.shutdown(bai::tcp::socket::shutdown_both, ec);
+					connection->deadline.cancel();
+				}
+			);
+		}
+	);
+}
+
+} // ember
\ No newline at end of file
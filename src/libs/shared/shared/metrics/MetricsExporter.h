@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include <shared/metrics/Metrics.h>
+#include <shared/metrics/ThreadShards.h>
+#include <boost/asio.hpp>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <cstdint>
+
+namespace ember {
+
+/*
+ * Holds metrics in-process and serves them over HTTP, in the Prometheus
+ * text exposition format, to anything that requests /metrics.
+ *
+ * Timings are recorded into HDR histograms and exposed in seconds, against
+ * a fixed set of coarse bucket bounds from 50us to 60s. Timings given
+ * in microseconds are kept in histograms of their own at that resolution,
+ * so sub-millisecond values aren't lost. Counters and
+ * histograms are kept in per-thread shards and merged when scraped. The
+ * shards of threads that have exited are folded into running totals before
+ * being dropped, so counters and buckets never go backwards.
+ * Gauges hold a single value each, which threads update with a relaxed
+ * atomic after caching its location. Sets have no Prometheus equivalent
+ * and are only forwarded.
+ *
+ * Everything is also passed on to the forwarding Metrics, if provided, so
+ * the exporter can sit in front of statsd.
+ */
+class MetricsExporter final : public Metrics {
+	struct Shard;
+	struct Totals;
+	struct Connection;
+
+	static constexpr std::size_t MAX_REQUEST = 8192;
+	static constexpr std::chrono::seconds REQUEST_TIMEOUT { 5 };
+
+	std::unique_ptr<Metrics> forward_;
+	ThreadShards<Shard> shards_;
+	std::mutex retired_lock_;
+	std::unique_ptr<Totals> retired_; // exited threads, guarded by retired_lock_
+	std::mutex gauges_lock_;
+	SlotMap<std::unique_ptr<std::atomic<std::intmax_t>>> gauges_; // map guarded by gauges_lock_
+
+	boost::asio::strand<boost::asio::io_context::executor_type> strand_;
+	boost::asio::ip::tcp::acceptor acceptor_;
+	boost::asio::signal_set signals_;
+
+	std::atomic<std::intmax_t>& gauge_slot(const char* key);
+	void accept();
+	void respond(std::shared_ptr<Connection> connection);
+	void shutdown();
+
+public:
+	MetricsExporter(boost::asio::io_context& service, const std::string& interface,
+	                std::uint16_t port, std::unique_ptr<Metrics> forward = nullptr);
+	~MetricsExporter();
+
+	void increment(const char* key, std::intmax_t value = 1) override;
+	void timing(const char* key, const std::chrono::milliseconds& value) override;
+	void timing(const char* key, const std::chrono::microseconds& value) override;
+	void gauge(const char* key, std::uintmax_t value, Adjustment adjustment = Adjustment::NONE) override;
+	void set(const char* key, std::intmax_t value) override;
+
+	std::string scrape();
+	std::uint16_t port() const;
+};
+
+} // ember
\ No newline at end of file
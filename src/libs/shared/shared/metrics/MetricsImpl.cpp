@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2015 Ember
+ * Copyright (c) 2015 - 2022 Ember
  *
  * This Source Code Form is subject to the terms of the Mozilla Public
  * License, v. 2.0. If a copy of the MPL was not distributed with this
@@ -7,69 +7,310 @@
  */
 
 #include <shared/metrics/MetricsImpl.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <charconv>
 #include <functional>
-#include <memory>
-#include <sstream>
+#include <limits>
 #include <utility>
-#include <cstddef>
 
 namespace ember {
 
+namespace {
+
+/*
+ * Timings below 16ms get a bucket each. Beyond that, each power of two is
+ * split into eight buckets, up to the limit of a 32-bit millisecond count.
+ */
+constexpr std::size_t EXACT_BUCKETS = 16;
+constexpr std::size_t SUB_BUCKETS = 8;
+constexpr std::size_t TIMING_BUCKETS = EXACT_BUCKETS + (32 - 4) * SUB_BUCKETS;
+
+std::size_t bucket_index(const std::uint32_t value) {
+	if(value < EXACT_BUCKETS) {
+		return value;
+	}
+
+	const auto shift = std::bit_width(value) - 4;
+	return EXACT_BUCKETS + (shift - 1) * SUB_BUCKETS + ((value >> shift) - SUB_BUCKETS);
+}
+
+// midpoint of the bucket's range
+std::uint64_t bucket_value(const std::size_t index) {
+	if(index < EXACT_BUCKETS) {
+		return index;
+	}
+
+	const auto shift = (index - EXACT_BUCKETS) / SUB_BUCKETS + 1;
+	const std::uint64_t base = (index - EXACT_BUCKETS) % SUB_BUCKETS + SUB_BUCKETS;
+	return (base << shift) + ((1ull << shift) >> 1);
+}
+
+struct Counter {
+	std::atomic<std::intmax_t> value { 0 };
+};
+
+struct Gauge {
+	std::atomic<std::uintmax_t> value { 0 };
+	std::atomic<std::intmax_t> delta { 0 };
+	std::atomic_bool absolute { false };
+};
+
+struct Timing {
+	std::array<std::atomic<std::uint32_t>, TIMING_BUCKETS> buckets {};
+};
+
+template<typename Rep>
+std::size_t timing_index(const Rep count) {
+	const auto clamped = std::clamp<Rep>(count, 0, std::numeric_limits<std::uint32_t>::max());
+	return bucket_index(static_cast<std::uint32_t>(clamped));
+}
+
+template<typename Totals>
+void collect_timings(SlotMap<std::unique_ptr<Timing>>& timings, Totals& totals) {
+	for(auto& [key, timing] : timings) {
+		std::vector<std::uint64_t>* counts = nullptr;
+
+		for(std::size_t i = 0; i < timing->buckets.size(); ++i) {
+			if(!timing->buckets[i].load(std::memory_order_relaxed)) {
+				continue;
+			}
+
+			if(!counts) {
+				counts = &totals[key];
+				counts->resize(TIMING_BUCKETS);
+			}
+
+			(*counts)[i] += timing->buckets[i].exchange(0, std::memory_order_relaxed);
+		}
+	}
+}
+
+// statsd counts a sample sent at a rate of 1/n as n samples
+std::string sample_rate(const std::uint64_t count) {
+	std::array<char, 32> buffer;
+	const auto result = std::to_chars(buffer.data(), buffer.data() + buffer.size(), 1.0 / count);
+	return std::string(buffer.data(), result.ptr);
+}
+
+} // unnamed
+
+struct MetricsImpl::Shard {
+	std::mutex lock;
+	SlotMap<std::unique_ptr<Counter>> counters;
+	SlotMap<std::unique_ptr<Gauge>> gauges;
+	SlotMap<std::unique_ptr<Timing>> timings;
+	SlotMap<std::unique_ptr<Timing>> fine_timings; // microseconds
+	std::vector<std::pair<std::string, std::intmax_t>> sets; // guarded by lock
+};
+
 MetricsImpl::MetricsImpl(boost::asio::io_context& service, const std::string& host,
-                         std::uint16_t port)
-                         : socket_(service), signals_(service, SIGINT, SIGTERM) {
-	signals_.async_wait(std::bind(&MetricsImpl::shutdown, this));
+                         std::uint16_t port, std::chrono::milliseconds interval)
+                         : interval_(interval), strand_(service.get_executor()),
+                           signals_(service, SIGINT, SIGTERM), timer_(strand_), socket_(service) {
+	signals_.async_wait(boost::asio::bind_executor(strand_, std::bind(&MetricsImpl::shutdown, this)));
 	boost::asio::ip::udp::resolver resolver(service);
-	boost::asio::ip::udp::resolver::query query(host, std::to_string(port));
-	boost::asio::connect(socket_, resolver.resolve(query));
+	boost::asio::connect(socket_, resolver.resolve(host, std::to_string(port)));
+	schedule_flush();
+}
+
+// expects the io_context to have stopped running handlers by now
+MetricsImpl::~MetricsImpl() {
+	if(!stopped_) {
+		flush();
+	}
+
+	boost::system::error_code ec;
+	timer_.cancel(ec);
+	signals_.cancel(ec);
 }
 
 void MetricsImpl::shutdown() {
+	stopped_ = true;
+	flush(); // anything recorded since the last interval
+
 	boost::system::error_code ec; // we don't care about any errors
-	socket_.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
+	timer_.cancel(ec);
+	socket_.shutdown(boost::asio::ip::udp::socket::shutdown_both, ec);
 	socket_.close(ec);
 }
 
 void MetricsImpl::increment(const char* key, std::intmax_t value) {
-	std::stringstream format;
-	format << key << ":" << value << "|c";
-	send(format.str());
+	auto& shard = shards_.local();
+	slot(shard.counters, shard.lock, key).value.fetch_add(value, std::memory_order_relaxed);
 }
 
 void MetricsImpl::timing(const char* key, const std::chrono::milliseconds& value) {
-	std::stringstream format;
-	format << key << ":" << value.count() << "|ms";
-	send(format.str());
+	auto& shard = shards_.local();
+	const auto index = timing_index(value.count());
+	slot(shard.timings, shard.lock, key).buckets[index].fetch_add(1, std::memory_order_relaxed);
+}
+
+void MetricsImpl::timing(const char* key, const std::chrono::microseconds& value) {
+	auto& shard = shards_.local();
+	const auto index = timing_index(value.count());
+	slot(shard.fine_timings, shard.lock, key).buckets[index].fetch_add(1, std::memory_order_relaxed);
 }
 
 void MetricsImpl::gauge(const char* key, std::uintmax_t value, Adjustment adjustment) {
-	std::stringstream format;
-	format << key << ":";
+	auto& shard = shards_.local();
+	auto& gauge = slot(shard.gauges, shard.lock, key);
 
-	switch (adjustment) {
-		case Adjustment::POSITIVE: format << "+";
+	switch(adjustment) {
+		case Adjustment::POSITIVE:
+			gauge.delta.fetch_add(static_cast<std::intmax_t>(value), std::memory_order_relaxed);
 			break;
-		case Adjustment::NEGATIVE: format << "-";
+		case Adjustment::NEGATIVE:
+			gauge.delta.fetch_sub(static_cast<std::intmax_t>(value), std::memory_order_relaxed);
 			break;
 		case Adjustment::NONE:
+			// an absolute value replaces any adjustments made before it
+			gauge.delta.store(0, std::memory_order_relaxed);
+			gauge.value.store(value, std::memory_order_relaxed);
+			gauge.absolute.store(true, std::memory_order_release);
 			break;
 	}
+}
+
+// sets need every distinct value, so these aren't aggregated beyond batching
+void MetricsImpl::set(const char* key, std::intmax_t value) {
+	auto& shard = shards_.local();
+	std::lock_guard<std::mutex> guard(shard.lock);
+	shard.sets.emplace_back(key, value);
+}
+
+void MetricsImpl::schedule_flush() {
+	timer_.expires_after(interval_);
 
-	format << value << "|g";
+	timer_.async_wait([this](const boost::system::error_code& ec) {
+		if(ec || stopped_) {
+			return;
+		}
 
-	send(format.str());
+		flush();
+		schedule_flush();
+	});
 }
 
-void MetricsImpl::set(const char* key, std::intmax_t value) {
-	std::stringstream format;
-	format << key << ":" << value << "|s";
-	send(format.str());
+void MetricsImpl::collect(Shard& shard) {
+	std::lock_guard<std::mutex> guard(shard.lock);
+
+	for(auto& [key, counter] : shard.counters) {
+		if(const auto value = counter->value.exchange(0, std::memory_order_relaxed)) {
+			counters_[key] += value;
+		}
+	}
+
+	collect_timings(shard.timings, timings_);
+	collect_timings(shard.fine_timings, fine_timings_);
+
+	/*
+	 * Gauges can't be merged across threads, so each shard's are sent as-is.
+	 * A gauge set from several threads within an interval ends up with
+	 * whichever arrives last, as was the case when they were sent directly.
+	 */
+	for(auto& [key, gauge] : shard.gauges) {
+		if(gauge->absolute.exchange(false, std::memory_order_acquire)) {
+			append(key, std::to_string(gauge->value.load(std::memory_order_relaxed)) + "|g");
+		}
+
+		if(const auto delta = gauge->delta.exchange(0, std::memory_order_relaxed)) {
+			append(key, (delta > 0? "+" : "") + std::to_string(delta) + "|g");
+		}
+	}
+
+	for(const auto& [key, value] : shard.sets) {
+		append(key, std::to_string(value) + "|s");
+	}
+
+	shard.sets.clear();
+}
+
+/*
+ * Each bucket is sent once, at its midpoint, with a sample rate standing in
+ * for the number of samples it holds. statsd's own aggregation still works
+ * and the output per key is bounded by the bucket count, however busy it is.
+ */
+void MetricsImpl::append_timings(Totals& timings, const bool microseconds) {
+	for(auto& [key, totals] : timings) {
+		for(std::size_t i = 0; i < totals.size(); ++i) {
+			if(!totals[i]) {
+				continue;
+			}
+
+			const auto value = bucket_value(i);
+			std::string sample;
+
+			if(microseconds) {
+				const auto fraction = std::to_string(1000 + value % 1000).substr(1);
+				sample = std::to_string(value / 1000) + "." + fraction + "|ms";
+			} else {
+				sample = std::to_string(value) + "|ms";
+			}
+
+			if(totals[i] > 1) {
+				sample += "|@" + sample_rate(totals[i]);
+			}
+
+			append(key, sample);
+
+			totals[i] = 0;
+		}
+	}
+}
+
+void MetricsImpl::flush() {
+	shards_.collect([&](Shard& shard) {
+		collect(shard);
+	});
+
+	for(auto& [key, value] : counters_) {
+		if(value) {
+			append(key, std::to_string(value) + "|c");
+			value = 0;
+		}
+	}
+
+	append_timings(timings_, false);
+	append_timings(fine_timings_, true);
+
+	if(!datagram_.empty()) {
+		send();
+	}
+}
+
+/*
+ * Consecutive samples for the same key share a line (key:1|c:2|c), other
+ * keys go on their own lines. A datagram is sent once the next sample
+ * wouldn't fit.
+ */
+void MetricsImpl::append(std::string_view key, std::string_view sample) {
+	if(!datagram_.empty() && key == line_key_ && datagram_.size() + 1 + sample.size() <= MAX_DATAGRAM) {
+		datagram_.append(":").append(sample);
+		return;
+	}
+
+	const auto separator = datagram_.empty()? 0 : 1;
+
+	if(!datagram_.empty() && datagram_.size() + separator + key.size() + 1 + sample.size() > MAX_DATAGRAM) {
+		send();
+	}
+
+	if(!datagram_.empty()) {
+		datagram_.push_back('\n');
+	}
+
+	datagram_.append(key).append(":").append(sample);
+	line_key_ = key;
 }
 
-void MetricsImpl::send(std::string message) {
-	auto datagram = std::make_shared<std::string>(std::move(message));
-	socket_.async_send(boost::asio::buffer(*datagram),
-		[datagram](const boost::system::error_code&, std::size_t) { });
+void MetricsImpl::send() {
+	boost::system::error_code ec; // metrics are best effort
+	socket_.send(boost::asio::buffer(datagram_), 0, ec);
+	datagram_.clear();
+	line_key_.clear();
 }
 
 } // ember
\ No newline at end of file
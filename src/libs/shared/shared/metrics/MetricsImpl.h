@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2015 - 2018 Ember
+ * Copyright (c) 2015 - 2022 Ember
  *
  * This Source Code Form is subject to the terms of the Mozilla Public
  * License, v. 2.0. If a copy of the MPL was not distributed with this
@@ -9,26 +9,74 @@
 #pragma once
 
 #include <shared/metrics/Metrics.h>
+#include <shared/metrics/ThreadShards.h>
 #include <boost/asio.hpp>
 #include <chrono>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <cstddef>
 #include <cstdint>
 
 namespace ember {
 
+/*
+ * Metrics are aggregated in per-thread shards rather than being sent as
+ * they're recorded. Counters are summed, gauges keep their last value and
+ * timings are reduced to log-linear histograms (exact up to 16ms, within
+ * ~6% beyond). Timings recorded in microseconds get histograms of their
+ * own and are sent as fractional milliseconds. Each non-empty bucket is
+ * sent as a single sample with a sample rate of 1/count. Every interval,
+ * the shards are collected and packed into multi-metric statsd datagrams
+ * of up to MAX_DATAGRAM bytes.
+ *
+ * Recording a metric costs a hash lookup on the calling thread's shard and
+ * a relaxed atomic or two, other than the first time a thread uses a key.
+ */
 class MetricsImpl final : public Metrics {
+public:
+	static constexpr std::size_t MAX_DATAGRAM = 1432; // fits a 1500 byte MTU
+	static constexpr std::chrono::milliseconds DEFAULT_INTERVAL { 1000 };
+
+	struct Shard;
+
+private:
+	const std::chrono::milliseconds interval_;
+	boost::asio::strand<boost::asio::io_context::executor_type> strand_;
 	boost::asio::signal_set signals_;
+	boost::asio::steady_timer timer_;
 	boost::asio::ip::udp::socket socket_;
-	boost::asio::ip::udp::endpoint endpoint_;
+	bool stopped_ = false;
+
+	using Totals = std::unordered_map<std::string, std::vector<std::uint64_t>>;
+
+	ThreadShards<Shard> shards_;
+
+	// only touched while flushing
+	std::unordered_map<std::string, std::intmax_t> counters_;
+	Totals timings_;
+	Totals fine_timings_; // microseconds
+	std::string datagram_;
+	std::string line_key_;
 
-	void send(std::string message);
+	void collect(Shard& shard);
+	void append_timings(Totals& totals, bool microseconds);
+	void schedule_flush();
+	void flush();
+	void append(std::string_view key, std::string_view sample);
+	void send();
 	void shutdown();
 
 public:
-	MetricsImpl(boost::asio::io_context& service, const std::string& host, std::uint16_t port);
+	MetricsImpl(boost::asio::io_context& service, const std::string& host, std::uint16_t port,
+	            std::chrono::milliseconds interval = DEFAULT_INTERVAL);
+	~MetricsImpl();
 
 	void increment(const char* key, std::intmax_t value = 1) override;
 	void timing(const char* key, const std::chrono::milliseconds& value) override;
+	void timing(const char* key, const std::chrono::microseconds& value) override;
 	void gauge(const char* key, std::uintmax_t value, Adjustment adjustment = Adjustment::NONE) override;
 	void set(const char* key, std::intmax_t value) override;
 };
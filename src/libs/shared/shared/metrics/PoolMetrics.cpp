@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "PoolMetrics.h"
+#include <shared/metrics/Metrics.h>
+
+namespace ember {
+
+namespace {
+
+Histogram::Snapshot since(const Histogram::Snapshot& now, const Histogram::Snapshot& then) {
+	Histogram::Snapshot delta;
+
+	for(std::size_t i = 0; i < Histogram::BUCKETS; ++i) {
+		delta.counts[i] = now.counts[i] - then.counts[i];
+	}
+
+	delta.sum = now.sum - then.sum;
+	return delta;
+}
+
+} // unnamed
+
+PoolMetrics::PoolMetrics(const ThreadPool& pool)
+	: pool_(pool),
+	  lanes_ {{
+		{ ThreadPool::Lane::INTERACTIVE, "thread_pool.interactive.", {}, {} },
+		{ ThreadPool::Lane::BACKGROUND, "thread_pool.background.", {}, {} },
+		{ ThreadPool::Lane::BLOCKING, "thread_pool.blocking.", {}, {} }
+	  }} {}
+
+void PoolMetrics::report(Metrics& metrics) {
+	for(auto& lane : lanes_) {
+		const auto stats = pool_.stats(lane.lane);
+		const auto wait = since(stats.wait, lane.wait);
+		const auto run = since(stats.run, lane.run);
+		const auto& prefix = lane.prefix;
+
+		metrics.gauge((prefix + "depth").c_str(), stats.depth);
+		metrics.gauge((prefix + "rejected").c_str(), stats.rejected);
+		metrics.gauge((prefix + "tasks").c_str(), run.count());
+		metrics.gauge((prefix + "wait_p50_us").c_str(), wait.value_at(0.5));
+		metrics.gauge((prefix + "wait_p99_us").c_str(), wait.value_at(0.99));
+		metrics.gauge((prefix + "run_p50_us").c_str(), run.value_at(0.5));
+		metrics.gauge((prefix + "run_p99_us").c_str(), run.value_at(0.99));
+
+		lane.wait = stats.wait;
+		lane.run = stats.run;
+	}
+}
+
+} // ember
\ No newline at end of file
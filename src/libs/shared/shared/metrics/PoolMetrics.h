@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include <shared/metrics/Histogram.h>
+#include <shared/threading/ThreadPool.h>
+#include <array>
+#include <string>
+#include <cstddef>
+
+namespace ember {
+
+class Metrics;
+
+/*
+ * Reports a ThreadPool's lanes as gauges, keyed thread_pool.<lane>.<stat>:
+ * the queue depth, how many tasks have been rejected since start-up and
+ * the p50/p99 time tasks spent queued and running, in microseconds.
+ *
+ * The pool's histograms only ever grow, so the percentiles are worked out
+ * from what's been recorded since the previous report, which also makes
+ * tasks the number of tasks that finished in between.
+ */
+class PoolMetrics final {
+	static constexpr std::size_t LANES = 3;
+
+	struct Lane {
+		ThreadPool::Lane lane;
+		std::string prefix;
+		Histogram::Snapshot wait;
+		Histogram::Snapshot run;
+	};
+
+	const ThreadPool& pool_;
+	std::array<Lane, LANES> lanes_;
+
+public:
+	explicit PoolMetrics(const ThreadPool& pool);
+
+	void report(Metrics& metrics);
+};
+
+} // ember
\ No newline at end of file
@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace ember {
+
+struct KeyHash {
+	using is_transparent = void;
+
+	std::size_t operator()(std::string_view key) const {
+		return std::hash<std::string_view>{}(key);
+	}
+};
+
+// metric name to per-thread state, looked up by const char* without allocating
+template<typename T>
+using SlotMap = std::unordered_map<std::string, T, KeyHash, std::equal_to<>>;
+
+/*
+ * Finds or adds the key's slot. Only the owning thread adds keys, so it can
+ * look them up without locking - the lock keeps anybody collecting the
+ * shard from walking the map while it's modified.
+ */
+template<typename T>
+T& slot(SlotMap<std::unique_ptr<T>>& map, std::mutex& lock, const char* key) {
+	const std::string_view name(key);
+
+	if(auto it = map.find(name); it != map.end()) {
+		return *it->second;
+	}
+
+	std::lock_guard<std::mutex> guard(lock);
+	return *map.emplace(std::string(name), std::make_unique<T>()).first->second;
+}
+
+/*
+ * One T per thread, created the first time the thread asks for it. collect()
+ * visits every shard, dropping those belonging to threads that have exited
+ * once they've been visited for the last time. A visitor that also takes a
+ * bool is told when that is, so it can empty or fold away the shard.
+ */
+template<typename T>
+class ThreadShards final {
+	// keyed by ID so a new instance at the address of an old one doesn't pick up a stale shard
+	struct Local {
+		std::vector<std::pair<std::uint64_t, std::shared_ptr<T>>> shards;
+		std::uint64_t cached_id = 0;
+		T* cached = nullptr;
+	};
+
+	static inline std::atomic<std::uint64_t> ids_ { 0 };
+	static inline thread_local Local local_;
+
+	const std::uint64_t id_ = ++ids_;
+	std::mutex lock_;
+	std::vector<std::shared_ptr<T>> shards_; // guarded by lock_
+
+public:
+	ThreadShards() = default;
+
+	// any arguments are only used to construct the shard on the thread's first call
+	template<typename ...Args>
+	T& local(Args&&... args) {
+		auto& local = local_;
+
+		if(local.cached_id == id_) {
+			return *local.cached;
+		}
+
+		auto it = std::find_if(local.shards.begin(), local.shards.end(), [&](const auto& entry) {
+			return entry.first == id_;
+		});
+
+		if(it == local.shards.end()) {
+			// only this thread holds the shard once its owner has gone
+			std::erase_if(local.shards, [](const auto& entry) {
+				return entry.second.use_count() == 1;
+			});
+
+			auto shard = std::make_shared<T>(std::forward<Args>(args)...);
+
+			{
+				std::lock_guard<std::mutex> guard(lock_);
+				shards_.emplace_back(shard);
+			}
+
+			it = local.shards.emplace(local.shards.end(), id_, std::move(shard));
+		}
+
+		local.cached_id = id_;
+		local.cached = it->second.get();
+		return *local.cached;
+	}
+
+	template<typename Func>
+	void collect(Func&& func) {
+		std::lock_guard<std::mutex> guard(lock_);
+
+		std::erase_if(shards_, [&](const auto& shard) {
+			// checked first so a thread that exits mid-collection isn't dropped early
+			const bool orphaned = shard.use_count() == 1;
+
+			if constexpr(std::is_invocable_v<Func, T&, bool>) {
+				func(*shard, orphaned);
+			} else {
+				func(*shard);
+			}
+
+			return orphaned;
+		});
+	}
+
+	// visits shards without dropping any, stopping at the first for which func returns true
+	template<typename Func>
+	bool any_of(Func&& func) {
+		std::lock_guard<std::mutex> guard(lock_);
+
+		return std::any_of(shards_.begin(), shards_.end(), [&](const auto& shard) {
+			return func(*shard);
+		});
+	}
+
+	ThreadShards(const ThreadShards&) = delete;
+	ThreadShards& operator=(const ThreadShards&) = delete;
+};
+
+} // ember
\ No newline at end of file
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2015 Ember
+ * Copyright (c) 2015 - 2022 Ember
  *
  * This Source Code Form is subject to the terms of the Mozilla Public
  * License, v. 2.0. If a copy of the MPL was not distributed with this
@@ -8,37 +8,248 @@
 
 #include "ThreadPool.h"
 #include <boost/assert.hpp>
+#include <algorithm>
+#include <exception>
+#include <limits>
 
 namespace ember {
 
 using namespace std::string_literals;
 
-ThreadPool::ThreadPool(std::size_t initial_count) : work_(service_), stopped_(false) {
+namespace {
+
+// lets tasks posted from a worker go straight onto its own deques
+thread_local const ThreadPool* local_pool = nullptr;
+thread_local std::size_t local_index = 0;
+
+template<typename Duration>
+std::uint32_t microseconds(const Duration& duration) {
+	const auto count = std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+	return static_cast<std::uint32_t>(std::clamp<decltype(count)>(
+		count, 0, std::numeric_limits<std::uint32_t>::max()));
+}
+
+} // unnamed
+
+ThreadPool::ThreadPool(std::size_t initial_count, std::size_t blocking_count,
+                       std::size_t blocking_limit)
+                       : blocking_limit_(std::max<std::size_t>(blocking_limit, 1)), stopped_(false) {
+	initial_count = std::max<std::size_t>(initial_count, 1);
+	blocking_count = std::max<std::size_t>(blocking_count, 1);
+
 	for(std::size_t i = 0; i < initial_count; ++i) {
-		workers_.emplace_back(static_cast<std::size_t(boost::asio::io_context::*)()>
-			(&boost::asio::io_context::run), &service_); 
+		queues_.emplace_back(std::make_unique<Worker>());
+	}
+
+	for(std::size_t i = 0; i < initial_count; ++i) {
+		workers_.emplace_back(&ThreadPool::worker, this, i);
+	}
+
+	for(std::size_t i = 0; i < blocking_count; ++i) {
+		blocking_workers_.emplace_back(&ThreadPool::blocking_worker, this);
 	}
 }
 
+bool ThreadPool::enqueue(Work work, const Lane lane) {
+	Task task { std::move(work), Clock::now() };
+	auto& stats = stats_[static_cast<std::size_t>(lane)];
+	auto& depth = stats.depth;
 
-void ThreadPool::shutdown() {
-	stopped_ = true;
-	service_.stop();
+	if(lane == Lane::BLOCKING) {
+		{
+			std::lock_guard<std::mutex> guard(blocking_lock_);
+
+			if(blocking_queue_.size() >= blocking_limit_) {
+				stats.rejected.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+
+			blocking_queue_.emplace_back(std::move(task));
+			depth.fetch_add(1, std::memory_order_relaxed);
+		}
 
-	for(auto& worker : workers_) {
-		try { // todo move when VS201? is out - apparently they didn't fix this in VS2015 either
-			worker.join();
-		} catch(const std::exception& e) {
-			BOOST_ASSERT_MSG(false, e.what());
+		blocking_cond_.notify_one();
+		return true;
+	}
+
+	const auto index = local_pool == this?
+		local_index : next_.fetch_add(1, std::memory_order_relaxed) % queues_.size();
 
-			std::lock_guard<std::mutex> guard(log_cb_lock_);
+	{
+		auto& worker = *queues_[index];
+		std::lock_guard<std::mutex> guard(worker.lock);
+		worker.queues[static_cast<std::size_t>(lane)].emplace_back(std::move(task));
+	}
 
-			if(log_cb_) {
-				log_cb_(Severity::FATAL, "In thread pool shutdown: "s + e.what());
+	/*
+	 * Published once it's in a deque, so any worker that claims it can find it.
+	 * A worker announces that it's going to sleep before checking the depth
+	 * (both seq_cst), so either it sees this task or we see it and wake it.
+	 * Waking takes the lock to make sure it's actually waiting by then.
+	 */
+	depth.fetch_add(1);
+
+	if(sleeping_.load()) {
+		{
+			std::lock_guard<std::mutex> guard(lock_);
+		}
+
+		cond_.notify_one();
+	}
+
+	return true;
+}
+
+/*
+ * Checks every deque for interactive work before looking for anything in the
+ * background. The owner takes from the front, so its tasks run in the order
+ * they were posted, while thieves take from the back.
+ *
+ * A task is claimed by decrementing its lane's depth before searching for
+ * it. Tasks are only counted once they're in a deque, so there's always at
+ * least one unclaimed task to be found for every claim, although it may have
+ * to go around more than once if tasks land behind it.
+ */
+bool ThreadPool::take(const std::size_t index, Task& task, Lane& lane) {
+	const auto count = queues_.size();
+
+	for(std::size_t priority = 0; priority < PRIORITIES; ++priority) {
+		auto& depth = stats_[priority].depth;
+		auto available = depth.load(std::memory_order_relaxed);
+
+		do {
+			if(!available) {
+				break;
 			}
+		} while(!depth.compare_exchange_weak(available, available - 1, std::memory_order_relaxed));
+
+		if(!available) {
+			continue;
+		}
+
+		for(std::size_t i = 0;; ++i) {
+			auto& worker = *queues_[(index + i) % count];
+			std::lock_guard<std::mutex> guard(worker.lock);
+			auto& queue = worker.queues[priority];
+
+			if(queue.empty()) {
+				continue;
+			}
+
+			if(i % count == 0) {
+				task = std::move(queue.front());
+				queue.pop_front();
+			} else {
+				task = std::move(queue.back());
+				queue.pop_back();
+			}
+
+			lane = static_cast<Lane>(priority);
+			return true;
 		}
 	}
 
+	return false;
+}
+
+void ThreadPool::execute(Task& task, const Lane lane) {
+	auto& stats = stats_[static_cast<std::size_t>(lane)];
+	const auto start = Clock::now();
+	stats.wait.record(microseconds(start - task.queued));
+
+	try {
+		task.work();
+	} catch(const std::exception& e) {
+		log(Severity::ERROR, "Unhandled exception in thread pool task: "s + e.what());
+	}
+
+	stats.run.record(microseconds(Clock::now() - start));
+	task.work = nullptr; // release anything captured before waiting for more work
+}
+
+void ThreadPool::worker(const std::size_t index) {
+	local_pool = this;
+	local_index = index;
+
+	Task task;
+	Lane lane;
+
+	while(!stopped_) {
+		if(take(index, task, lane)) {
+			execute(task, lane);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> guard(lock_);
+		sleeping_.fetch_add(1);
+
+		cond_.wait(guard, [&] {
+			return stopped_ || stats_[0].depth.load() || stats_[1].depth.load();
+		});
+
+		sleeping_.fetch_sub(1);
+	}
+}
+
+void ThreadPool::blocking_worker() {
+	auto& depth = stats_[static_cast<std::size_t>(Lane::BLOCKING)].depth;
+
+	while(true) {
+		Task task;
+
+		{
+			std::unique_lock<std::mutex> guard(blocking_lock_);
+
+			blocking_cond_.wait(guard, [&] {
+				return stopped_ || !blocking_queue_.empty();
+			});
+
+			if(stopped_) {
+				return;
+			}
+
+			task = std::move(blocking_queue_.front());
+			blocking_queue_.pop_front();
+			depth.fetch_sub(1, std::memory_order_relaxed);
+		}
+
+		execute(task, Lane::BLOCKING);
+	}
+}
+
+ThreadPool::Stats ThreadPool::stats(const Lane lane) const {
+	const auto& lane_stats = stats_[static_cast<std::size_t>(lane)];
+
+	Stats stats;
+	stats.depth = lane_stats.depth.load(std::memory_order_relaxed);
+	stats.rejected = lane_stats.rejected.load(std::memory_order_relaxed);
+	stats.wait.merge(lane_stats.wait);
+	stats.run.merge(lane_stats.run);
+	return stats;
+}
+
+void ThreadPool::shutdown() {
+	{
+		std::lock_guard<std::mutex> guard(lock_);
+		std::lock_guard<std::mutex> blocking_guard(blocking_lock_);
+		stopped_ = true;
+	}
+
+	cond_.notify_all();
+	blocking_cond_.notify_all();
+
+	for(auto* threads : { &workers_, &blocking_workers_ }) {
+		for(auto& worker : *threads) {
+			try {
+				if(worker.joinable()) {
+					worker.join();
+				}
+			} catch(const std::exception& e) {
+				BOOST_ASSERT_MSG(false, e.what());
+				log(Severity::FATAL, "In thread pool shutdown: "s + e.what());
+			}
+		}
+	}
 }
 
 ThreadPool::~ThreadPool() {
@@ -47,6 +258,14 @@ ThreadPool::~ThreadPool() {
 	}
 }
 
+void ThreadPool::log(const Severity severity, const std::string& message) {
+	std::lock_guard<std::mutex> guard(log_cb_lock_);
+
+	if(log_cb_) {
+		log_cb_(severity, message);
+	}
+}
+
 void ThreadPool::log_callback(const LogCallback& callback) {
 	std::lock_guard<std::mutex> guard(log_cb_lock_);
 	log_cb_ = callback;
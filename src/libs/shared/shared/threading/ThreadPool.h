@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2015 Ember
+ * Copyright (c) 2015 - 2022 Ember
  *
  * This Source Code Form is subject to the terms of the Mozilla Public
  * License, v. 2.0. If a copy of the MPL was not distributed with this
@@ -8,12 +8,18 @@
 
 #pragma once
 
-#include <boost/asio/io_context.hpp>
+#include <shared/metrics/Histogram.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <functional>
 #include <memory>
 #include <mutex>
 #include <string>
 #include <thread>
+#include <utility>
 #include <vector>
 #include <cstddef>
 
@@ -21,32 +27,113 @@
 
 namespace ember {
 
-class ThreadPool {
+/*
+ * Work-stealing pool for CPU-bound tasks, with a separate lane for tasks
+ * that block (database calls, mostly).
+ *
+ * Each worker owns a deque per priority. Tasks posted from outside the pool
+ * are spread across the workers in turn and tasks posted from a worker go
+ * to its own deques. Workers take the oldest task from their own deque and
+ * steal the newest from somebody else's when they run dry, always draining
+ * interactive work before touching anything in the background.
+ *
+ * Blocking tasks are run in order by their own, fixed set of threads, so
+ * however slow they are, they can't hold up the workers. Bound that set by
+ * whatever the tasks are waiting on, e.g. the database connection limit.
+ * Their queue is bounded too: once it's full, new blocking tasks are turned
+ * away rather than piling up behind a database that isn't keeping up, and
+ * it's up to the caller to fail the request.
+ *
+ * Tasks that are still queued at shutdown are discarded.
+ */
+class ThreadPool final {
 public:
 	enum class Severity { DEBUG, INFO, ERROR, FATAL };
+	enum class Lane { INTERACTIVE, BACKGROUND, BLOCKING };
 	typedef std::function<void(Severity, std::string)> LogCallback;
 
+	static constexpr std::size_t DEFAULT_BLOCKING_LIMIT = 1024;
+
+	// wait is the time spent queued and run the time spent executing, both in microseconds
+	struct Stats {
+		std::size_t depth = 0;
+		std::size_t rejected = 0;
+		Histogram::Snapshot wait;
+		Histogram::Snapshot run;
+	};
+
 private:
-	boost::asio::io_context service_;
-	boost::asio::io_context::work work_;
+	using Clock = std::chrono::steady_clock;
+
+	static constexpr std::size_t LANES = 3;
+	static constexpr std::size_t PRIORITIES = 2; // lanes serviced by the workers
+
+	using Work = std::move_only_function<void()>;
+
+	struct Task {
+		Work work;
+		Clock::time_point queued;
+	};
+
+	struct Worker {
+		std::mutex lock;
+		std::array<std::deque<Task>, PRIORITIES> queues;
+	};
+
+	struct LaneStats {
+		std::atomic<std::size_t> depth { 0 };
+		std::atomic<std::size_t> rejected { 0 };
+		Histogram wait;
+		Histogram run;
+	};
+
+	std::vector<std::unique_ptr<Worker>> queues_;
 	std::vector<std::thread> workers_;
+	std::atomic<std::size_t> next_ { 0 };
+	std::atomic<std::size_t> sleeping_ { 0 };
+	std::mutex lock_; // only taken to sleep and to wake sleepers
+	std::condition_variable cond_;
+
+	std::deque<Task> blocking_queue_; // guarded by blocking_lock_
+	const std::size_t blocking_limit_;
+	std::vector<std::thread> blocking_workers_;
+	std::mutex blocking_lock_;
+	std::condition_variable blocking_cond_;
+
+	std::array<LaneStats, LANES> stats_;
 	LogCallback log_cb_;
 	std::mutex log_cb_lock_;
-	bool stopped_;
+	std::atomic_bool stopped_;
+
+	bool enqueue(Work work, Lane lane);
+	bool take(std::size_t index, Task& task, Lane& lane);
+	void execute(Task& task, Lane lane);
+	void worker(std::size_t index);
+	void blocking_worker();
+	void log(Severity severity, const std::string& message);
 
 public:
-	explicit ThreadPool(std::size_t initial_count);
+	explicit ThreadPool(std::size_t initial_count, std::size_t blocking_count = 1,
+	                    std::size_t blocking_limit = DEFAULT_BLOCKING_LIMIT);
 	~ThreadPool();
 
+	// returns false if the task was rejected, which only happens when the blocking queue is full
 	template<typename T>
-	void run(T work) {
+	bool run(T work, Lane lane = Lane::INTERACTIVE) {
 #ifdef DEBUG_NO_THREADS
 		work();
+		return true;
 #else
-		service_.post(work);
+		return enqueue(std::move(work), lane);
 #endif
 	}
 
+	template<typename T>
+	bool run_blocking(T work) {
+		return run(std::move(work), Lane::BLOCKING);
+	}
+
+	Stats stats(Lane lane) const;
 	void shutdown();
 	void log_callback(const LogCallback& callback);
 };
@@ -11,6 +11,7 @@
 #include <logger/FileSink.h>
 #include <logger/SyslogSink.h>
 #include <logger/Utility.h>
+#include <chrono>
 #include <string>
 #include <stdexcept>
 #include <utility>
@@ -29,7 +30,26 @@ std::unique_ptr<el::Sink> init_remote_sink(const po::variables_map& args, el::Se
 	auto port = args["remote_log.port"].as<std::uint16_t>();
 	auto facility = el::SyslogSink::Facility::LOCAL_USE_0;
 	auto filter = args["remote_log.filter-mask"].as<std::uint32_t>();
-	return std::make_unique<el::SyslogSink>(severity, el::Filter(filter), host, port, facility, service);
+	auto transport = el::SyslogSink::Transport::UDP;
+	bool own_thread = false;
+
+	// optional, only declared by services that expose them
+	if(args.count("remote_log.transport")) {
+		const auto value = args["remote_log.transport"].as<std::string>();
+
+		if(value == "tcp") {
+			transport = el::SyslogSink::Transport::TCP;
+		} else if(value != "udp") {
+			throw std::runtime_error("Invalid remote log transport supplied");
+		}
+	}
+
+	if(args.count("remote_log.own_thread")) {
+		own_thread = args["remote_log.own_thread"].as<bool>();
+	}
+
+	return std::make_unique<el::SyslogSink>(severity, el::Filter(filter), host, port, facility, service,
+	                                        transport, own_thread);
 }
 
 std::unique_ptr<el::Sink> init_file_sink(const po::variables_map& args, el::Severity severity) {
@@ -50,6 +70,31 @@ std::unique_ptr<el::Sink> init_file_sink(const po::variables_map& args, el::Seve
 	sink->log_date(args["file_log.log_timestamp"].as<bool>());
 	sink->time_format(args["file_log.timestamp_format"].as<std::string>());
 	sink->midnight_rotate(args["file_log.midnight_rotate"].as<bool>());
+
+	if(args.count("file_log.fsync_severity")) {
+		sink->sync_severity(el::severity_string(args["file_log.fsync_severity"].as<std::string>()));
+	}
+
+	if(args.count("file_log.compress")) {
+		sink->compress(args["file_log.compress"].as<bool>());
+	}
+
+	el::Retention retention;
+
+	if(args.count("file_log.retain_files")) {
+		retention.max_files = args["file_log.retain_files"].as<std::uint32_t>();
+	}
+
+	if(args.count("file_log.retain_days")) {
+		retention.max_age = std::chrono::hours(args["file_log.retain_days"].as<std::uint32_t>() * 24);
+	}
+
+	if(args.count("file_log.retain_size")) {
+		retention.max_size = std::uintmax_t(args["file_log.retain_size"].as<std::uint32_t>()) * 1024 * 1024;
+	}
+
+	sink->retention(retention);
+
 	return sink;
 }
 
@@ -82,7 +127,45 @@ std::unique_ptr<ember::log::Logger> init_logging(const po::variables_map& args)
 		logger->add_sink(init_remote_sink(args, severity));
 	}
 
+	// optional, only declared by services that log heavily from I/O threads
+	if(args.count("logging.capture")) {
+		const auto capture = args["logging.capture"].as<std::string>();
+
+		if(capture != "text" && capture != "binary") {
+			throw std::runtime_error("Invalid logging capture mode supplied");
+		}
+
+		logger->capture(capture == "binary"? el::Capture::BINARY : el::Capture::TEXT);
+	}
+
+	if(args.count("logging.overflow")) {
+		const auto overflow = args["logging.overflow"].as<std::string>();
+		auto threshold = el::Severity::WARN;
+
+		if(args.count("logging.overflow_threshold")) {
+			threshold = el::severity_string(args["logging.overflow_threshold"].as<std::string>());
+		}
+
+		if(overflow == "block") {
+			logger->overflow(el::Overflow::BLOCK);
+		} else if(overflow == "drop") {
+			logger->overflow(el::Overflow::DROP_NEWEST);
+		} else if(overflow == "severity") {
+			logger->overflow(el::Overflow::DROP_BY_SEVERITY, threshold);
+		} else {
+			throw std::runtime_error("Invalid logging overflow policy supplied");
+		}
+	}
+
 	return logger;
 }
 
+LogMetrics::LogMetrics(el::Logger& logger, Metrics& metrics) : logger_(logger) {
+	logger_.metrics(&metrics);
+}
+
+LogMetrics::~LogMetrics() {
+	logger_.metrics(nullptr);
+}
+
 } // util, ember
\ No newline at end of file
@@ -9,6 +9,7 @@
 #pragma once
 
 #include <logger/Logging.h>
+#include <shared/metrics/Metrics.h>
 #include <boost/program_options.hpp>
 #include <memory>
 
@@ -16,4 +17,20 @@ namespace ember::util {
 
 std::unique_ptr<ember::log::Logger> init_logging(const boost::program_options::variables_map& args);
 
+/*
+ * Points the logger's sinks at the service's metrics for as long as this
+ * object lives. The logger is created before the metrics and outlives them,
+ * so the sinks are pointed back at the null metrics on destruction.
+ */
+class LogMetrics final {
+	ember::log::Logger& logger_;
+
+public:
+	LogMetrics(ember::log::Logger& logger, Metrics& metrics);
+	~LogMetrics();
+
+	LogMetrics(const LogMetrics&) = delete;
+	LogMetrics& operator=(const LogMetrics&) = delete;
+};
+
 } // util, ember
\ No newline at end of file
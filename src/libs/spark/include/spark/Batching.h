@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include "Batch_generated.h"
+#include <spark/BufferPool.h>
+#include <flatbuffers/flatbuffers.h>
+#include <mutex>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace ember::spark::inline v1 {
+
+/*
+ * Opt-in batching for services that send bursts of small messages. Messages
+ * no larger than max_message are held back and sent to the peer together in
+ * a single frame, either once flush_size bytes are waiting or once the
+ * handlers already queued on the link's io_context have run.
+ *
+ * Only used on links where both ends enabled it during negotiation.
+ */
+struct BatchPolicy {
+	static constexpr std::size_t DEFAULT_MAX_MESSAGE = 256;
+	static constexpr std::size_t DEFAULT_FLUSH_SIZE = 1024 * 16;
+
+	bool enabled = false;
+	std::size_t max_message = DEFAULT_MAX_MESSAGE;
+	std::size_t flush_size = DEFAULT_FLUSH_SIZE;
+};
+
+namespace detail {
+
+/*
+ * Per-link batching state. Any thread may send on a link, so pending
+ * messages are guarded by a lock which is also held while writing, to stop
+ * a message that bypasses the batch from overtaking those held in it.
+ */
+class Batcher final {
+public:
+	struct Stats {
+		std::uint64_t batches;
+		std::uint64_t batched;
+		std::uint64_t bypassed;
+		std::uint64_t dropped; // held back, then lost when the batch couldn't be written
+	};
+
+	enum class Result { WRITTEN, HELD, HELD_FIRST, REJECTED };
+
+private:
+	const std::size_t max_message_;
+	const std::size_t flush_size_;
+
+	std::mutex lock_;
+	std::vector<BufferHandle> pending_;                                // guarded by lock_
+	std::vector<flatbuffers::Offset<messaging::core::Batched>> frames_; // guarded by lock_
+	std::size_t pending_bytes_ = 0;                                    // guarded by lock_
+	Stats stats_{};                                                    // guarded by lock_
+
+	BufferHandle build();
+
+	// lock_ must be held by the caller
+	template<typename Writer>
+	bool flush_pending(Writer& writer) {
+		if(pending_.empty()) {
+			return true;
+		}
+
+		const auto count = pending_.size();
+		const auto out = build();
+		pending_.clear();
+		pending_bytes_ = 0;
+
+		if(writer(out)) {
+			return true;
+		}
+
+		stats_.dropped += count;
+		return false;
+	}
+
+public:
+	explicit Batcher(const BatchPolicy& policy);
+
+	static bool batched(const std::uint8_t* data, std::size_t size);
+
+	/*
+	 * Holds the message back if it's small enough, otherwise writes it after
+	 * anything already held. HELD_FIRST means the message started a new
+	 * batch and the caller should arrange for flush() to be called.
+	 */
+	template<typename Writer>
+	Result write(const BufferHandle& fbb, Writer&& writer) {
+		const auto size = fbb->GetSize();
+		std::lock_guard<std::mutex> guard(lock_);
+
+		if(size > max_message_) {
+			++stats_.bypassed;
+			flush_pending(writer);
+			return writer(fbb)? Result::WRITTEN : Result::REJECTED;
+		}
+
+		pending_.emplace_back(fbb);
+		pending_bytes_ += size;
+		++stats_.batched;
+
+		if(pending_bytes_ >= flush_size_) {
+			return flush_pending(writer)? Result::WRITTEN : Result::REJECTED;
+		}
+
+		return pending_.size() == 1? Result::HELD_FIRST : Result::HELD;
+	}
+
+	template<typename Writer>
+	bool flush(Writer&& writer) {
+		std::lock_guard<std::mutex> guard(lock_);
+		return flush_pending(writer);
+	}
+
+	Stats stats();
+};
+
+} // detail
+
+} // spark, ember
\ No newline at end of file
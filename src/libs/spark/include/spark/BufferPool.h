@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include <flatbuffers/flatbuffers.h>
+#include <atomic>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+
+namespace ember::spark::inline v1 {
+
+namespace detail {
+
+/*
+ * FlatBuffers allocator backed by per-thread caches of fixed size blocks.
+ * Blocks are returned to the cache of whichever thread frees them, so it
+ * doesn't matter which thread a send completes on. Allocations larger than
+ * the biggest size class go straight to the heap.
+ */
+class SlabAllocator final : public flatbuffers::Allocator {
+	std::size_t reserved_ = 0;
+
+public:
+	std::uint8_t* allocate(std::size_t size) override;
+	void deallocate(std::uint8_t* p, std::size_t size) override;
+
+	// bytes currently held by the builder using this allocator
+	std::size_t reserved() const { return reserved_; }
+};
+
+struct BuilderHome;
+
+struct PooledBuilder {
+	static constexpr std::size_t INITIAL_SIZE = 1024;
+
+	SlabAllocator allocator;
+	flatbuffers::FlatBufferBuilder fbb;
+	std::atomic<std::uint32_t> refs;
+	BuilderHome* home;     // pool of the thread that created it
+	PooledBuilder* next;   // link in the home's return list
+
+	explicit PooledBuilder(BuilderHome* home)
+		: fbb(INITIAL_SIZE, &allocator), refs(0), home(home), next(nullptr) {}
+};
+
+void release(PooledBuilder* node);
+
+} // detail
+
+/*
+ * Reference counted handle to a pooled FlatBufferBuilder. The builder is
+ * cleared and returned to the pool once the last handle to it is released,
+ * which for outbound messages is when the send completes. That's the pool
+ * of the thread that created it, even if the send completed elsewhere.
+ */
+class BufferHandle final {
+	detail::PooledBuilder* node_ = nullptr;
+
+	void reset() {
+		if(node_ && node_->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			detail::release(node_);
+		}
+
+		node_ = nullptr;
+	}
+
+public:
+	BufferHandle() = default;
+
+	explicit BufferHandle(detail::PooledBuilder* node) : node_(node) {
+		node_->refs.store(1, std::memory_order_relaxed);
+	}
+
+	BufferHandle(const BufferHandle& rhs) : node_(rhs.node_) {
+		if(node_) {
+			node_->refs.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	BufferHandle(BufferHandle&& rhs) noexcept : node_(std::exchange(rhs.node_, nullptr)) {}
+
+	BufferHandle& operator=(const BufferHandle& rhs) {
+		if(this != &rhs) {
+			BufferHandle copy(rhs);
+			std::swap(node_, copy.node_);
+		}
+
+		return *this;
+	}
+
+	BufferHandle& operator=(BufferHandle&& rhs) noexcept {
+		if(this != &rhs) {
+			reset();
+			node_ = std::exchange(rhs.node_, nullptr);
+		}
+
+		return *this;
+	}
+
+	~BufferHandle() {
+		reset();
+	}
+
+	flatbuffers::FlatBufferBuilder* get() const { return &node_->fbb; }
+	flatbuffers::FlatBufferBuilder* operator->() const { return &node_->fbb; }
+	flatbuffers::FlatBufferBuilder& operator*() const { return node_->fbb; }
+	explicit operator bool() const { return node_ != nullptr; }
+};
+
+// Acquires a cleared builder from the calling thread's pool
+BufferHandle make_buffer();
+
+} // spark, ember
\ No newline at end of file
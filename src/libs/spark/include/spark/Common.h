@@ -21,7 +21,7 @@ struct Endpoint;
 
 struct Beacon {
 	bool tracked;
-	boost::uuids::uuid uuid;
+	std::uint64_t sequence;
 };
 
 struct Message {
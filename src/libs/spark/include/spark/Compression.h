@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include "Compression_generated.h"
+#include <spark/BufferPool.h>
+#include <shared/metrics/Metrics.h>
+#include <flatbuffers/flatbuffers.h>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace ember::spark::inline v1 {
+
+/*
+ * Codecs are offered during negotiation in order of preference and each end
+ * compresses with the first of its own that the peer also offered. Messages
+ * smaller than the threshold, or that don't shrink, are sent as they are.
+ */
+struct CompressionPolicy {
+	static constexpr std::size_t DEFAULT_THRESHOLD = 1024;
+
+	std::vector<messaging::core::Codec> codecs;
+	std::size_t threshold = DEFAULT_THRESHOLD;
+	Metrics* metrics = nullptr;
+
+	// every codec this build supports, best first
+	static CompressionPolicy supported();
+};
+
+namespace detail {
+
+/*
+ * Per-link compression state. The codec contexts are created once when the
+ * link is negotiated and reset between messages rather than being set up for
+ * every message. Compression is serialised as any thread may send on a link,
+ * whereas decompression only happens on the link's read path.
+ */
+class Compressor final {
+public:
+	struct Stats {
+		std::uint64_t compressed;
+		std::uint64_t skipped;
+		std::uint64_t bytes_in;
+		std::uint64_t bytes_out;
+	};
+
+private:
+	struct Contexts;
+
+	const messaging::core::Codec codec_;
+	const std::size_t threshold_;
+	Metrics& metrics_;
+	std::unique_ptr<Contexts> contexts_;
+
+	std::mutex lock_;
+	std::vector<std::uint8_t> deflated_; // guarded by lock_
+	std::vector<std::uint8_t> inflated_; // read path only
+	Stats stats_{};                      // guarded by lock_
+
+	std::size_t deflate(const std::uint8_t* data, std::size_t size);
+	bool inflate(messaging::core::Codec codec, const flatbuffers::Vector<std::uint8_t>& payload,
+	             std::size_t size);
+
+public:
+	Compressor(const CompressionPolicy& policy, messaging::core::Codec codec);
+	~Compressor();
+
+	// the best codec offered by both ends, or NONE
+	static messaging::core::Codec select(const CompressionPolicy& policy,
+	                                     const flatbuffers::Vector<std::uint8_t>* offered);
+	static bool compressed(const std::uint8_t* data, std::size_t size);
+	static bool supported(messaging::core::Codec codec);
+
+	// returns the original message if it isn't worth compressing
+	BufferHandle compress(const BufferHandle& fbb);
+
+	// the returned frame is only valid until the next call
+	std::span<const std::uint8_t> decompress(const std::uint8_t* data, std::size_t size,
+	                                         std::size_t max_size);
+
+	messaging::core::Codec codec() const { return codec_; }
+	Stats stats();
+};
+
+} // detail
+
+} // spark, ember
\ No newline at end of file
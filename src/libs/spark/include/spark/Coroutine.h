@@ -0,0 +1,281 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include <spark/BufferPool.h>
+#include <spark/Common.h>
+#include <spark/DispatchTable.h>
+#include <spark/Link.h>
+#include <spark/Service.h>
+#include <spark/TrackingService.h>
+#include <boost/asio/dispatch.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+#include <flatbuffers/flatbuffers.h>
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+namespace ember::spark::inline v1 {
+
+/*
+ * A detached coroutine, started with spawn() on the io_context it should
+ * run on. Any requests it awaits resume on that same io_context, whichever
+ * thread the response arrived on.
+ *
+ * Frames come from the same per-thread slab caches as message buffers, so
+ * starting a coroutine per request doesn't go to the heap in steady state.
+ */
+class Task final {
+public:
+	struct promise_type {
+		boost::asio::io_context* context = nullptr;
+		std::exception_ptr exception;
+
+		static void* operator new(std::size_t size) {
+			return detail::SlabAllocator().allocate(size);
+		}
+
+		static void operator delete(void* frame, std::size_t size) {
+			detail::SlabAllocator().deallocate(static_cast<std::uint8_t*>(frame), size);
+		}
+
+		Task get_return_object() {
+			return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+		}
+
+		std::suspend_always initial_suspend() noexcept { return {}; }
+
+		// the frame is destroyed by whoever resumed it, see detail::resume
+		std::suspend_always final_suspend() noexcept { return {}; }
+		void return_void() { }
+
+		void unhandled_exception() { exception = std::current_exception(); }
+	};
+
+private:
+	std::coroutine_handle<promise_type> handle_;
+
+	explicit Task(std::coroutine_handle<promise_type> handle) : handle_(handle) { }
+
+	friend void spawn(boost::asio::io_context& context, Task task);
+
+public:
+	Task(Task&& rhs) noexcept : handle_(std::exchange(rhs.handle_, nullptr)) { }
+	Task& operator=(Task&&) = delete;
+
+	// never spawned
+	~Task() {
+		if(handle_) {
+			handle_.destroy();
+		}
+	}
+};
+
+namespace detail {
+
+/*
+ * Resumes a task, destroying its frame if it ran to completion. An exception
+ * that escaped the task is then rethrown to whoever is running the
+ * io_context, as it would be from any other handler.
+ */
+inline void resume(std::coroutine_handle<Task::promise_type> handle) {
+	handle.resume();
+
+	if(!handle.done()) {
+		return;
+	}
+
+	auto exception = std::move(handle.promise().exception);
+	handle.destroy();
+
+	if(exception) {
+		std::rethrow_exception(exception);
+	}
+}
+
+} // detail
+
+inline void spawn(boost::asio::io_context& context, Task task) {
+	auto handle = std::exchange(task.handle_, nullptr);
+	handle.promise().context = &context;
+
+	boost::asio::dispatch(context, [handle] {
+		detail::resume(handle);
+	});
+}
+
+enum class CallStatus { OK, TIMED_OUT, SEND_FAILED, BAD_MESSAGE, LINK_DOWN, SHUTDOWN };
+
+/*
+ * The reply to an awaited request. The message is copied out of the link's
+ * receive buffer, which will have been reused by the time the coroutine is
+ * resumed, into a pooled block and verified as MessageType if the link it
+ * arrived on requires it.
+ */
+template<typename MessageType>
+class Response final {
+	CallStatus status_;
+	std::uint16_t opcode_ = 0;
+	std::uint8_t* data_ = nullptr;
+	std::size_t size_ = 0;
+
+	void release() {
+		if(data_) {
+			detail::SlabAllocator().deallocate(data_, size_);
+			data_ = nullptr;
+		}
+	}
+
+public:
+	explicit Response(CallStatus status = CallStatus::TIMED_OUT) : status_(status) { }
+
+	Response(const Link& link, const Message& message)
+	         : status_(CallStatus::BAD_MESSAGE), opcode_(message.opcode),
+	           size_(message.size) {
+		if(!size_) {
+			return;
+		}
+
+		data_ = detail::SlabAllocator().allocate(size_);
+		std::memcpy(data_, message.data, size_);
+
+		auto copy = message;
+		copy.data = data_;
+
+		if(verify<MessageType>(link, copy)) {
+			status_ = CallStatus::OK;
+		}
+	}
+
+	Response(Response&& rhs) noexcept
+	         : status_(rhs.status_), opcode_(rhs.opcode_),
+	           data_(std::exchange(rhs.data_, nullptr)), size_(rhs.size_) { }
+
+	Response& operator=(Response&& rhs) noexcept {
+		if(this != &rhs) {
+			release();
+			status_ = rhs.status_;
+			opcode_ = rhs.opcode_;
+			data_ = std::exchange(rhs.data_, nullptr);
+			size_ = rhs.size_;
+		}
+
+		return *this;
+	}
+
+	~Response() {
+		release();
+	}
+
+	CallStatus status() const { return status_; }
+	std::uint16_t opcode() const { return opcode_; }
+	explicit operator bool() const { return status_ == CallStatus::OK; }
+
+	// only valid if the status is OK
+	const MessageType* get() const { return flatbuffers::GetRoot<MessageType>(data_); }
+	const MessageType* operator->() const { return get(); }
+	const MessageType& operator*() const { return *get(); }
+};
+
+/*
+ * Awaitable tracked request, created by Service::call. The awaiting coroutine
+ * is suspended until the reply arrives, the request times out, the link goes
+ * down or the service shuts down, then resumed on its own io_context.
+ *
+ * The reply can arrive before the coroutine has finished suspending, in which
+ * case it carries on without suspending at all rather than racing with a
+ * resume posted from the network thread.
+ */
+template<typename MessageType>
+class Call final : detail::Waiter {
+	enum State { PENDING, COMPLETE, SUSPENDED };
+
+	Service& service_;
+	const Link link_;
+	const std::uint16_t opcode_;
+	BufferHandle fbb_;
+	const std::chrono::milliseconds timeout_;
+
+	boost::asio::io_context* context_ = nullptr;
+	std::coroutine_handle<Task::promise_type> handle_;
+	std::atomic<State> state_ { PENDING };
+	Response<MessageType> response_;
+
+	static CallStatus to_status(const Failure failure) {
+		switch(failure) {
+			case Failure::LINK_DOWN:
+				return CallStatus::LINK_DOWN;
+			case Failure::SEND_FAILED:
+				return CallStatus::SEND_FAILED;
+			case Failure::SHUTDOWN:
+				return CallStatus::SHUTDOWN;
+			default:
+				return CallStatus::TIMED_OUT;
+		}
+	}
+
+	void finish(Response<MessageType> response) {
+		response_ = std::move(response);
+
+		if(state_.exchange(COMPLETE, std::memory_order_acq_rel) == SUSPENDED) {
+			boost::asio::post(*context_, [handle = handle_] {
+				detail::resume(handle);
+			});
+		}
+	}
+
+	void complete(const Link& link, const Message& message) override {
+		finish(Response<MessageType>(link, message));
+	}
+
+	void fail(const Failure failure) override {
+		finish(Response<MessageType>(to_status(failure)));
+	}
+
+public:
+	Call(Service& service, Link link, std::uint16_t opcode, BufferHandle fbb,
+	     std::chrono::milliseconds timeout)
+	     : service_(service), link_(std::move(link)), opcode_(opcode), fbb_(std::move(fbb)),
+	       timeout_(timeout) { }
+
+	Call(const Call&) = delete;
+	Call& operator=(const Call&) = delete;
+
+	bool await_ready() const noexcept {
+		return false;
+	}
+
+	bool await_suspend(std::coroutine_handle<Task::promise_type> handle) {
+		context_ = handle.promise().context;
+		handle_ = handle;
+
+		// failures are reported through the waiter too, so there's only one way to complete
+		service_.send(link_, opcode_, std::move(fbb_), *this, timeout_);
+		return state_.exchange(SUSPENDED, std::memory_order_acq_rel) != COMPLETE;
+	}
+
+	Response<MessageType> await_resume() {
+		return std::move(response_);
+	}
+};
+
+template<typename MessageType>
+Call<MessageType> Service::call(const Link& link, std::uint16_t opcode, BufferHandle fbb,
+                                std::chrono::milliseconds timeout) {
+	return Call<MessageType>(*this, link, opcode, std::move(fbb), timeout);
+}
+
+} // spark, ember
\ No newline at end of file
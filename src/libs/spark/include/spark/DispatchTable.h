@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include <spark/Common.h>
+#include <spark/Link.h>
+#include <flatbuffers/flatbuffers.h>
+#include <array>
+#include <utility>
+#include <cstddef>
+
+namespace ember::spark::inline v1 {
+
+/*
+ * Maps an opcode to the table it carries. Specialised for every opcode in
+ * the headers sparkc generates from the schemas (<Schema>_dispatch.h), using
+ * each opcode's message attribute.
+ */
+template<auto opcode>
+struct MessageType;
+
+template<auto opcode>
+using message_type_t = typename MessageType<opcode>::type;
+
+template<typename Type>
+bool verify(const Message& message) {
+	flatbuffers::Verifier verifier(message.data, message.size);
+	return flatbuffers::GetRoot<Type>(message.data)->Verify(verifier);
+}
+
+template<typename Type>
+bool verify(const Link& link, const Message& message) {
+	return link.verification == Verification::SKIP || verify<Type>(message);
+}
+
+/*
+ * Opcode indexed table of typed handlers for a single service. Handlers
+ * are registered against an opcode and receive its table directly, e.g.
+ *
+ * handlers_.add<Opcode::CMSG_FOO, &Service::handle_foo>(this);
+ * void Service::handle_foo(const Link& link, const Message& message, const Foo& msg);
+ *
+ * Messages are only verified if the link they arrived on requires it.
+ */
+template<typename OpcodeType>
+class DispatchTable final {
+public:
+	enum class Result { OK, UNHANDLED, BAD_MESSAGE };
+
+private:
+	static constexpr std::size_t SIZE = std::to_underlying(OpcodeType::MAX) + 1;
+
+	using Handler = void(*)(void* instance, const Link& link, const Message& message);
+	using Verifier = bool(*)(const Message& message);
+
+	struct Entry {
+		void* instance;
+		Handler handle;
+		Verifier verify;
+	};
+
+	std::array<Entry, SIZE> entries_{};
+
+public:
+	template<OpcodeType opcode, auto handler, typename Class>
+	void add(Class* instance) {
+		using Type = message_type_t<opcode>;
+
+		entries_[std::to_underlying(opcode)] = {
+			instance,
+			[](void* instance, const Link& link, const Message& message) {
+				const auto msg = flatbuffers::GetRoot<Type>(message.data);
+				(static_cast<Class*>(instance)->*handler)(link, message, *msg);
+			},
+			&spark::verify<Type>
+		};
+	}
+
+	Result dispatch(const Link& link, const Message& message) const {
+		if(message.opcode >= SIZE || !entries_[message.opcode].handle) {
+			return Result::UNHANDLED;
+		}
+
+		const auto& entry = entries_[message.opcode];
+
+		if(link.verification == Verification::FULL && !entry.verify(message)) {
+			return Result::BAD_MESSAGE;
+		}
+
+		entry.handle(entry.instance, link, message);
+		return Result::OK;
+	}
+};
+
+} // spark, ember
\ No newline at end of file
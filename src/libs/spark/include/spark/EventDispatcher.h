@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2015, 2016 Ember
+ * Copyright (c) 2015 - 2022 Ember
  *
  * This Source Code Form is subject to the terms of the Mozilla Public
  * License, v. 2.0. If a copy of the MPL was not distributed with this
@@ -11,34 +11,70 @@
 #include "Services_generated.h"
 #include <spark/Common.h>
 #include <spark/EventHandler.h>
+#include <spark/FlowControl.h>
 #include <spark/Link.h>
-#include <forward_list>
-#include <shared_mutex>
-#include <unordered_map>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <utility>
 #include <vector>
+#include <cstdint>
 
 namespace ember::spark::inline v1 {
 
+/*
+ * Handlers are stored in an immutable table indexed by service. Lookups
+ * are a single atomic load and never block; registering or removing a
+ * handler copies the table and swaps the new one in.
+ * 
+ * Superseded tables are retired rather than freed, as a dispatch may still
+ * be reading them. Handlers are only expected to change during startup and
+ * shutdown, so the number retired stays small. Removing a handler does not
+ * wait for dispatches already in progress to finish, so a handler must not
+ * be destroyed while its io_context can still be delivering to it.
+ *
+ * Each handler also sets the flow control window for its service, which is
+ * how many of its messages a peer may have outstanding before it has to wait
+ * for the handler to catch up. Links carry a single window, the largest of
+ * the services registered, as the sender doesn't yet tag what it sends.
+ */
 class EventDispatcher {
 public:
 	enum class Mode { CLIENT, SERVER, BOTH };
 
 private:
+	static constexpr auto MAX_SERVICES = std::to_underlying(messaging::Service::MAX) + 1;
+
 	struct Handler {
 		Mode mode;
 		EventHandler* handler;
+		std::uint32_t window;
 	};
 
-	std::unordered_map<messaging::Service, Handler> handlers_;
-	mutable std::shared_mutex lock_;
+	typedef std::array<Handler, MAX_SERVICES> HandlerTable;
+
+	std::atomic<const HandlerTable*> handlers_;
+	std::vector<std::unique_ptr<const HandlerTable>> retired_;
+	mutable std::mutex lock_; // writers only
+
+	const Handler* find(messaging::Service service) const;
+	void publish(std::unique_ptr<HandlerTable> table);
 
 public:
+	EventDispatcher();
+
 	std::vector<messaging::Service> services(Mode mode) const;
-	void register_handler(EventHandler* handler, messaging::Service service, Mode mode);
+	std::uint32_t window() const;
+	void register_handler(EventHandler* handler, messaging::Service service, Mode mode,
+	                      std::uint32_t window = FlowControl::DEFAULT_WINDOW);
 	void remove_handler(const EventHandler* handler);
 	void notify_link_up(messaging::Service service, const Link& link) const;
 	void notify_link_down(messaging::Service service, const Link& link) const;
 	void dispatch_message(messaging::Service service, const Link& link, const Message& message) const;
+
+	EventDispatcher(const EventDispatcher&) = delete;
+	EventDispatcher& operator=(const EventDispatcher&) = delete;
 };
 
 } // spark, ember
\ No newline at end of file
@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <cstddef>
+
+namespace ember::spark::inline v1 {
+
+namespace detail {
+
+/*
+ * Phi accrual failure detector for a single link. Rather than a fixed
+ * timeout, it gives the suspicion that the peer has failed as a value that
+ * grows the longer the link stays silent, relative to the spread of arrival
+ * intervals seen so far.
+ *
+ * Every message counts as a heartbeat, so arrivals closer together than
+ * MIN_INTERVAL are folded together to keep busy links from teaching the
+ * detector to expect constant traffic. ACCEPTABLE_PAUSE covers the gap while
+ * a link falls idle and the heartbeat starts pinging it, which happens every
+ * EXPECTED_INTERVAL.
+ *
+ * Arrivals are recorded by the link's read path, phi may be read from any thread.
+ */
+class FailureDetector final {
+public:
+	using Clock = std::chrono::steady_clock;
+
+	static constexpr std::size_t WINDOW = 100;
+	static constexpr std::chrono::milliseconds MIN_INTERVAL { 100 };
+	static constexpr std::chrono::milliseconds MIN_STDDEV { 100 };
+	static constexpr std::chrono::milliseconds ACCEPTABLE_PAUSE { 4000 };
+	static constexpr std::chrono::milliseconds EXPECTED_INTERVAL { 2000 };
+
+private:
+	std::atomic<Clock::rep> latest_;
+	Clock::time_point recorded_; // read path only
+
+	mutable std::mutex lock_;
+	std::array<double, WINDOW> intervals_{}; // milliseconds, guarded by lock_
+	std::size_t count_ = 0;                  // guarded by lock_
+	std::size_t next_ = 0;                   // guarded by lock_
+	double sum_ = 0.0;                       // guarded by lock_
+	double sum_squares_ = 0.0;               // guarded by lock_
+
+	void record(double interval);
+
+public:
+	explicit FailureDetector(Clock::time_point now = Clock::now());
+
+	void arrival(Clock::time_point now);
+	double phi(Clock::time_point now) const;
+	Clock::time_point latest() const;
+};
+
+} // detail
+
+} // spark, ember
\ No newline at end of file
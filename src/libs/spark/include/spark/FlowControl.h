@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include <spark/BufferPool.h>
+#include <atomic>
+#include <deque>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <cstdint>
+#include <cstddef>
+
+namespace ember::spark::inline v1 {
+
+/*
+ * Credit based flow control for a single link.
+ *
+ * Each end grants the other a window of messages during negotiation. Grants
+ * are cumulative (the total number of messages the peer may have sent so
+ * far) rather than deltas, so a stale or repeated grant is harmless and the
+ * heartbeat can carry the current value to resynchronise the two ends.
+ * The receiver tops the sender back up once half of the window has been
+ * consumed by the handlers.
+ *
+ * A sender without credit has its message held in a bounded backlog until
+ * the peer grants more and is told it was queued. Once the backlog is full,
+ * sends are refused with WOULD_BLOCK rather than growing without limit, so
+ * the caller can shed load or pick another peer.
+ *
+ * Until the peer has advertised a window, which includes peers that predate
+ * flow control, sends are unrestricted.
+ */
+class FlowControl final {
+public:
+	enum class Result { SENT, QUEUED, WOULD_BLOCK, REJECTED };
+
+	static constexpr std::uint32_t DEFAULT_WINDOW = 1024;
+	static constexpr std::size_t DEFAULT_BACKLOG = 256;
+
+	struct Stats {
+		std::uint64_t sent;
+		std::uint64_t limit;
+		std::size_t backlog;
+		std::uint64_t queued;
+		std::uint64_t would_block;
+		std::uint64_t dropped;
+		std::uint64_t consumed;
+		std::uint64_t granted;
+	};
+
+private:
+	static constexpr auto UNLIMITED = std::numeric_limits<std::uint64_t>::max();
+
+	mutable std::mutex lock_;
+	const std::size_t max_backlog_;
+
+	// outbound, lock_ must be held
+	std::uint64_t sent_ = 0;
+	std::uint64_t limit_ = UNLIMITED;
+	std::deque<BufferHandle> backlog_;
+	std::uint64_t queued_ = 0;
+	std::uint64_t would_block_ = 0;
+	std::uint64_t dropped_ = 0;
+
+	// inbound, only updated by the session's read path
+	std::atomic<std::uint32_t> window_ = 0;
+	std::atomic<std::uint64_t> consumed_ = 0;
+	std::atomic<std::uint64_t> granted_ = 0;
+
+	template<typename Writer>
+	void drain(Writer& write) {
+		while(!backlog_.empty() && sent_ < limit_) {
+			if(write(backlog_.front())) {
+				++sent_;
+			} else {
+				++dropped_;
+			}
+
+			backlog_.pop_front();
+		}
+	}
+
+public:
+	explicit FlowControl(std::size_t max_backlog = DEFAULT_BACKLOG)
+	                     : max_backlog_(max_backlog) { }
+
+	/*
+	 * Writes the message if there's credit for it and nothing is waiting
+	 * ahead of it. The write happens under the lock so that messages released
+	 * from the backlog can't be overtaken by a concurrent send.
+	 */
+	template<typename Writer>
+	Result send(const BufferHandle& fbb, Writer&& write) {
+		std::lock_guard<std::mutex> guard(lock_);
+
+		if(backlog_.empty() && sent_ < limit_) {
+			if(!write(fbb)) {
+				return Result::REJECTED;
+			}
+
+			++sent_;
+			return Result::SENT;
+		}
+
+		if(backlog_.size() >= max_backlog_) {
+			++would_block_;
+			return Result::WOULD_BLOCK;
+		}
+
+		backlog_.emplace_back(fbb);
+		++queued_;
+		return Result::QUEUED;
+	}
+
+	// raises the send limit to a cumulative grant, ignored until the peer has opened a window
+	template<typename Writer>
+	void grant(std::uint64_t limit, Writer&& write) {
+		std::lock_guard<std::mutex> guard(lock_);
+
+		if(limit_ == UNLIMITED || limit <= limit_) {
+			return;
+		}
+
+		limit_ = limit;
+		drain(write);
+	}
+
+	// the window advertised by the peer during negotiation
+	template<typename Writer>
+	void peer_window(std::uint32_t window, Writer&& write) {
+		if(!window) {
+			return; // peer doesn't support flow control
+		}
+
+		std::lock_guard<std::mutex> guard(lock_);
+		limit_ = sent_ + window;
+		drain(write);
+	}
+
+	std::uint32_t open(std::uint32_t window);
+	std::optional<std::uint64_t> consume();
+	std::uint64_t granted() const;
+	Stats stats() const;
+};
+
+} // spark, ember
\ No newline at end of file
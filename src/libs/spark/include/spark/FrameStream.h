@@ -0,0 +1,283 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include <spark/BufferPool.h>
+#include <boost/asio.hpp>
+#include <boost/endian/conversion.hpp>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <concepts>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <utility>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+namespace ember::spark::inline v1 {
+
+namespace detail {
+
+/*
+ * Length-prefixed framing over a stream socket, shared by the v1 and v2
+ * transports.
+ *
+ * Inbound frames are handed to the handler straight out of the receive
+ * buffer. Only a trailing partial frame is ever moved, and only once it no
+ * longer fits in the space left at the end of the buffer. The buffer grows
+ * to fit a single oversized frame and shrinks back once it has been drained.
+ *
+ * Outbound frames are queued while a write is in progress and sent together
+ * in a single gather write once it completes.
+ *
+ * The stream does not own itself; whatever owns it passes a pointer to
+ * start() which is kept alive for as long as any operations are pending.
+ *
+ * The handler is given each frame with receive(span), returning false to
+ * close the stream, and told about the stream closing underneath it with
+ * connection_closed(). If it has a frame_too_large(size) member, that's
+ * called before the stream is closed over an oversized inbound frame.
+ */
+template<std::movable Socket, typename Handler>
+class FrameStream final {
+public:
+	static constexpr std::size_t HEADER_SIZE = sizeof(std::uint32_t);
+	static constexpr std::size_t MAX_FRAME_SIZE = 1024 * 1024;
+	static constexpr std::size_t DEFAULT_BUFFER_SIZE = 64 * 1024;
+	static constexpr std::size_t MAX_QUEUED_MESSAGES = 4096;
+	static constexpr std::size_t MAX_QUEUED_BYTES = 16 * 1024 * 1024;
+
+	// two buffers per message (prefix + payload), keeps a flush within a single writev
+	static constexpr std::size_t MAX_BATCH_MESSAGES = 64;
+
+private:
+	Handler& handler_;
+	Socket socket_;
+	std::weak_ptr<void> owner_;
+	std::atomic<bool> closed_ = false;
+
+	// inbound - only touched by the receive handler
+	std::vector<std::uint8_t> buff_;
+	std::size_t read_offset_ = 0;
+	std::size_t write_offset_ = 0;
+
+	// outbound - guarded by write_lock_
+	std::mutex write_lock_;
+	std::deque<BufferHandle> queue_;
+	std::vector<BufferHandle> in_flight_;
+	std::array<std::uint32_t, MAX_BATCH_MESSAGES> prefixes_;
+	std::vector<boost::asio::const_buffer> gather_;
+	std::size_t queued_bytes_ = 0;
+	bool writing_ = false;
+
+	void receive(std::shared_ptr<void> owner) {
+		if(closed_) {
+			return;
+		}
+
+		auto buffer = boost::asio::buffer(buff_.data() + write_offset_,
+		                                  buff_.size() - write_offset_);
+
+		socket_.async_read_some(buffer,
+			[this, owner = std::move(owner)](boost::system::error_code ec, std::size_t size) mutable {
+				if(ec) {
+					if(ec != boost::asio::error::operation_aborted) {
+						handler_.connection_closed();
+					}
+
+					return;
+				}
+
+				write_offset_ += size;
+
+				if(!process_frames()) {
+					handler_.connection_closed();
+					return;
+				}
+
+				receive(std::move(owner));
+			}
+		);
+	}
+
+	bool process_frames() {
+		while(write_offset_ - read_offset_ >= HEADER_SIZE) {
+			const auto frame = buff_.data() + read_offset_;
+			const auto available = write_offset_ - read_offset_;
+
+			std::uint32_t size = 0;
+			std::memcpy(&size, frame, sizeof(size));
+			boost::endian::little_to_native_inplace(size);
+
+			if(size > MAX_FRAME_SIZE) {
+				if constexpr(requires { handler_.frame_too_large(size); }) {
+					handler_.frame_too_large(size);
+				}
+
+				return false;
+			}
+
+			const auto frame_size = HEADER_SIZE + size;
+
+			if(available < frame_size) {
+				// compact only if the rest of the frame won't fit in the tail
+				if(frame_size > buff_.size() - read_offset_) {
+					std::memmove(buff_.data(), frame, available);
+					read_offset_ = 0;
+					write_offset_ = available;
+
+					if(frame_size > buff_.size()) {
+						buff_.resize(frame_size);
+					}
+				}
+
+				return true;
+			}
+
+			if(!handler_.receive({ frame + HEADER_SIZE, size })) {
+				return false;
+			}
+
+			read_offset_ += frame_size;
+		}
+
+		if(read_offset_ == write_offset_) {
+			read_offset_ = write_offset_ = 0;
+
+			// release any growth caused by an oversized frame
+			if(buff_.size() > DEFAULT_BUFFER_SIZE) {
+				buff_.resize(DEFAULT_BUFFER_SIZE);
+				buff_.shrink_to_fit();
+			}
+		} else if(write_offset_ == buff_.size()) {
+			// partial length prefix at the very end of the buffer
+			const auto available = write_offset_ - read_offset_;
+			std::memmove(buff_.data(), buff_.data() + read_offset_, available);
+			read_offset_ = 0;
+			write_offset_ = available;
+		}
+
+		return true;
+	}
+
+	// write_lock_ must be held by the caller
+	void flush(std::shared_ptr<void> owner) {
+		const auto count = std::min(queue_.size(), MAX_BATCH_MESSAGES);
+		gather_.clear();
+
+		for(std::size_t i = 0; i < count; ++i) {
+			auto& fbb = in_flight_.emplace_back(std::move(queue_.front()));
+			queue_.pop_front();
+
+			const auto size = fbb->GetSize();
+			queued_bytes_ -= size;
+			prefixes_[i] = boost::endian::native_to_little(static_cast<std::uint32_t>(size));
+
+			gather_.emplace_back(&prefixes_[i], HEADER_SIZE);
+			gather_.emplace_back(fbb->GetBufferPointer(), size);
+		}
+
+		writing_ = true;
+
+		boost::asio::async_write(socket_, gather_,
+			[this, owner = std::move(owner)](boost::system::error_code ec, std::size_t) mutable {
+				std::unique_lock<std::mutex> guard(write_lock_);
+				in_flight_.clear();
+
+				if(!ec && !closed_ && !queue_.empty()) {
+					flush(std::move(owner));
+					return;
+				}
+
+				writing_ = false;
+				guard.unlock();
+
+				if(ec && ec != boost::asio::error::operation_aborted) {
+					handler_.connection_closed();
+				}
+			}
+		);
+	}
+
+public:
+	FrameStream(Handler& handler, Socket socket)
+		: handler_(handler), socket_(std::move(socket)), buff_(DEFAULT_BUFFER_SIZE) {
+		in_flight_.reserve(MAX_BATCH_MESSAGES);
+		gather_.reserve(MAX_BATCH_MESSAGES * 2);
+	}
+
+	void start(std::shared_ptr<void> owner) {
+		owner_ = owner;
+		receive(std::move(owner));
+	}
+
+	/*
+	 * Returns false if the frame could not be queued, either because it is
+	 * too large, the stream is closed or the peer isn't keeping up.
+	 */
+	bool send(const BufferHandle& fbb) {
+		const auto size = fbb->GetSize();
+
+		if(closed_ || size > MAX_FRAME_SIZE) {
+			return false;
+		}
+
+		std::lock_guard<std::mutex> guard(write_lock_);
+
+		if(queue_.size() >= MAX_QUEUED_MESSAGES || queued_bytes_ + size > MAX_QUEUED_BYTES) {
+			return false;
+		}
+
+		queue_.emplace_back(fbb);
+		queued_bytes_ += size;
+
+		if(!writing_) {
+			auto owner = owner_.lock();
+
+			if(!owner) { // not started or being destroyed
+				queue_.pop_back();
+				queued_bytes_ -= size;
+				return false;
+			}
+
+			flush(std::move(owner));
+		}
+
+		return true;
+	}
+
+	std::size_t queued() {
+		std::lock_guard<std::mutex> guard(write_lock_);
+		return queue_.size();
+	}
+
+	bool closed() const {
+		return closed_;
+	}
+
+	void close() {
+		closed_ = true;
+		boost::system::error_code ec; // we don't care about any errors
+		socket_.shutdown(Socket::shutdown_both, ec);
+		socket_.close(ec);
+	}
+
+	Socket& socket() {
+		return socket_;
+	}
+};
+
+} // detail
+
+} // spark, ember
\ No newline at end of file
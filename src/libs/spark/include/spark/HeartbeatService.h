@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2015 - 2020 Ember
+ * Copyright (c) 2015 - 2022 Ember
  *
  * This Source Code Form is subject to the terms of the Mozilla Public
  * License, v. 2.0. If a copy of the MPL was not distributed with this
@@ -8,45 +8,78 @@
 
 #pragma once
 
-#include "Core_generated.h"
+#include "Core_dispatch.h"
+#include <spark/BufferPool.h>
+#include <spark/FailureDetector.h>
 #include <spark/Link.h>
 #include <spark/EventHandler.h>
-#include <spark/Helpers.h>
+#include <shared/metrics/Metrics.h>
 #include <logger/Logging.h>
 #include <boost/asio/io_context.hpp>
 #include <boost/asio/steady_timer.hpp>
 #include <chrono>
 #include <forward_list>
 #include <functional>
+#include <memory>
 #include <mutex>
-#include <unordered_map>
+#include <string>
 #include <cstdint>
 
 namespace ember::spark::inline v1 {
 
 class Service;
+class NetworkSession;
 
+/*
+ * Links are only pinged once nothing has been sent on them for IDLE_PERIOD,
+ * as any other traffic serves just as well to show the peer we're alive,
+ * and at least every PING_FREQUENCY to keep round trip times current. Each
+ * link's failure detector is checked on every tick and the link is closed
+ * as soon as it suspects the peer, which takes it down for every service
+ * rather than leaving it to their requests to time out.
+ *
+ * Round trip times are reported per link as timings in microseconds, as
+ * spark.heartbeat.rtt.<peer description>, and kept on the link's session
+ * for load balancing. Pings carry the sender's own clock, which the peer
+ * only echoes back, so its resolution is ours to choose.
+ *
+ * Also carries flow control credit for the link. Grants are sent as they're
+ * earned and repeated in every ping and pong, so the two ends resynchronise
+ * even if a grant couldn't be queued when it was first sent.
+ */
 class HeartbeatService : public EventHandler {
+	const std::chrono::seconds TICK_FREQUENCY { 1 };
 	const std::chrono::seconds PING_FREQUENCY { 20 };
+	const std::chrono::milliseconds IDLE_PERIOD { detail::FailureDetector::EXPECTED_INTERVAL };
 	const std::chrono::milliseconds LATENCY_WARN_THRESHOLD { 1000 };
+	const double FAILURE_THRESHOLD = 8.0;
+
+	struct Peer {
+		Link link;
+		std::string rtt_key;
+		std::chrono::steady_clock::time_point last_ping;
+	};
 
 	const Service* service_;
-	std::forward_list<Link> peers_;
+	std::forward_list<Peer> peers_;
 	std::mutex lock_;
 	boost::asio::steady_timer timer_;
-	std::unordered_map<messaging::core::Opcode, LocalDispatcher> handlers_;
+	messaging::core::DispatchTable handlers_;
+	Metrics& metrics_;
 
 	log::Logger* logger_;
 	void set_timer();
-	void send_ping(const Link& link, std::uint64_t time);
+	void send_ping(NetworkSession& net, std::uint64_t time);
 	void send_pong(const Link& link, std::uint64_t time);
 	void trigger_pings(const boost::system::error_code& ec);
-	void handle_ping(const Link& link, const Message& message);
-	void handle_pong(const Link& link, const Message& message);
+	void handle_ping(const Link& link, const Message& message, const messaging::core::Ping& ping);
+	void handle_pong(const Link& link, const Message& message, const messaging::core::Pong& pong);
+	void handle_credit(const Link& link, const Message& message, const messaging::core::Credit& credit);
+	void apply_credit(const Link& link, std::uint64_t credits);
 
 public:
 	HeartbeatService(boost::asio::io_context& io_context, const Service* service,
-	                 log::Logger* logger);
+	                 log::Logger* logger, Metrics* metrics = nullptr);
 
 	void on_message(const Link& link, const Message& message) override;
 	void on_link_up(const Link& link) override;
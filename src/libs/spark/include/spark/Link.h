@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2015 Ember
+ * Copyright (c) 2015 - 2022 Ember
  *
  * This Source Code Form is subject to the terms of the Mozilla Public
  * License, v. 2.0. If a copy of the MPL was not distributed with this
@@ -16,10 +16,18 @@ namespace ember::spark::inline v1 {
 
 class NetworkSession;
 
+/*
+ * Whether messages received over a link are verified before being handed to
+ * their handlers. Peers on the other end of a socket are always verified,
+ * whereas links that never leave the host can skip it.
+ */
+enum class Verification { FULL, SKIP };
+
 struct Link {
 	boost::uuids::uuid uuid;
 	std::string description;
 	std::weak_ptr<NetworkSession> net;
+	Verification verification = Verification::FULL;
 };
 
 inline bool operator==(const Link& lhs, const Link& rhs) {
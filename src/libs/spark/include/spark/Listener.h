@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2015 - 2020 Ember
+ * Copyright (c) 2015 - 2022 Ember
  *
  * This Source Code Form is subject to the terms of the Mozilla Public
  * License, v. 2.0. If a copy of the MPL was not distributed with this
@@ -18,6 +18,9 @@ class LinkMap;
 class SessionManager;
 class EventDispatcher;
 class ServicesMap;
+struct CompressionPolicy;
+struct BatchPolicy;
+enum class Transport;
 
 class Listener {
 	boost::asio::io_context& service_;
@@ -29,6 +32,9 @@ class Listener {
 	const Link& link_;
 	const EventDispatcher& handlers_;
 	ServicesMap& services_;
+	const Transport transport_;
+	const CompressionPolicy& compression_;
+	const BatchPolicy& batching_;
 
 	void accept_connection();
 	void start_session(boost::asio::ip::tcp::socket socket, boost::asio::ip::tcp::endpoint ep);
@@ -36,7 +42,8 @@ class Listener {
 public:
 	Listener(boost::asio::io_context& service, std::string interface, std::uint16_t port,
 	         SessionManager& sessions, const EventDispatcher& handlers, ServicesMap& services,
-	         const Link& link, log::Logger* logger);
+	         const Link& link, Transport transport, const CompressionPolicy& compression,
+	         const BatchPolicy& batching, log::Logger* logger);
 
 	void shutdown();
 };
@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include "Services_generated.h"
+#include <spark/BufferPool.h>
+#include <spark/Common.h>
+#include <spark/Coroutine.h>
+#include <spark/Link.h>
+#include <spark/Service.h>
+#include <spark/ServicesMap.h>
+#include <logger/Logging.h>
+#include <array>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <cstdint>
+#include <cstddef>
+
+namespace ember::spark::inline v1 {
+
+/*
+ * Spreads tracked requests for a service across every peer currently
+ * providing it, rather than latching on to the first link to come up.
+ * 
+ * Without a key, two peers are sampled at random and the one with fewer
+ * requests in flight, weighted by the link's heartbeat round trip time once
+ * both have one, is used (power of two choices). With a key, such as an
+ * account ID, the peer is found by consistent hashing, so the same key keeps
+ * going to the same peer and only keys belonging to a peer that leaves are
+ * moved.
+ * 
+ * If the chosen link is gone, its queue is full or it has no flow control
+ * credit or backlog left, another peer is tried.
+ * By default, if the link goes down while a request is outstanding, the
+ * request is sent again to another peer before the caller is told it failed.
+ * The first peer may have handled it before going down, so requests that
+ * aren't idempotent should be sent with Resend::NEVER.
+ *
+ * Awaited requests (see spark/Coroutine.h) go to a single peer and report a
+ * lost link as CallStatus::LINK_DOWN, leaving the caller to decide whether
+ * it's safe to try again.
+ */
+template<typename MessageType>
+class BalancedCall;
+
+class LoadBalancer final {
+public:
+	enum class Resend { ON_LINK_LOSS, NEVER };
+
+	// a chosen peer, which counts as having a request in flight while held
+	class Lease final {
+		std::shared_ptr<ServicesMap::Peer> peer_;
+		Link link_ {};
+
+	public:
+		explicit Lease(std::shared_ptr<ServicesMap::Peer> peer = nullptr);
+		Lease(Lease&& rhs) noexcept = default;
+		Lease& operator=(Lease&& rhs) noexcept;
+		~Lease();
+
+		// empty if there was no peer to choose, which any send to it will fail on
+		const Link& link() const { return link_; }
+		explicit operator bool() const { return peer_ != nullptr; }
+	};
+
+private:
+	static constexpr std::size_t MAX_ATTEMPTS = 3;
+
+	using Peer = ServicesMap::Peer;
+	using Tried = std::array<std::shared_ptr<const Peer>, MAX_ATTEMPTS>;
+
+	Service& spark_;
+	const ServicesMap& services_;
+	const messaging::Service service_;
+	log::Logger* logger_;
+
+	static bool tried(const Tried& tried, const Peer* peer);
+
+	Service::Result send(std::optional<std::uint64_t> key, std::uint16_t opcode,
+	                     const BufferHandle& fbb, const TrackingHandler& callback,
+	                     Resend resend, Tried excluded, std::size_t attempt) const;
+
+public:
+	LoadBalancer(Service& spark, messaging::Service service, log::Logger* logger);
+
+	// selection from a snapshot, skipping any peers already tried
+	static std::shared_ptr<Peer> by_load(const ServicesMap::PeerSet& set, const Tried& tried = {});
+	static std::shared_ptr<Peer> by_key(const ServicesMap::PeerSet& set, std::uint64_t key,
+	                                    const Tried& tried = {});
+
+	std::optional<Link> pick() const;
+	std::optional<Link> pick(std::uint64_t key) const;
+	Lease lease() const;
+	Lease lease(std::uint64_t key) const;
+	std::size_t peers() const;
+
+	template<typename MessageType>
+	BalancedCall<MessageType> call(std::uint16_t opcode, BufferHandle fbb,
+	                               std::chrono::milliseconds timeout = Service::DEFAULT_TIMEOUT) const {
+		return BalancedCall<MessageType>(spark_, lease(), opcode, std::move(fbb), timeout);
+	}
+
+	template<typename MessageType>
+	BalancedCall<MessageType> call(std::uint64_t key, std::uint16_t opcode, BufferHandle fbb,
+	                               std::chrono::milliseconds timeout = Service::DEFAULT_TIMEOUT) const {
+		return BalancedCall<MessageType>(spark_, lease(key), opcode, std::move(fbb), timeout);
+	}
+
+	Service::Result send(std::uint16_t opcode, BufferHandle fbb, TrackingHandler callback,
+	                     Resend resend = Resend::ON_LINK_LOSS) const;
+	Service::Result send(std::uint64_t key, std::uint16_t opcode, BufferHandle fbb,
+	                     TrackingHandler callback, Resend resend = Resend::ON_LINK_LOSS) const;
+};
+
+// awaitable request to a peer chosen by a LoadBalancer, which holds its lease until resumed
+template<typename MessageType>
+class BalancedCall final {
+	LoadBalancer::Lease lease_;
+	Call<MessageType> call_;
+
+public:
+	BalancedCall(Service& spark, LoadBalancer::Lease lease, std::uint16_t opcode, BufferHandle fbb,
+	             std::chrono::milliseconds timeout)
+	             : lease_(std::move(lease)),
+	               call_(spark, lease_.link(), opcode, std::move(fbb), timeout) { }
+
+	BalancedCall(const BalancedCall&) = delete;
+	BalancedCall& operator=(const BalancedCall&) = delete;
+
+	bool await_ready() const noexcept {
+		return call_.await_ready();
+	}
+
+	bool await_suspend(std::coroutine_handle<Task::promise_type> handle) {
+		return call_.await_suspend(handle);
+	}
+
+	Response<MessageType> await_resume() {
+		lease_ = LoadBalancer::Lease();
+		return call_.await_resume();
+	}
+};
+
+} // spark, ember
\ No newline at end of file
@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include <spark/NetworkSession.h>
+#include <spark/BufferPool.h>
+#include <spark/MessageHandler.h>
+#include <spark/SessionManager.h>
+#include <shared/FilterTypes.h>
+#include <logger/Logging.h>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/strand.hpp>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <utility>
+#include <cstddef>
+
+namespace ember::spark::inline v1 {
+
+/*
+ * Session between two services in the same process. Messages are never
+ * serialised onto a socket; the sender's builder is handed to the peer and
+ * processed on the peer's io_context, through a strand to preserve ordering.
+ * The builder is returned to the pool once the peer has handled it.
+ */
+class LocalSession : public NetworkSession {
+	static constexpr std::size_t MAX_QUEUED_MESSAGES = 4096;
+
+	boost::asio::strand<boost::asio::io_context::executor_type> strand_;
+	std::weak_ptr<LocalSession> peer_;
+	std::atomic<std::size_t> queued_;
+	std::atomic<bool> stopped_;
+
+	void deliver(const BufferHandle& fbb) {
+		if(stopped_) {
+			return;
+		}
+
+		if(!handle_frame(fbb->GetBufferPointer(), fbb->GetSize())) {
+			close_session();
+		}
+	}
+
+	void stop() override {
+		if(stopped_.exchange(true)) {
+			return;
+		}
+
+		LOG_DEBUG_FILTER(logger_, LF_SPARK)
+			<< "[spark] Closing in-process connection"_lit << LOG_ASYNC;
+
+		// closing either end closes the link
+		if(auto peer = peer_.lock()) {
+			boost::asio::post(peer->strand_, [peer]() {
+				peer->close_session();
+			});
+		}
+	}
+
+public:
+	LocalSession(SessionManager& sessions, boost::asio::io_context& context,
+	             MessageHandler handler, log::Logger* logger)
+	             : NetworkSession(sessions, std::move(handler), logger),
+	               strand_(boost::asio::make_strand(context)), queued_(0), stopped_(false) { }
+
+	static void pair(const std::shared_ptr<LocalSession>& lhs,
+	                 const std::shared_ptr<LocalSession>& rhs) {
+		lhs->peer_ = rhs;
+		rhs->peer_ = lhs;
+	}
+
+	void start() override {
+		auto self(shared_from_this());
+
+		boost::asio::post(strand_, [this, self]() {
+			start_handler();
+		});
+	}
+
+	bool write(const BufferHandle& fbb) override {
+		auto peer = peer_.lock();
+
+		if(stopped_ || !peer || peer->stopped_) {
+			return false;
+		}
+
+		if(fbb->GetSize() > MAX_MESSAGE_LENGTH) {
+			LOG_DEBUG_FILTER(logger_, LF_SPARK)
+				<< "[spark] Attempted to send a message larger than permitted size ("_lit
+				<< MAX_MESSAGE_LENGTH << " bytes)"_lit << LOG_ASYNC;
+			return false;
+		}
+
+		if(queued_.fetch_add(1, std::memory_order_relaxed) >= MAX_QUEUED_MESSAGES) {
+			queued_.fetch_sub(1, std::memory_order_relaxed);
+
+			LOG_WARN_FILTER(logger_, LF_SPARK)
+				<< "[spark] Outbound queue limit reached for in-process peer"_lit
+				<< ", message dropped"_lit << LOG_ASYNC;
+			return false;
+		}
+
+		auto self(shared_from_this());
+
+		boost::asio::post(peer->strand_, [this, self, peer, fbb]() {
+			queued_.fetch_sub(1, std::memory_order_relaxed);
+			peer->deliver(fbb);
+		});
+
+		return true;
+	}
+
+	std::size_t queued_messages() override {
+		return queued_.load(std::memory_order_relaxed);
+	}
+
+	std::string remote_host() const override {
+		return "in-process";
+	}
+
+	Verification verification() const override {
+		return Verification::SKIP;
+	}
+};
+
+} // spark, ember
\ No newline at end of file
@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include <logger/Logging.h>
+#include <boost/asio/io_context.hpp>
+#include <functional>
+#include <memory>
+#include <string>
+#include <cstdint>
+
+namespace ember::spark::inline v1 {
+
+struct Link;
+class SessionManager;
+class EventDispatcher;
+class ServicesMap;
+class ShmAcceptor;
+class NetworkSession;
+
+/*
+ * Picks a cheaper transport than TCP when the peer is close by. A service in
+ * the same process is connected directly, one in another process on the same
+ * host is connected through shared memory (Linux only). Anything else is
+ * left to the caller to connect over the network.
+ *
+ * Only peers running as the same user are trusted with a shared memory link.
+ */
+class LocalTransport final {
+public:
+	using ConnectHandler = std::function<void(std::shared_ptr<NetworkSession>)>;
+
+private:
+	boost::asio::io_context& service_;
+	const std::string interface_;
+	const std::uint16_t port_;
+
+	SessionManager& sessions_;
+	const EventDispatcher& handlers_;
+	ServicesMap& services_;
+	const Link& link_;
+	log::Logger* logger_;
+
+#if defined __linux__
+	std::unique_ptr<ShmAcceptor> shm_acceptor_;
+#endif
+	bool registered_;
+
+	std::shared_ptr<NetworkSession> connect_in_process(const std::string& host, std::uint16_t port);
+	bool connect_shared_memory(const std::string& host, std::uint16_t port, ConnectHandler handler);
+	void unregister();
+
+public:
+	LocalTransport(boost::asio::io_context& service, std::string interface, std::uint16_t port,
+	               SessionManager& sessions, const EventDispatcher& handlers, ServicesMap& services,
+	               const Link& link, log::Logger* logger);
+	~LocalTransport();
+
+	/*
+	 * Returns false if the peer isn't local, in which case nothing was done.
+	 * Otherwise, the handler is given the new session, or null if the shared
+	 * memory handshake failed and the peer should be connected over TCP. The
+	 * handshake completes asynchronously.
+	 */
+	bool connect(const std::string& host, std::uint16_t port, ConnectHandler handler);
+	void shutdown();
+};
+
+} // spark, ember
\ No newline at end of file
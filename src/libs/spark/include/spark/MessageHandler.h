@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2015, 2016 Ember
+ * Copyright (c) 2015 - 2022 Ember
  *
  * This Source Code Form is subject to the terms of the Mozilla Public
  * License, v. 2.0. If a copy of the MPL was not distributed with this
@@ -8,9 +8,13 @@
 
 #pragma once
 
+#include <spark/BufferPool.h>
+#include <spark/Batching.h>
+#include <spark/Compression.h>
 #include <spark/Link.h>
 #include <spark/ServicesMap.h>
 #include <logger/Logging.h>
+#include <memory>
 #include <set>
 #include <cstdint>
 
@@ -34,20 +38,34 @@ class MessageHandler {
 	std::set<std::int32_t> matches_;
 	bool initiator_;
 
+	// only set when the link is negotiated, which happens before anybody can send on it
+	const CompressionPolicy* compression_;
+	std::shared_ptr<detail::Compressor> compressor_;
+	const BatchPolicy* batching_;
+	std::shared_ptr<detail::Batcher> batcher_;
+
 	void dispatch_message(const Message& message);
+	void return_credit(NetworkSession& net, const Message& message);
 	bool negotiate_protocols(NetworkSession& net, const Message& message);
 	bool establish_link(NetworkSession& net, const Message& message);
 	void send_banner(NetworkSession& net);
 	void send_negotiation(NetworkSession& net);
+	void send_credit(NetworkSession& net, std::uint64_t credits);
 
 public:
 	MessageHandler(const EventDispatcher& dispatcher, ServicesMap& services, const Link& link,
-	               bool initiator, log::Logger* logger);
+	               bool initiator, log::Logger* logger,
+	               const CompressionPolicy* compression = nullptr,
+	               const BatchPolicy* batching = nullptr);
 	~MessageHandler();
 
 	bool handle_message(NetworkSession& net, const messaging::core::Header* header,
 	                    const std::uint8_t* data, std::uint32_t size);
 	void start(NetworkSession& net);
+
+	BufferHandle compress(const BufferHandle& fbb) const;
+	detail::Compressor* compressor() const;
+	detail::Batcher* batcher() const;
 };
 
 } // spark, ember
\ No newline at end of file
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2015 - 2020 Ember
+ * Copyright (c) 2015 - 2022 Ember
  *
  * This Source Code Form is subject to the terms of the Mozilla Public
  * License, v. 2.0. If a copy of the MPL was not distributed with this
@@ -10,186 +10,255 @@
 
 #define FLATBUFFERS_TRACK_VERIFIER_BUFFER_SIZE
 #include "Core_generated.h"
+#include <spark/Batching.h>
+#include <spark/BufferPool.h>
+#include <spark/FailureDetector.h>
+#include <spark/FlowControl.h>
 #include <spark/MessageHandler.h>
 #include <spark/SessionManager.h>
-#include <spark/buffers/DynamicBuffer.h>
 #include <shared/FilterTypes.h>
 #include <logger/Logging.h>
-#include <boost/asio.hpp>
-#include <boost/endian/conversion.hpp>
+#include <boost/asio/ip/tcp.hpp>
 #include <flatbuffers/flatbuffers.h>
-#include <gsl/gsl_util>
 #include <algorithm>
-#include <array>
+#include <atomic>
 #include <chrono>
+#include <functional>
+#include <limits>
 #include <memory>
+#include <span>
 #include <string>
 #include <utility>
-#include <vector>
 #include <cstdint>
 #include <cstddef>
 
 namespace ember::spark::inline v1 {
 
-class NetworkSession : public std::enable_shared_from_this<NetworkSession> {
-	const std::size_t MAX_MESSAGE_LENGTH = 1024 * 1024;  // 1MB
-	const std::size_t DEFAULT_BUFFER_LENGTH = 1024 * 4;  // 4KB
-	enum class ReadState { SIZE_PREFIX, PAYLOAD };
-
-	boost::asio::ip::tcp::socket socket_;
-	const boost::asio::ip::tcp::endpoint ep_;
+/*
+ * Selects the transport used for peer sessions. V1 is the original TCP
+ * session, V2 runs the same handshake and messages over the v2 peer
+ * connection. Both use the same framing on the wire, so either end of a
+ * link can use either transport.
+ */
+enum class Transport { V1, V2 };
 
-	ReadState state_;
-	messaging::core::Header* header_;
-	std::uint32_t message_size_;
-	std::vector<std::uint8_t> in_buff_;
+class NetworkSession : public std::enable_shared_from_this<NetworkSession> {
 	SessionManager& sessions_;
 	MessageHandler handler_;
-	log::Logger* logger_; 
-	bool stopped_;
+	FlowControl flow_;
+	detail::FailureDetector detector_;
 
-	bool process_header() {
-		flatbuffers::Verifier verifier(in_buff_.data(), message_size_);
-		auto header = flatbuffers::GetRoot<messaging::core::Header>(in_buff_.data());
-		
-		if(!header->Verify(verifier)) {
+	// steady clock ticks, lets the heartbeat skip links that are already busy
+	std::atomic<std::chrono::steady_clock::rep> last_sent_;
+
+	// source of tracked request sequence numbers, zero is reserved for untracked
+	std::atomic<std::uint64_t> sequence_;
+
+	// smoothed round trip time in microseconds, zero until the first pong
+	std::atomic<std::uint32_t> rtt_;
+
+	// peers only compress once a codec has been negotiated, anything else is a protocol error
+	bool handle_compressed(const std::uint8_t* data, std::uint32_t size) {
+		auto compressor = handler_.compressor();
+		const auto frame = compressor? compressor->decompress(data, size, MAX_MESSAGE_LENGTH)
+		                             : std::span<const std::uint8_t>();
+
+		if(frame.empty()) {
 			LOG_WARN_FILTER(logger_, LF_SPARK)
-				<< "[spark] Bad header from " << remote_host() << LOG_ASYNC;
+				<< "[spark] Bad compressed message from "_lit << remote_host() << LOG_ASYNC;
 			return false;
 		}
 
-		return true;
+		const auto inflated_size = static_cast<std::uint32_t>(frame.size());
+		const auto header = process_header(frame.data(), inflated_size);
+		return header && handler_.handle_message(*this, header, frame.data(), inflated_size);
 	}
 
-	bool adjust_buffer() {
-		std::memcpy(&message_size_, in_buff_.data(), sizeof(message_size_));
-		boost::endian::little_to_native_inplace(message_size_);
-	
-		if(message_size_ > MAX_MESSAGE_LENGTH) {
+	// each frame is handled as though it arrived on its own, batches are never nested or compressed
+	bool handle_batch(const std::uint8_t* data, std::uint32_t size) {
+		flatbuffers::Verifier verifier(data, size);
+
+		if(!messaging::core::VerifyBatchBuffer(verifier)) {
 			LOG_WARN_FILTER(logger_, LF_SPARK)
-				<< "[spark] Peer at " << remote_host()
-				<< " attempted to send a message of "
-				<< message_size_ << " bytes" << LOG_ASYNC;
+				<< "[spark] Bad batch from "_lit << remote_host() << LOG_ASYNC;
 			return false;
 		}
 
-		if(message_size_ > in_buff_.size()) {
-			in_buff_.resize(message_size_);
+		const auto batch = messaging::core::GetBatch(data);
+
+		if(!batch->frames()) {
+			return true;
+		}
+
+		for(const auto entry : *batch->frames()) {
+			const auto frame = entry->frame();
+
+			if(!frame || !process_frame(frame->data(), frame->size())) {
+				return false;
+			}
 		}
 
 		return true;
 	}
 
-	void handle_read() {
-		switch(state_) {
-			case ReadState::SIZE_PREFIX:
-				if(adjust_buffer()) {
-					state_ = ReadState::PAYLOAD;
-				} else {
-					close_session();
-				}
-				break;
-			case ReadState::PAYLOAD:
-				if(process_header()) {
-					if(handler_.handle_message(*this, header_, in_buff_.data(), message_size_)) {
-						state_ = ReadState::SIZE_PREFIX;
-					} else {
-						close_session();
-					}
-				} else {
-					close_session();
-				}
-				break;
+	bool process_frame(const std::uint8_t* data, std::uint32_t size) {
+		if(detail::Compressor::compressed(data, size)) {
+			return handle_compressed(data, size);
 		}
 
-		read();
+		const auto header = process_header(data, size);
+		return header && handler_.handle_message(*this, header, data, size);
 	}
 
-	void read() {
-		if(stopped_) {
-			return;
+	// lock ordering, the batcher's lock is only ever taken inside flow control's or on its own
+	bool write_batched(const BufferHandle& fbb) {
+		const auto batcher = handler_.batcher();
+
+		if(!batcher) {
+			return write(fbb);
 		}
 
-		auto self(shared_from_this());
-		const std::uint32_t read_size = state_ == ReadState::SIZE_PREFIX? sizeof(message_size_) : message_size_;
+		const auto result = batcher->write(fbb, [&](const BufferHandle& msg) { return write(msg); });
 
-		boost::asio::async_read(socket_, boost::asio::buffer(in_buff_, read_size),
-			[this, self](boost::system::error_code ec, std::size_t /*size*/) {
-				if(ec && ec != boost::asio::error::operation_aborted) {
-					close_session();
-					return;
-				}
+		if(result == detail::Batcher::Result::HELD_FIRST) {
+			defer([self = shared_from_this()]() {
+				self->flush_batch();
+			});
+		}
 
-				handle_read();
-			}
-		);
+		return result != detail::Batcher::Result::REJECTED;
+	}
+
+	void flush_batch() {
+		if(auto batcher = handler_.batcher()) {
+			batcher->flush([&](const BufferHandle& msg) { return write(msg); });
+		}
 	}
 
-	void stop() {
-		LOG_DEBUG_FILTER(logger_, LF_SPARK)
-			<< "[spark] Closing connection to " << remote_host() << LOG_ASYNC;
+	const messaging::core::Header* process_header(const std::uint8_t* data, std::uint32_t size) {
+		flatbuffers::Verifier verifier(data, size);
+		auto header = flatbuffers::GetRoot<messaging::core::Header>(data);
+		
+		if(!header->Verify(verifier)) {
+			LOG_WARN_FILTER(logger_, LF_SPARK)
+				<< "[spark] Bad header from "_lit << remote_host() << LOG_ASYNC;
+			return nullptr;
+		}
 
-		stopped_ = true;
-		boost::system::error_code ec; // we don't care about any errors
-		socket_.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
-		socket_.close(ec);
+		return header;
 	}
 
-public:
-	NetworkSession(SessionManager& sessions, boost::asio::ip::tcp::socket socket,
-	               boost::asio::ip::tcp::endpoint ep, MessageHandler handler,
-	               log::Logger* logger)
-	               : header_(nullptr), sessions_(sessions), socket_(std::move(socket)), ep_(std::move(ep)),
-	                 message_size_(0), handler_(handler), logger_(logger), stopped_(false),
-	                 state_(ReadState::SIZE_PREFIX), in_buff_(DEFAULT_BUFFER_LENGTH) { }
-
-	void start() {
+protected:
+	static constexpr std::size_t MAX_MESSAGE_LENGTH = 1024 * 1024; // 1MB
+
+	log::Logger* logger_;
+
+	NetworkSession(SessionManager& sessions, MessageHandler handler, log::Logger* logger)
+	               : sessions_(sessions), handler_(std::move(handler)),
+	                 last_sent_(std::chrono::steady_clock::now().time_since_epoch().count()),
+	                 sequence_(1), rtt_(0), logger_(logger) { }
+
+	void start_handler() {
 		handler_.start(*this);
-		read();
 	}
 
-	void close_session() {
-		sessions_.stop(shared_from_this());
+	// returning false will close the session
+	virtual bool handle_frame(const std::uint8_t* data, std::uint32_t size) {
+		// anything from the peer shows it's alive, not just heartbeats
+		detector_.arrival(std::chrono::steady_clock::now());
+
+		if(detail::Batcher::batched(data, size)) {
+			return handle_batch(data, size);
+		}
+
+		return process_frame(data, size);
 	}
 
-	std::string remote_host() const {
-		return ep_.address().to_string();
+	/*
+	 * Runs the work once the handlers already queued on the session's
+	 * io_context have had their turn, which is when batched messages are
+	 * flushed. Sessions without an io_context of their own run it immediately.
+	 */
+	virtual void defer(std::function<void()> work) {
+		work();
 	}
 
-	void write(const std::shared_ptr<flatbuffers::FlatBufferBuilder>& fbb) {
-		if(!socket_.is_open()) {
-			return;
-		}
+	virtual void stop() = 0;
 
-		auto size = gsl::narrow<decltype(message_size_)>(fbb->GetSize());
+public:
+	virtual void start() = 0;
+
+	/*
+	 * Queues the message for sending. Returns false if the message could not
+	 * be queued, either because it is too large or because the peer isn't
+	 * keeping up with the outbound queue.
+	 */
+	virtual bool write(const BufferHandle& fbb) = 0;
+	virtual std::size_t queued_messages() = 0;
+	virtual std::string remote_host() const = 0;
+
+	// sessions that never leave the host don't need their messages verified
+	virtual Verification verification() const {
+		return Verification::FULL;
+	}
 
-		if(size > MAX_MESSAGE_LENGTH) {
-			LOG_DEBUG_FILTER(logger_, LF_SPARK)
-				<< "[spark] Attempted to send a message larger than permitted size ("
-				<< MAX_MESSAGE_LENGTH << " bytes)" << LOG_ASYNC;
-			return;
-		}
+	/*
+	 * Writes the message if the peer has granted credit for it, otherwise
+	 * holds it until more credit arrives. Large messages are compressed
+	 * first if the link negotiated a codec. Core messages (handshake, heartbeat
+	 * and credit grants) should use write() so they're never held up.
+	 *
+	 * Small messages are held back to be sent in a single frame if the link
+	 * negotiated batching. They still count against the peer's window
+	 * individually, as the peer hands each one to its handlers separately.
+	 */
+	FlowControl::Result send(const BufferHandle& fbb) {
+		last_sent_.store(std::chrono::steady_clock::now().time_since_epoch().count(),
+		                 std::memory_order_relaxed);
+		const auto out = handler_.compress(fbb);
+		return flow_.send(out, [&](const BufferHandle& msg) { return write_batched(msg); });
+	}
 
-		boost::endian::native_to_little_inplace(size);
+	void grant(std::uint64_t credits) {
+		flow_.grant(credits, [&](const BufferHandle& msg) { return write_batched(msg); });
+	}
 
-		// todo - remove this allocation - waiting for a better solution than can be achieved
-		// with the current FlatBuffers custom allocator design
-		auto size_ptr = std::make_shared<decltype(message_size_)>(size);
+	void peer_window(std::uint32_t window) {
+		flow_.peer_window(window, [&](const BufferHandle& msg) { return write_batched(msg); });
+	}
 
-		std::array<boost::asio::const_buffer, 2> buffers {
-			boost::asio::const_buffer { size_ptr.get(), sizeof(message_size_) },
-			boost::asio::const_buffer { fbb->GetBufferPointer(), fbb->GetSize() }
-		};
+	FlowControl& flow() {
+		return flow_;
+	}
 
-		auto self(shared_from_this());
+	const detail::FailureDetector& detector() const {
+		return detector_;
+	}
 
-		socket_.async_send(buffers,
-			[this, self, fbb, size_ptr](boost::system::error_code ec, std::size_t /*size*/) {
-				if(ec && ec != boost::asio::error::operation_aborted) {
-					close_session();
-				}
-			}
-		);
+	std::chrono::steady_clock::time_point last_sent() const {
+		using Clock = std::chrono::steady_clock;
+		return Clock::time_point(Clock::duration(last_sent_.load(std::memory_order_relaxed)));
+	}
+
+	void close_session() {
+		sessions_.stop(shared_from_this());
+	}
+
+	std::uint64_t next_sequence() {
+		return sequence_.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// weights each new sample by 1/8, as TCP does for its own estimate
+	void record_rtt(const std::chrono::microseconds& sample) {
+		const auto value = static_cast<std::uint32_t>(std::clamp<std::chrono::microseconds::rep>(
+			sample.count(), 1, std::numeric_limits<std::uint32_t>::max()));
+		const auto current = rtt_.load(std::memory_order_relaxed);
+		const auto smoothed = current? current - current / 8 + value / 8 : value;
+		rtt_.store(smoothed, std::memory_order_relaxed);
+	}
+
+	std::chrono::microseconds rtt() const {
+		return std::chrono::microseconds(rtt_.load(std::memory_order_relaxed));
 	}
 
 	virtual ~NetworkSession() = default;
@@ -197,4 +266,9 @@ public:
 	friend class SessionManager;
 };
 
+std::shared_ptr<NetworkSession> make_session(Transport transport, SessionManager& sessions,
+                                             boost::asio::ip::tcp::socket socket,
+                                             boost::asio::ip::tcp::endpoint ep,
+                                             MessageHandler handler, log::Logger* logger);
+
 } // spark, ember
\ No newline at end of file
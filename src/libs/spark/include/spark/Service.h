@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2015 - 2020 Ember
+ * Copyright (c) 2015 - 2022 Ember
  *
  * This Source Code Form is subject to the terms of the Mozilla Public
  * License, v. 2.0. If a copy of the MPL was not distributed with this
@@ -10,6 +10,9 @@
 
 #include "Services_generated.h"
 #include "ServiceDiscovery.h"
+#include <spark/BufferPool.h>
+#include <spark/Batching.h>
+#include <spark/Compression.h>
 #include <spark/Common.h>
 #include <spark/ServiceDiscovery.h>
 #include <spark/HeartbeatService.h>
@@ -20,22 +23,30 @@
 #include <spark/SessionManager.h>
 #include <spark/NetworkSession.h>
 #include <spark/Listener.h>
+#include <spark/LocalTransport.h>
 #include <shared/FilterTypes.h>
 #include <logger/Logging.h>
 #include <boost/asio.hpp>
 #include <boost/uuid/uuid.hpp>
 #include <boost/uuid/uuid_generators.hpp>
 #include <flatbuffers/flatbuffers.h>
+#include <chrono>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <utility>
 #include <cstdint>
 
 namespace ember::spark::inline v1 {
 
-class Service final {
-	typedef std::shared_ptr<flatbuffers::FlatBufferBuilder> BufferHandle;
+template<typename MessageType> class Call;
 
+class Service final {
 	boost::asio::io_context& service_;
+	const Transport transport_;
+	const CompressionPolicy compression_;
+	const BatchPolicy batching_;
 
 	Link link_;
 	EventDispatcher dispatcher_;
@@ -44,21 +55,59 @@ class Service final {
 	HeartbeatService hb_service_;
 	TrackingService track_service_;
 	Listener listener_;
-	boost::uuids::random_generator generate_uuid;
+	LocalTransport local_;
 
 	log::Logger* logger_;
+
+	/*
+	 * Outbound links by the endpoint they were made to, so that a peer that's
+	 * located again while the link is up isn't connected to twice.
+	 */
+	struct Outbound {
+		bool pending;
+		std::weak_ptr<NetworkSession> session;
+	};
+
+	std::mutex outbound_lock_;
+	std::map<std::pair<std::string, std::uint16_t>, Outbound> outbound_;
 	
 	void do_connect(const std::string& host, std::uint16_t port);
-	void start_session(boost::asio::ip::tcp::socket socket, boost::asio::ip::tcp::endpoint ep);
+	void connected(const std::string& host, std::uint16_t port, std::shared_ptr<NetworkSession> session);
+	std::shared_ptr<NetworkSession> start_session(boost::asio::ip::tcp::socket socket,
+	                                              boost::asio::ip::tcp::endpoint ep);
 
 public:
-	enum class Result { OK, LINK_GONE };
+	/*
+	 * REJECTED indicates that the message could not be queued for sending,
+	 * either because it exceeded the maximum message size or because the
+	 * link's outbound queue is full
+	 * 
+	 * QUEUED indicates that the peer hasn't granted enough credit and the
+	 * message will be sent once it does. WOULD_BLOCK indicates that the
+	 * link's flow control backlog is also full and the message was dropped.
+	 */
+	enum class Result { OK, QUEUED, LINK_GONE, REJECTED, WOULD_BLOCK };
+
+	static constexpr std::chrono::milliseconds DEFAULT_TIMEOUT { 5000 };
+
+	// whether the message was accepted, tracked callbacks will be invoked
+	static constexpr bool accepted(Result result) {
+		return result == Result::OK || result == Result::QUEUED;
+	}
+
+private:
+	static Result to_result(FlowControl::Result result);
 
+public:
 	Service(std::string description, boost::asio::io_context& service,
-	        const std::string& interface, std::uint16_t port, log::Logger* logger);
+	        const std::string& interface, std::uint16_t port, log::Logger* logger,
+	        Transport transport = Transport::V1,
+	        CompressionPolicy compression = CompressionPolicy::supported(),
+	        BatchPolicy batching = {}, Metrics* metrics = nullptr);
 	~Service();
 
 	EventDispatcher* dispatcher();
+	const ServicesMap* services() const;
 	void connect(const std::string& host, std::uint16_t port);
 
 	Result send(const Link& link, std::uint16_t opcode, BufferHandle fbb) const;
@@ -69,6 +118,13 @@ public:
 	            const Beacon& token, TrackingHandler callback);
 	Result send(const Link& link, std::uint16_t opcode, BufferHandle fbb,
 	            TrackingHandler callback);
+	Result send(const Link& link, std::uint16_t opcode, BufferHandle fbb,
+	            detail::Waiter& waiter, std::chrono::milliseconds timeout);
+
+	// awaitable request, see spark/Coroutine.h
+	template<typename MessageType>
+	Call<MessageType> call(const Link& link, std::uint16_t opcode, BufferHandle fbb,
+	                       std::chrono::milliseconds timeout = DEFAULT_TIMEOUT);
 
 	void broadcast(messaging::Service service, ServicesMap::Mode mode, BufferHandle fbb) const;
 	void shutdown();
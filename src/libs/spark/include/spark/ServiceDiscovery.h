@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2015 - 2021 Ember
+ * Copyright (c) 2015 - 2022 Ember
  *
  * This Source Code Form is subject to the terms of the Mozilla Public
  * License, v. 2.0. If a copy of the MPL was not distributed with this
@@ -9,6 +9,7 @@
 #pragma once
 
 #include "Multicast_generated.h"
+#include <spark/BufferPool.h>
 #include <spark/Common.h>
 #include <spark/ServiceListener.h>
 #include <logger/Logging.h>
@@ -19,6 +20,8 @@
 #include <functional>
 #include <memory>
 #include <mutex>
+#include <random>
+#include <string>
 #include <unordered_map>
 #include <vector>
 #include <cstdint>
@@ -28,17 +31,48 @@ namespace ember::spark::inline v1 {
 
 typedef std::function<void(const messaging::multicast::LocateResponse*)> LocateCallback;
 
+/*
+ * Registered services are announced to the multicast group when registered,
+ * when somebody asks for them and periodically thereafter, with jitter so
+ * that services started together don't stay in lockstep.
+ * 
+ * Every answer seen is cached for its TTL, so a search for a service that's
+ * already known is answered from the cache without sending anything.
+ * Listeners are told about every answer, refreshes included, so a link that
+ * has gone down is re-established by the peer's next announcement. Connecting
+ * to a peer that's already linked does nothing, see Service::connect.
+ *
+ * Failing to join the group isn't fatal, as peers can still connect to us;
+ * discovery just stays inactive.
+ */
 class ServiceDiscovery {
+public:
+	static constexpr std::chrono::seconds ANNOUNCE_INTERVAL { 30 };
+	static constexpr std::chrono::seconds DEFAULT_TTL { ANNOUNCE_INTERVAL * 3 };
+
+private:
 	static const std::size_t BUFFER_SIZE = 1024;
 
+	using Clock = std::chrono::steady_clock;
+
+	struct CacheEntry {
+		std::string ip;
+		std::uint16_t port;
+		Clock::time_point expiry;
+		BufferHandle answer; // kept for replaying to listeners on a cache hit
+	};
+
 	std::string address_;
 	std::uint16_t port_;
 	boost::asio::io_context& service_;
 	boost::asio::ip::udp::socket socket_;
 	boost::asio::ip::udp::endpoint endpoint_, remote_ep_;
+	boost::asio::steady_timer announce_timer_;
 	std::array<std::uint8_t, BUFFER_SIZE> buffer_;
 	std::vector<messaging::Service> services_;
 	std::unordered_map<messaging::Service, std::vector<const ServiceListener*>> listeners_;
+	std::unordered_map<messaging::Service, std::vector<CacheEntry>> cache_;
+	std::minstd_rand jitter_;
 	mutable std::mutex lock_;
 
 	log::Logger* logger_;
@@ -52,11 +86,14 @@ class ServiceDiscovery {
 	void handle_locate_answer(const messaging::multicast::LocateResponse* message);
 
 	// packet senders
-	void send(const std::shared_ptr<flatbuffers::FlatBufferBuilder>& fbb,
+	void send(const BufferHandle& fbb,
 	          messaging::multicast::Opcode opcode);
 	void send_announce(messaging::Service service);
+	void schedule_announce();
 
-	void locate_service(messaging::Service);
+	void cache_answer(const messaging::multicast::LocateResponse* message);
+	void expire(std::vector<CacheEntry>& entries, Clock::time_point now);
+	void locate_service(const ServiceListener* listener);
 	void handle_receive(const boost::system::error_code& ec, std::size_t size);
 
 public:
@@ -67,6 +104,8 @@ public:
 	void register_service(messaging::Service service);
 	void remove_service(messaging::Service service);
 	std::unique_ptr<ServiceListener> listener(messaging::Service service, LocateCallback cb);
+	std::size_t cached(messaging::Service service);
+	bool joined() const;
 	void shutdown();
 
 	friend class ServiceListener;
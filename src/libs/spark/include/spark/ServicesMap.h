@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2015, 2016 Ember
+ * Copyright (c) 2015 - 2022 Ember
  *
  * This Source Code Form is subject to the terms of the Mozilla Public
  * License, v. 2.0. If a copy of the MPL was not distributed with this
@@ -10,23 +10,86 @@
 
 #include "Services_generated.h"
 #include <spark/Link.h>
-#include <forward_list>
+#include <array>
+#include <atomic>
+#include <memory>
 #include <mutex>
-#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
 
 namespace ember::spark::inline v1 {
 
+/*
+ * Peers are published per service as immutable sets, so readers (sends,
+ * broadcasts, load balancing) take a snapshot with an atomic load rather
+ * than copying the list under a lock. Links coming up or going down copy
+ * the set and swap the new one in.
+ * 
+ * A snapshot shares ownership of its set, so a superseded set is freed
+ * as soon as the last reader still holding it lets go.
+ */
 class ServicesMap {
-	std::unordered_map<messaging::Service, std::forward_list<Link>> peer_servers_;
-	std::unordered_map<messaging::Service, std::forward_list<Link>> peer_clients_;
-	mutable std::mutex lock_;
-
 public:
 	enum class Mode { CLIENT, SERVER };
 
+	/*
+	 * Shared between successive sets so request counts carry across peers
+	 * joining and leaving. healthy is cleared when the link goes down, for
+	 * anybody still holding on to it.
+	 */
+	struct Peer {
+		const Link link;
+		std::atomic<std::uint32_t> in_flight;
+		std::atomic<bool> healthy;
+
+		explicit Peer(Link link) : link(std::move(link)), in_flight(0), healthy(true) {}
+	};
+
+	struct PeerSet {
+		std::vector<std::shared_ptr<Peer>> peers;
+
+		// consistent hashing ring of (point, index into peers), sorted by point
+		std::vector<std::pair<std::uint64_t, std::uint32_t>> ring;
+	};
+
+	using Snapshot = std::shared_ptr<const PeerSet>;
+
+	static constexpr std::size_t VIRTUAL_NODES = 64; // ring points per peer
+
+private:
+	static constexpr auto MAX_SERVICES = std::to_underlying(messaging::Service::MAX) + 1;
+
+	using SetTable = std::array<std::atomic<Snapshot>, MAX_SERVICES>;
+
+	const Snapshot empty_;
+	std::array<SetTable, 2> sets_; // indexed by mode
+	std::mutex lock_; // writers only
+
+	std::atomic<Snapshot>* slot(messaging::Service service, Mode type);
+	const std::atomic<Snapshot>* slot(messaging::Service service, Mode type) const;
+	static void build_ring(PeerSet& set);
+
+public:
+	ServicesMap();
+
+	// finaliser used for ring points, also suitable for spreading keys across the ring
+	static std::uint64_t hash_point(std::uint64_t value) {
+		value ^= value >> 30;
+		value *= 0xBF58476D1CE4E5B9ull;
+		value ^= value >> 27;
+		value *= 0x94D049BB133111EBull;
+		return value ^ (value >> 31);
+	}
+
+	Snapshot snapshot(messaging::Service service, Mode type) const;
 	std::vector<Link> peer_services(messaging::Service service, Mode type) const;
 	void register_peer_service(const Link& link, messaging::Service service, Mode type);
 	void remove_peer(const Link& link);
+
+	ServicesMap(const ServicesMap&) = delete;
+	ServicesMap& operator=(const ServicesMap&) = delete;
 };
 
 } // spark, ember
\ No newline at end of file
@@ -0,0 +1,480 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#if defined __linux__
+
+#include <spark/NetworkSession.h>
+#include <spark/BufferPool.h>
+#include <spark/MessageHandler.h>
+#include <spark/SessionManager.h>
+#include <shared/FilterTypes.h>
+#include <logger/Logging.h>
+#include <boost/asio/bind_executor.hpp>
+#include <boost/asio/dispatch.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/local/stream_protocol.hpp>
+#include <boost/asio/posix/stream_descriptor.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/strand.hpp>
+#include <array>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <unistd.h>
+
+namespace ember::spark::inline v1 {
+
+namespace detail {
+
+/*
+ * Indices are free-running byte counts, only ever masked when touching the
+ * data. Each is written by one side only and kept on its own cache line.
+ */
+struct RingControl {
+	alignas(64) std::atomic<std::uint64_t> head;      // written by the consumer
+	alignas(64) std::atomic<std::uint64_t> tail;      // written by the producer
+	alignas(64) std::atomic<std::uint32_t> waiting;   // consumer is parked on the eventfd
+	alignas(64) std::atomic<std::uint64_t> consumed;  // messages, for queue reporting
+};
+
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free);
+static_assert(std::atomic<std::uint32_t>::is_always_lock_free);
+
+/*
+ * Single producer, single consumer byte ring living in shared memory. Each
+ * record is an eight byte header followed by the payload, padded so that
+ * every header (and so every payload) stays eight byte aligned. A record
+ * never wraps; if it won't fit before the end of the ring, a padding marker
+ * is written and the record starts again at the beginning.
+ */
+class ShmRing final {
+public:
+	static constexpr std::size_t CAPACITY = 1024 * 1024 * 4; // 4MB, power of two
+	static constexpr std::size_t RECORD_HEADER = 8;
+	static constexpr std::size_t SEGMENT_SIZE = sizeof(RingControl) + CAPACITY;
+	static constexpr std::uint32_t PADDING = 0xFFFFFFFF;
+
+	static_assert((CAPACITY & (CAPACITY - 1)) == 0, "Ring capacity must be a power of two");
+
+private:
+	RingControl* control_ = nullptr;
+	std::uint8_t* data_ = nullptr;
+
+	static std::size_t record_size(const std::size_t payload) {
+		return (RECORD_HEADER + payload + 7) & ~std::size_t(7);
+	}
+
+	static void write_size(std::uint8_t* at, std::uint32_t size) {
+		std::memcpy(at, &size, sizeof(size));
+	}
+
+	static std::uint32_t read_size(const std::uint8_t* at) {
+		std::uint32_t size = 0;
+		std::memcpy(&size, at, sizeof(size));
+		return size;
+	}
+
+public:
+	ShmRing() = default;
+
+	// memory must be SEGMENT_SIZE bytes, suitably aligned and zeroed on creation
+	explicit ShmRing(void* memory)
+		: control_(static_cast<RingControl*>(memory)),
+		  data_(static_cast<std::uint8_t*>(memory) + sizeof(RingControl)) { }
+
+	// largest payload that is guaranteed to fit in an empty ring
+	static constexpr std::size_t max_payload() {
+		return CAPACITY / 2 - RECORD_HEADER;
+	}
+
+	/*
+	 * Producer only. Returns false if there isn't currently enough space, in
+	 * which case nothing is written. The release store to tail publishes the
+	 * record.
+	 */
+	bool push(const std::uint8_t* payload, const std::size_t size) {
+		if(size > max_payload()) {
+			return false;
+		}
+
+		const auto tail = control_->tail.load(std::memory_order_relaxed);
+		const auto head = control_->head.load(std::memory_order_acquire);
+		const auto offset = tail & (CAPACITY - 1);
+		const auto contiguous = CAPACITY - offset;
+		const auto needed = record_size(size);
+		const auto pad = needed > contiguous? contiguous : 0;
+
+		if(CAPACITY - (tail - head) < needed + pad) {
+			return false;
+		}
+
+		if(pad) {
+			write_size(data_ + offset, PADDING);
+		}
+
+		const auto start = (tail + pad) & (CAPACITY - 1);
+		write_size(data_ + start, static_cast<std::uint32_t>(size));
+		std::memcpy(data_ + start + RECORD_HEADER, payload, size);
+
+		// seq_cst so the store can't be reordered with the waiting check that follows
+		control_->tail.store(tail + pad + needed, std::memory_order_seq_cst);
+		return true;
+	}
+
+	/*
+	 * Producer only, after a successful push. Returns true if the consumer
+	 * had parked and so needs to be woken.
+	 */
+	bool consumer_parked() {
+		if(!control_->waiting.load(std::memory_order_seq_cst)) {
+			return false;
+		}
+
+		return control_->waiting.exchange(0, std::memory_order_seq_cst) != 0;
+	}
+
+	/*
+	 * Consumer only. Passes up to limit records to the callback in place,
+	 * releasing the space once the callback returns. The callback returns
+	 * false to stop the drain. Returns the number of records consumed, or -1
+	 * if the ring contents are invalid.
+	 */
+	template<typename Callback>
+	int drain(Callback&& callback, const int limit) {
+		auto head = control_->head.load(std::memory_order_relaxed);
+		const auto tail = control_->tail.load(std::memory_order_acquire);
+		int count = 0;
+
+		// the producer is in another process so nothing is taken on trust
+		if(tail - head > CAPACITY) {
+			return -1;
+		}
+
+		while(head != tail && count < limit) {
+			const auto offset = head & (CAPACITY - 1);
+			const auto size = read_size(data_ + offset);
+
+			if(size == PADDING) {
+				const auto skip = CAPACITY - offset;
+
+				if(skip > tail - head) {
+					return -1;
+				}
+
+				head += skip;
+				continue;
+			}
+
+			const auto needed = record_size(size);
+
+			if(size > max_payload() || needed > CAPACITY - offset || needed > tail - head) {
+				return -1;
+			}
+
+			const bool proceed = callback(data_ + offset + RECORD_HEADER, size);
+			head += needed;
+			++count;
+			control_->head.store(head, std::memory_order_release);
+
+			if(!proceed) {
+				break;
+			}
+		}
+
+		control_->head.store(head, std::memory_order_release);
+		control_->consumed.fetch_add(count, std::memory_order_relaxed);
+		return count;
+	}
+
+	// consumer only
+	bool empty() const {
+		return control_->head.load(std::memory_order_relaxed)
+			== control_->tail.load(std::memory_order_acquire);
+	}
+
+	/*
+	 * Consumer only. Flags the consumer as waiting and then checks the ring
+	 * once more, closing the window in which the producer could push without
+	 * seeing the flag. Returns false if there's data, in which case the
+	 * caller should drain rather than sleep.
+	 */
+	bool park() {
+		control_->waiting.store(1, std::memory_order_seq_cst);
+
+		if(control_->tail.load(std::memory_order_seq_cst)
+		   != control_->head.load(std::memory_order_relaxed)) {
+			control_->waiting.store(0, std::memory_order_relaxed);
+			return false;
+		}
+
+		return true;
+	}
+
+	std::uint64_t consumed() const {
+		return control_->consumed.load(std::memory_order_relaxed);
+	}
+};
+
+/*
+ * Owns the shared memory and wakeup descriptors for a link between two
+ * processes. The memfd holds one ring per direction, each with an eventfd
+ * that's signalled when its consumer is parked.
+ */
+class ShmSegment final {
+	int memfd_ = -1;
+	std::array<int, 2> eventfds_ { -1, -1 };
+	void* memory_ = nullptr;
+
+	ShmSegment() = default;
+
+	bool map();
+
+public:
+	static constexpr std::size_t MAPPING_SIZE = ShmRing::SEGMENT_SIZE * 2;
+	static constexpr std::size_t DESCRIPTOR_COUNT = 3;
+
+	// creates a new segment, returns null on failure
+	static std::unique_ptr<ShmSegment> create();
+
+	// adopts descriptors received from a peer, returns null if they're unusable
+	static std::unique_ptr<ShmSegment> open(const std::array<int, DESCRIPTOR_COUNT>& fds);
+
+	ShmSegment(const ShmSegment&) = delete;
+	ShmSegment& operator=(const ShmSegment&) = delete;
+	~ShmSegment();
+
+	// ring zero carries messages from the initiator
+	ShmRing ring(std::size_t index) const;
+	int eventfd(std::size_t index) const { return eventfds_[index]; }
+	std::array<int, DESCRIPTOR_COUNT> descriptors() const;
+};
+
+bool send_descriptors(int socket, const std::array<int, ShmSegment::DESCRIPTOR_COUNT>& fds);
+bool receive_descriptors(int socket, std::array<int, ShmSegment::DESCRIPTOR_COUNT>& fds);
+
+// true if the process at the other end of the unix socket runs as the same user as us
+bool same_user(int socket);
+
+} // detail
+
+/*
+ * Session between two processes on the same host. Messages are copied
+ * directly into a ring in shared memory rather than going through the
+ * network stack, and the receiver is only woken through its eventfd if it
+ * has run out of work and parked. The unix socket used to set the segment up
+ * is kept open so that either side notices if the other goes away.
+ *
+ * The peer can still write to the ring while a message is being read, so
+ * each one is copied out before it's verified and handled.
+ */
+class ShmSession : public NetworkSession {
+	static constexpr int MAX_BATCH_MESSAGES = 64;
+
+	using LocalSocket = boost::asio::local::stream_protocol::socket;
+
+	LocalSocket socket_;
+	std::unique_ptr<detail::ShmSegment> segment_;
+	boost::asio::strand<LocalSocket::executor_type> strand_;
+	boost::asio::posix::stream_descriptor wakeup_;
+	detail::ShmRing in_;
+	detail::ShmRing out_;
+	const int out_eventfd_;
+	std::uint8_t liveness_;
+	std::atomic<bool> stopped_;
+
+	// outbound ring - guarded by write_lock_, one producer per ring
+	std::mutex write_lock_;
+	std::uint64_t written_;
+
+	// inbound - only touched on the strand
+	std::vector<std::uint8_t> frame_;
+
+	void receive() {
+		auto self(shared_from_this());
+
+		const auto count = in_.drain([&](const std::uint8_t* data, std::size_t size) {
+			frame_.assign(data, data + size);
+
+			if(handle_frame(frame_.data(), static_cast<std::uint32_t>(frame_.size()))) {
+				return true;
+			}
+
+			close_session();
+			return false;
+		}, MAX_BATCH_MESSAGES);
+
+		if(count < 0) {
+			LOG_WARN_FILTER(logger_, LF_SPARK)
+				<< "[spark] Corrupt shared memory ring, closing session"_lit << LOG_ASYNC;
+			close_session();
+			return;
+		}
+
+		if(stopped_) {
+			return;
+		}
+
+		// yield between batches rather than starving other work on the context
+		if(count == MAX_BATCH_MESSAGES || !in_.park()) {
+			boost::asio::post(strand_, [this, self]() {
+				receive();
+			});
+			return;
+		}
+
+		wakeup_.async_wait(boost::asio::posix::stream_descriptor::wait_read,
+			boost::asio::bind_executor(strand_, [this, self](boost::system::error_code ec) {
+				if(ec) {
+					if(ec != boost::asio::error::operation_aborted) {
+						close_session();
+					}
+
+					return;
+				}
+
+				std::uint64_t value = 0;
+				boost::system::error_code read_ec;
+				wakeup_.read_some(boost::asio::buffer(&value, sizeof(value)), read_ec);
+				receive();
+			}));
+	}
+
+	void watch_peer() {
+		auto self(shared_from_this());
+
+		// the peer never writes to the socket, so completion means it's gone
+		socket_.async_read_some(boost::asio::buffer(&liveness_, sizeof(liveness_)),
+			boost::asio::bind_executor(strand_, [this, self](boost::system::error_code ec, std::size_t) {
+				if(ec != boost::asio::error::operation_aborted) {
+					close_session();
+				}
+			}));
+	}
+
+	void stop() override {
+		if(stopped_.exchange(true)) {
+			return;
+		}
+
+		LOG_DEBUG_FILTER(logger_, LF_SPARK)
+			<< "[spark] Closing shared memory connection"_lit << LOG_ASYNC;
+
+		boost::system::error_code ec; // we don't care about any errors
+		socket_.shutdown(boost::asio::socket_base::shutdown_both, ec);
+		socket_.close(ec);
+		wakeup_.close(ec);
+	}
+
+public:
+	ShmSession(SessionManager& sessions, LocalSocket socket,
+	           std::unique_ptr<detail::ShmSegment> segment, bool initiator,
+	           MessageHandler handler, log::Logger* logger)
+	           : NetworkSession(sessions, std::move(handler), logger),
+	             socket_(std::move(socket)), segment_(std::move(segment)),
+	             strand_(boost::asio::make_strand(socket_.get_executor())),
+	             wakeup_(strand_), in_(segment_->ring(initiator? 1 : 0)),
+	             out_(segment_->ring(initiator? 0 : 1)),
+	             out_eventfd_(segment_->eventfd(initiator? 0 : 1)),
+	             liveness_(0), stopped_(false), written_(0) {
+		// the descriptor takes ownership, so it gets its own copy
+		wakeup_.assign(::dup(segment_->eventfd(initiator? 1 : 0)));
+	}
+
+	void start() override {
+		auto self(shared_from_this());
+
+		boost::asio::dispatch(strand_, [this, self]() {
+			start_handler();
+			watch_peer();
+			receive();
+		});
+	}
+
+	bool write(const BufferHandle& fbb) override {
+		if(stopped_) {
+			return false;
+		}
+
+		if(fbb->GetSize() > MAX_MESSAGE_LENGTH) {
+			LOG_DEBUG_FILTER(logger_, LF_SPARK)
+				<< "[spark] Attempted to send a message larger than permitted size ("_lit
+				<< MAX_MESSAGE_LENGTH << " bytes)"_lit << LOG_ASYNC;
+			return false;
+		}
+
+		bool wake = false;
+
+		{
+			std::lock_guard guard(write_lock_);
+
+			if(!out_.push(fbb->GetBufferPointer(), fbb->GetSize())) {
+				LOG_WARN_FILTER(logger_, LF_SPARK)
+					<< "[spark] Shared memory ring full, message dropped"_lit << LOG_ASYNC;
+				return false;
+			}
+
+			++written_;
+			wake = out_.consumer_parked();
+		}
+
+		if(wake) {
+			const std::uint64_t value = 1;
+			[[maybe_unused]] auto res = ::write(out_eventfd_, &value, sizeof(value));
+		}
+
+		return true;
+	}
+
+	std::size_t queued_messages() override {
+		std::lock_guard guard(write_lock_);
+		return static_cast<std::size_t>(written_ - out_.consumed());
+	}
+
+	std::string remote_host() const override {
+		return "shared memory";
+	}
+};
+
+/*
+ * Accepts shared memory links on an abstract unix socket derived from the
+ * service's port. The connecting side creates the segment and passes its
+ * descriptors over the socket.
+ */
+class ShmAcceptor final {
+public:
+	using LocalSocket = boost::asio::local::stream_protocol::socket;
+	using AcceptHandler = std::function<void(LocalSocket, std::unique_ptr<detail::ShmSegment>)>;
+
+private:
+	boost::asio::local::stream_protocol::acceptor acceptor_;
+	AcceptHandler handler_;
+	log::Logger* logger_;
+
+	void accept();
+	void receive_segment(std::shared_ptr<LocalSocket> socket);
+
+public:
+	ShmAcceptor(boost::asio::io_context& context, std::uint16_t port,
+	            AcceptHandler handler, log::Logger* logger);
+
+	static boost::asio::local::stream_protocol::endpoint endpoint(std::uint16_t port);
+	void shutdown();
+};
+
+} // spark, ember
+
+#endif
\ No newline at end of file
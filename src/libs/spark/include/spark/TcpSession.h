@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2015 - 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include <spark/NetworkSession.h>
+#include <spark/BufferPool.h>
+#include <spark/FrameStream.h>
+#include <spark/MessageHandler.h>
+#include <spark/SessionManager.h>
+#include <shared/FilterTypes.h>
+#include <logger/Logging.h>
+#include <boost/asio.hpp>
+#include <functional>
+#include <span>
+#include <string>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+
+namespace ember::spark::inline v1 {
+
+class TcpSession : public NetworkSession {
+	using Socket = boost::asio::ip::tcp::socket;
+	using Stream = detail::FrameStream<Socket, TcpSession>;
+	friend Stream;
+
+	Stream stream_;
+	const boost::asio::ip::tcp::endpoint ep_;
+
+	bool receive(std::span<const std::uint8_t> frame) {
+		return handle_frame(frame.data(), static_cast<std::uint32_t>(frame.size()));
+	}
+
+	void frame_too_large(std::uint32_t size) {
+		LOG_WARN_FILTER(logger_, LF_SPARK)
+			<< "[spark] Peer at "_lit << remote_host()
+			<< " attempted to send a message of "_lit
+			<< size << " bytes"_lit << LOG_ASYNC;
+	}
+
+	void connection_closed() {
+		close_session();
+	}
+
+	void stop() override {
+		LOG_DEBUG_FILTER(logger_, LF_SPARK)
+			<< "[spark] Closing connection to "_lit << remote_host() << LOG_ASYNC;
+
+		stream_.close();
+	}
+
+	void defer(std::function<void()> work) override {
+		boost::asio::post(stream_.socket().get_executor(), std::move(work));
+	}
+
+public:
+	TcpSession(SessionManager& sessions, Socket socket,
+	           boost::asio::ip::tcp::endpoint ep, MessageHandler handler,
+	           log::Logger* logger)
+	           : NetworkSession(sessions, std::move(handler), logger),
+	             stream_(*this, std::move(socket)), ep_(std::move(ep)) { }
+
+	void start() override {
+		start_handler();
+		stream_.start(shared_from_this());
+	}
+
+	std::string remote_host() const override {
+		return ep_.address().to_string();
+	}
+
+	/*
+	 * Queues the message for sending. All messages queued while a write is in
+	 * progress are sent together in a single gather write once it completes,
+	 * so frames are never interleaved on the socket.
+	 * 
+	 * Returns false if the message could not be queued, either because it is
+	 * too large or because the peer isn't keeping up with the outbound queue.
+	 */
+	bool write(const BufferHandle& fbb) override {
+		if(stream_.closed()) {
+			return false;
+		}
+
+		if(fbb->GetSize() > MAX_MESSAGE_LENGTH) {
+			LOG_DEBUG_FILTER(logger_, LF_SPARK)
+				<< "[spark] Attempted to send a message larger than permitted size ("_lit
+				<< MAX_MESSAGE_LENGTH << " bytes)"_lit << LOG_ASYNC;
+			return false;
+		}
+
+		if(!stream_.send(fbb)) {
+			LOG_WARN_FILTER(logger_, LF_SPARK)
+				<< "[spark] Outbound queue limit reached for "_lit << remote_host()
+				<< ", message dropped"_lit << LOG_ASYNC;
+			return false;
+		}
+
+		return true;
+	}
+
+	std::size_t queued_messages() override {
+		return stream_.queued();
+	}
+};
+
+} // spark, ember
\ No newline at end of file
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2015 - 2020 Ember
+ * Copyright (c) 2015 - 2022 Ember
  *
  * This Source Code Form is subject to the terms of the Mozilla Public
  * License, v. 2.0. If a copy of the MPL was not distributed with this
@@ -14,36 +14,101 @@
 #include <logger/Logging.h>
 #include <boost/asio/io_context.hpp>
 #include <boost/asio/steady_timer.hpp>
-#include <boost/functional/hash.hpp>
 #include <boost/uuid/uuid.hpp>
+#include <array>
 #include <chrono>
-#include <memory>
-#include <unordered_map>
+#include <limits>
 #include <mutex>
+#include <optional>
+#include <vector>
 #include <cstdint>
+#include <cstddef>
 
 namespace ember::spark::inline v1 {
 
+namespace detail {
+
+/*
+ * Completion target for awaited requests. It lives in the awaiting coroutine's
+ * frame, so tracking the request doesn't need a handler to be allocated.
+ *
+ * Exactly one of complete or fail is called for each request.
+ */
+class Waiter {
+public:
+	enum class Failure { TIMED_OUT, LINK_DOWN, SEND_FAILED, SHUTDOWN };
+
+	virtual void complete(const Link& link, const Message& message) = 0;
+	virtual void fail(Failure failure) = 0;
+
+protected:
+	~Waiter() = default;
+};
+
+} // detail
+
+/*
+ * Tracked requests are identified by the link they were sent over and a
+ * sequence number drawn from that link, and are stored in a flat, linear
+ * probing table to avoid an allocation per request.
+ * 
+ * Rather than arming a timer per request, timeouts are handled by a single
+ * timer wheel that ticks while there are requests outstanding. A request
+ * times out on the first tick at or after its deadline, so expiry is only
+ * accurate to within TICK_INTERVAL.
+ * 
+ * Completed requests are not removed from the wheel; their entries are
+ * discarded when their slot is next visited.
+ * 
+ * Requests complete either through a handler or, for awaited requests, a
+ * waiter, which is always invoked outside of the lock. Waiters are also
+ * failed at shutdown, so that nothing is left waiting forever, whereas
+ * handlers are dropped.
+ */
 class TrackingService : public EventHandler {
-	struct Request {
-		Request(boost::asio::io_context& service, boost::uuids::uuid id, Link link,
-		         TrackingHandler handler)
-		        : timer(service), id(id), handler(handler), link(std::move(link)) { }
+public:
+	static constexpr std::chrono::milliseconds TICK_INTERVAL { 50 };
+
+private:
+	static constexpr std::size_t WHEEL_SLOTS = 256; // must be a power of two
+	static constexpr std::size_t INITIAL_CAPACITY = 1024;
+	static constexpr std::size_t npos = std::numeric_limits<std::size_t>::max();
 
-		boost::asio::steady_timer timer;
-		boost::uuids::uuid id;
+	struct Request {
+		std::uint64_t sequence = 0; // zero marks an empty slot
+		std::uint64_t expiry = 0;   // in ticks
+		Link link;
 		TrackingHandler handler;
-		const Link link;
+		detail::Waiter* waiter = nullptr;
+	};
+
+	struct Key {
+		boost::uuids::uuid link;
+		std::uint64_t sequence;
 	};
 
-	std::unordered_map<boost::uuids::uuid, std::unique_ptr<Request>,
-	                   boost::hash<boost::uuids::uuid>> handlers_;
+	std::vector<Request> requests_;
+	std::size_t active_;
+	std::array<std::vector<Key>, WHEEL_SLOTS> wheel_;
+	std::vector<Key> due_;
+	std::uint64_t tick_;
+	bool ticking_;
+	bool shutdown_;
 
-	boost::asio::io_context& io_context_;
+	boost::asio::steady_timer timer_;
 	log::Logger* logger_;
 	std::mutex lock_;
 
-	void timeout(const boost::uuids::uuid& id, Link link, const boost::system::error_code& ec);
+	std::size_t home(const boost::uuids::uuid& link, std::uint64_t sequence) const;
+	std::size_t find(const boost::uuids::uuid& link, std::uint64_t sequence) const;
+	void insert(Request request);
+	Request take(std::size_t index);
+	void grow();
+	void track(Request request, std::chrono::milliseconds timeout);
+	static void complete(Request& request, const Link& link, const Message& message);
+	static void fail(Request& request, detail::Waiter::Failure failure);
+	void start_timer();
+	void tick(const boost::system::error_code& ec);
 
 public:
 	TrackingService(boost::asio::io_context& io_context, log::Logger* logger);
@@ -52,8 +117,12 @@ public:
 	void on_link_up(const Link& link) override;
 	void on_link_down(const Link& link) override;
 
-	void register_tracked(const Link& link, boost::uuids::uuid id, TrackingHandler handler,
+	void register_tracked(const Link& link, std::uint64_t sequence, TrackingHandler handler,
+	                      std::chrono::milliseconds timeout);
+	void register_tracked(const Link& link, std::uint64_t sequence, detail::Waiter& waiter,
 	                      std::chrono::milliseconds timeout);
+	bool cancel(const Link& link, std::uint64_t sequence);
+	std::size_t outstanding();
 	void shutdown();
 };
 
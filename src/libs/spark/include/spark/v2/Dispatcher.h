@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2021 Ember
+ * Copyright (c) 2021 - 2022 Ember
  *
  * This Source Code Form is subject to the terms of the Mozilla Public
  * License, v. 2.0. If a copy of the MPL was not distributed with this
@@ -8,11 +8,16 @@
 
 #pragma once
 
+#include <span>
+#include <cstdint>
+
 namespace ember::spark::v2 {
 
 class Dispatcher {
 public:
-	virtual void receive() = 0;
+	// returning false will close the connection
+	virtual bool receive(std::span<const std::uint8_t> frame) = 0;
+	virtual void connection_closed() = 0;
 	virtual ~Dispatcher() = default;
 };
 
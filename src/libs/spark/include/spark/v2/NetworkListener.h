@@ -41,11 +41,11 @@ class NetworkListener {
 
 				if(ec) {
 					LOG_DEBUG(logger_)
-						<< "Aborted connection, remote peer disconnected" << LOG_ASYNC;
+						<< "Aborted connection, remote peer disconnected"_lit << LOG_ASYNC;
 				} else {
 					LOG_DEBUG(logger_)
-						<< "Accepted connection " << ep.address().to_string()
-						<< ":" << ep.port() << LOG_ASYNC;
+						<< "Accepted connection "_lit << ep.address().to_string()
+						<< ":"_lit << ep.port() << LOG_ASYNC;
 
 					sock_acc_.accept(std::move(socket_));
 				}
@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include <spark/v2/Dispatcher.h>
+#include <spark/v2/PeerConnection.h>
+#include <spark/NetworkSession.h>
+#include <spark/BufferPool.h>
+#include <spark/MessageHandler.h>
+#include <spark/SessionManager.h>
+#include <shared/FilterTypes.h>
+#include <logger/Logging.h>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/post.hpp>
+#include <functional>
+#include <span>
+#include <string>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+
+namespace ember::spark::v2 {
+
+/*
+ * Runs a v1 session over a v2 peer connection, allowing existing services
+ * to switch transports without any changes to their handlers
+ */
+class PeerSession : public spark::NetworkSession, public Dispatcher {
+	using Socket = boost::asio::ip::tcp::socket;
+
+	PeerConnection<Socket> conn_;
+	const boost::asio::ip::tcp::endpoint ep_;
+
+	bool receive(std::span<const std::uint8_t> frame) override {
+		return handle_frame(frame.data(), static_cast<std::uint32_t>(frame.size()));
+	}
+
+	void connection_closed() override {
+		close_session();
+	}
+
+	void stop() override {
+		LOG_DEBUG_FILTER(logger_, LF_SPARK)
+			<< "[spark] Closing connection to "_lit << remote_host() << LOG_ASYNC;
+
+		conn_.close();
+	}
+
+	void defer(std::function<void()> work) override {
+		boost::asio::post(conn_.socket().get_executor(), std::move(work));
+	}
+
+public:
+	PeerSession(SessionManager& sessions, Socket socket, boost::asio::ip::tcp::endpoint ep,
+	            MessageHandler handler, log::Logger* logger)
+	            : NetworkSession(sessions, std::move(handler), logger),
+	              conn_(*this, std::move(socket)), ep_(std::move(ep)) { }
+
+	void start() override {
+		conn_.start(shared_from_this());
+		start_handler();
+	}
+
+	bool write(const BufferHandle& fbb) override {
+		if(conn_.send(fbb)) {
+			return true;
+		}
+
+		LOG_DEBUG_FILTER(logger_, LF_SPARK)
+			<< "[spark] Unable to queue message for "_lit << remote_host() << LOG_ASYNC;
+		return false;
+	}
+
+	std::size_t queued_messages() override {
+		return conn_.queued();
+	}
+
+	std::string remote_host() const override {
+		return ep_.address().to_string();
+	}
+};
+
+} // spark, ember
\ No newline at end of file
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2021 Ember
+ * Copyright (c) 2021 - 2022 Ember
  *
  * This Source Code Form is subject to the terms of the Mozilla Public
  * License, v. 2.0. If a copy of the MPL was not distributed with this
@@ -11,14 +11,23 @@
 #include <spark/v2/PeerHandler.h>
 #include <spark/v2/PeerConnection.h>
 #include <spark/v2/Dispatcher.h>
+#include <spark/BufferPool.h>
 #include <logger/Logging.h>
 #include <concepts>
+#include <memory>
+#include <span>
 #include <utility>
+#include <cstdint>
 
 namespace ember::spark::v2 {
 
+/*
+ * Kept alive by its connection's pending operations, so it's destroyed
+ * once the connection has closed and nothing else holds a reference
+ */
 template<typename Handler, typename Connection, typename Socket>
-class RemotePeer final : public Dispatcher {
+class RemotePeer final : public Dispatcher,
+                         public std::enable_shared_from_this<RemotePeer<Handler, Connection, Socket>> {
 	Handler handler_;
 	Connection conn_;
 	log::Logger* log_;
@@ -27,12 +36,23 @@ public:
 	explicit RemotePeer(Socket socket, log::Logger* log)
 		: handler_(*this), conn_(*this, std::move(socket)), log_(log) {}
 
-	void send() {
+	void start() {
+		conn_.start(this->shared_from_this());
+	}
+
+	bool send(const BufferHandle& fbb) {
+		LOG_TRACE(log_) << __func__ << LOG_ASYNC;
+		return conn_.send(fbb);
+	}
+
+	bool receive(std::span<const std::uint8_t> frame) override {
 		LOG_TRACE(log_) << __func__ << LOG_ASYNC;
+		return true;
 	}
 
-	void receive() override {
+	void connection_closed() override {
 		LOG_TRACE(log_) << __func__ << LOG_ASYNC;
+		conn_.close();
 	}
 };
 
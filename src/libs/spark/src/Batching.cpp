@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <spark/Batching.h>
+
+namespace ember::spark::inline v1 {
+
+namespace em = ember::messaging;
+
+namespace {
+
+// frames are read in place on the receiving end, so keep them aligned for their largest scalars
+constexpr std::size_t FRAME_ALIGNMENT = sizeof(std::uint64_t);
+
+} // unnamed
+
+namespace detail {
+
+Batcher::Batcher(const BatchPolicy& policy)
+                 : max_message_(policy.max_message), flush_size_(policy.flush_size) { }
+
+bool Batcher::batched(const std::uint8_t* data, const std::size_t size) {
+	return size >= flatbuffers::FlatBufferBuilder::kFileIdentifierLength + sizeof(flatbuffers::uoffset_t)
+		&& em::core::BatchBufferHasIdentifier(data);
+}
+
+// lock_ must be held by the caller
+BufferHandle Batcher::build() {
+	// not worth wrapping
+	if(pending_.size() == 1) {
+		return pending_.front();
+	}
+
+	auto out = make_buffer();
+	frames_.clear();
+
+	for(const auto& msg : pending_) {
+		const auto size = msg->GetSize();
+		out->ForceVectorAlignment(size, sizeof(std::uint8_t), FRAME_ALIGNMENT);
+		auto frame = out->CreateVector(msg->GetBufferPointer(), size);
+		frames_.emplace_back(em::core::CreateBatched(*out, frame));
+	}
+
+	auto batch = em::core::CreateBatch(*out, out->CreateVector(frames_));
+	em::core::FinishBatchBuffer(*out, batch);
+	++stats_.batches;
+	return out;
+}
+
+auto Batcher::stats() -> Stats {
+	std::lock_guard<std::mutex> guard(lock_);
+	return stats_;
+}
+
+} // detail
+
+} // spark, ember
\ No newline at end of file
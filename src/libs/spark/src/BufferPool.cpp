@@ -0,0 +1,260 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <spark/BufferPool.h>
+#include <array>
+#include <new>
+#include <vector>
+
+namespace ember::spark::inline v1 {
+
+namespace {
+
+constexpr std::array<std::size_t, 4> SIZE_CLASSES { 1024, 4096, 16384, 65536 };
+constexpr std::size_t MAX_CACHED_BLOCKS = 32;   // per size class, per thread
+constexpr std::size_t MAX_CACHED_BUILDERS = 64; // per thread
+constexpr std::size_t MAX_RETAINED_BYTES = SIZE_CLASSES.back();
+
+struct SlabCache {
+	std::array<std::vector<std::uint8_t*>, SIZE_CLASSES.size()> blocks;
+
+	SlabCache() {
+		for(auto& list : blocks) {
+			list.reserve(MAX_CACHED_BLOCKS);
+		}
+	}
+
+	~SlabCache();
+};
+
+struct BuilderCache {
+	detail::BuilderHome* home;
+
+	BuilderCache();
+	~BuilderCache();
+};
+
+/*
+ * Builders & blocks can be released during thread exit after the caches
+ * have been destroyed (e.g. a builder held by another thread local), so
+ * these flags are checked before touching the caches
+ */
+thread_local bool slabs_destroyed = false;
+thread_local bool builders_destroyed = false;
+thread_local SlabCache slab_cache;
+thread_local BuilderCache builder_cache;
+
+SlabCache::~SlabCache() {
+	slabs_destroyed = true;
+
+	for(auto& list : blocks) {
+		for(auto block : list) {
+			::operator delete(block);
+		}
+	}
+}
+
+std::size_t size_class(const std::size_t size) {
+	for(std::size_t i = 0; i < SIZE_CLASSES.size(); ++i) {
+		if(size <= SIZE_CLASSES[i]) {
+			return i;
+		}
+	}
+
+	return SIZE_CLASSES.size();
+}
+
+} // unnamed
+
+namespace detail {
+
+/*
+ * Builders released on their creating thread go straight back into its
+ * cache. Any other thread pushes them onto the lock-free return list,
+ * which the owner drains once its cache runs dry. When the owner exits,
+ * it closes the list, and builders released after that are freed.
+ *
+ * Only single nodes are pushed, and the owner only takes the whole list,
+ * so the stack isn't subject to ABA. The home is refcounted by its thread
+ * and every builder created there, so it outlives the thread if needed.
+ */
+struct BuilderHome {
+	std::vector<PooledBuilder*> builders; // owning thread only
+	std::atomic<PooledBuilder*> returned { nullptr };
+	std::atomic<std::uint32_t> refs { 1 };
+
+	BuilderHome() {
+		builders.reserve(MAX_CACHED_BUILDERS);
+	}
+};
+
+} // detail
+
+namespace {
+
+char closed_tag;
+
+// marks a return list whose owner has exited, never dereferenced
+detail::PooledBuilder* closed() {
+	return reinterpret_cast<detail::PooledBuilder*>(&closed_tag);
+}
+
+void unref(detail::BuilderHome* home) {
+	if(home && home->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+		delete home;
+	}
+}
+
+void retire(detail::PooledBuilder* node) {
+	const auto home = node->home;
+	delete node;
+	unref(home);
+}
+
+// moves builders handed back by other threads into the owner's cache
+void reclaim(detail::BuilderHome& home) {
+	auto node = home.returned.exchange(nullptr, std::memory_order_acquire);
+
+	while(node) {
+		const auto next = node->next;
+
+		if(home.builders.size() < MAX_CACHED_BUILDERS) {
+			home.builders.emplace_back(node);
+		} else {
+			retire(node);
+		}
+
+		node = next;
+	}
+}
+
+BuilderCache::BuilderCache() : home(new detail::BuilderHome()) {}
+
+BuilderCache::~BuilderCache() {
+	builders_destroyed = true;
+	auto node = home->returned.exchange(closed(), std::memory_order_acquire);
+
+	while(node) {
+		const auto next = node->next;
+		retire(node);
+		node = next;
+	}
+
+	for(auto builder : home->builders) {
+		retire(builder);
+	}
+
+	home->builders.clear();
+	unref(home);
+}
+
+} // unnamed
+
+namespace detail {
+
+std::uint8_t* SlabAllocator::allocate(const std::size_t size) {
+	reserved_ += size;
+	const auto index = size_class(size);
+
+	if(index == SIZE_CLASSES.size()) {
+		return static_cast<std::uint8_t*>(::operator new(size));
+	}
+
+	if(!slabs_destroyed) {
+		auto& list = slab_cache.blocks[index];
+
+		if(!list.empty()) {
+			auto block = list.back();
+			list.pop_back();
+			return block;
+		}
+	}
+
+	return static_cast<std::uint8_t*>(::operator new(SIZE_CLASSES[index]));
+}
+
+void SlabAllocator::deallocate(std::uint8_t* p, const std::size_t size) {
+	reserved_ -= size;
+	const auto index = size_class(size);
+
+	if(index != SIZE_CLASSES.size() && !slabs_destroyed) {
+		auto& list = slab_cache.blocks[index];
+
+		if(list.size() < MAX_CACHED_BLOCKS) {
+			list.emplace_back(p);
+			return;
+		}
+	}
+
+	::operator delete(p);
+}
+
+void release(PooledBuilder* node) {
+	// don't allow a single large message to pin memory in the pool
+	if(node->allocator.reserved() > MAX_RETAINED_BYTES) {
+		node->fbb.Reset();
+	} else {
+		node->fbb.Clear();
+	}
+
+	const auto home = node->home;
+
+	if(!home) {
+		delete node;
+		return;
+	}
+
+	if(!builders_destroyed && home == builder_cache.home) {
+		if(home->builders.size() < MAX_CACHED_BUILDERS) {
+			home->builders.emplace_back(node);
+		} else {
+			retire(node);
+		}
+
+		return;
+	}
+
+	// another thread's builder, hand it back unless that thread has gone
+	auto head = home->returned.load(std::memory_order_relaxed);
+
+	do {
+		if(head == closed()) {
+			retire(node);
+			return;
+		}
+
+		node->next = head;
+	} while(!home->returned.compare_exchange_weak(head, node, std::memory_order_release,
+	                                              std::memory_order_relaxed));
+}
+
+} // detail
+
+BufferHandle make_buffer() {
+	// thread is exiting, the builder is freed on release
+	if(builders_destroyed) {
+		return BufferHandle(new detail::PooledBuilder(nullptr));
+	}
+
+	auto& home = *builder_cache.home;
+
+	if(home.builders.empty()) {
+		reclaim(home);
+	}
+
+	if(!home.builders.empty()) {
+		auto node = home.builders.back();
+		home.builders.pop_back();
+		return BufferHandle(node);
+	}
+
+	home.refs.fetch_add(1, std::memory_order_relaxed);
+	return BufferHandle(new detail::PooledBuilder(&home));
+}
+
+} // spark, ember
\ No newline at end of file
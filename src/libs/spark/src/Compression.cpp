@@ -0,0 +1,249 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <spark/Compression.h>
+#include <zlib.h>
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <utility>
+
+#if defined EMBER_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace ember::spark::inline v1 {
+
+namespace em = ember::messaging;
+namespace sc = std::chrono;
+
+namespace {
+
+// favour speed, these messages are compressed on the sending thread
+constexpr int ZLIB_LEVEL = Z_BEST_SPEED;
+constexpr int ZSTD_LEVEL = 1;
+
+sc::microseconds elapsed(const sc::steady_clock::time_point start) {
+	return sc::duration_cast<sc::microseconds>(sc::steady_clock::now() - start);
+}
+
+} // unnamed
+
+CompressionPolicy CompressionPolicy::supported() {
+	CompressionPolicy policy;
+
+#if defined EMBER_HAVE_ZSTD
+	policy.codecs.emplace_back(em::core::Codec::ZSTD);
+#endif
+	policy.codecs.emplace_back(em::core::Codec::ZLIB);
+	return policy;
+}
+
+namespace detail {
+
+struct Compressor::Contexts {
+	z_stream deflate{};
+	z_stream inflate{};
+
+#if defined EMBER_HAVE_ZSTD
+	ZSTD_CCtx* zstd_compress = nullptr;
+	ZSTD_DCtx* zstd_decompress = nullptr;
+#endif
+
+	Contexts() {
+		// raw streams, the envelope already records the size
+		if(deflateInit2(&deflate, ZLIB_LEVEL, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+			throw std::runtime_error("Unable to initialise deflate stream");
+		}
+
+		if(inflateInit2(&inflate, -MAX_WBITS) != Z_OK) {
+			deflateEnd(&deflate);
+			throw std::runtime_error("Unable to initialise inflate stream");
+		}
+
+#if defined EMBER_HAVE_ZSTD
+		zstd_compress = ZSTD_createCCtx();
+		zstd_decompress = ZSTD_createDCtx();
+#endif
+	}
+
+	~Contexts() {
+		deflateEnd(&deflate);
+		inflateEnd(&inflate);
+
+#if defined EMBER_HAVE_ZSTD
+		ZSTD_freeCCtx(zstd_compress);
+		ZSTD_freeDCtx(zstd_decompress);
+#endif
+	}
+};
+
+Compressor::Compressor(const CompressionPolicy& policy, const em::core::Codec codec)
+                       : codec_(codec), threshold_(policy.threshold),
+                         metrics_(policy.metrics? *policy.metrics : Metrics::null()),
+                         contexts_(std::make_unique<Contexts>()) { }
+
+Compressor::~Compressor() = default;
+
+bool Compressor::supported(const em::core::Codec codec) {
+	switch(codec) {
+		case em::core::Codec::ZLIB:
+			return true;
+#if defined EMBER_HAVE_ZSTD
+		case em::core::Codec::ZSTD:
+			return true;
+#endif
+		default:
+			return false;
+	}
+}
+
+em::core::Codec Compressor::select(const CompressionPolicy& policy,
+                                   const flatbuffers::Vector<std::uint8_t>* offered) {
+	if(!offered) {
+		return em::core::Codec::NONE;
+	}
+
+	for(const auto codec : policy.codecs) {
+		const auto value = std::to_underlying(codec);
+
+		if(supported(codec) && std::find(offered->begin(), offered->end(), value) != offered->end()) {
+			return codec;
+		}
+	}
+
+	return em::core::Codec::NONE;
+}
+
+bool Compressor::compressed(const std::uint8_t* data, const std::size_t size) {
+	return size >= flatbuffers::FlatBufferBuilder::kFileIdentifierLength + sizeof(flatbuffers::uoffset_t)
+		&& em::core::CompressedBufferHasIdentifier(data);
+}
+
+// lock_ must be held by the caller
+std::size_t Compressor::deflate(const std::uint8_t* data, const std::size_t size) {
+#if defined EMBER_HAVE_ZSTD
+	if(codec_ == em::core::Codec::ZSTD) {
+		deflated_.resize(ZSTD_compressBound(size));
+
+		const auto result = ZSTD_compressCCtx(contexts_->zstd_compress, deflated_.data(),
+		                                      deflated_.size(), data, size, ZSTD_LEVEL);
+		return ZSTD_isError(result)? 0 : result;
+	}
+#endif
+
+	auto& stream = contexts_->deflate;
+	deflateReset(&stream);
+	deflated_.resize(deflateBound(&stream, static_cast<uLong>(size)));
+
+	stream.next_in = const_cast<Bytef*>(data);
+	stream.avail_in = static_cast<uInt>(size);
+	stream.next_out = deflated_.data();
+	stream.avail_out = static_cast<uInt>(deflated_.size());
+
+	if(::deflate(&stream, Z_FINISH) != Z_STREAM_END) {
+		return 0;
+	}
+
+	return stream.total_out;
+}
+
+BufferHandle Compressor::compress(const BufferHandle& fbb) {
+	const auto size = fbb->GetSize();
+
+	if(codec_ == em::core::Codec::NONE || size < threshold_) {
+		return fbb;
+	}
+
+	std::lock_guard<std::mutex> guard(lock_);
+	const auto start = sc::steady_clock::now();
+	const auto deflated = deflate(fbb->GetBufferPointer(), size);
+
+	// not worth the receiver's time to decompress
+	if(!deflated || deflated >= size) {
+		++stats_.skipped;
+		return fbb;
+	}
+
+	auto out = make_buffer();
+	auto payload = out->CreateVector(deflated_.data(), deflated);
+	auto msg = em::core::CreateCompressed(*out, codec_, static_cast<std::uint32_t>(size), payload);
+	em::core::FinishCompressedBuffer(*out, msg);
+
+	++stats_.compressed;
+	stats_.bytes_in += size;
+	stats_.bytes_out += deflated;
+
+	metrics_.increment("spark.compression.bytes_in", size);
+	metrics_.increment("spark.compression.bytes_out", deflated);
+	metrics_.gauge("spark.compression.ratio", (size * 100) / deflated);
+	metrics_.timing("spark.compression.compress", elapsed(start));
+	return out;
+}
+
+// read path only
+bool Compressor::inflate(const em::core::Codec codec, const flatbuffers::Vector<std::uint8_t>& payload,
+                         const std::size_t size) {
+	inflated_.resize(size);
+
+#if defined EMBER_HAVE_ZSTD
+	if(codec == em::core::Codec::ZSTD) {
+		const auto result = ZSTD_decompressDCtx(contexts_->zstd_decompress, inflated_.data(),
+		                                        size, payload.data(), payload.size());
+		return !ZSTD_isError(result) && result == size;
+	}
+#endif
+
+	if(codec != em::core::Codec::ZLIB) {
+		return false;
+	}
+
+	auto& stream = contexts_->inflate;
+	inflateReset(&stream);
+
+	stream.next_in = const_cast<Bytef*>(payload.data());
+	stream.avail_in = payload.size();
+	stream.next_out = inflated_.data();
+	stream.avail_out = static_cast<uInt>(size);
+
+	return ::inflate(&stream, Z_FINISH) == Z_STREAM_END && stream.total_out == size;
+}
+
+std::span<const std::uint8_t> Compressor::decompress(const std::uint8_t* data, const std::size_t size,
+                                                     const std::size_t max_size) {
+	flatbuffers::Verifier verifier(data, size);
+
+	if(!em::core::VerifyCompressedBuffer(verifier)) {
+		return {};
+	}
+
+	const auto msg = em::core::GetCompressed(data);
+
+	// the size is checked before allocating anything, guards against decompression bombs
+	if(!msg->payload() || !msg->size() || msg->size() > max_size) {
+		return {};
+	}
+
+	const auto start = sc::steady_clock::now();
+
+	if(!inflate(msg->codec(), *msg->payload(), msg->size())) {
+		return {};
+	}
+
+	metrics_.timing("spark.compression.decompress", elapsed(start));
+	return { inflated_.data(), msg->size() };
+}
+
+auto Compressor::stats() -> Stats {
+	std::lock_guard<std::mutex> guard(lock_);
+	return stats_;
+}
+
+} // detail
+
+} // spark, ember
\ No newline at end of file
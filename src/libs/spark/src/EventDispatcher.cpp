@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2015, 2016 Ember
+ * Copyright (c) 2015 - 2022 Ember
  *
  * This Source Code Form is subject to the terms of the Mozilla Public
  * License, v. 2.0. If a copy of the MPL was not distributed with this
@@ -7,69 +7,117 @@
  */
 
 #include <spark/EventDispatcher.h>
-#include <mutex>
+#include <algorithm>
 
 namespace ember::spark::inline v1 {
 
-void EventDispatcher::register_handler(EventHandler* handler, messaging::Service service, Mode mode) {
-	std::unique_lock<std::shared_mutex> guard(lock_);
-	handlers_[service] = { mode, handler };
+EventDispatcher::EventDispatcher() {
+	auto table = std::make_unique<HandlerTable>();
+	table->fill({ Mode::BOTH, nullptr, 0 });
+	handlers_.store(table.get(), std::memory_order_release);
+	retired_.emplace_back(std::move(table));
+}
+
+// lock_ must be held by the caller
+void EventDispatcher::publish(std::unique_ptr<HandlerTable> table) {
+	handlers_.store(table.get(), std::memory_order_release);
+	retired_.emplace_back(std::move(table));
+}
+
+auto EventDispatcher::find(messaging::Service service) const -> const Handler* {
+	const auto index = static_cast<std::size_t>(std::to_underlying(service));
+
+	if(index >= MAX_SERVICES) {
+		return nullptr;
+	}
+
+	const auto& entry = (*handlers_.load(std::memory_order_acquire))[index];
+	return entry.handler? &entry : nullptr;
+}
+
+void EventDispatcher::register_handler(EventHandler* handler, messaging::Service service, Mode mode,
+                                       const std::uint32_t window) {
+	const auto index = static_cast<std::size_t>(std::to_underlying(service));
+
+	if(index >= MAX_SERVICES) {
+		return;
+	}
+
+	std::lock_guard<std::mutex> guard(lock_);
+	auto table = std::make_unique<HandlerTable>(*handlers_.load(std::memory_order_relaxed));
+	(*table)[index] = { mode, handler, window };
+	publish(std::move(table));
 }
 
 /* Remove by pointer rather than service to reduce the odds of making the
    mistake of removing a handler that doesn't belong to the caller */
 void EventDispatcher::remove_handler(const EventHandler* handler) {
-	std::unique_lock<std::shared_mutex> guard(lock_);
+	std::lock_guard<std::mutex> guard(lock_);
+	auto table = std::make_unique<HandlerTable>(*handlers_.load(std::memory_order_relaxed));
 	
-	for(auto& entry: handlers_) {
-		if(entry.second.handler == handler) {
-			handlers_.erase(entry.first);
+	for(auto& entry : *table) {
+		if(entry.handler == handler) {
+			entry.handler = nullptr;
+			publish(std::move(table));
 			break;
 		}
 	}
 }
 
 void EventDispatcher::notify_link_up(messaging::Service service, const Link& link) const {
-	std::lock_guard<std::shared_mutex> guard(lock_);
-
-	auto it = handlers_.find(service);
-
-	if(it != handlers_.end()) {
-		it->second.handler->on_link_up(link);
+	if(auto entry = find(service)) {
+		entry->handler->on_link_up(link);
 	}
 }
 
 void EventDispatcher::notify_link_down(messaging::Service service, const Link& link) const {
-	std::lock_guard<std::shared_mutex> guard(lock_);
-
-	auto it = handlers_.find(service);
-
-	if(it != handlers_.end()) {
-		it->second.handler->on_link_down(link);
+	if(auto entry = find(service)) {
+		entry->handler->on_link_down(link);
 	}
 }
 
 void EventDispatcher::dispatch_message(messaging::Service service, const Link& link,
                                        const Message& message) const {
-	std::unique_lock<std::shared_mutex> guard(lock_);
-	auto it = handlers_.find(service);
-
-	if(it != handlers_.end()) {
-		it->second.handler->on_message(link, message);
+	if(auto entry = find(service)) {
+		entry->handler->on_message(link, message);
 	}
 } 
 
 std::vector<messaging::Service> EventDispatcher::services(Mode mode) const {
-	std::shared_lock<std::shared_mutex> guard(lock_);
+	const auto table = handlers_.load(std::memory_order_acquire);
 	std::vector<messaging::Service> services;
 
-	for(auto& handler : handlers_) {
-		if(handler.second.mode == mode || handler.second.mode == Mode::BOTH) {
-			services.emplace_back(handler.first);
+	for(std::size_t i = 0; i < table->size(); ++i) {
+		const auto& entry = (*table)[i];
+
+		if(entry.handler && (entry.mode == mode || entry.mode == Mode::BOTH)) {
+			services.emplace_back(static_cast<messaging::Service>(i));
 		}
 	}
 
 	return services;
 }
 
+// core services are excluded, their messages are never held back
+std::uint32_t EventDispatcher::window() const {
+	const auto table = handlers_.load(std::memory_order_acquire);
+	std::uint32_t window = 0;
+
+	for(std::size_t i = 0; i < table->size(); ++i) {
+		const auto service = static_cast<messaging::Service>(i);
+
+		if(service == messaging::Service::CORE_HEARTBEAT || service == messaging::Service::CORE_TRACKING) {
+			continue;
+		}
+
+		const auto& entry = (*table)[i];
+
+		if(entry.handler) {
+			window = std::max(window, entry.window);
+		}
+	}
+
+	return window;
+}
+
 } // spark, ember
@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <spark/FailureDetector.h>
+#include <algorithm>
+#include <cmath>
+
+namespace ember::spark::inline v1 {
+
+namespace sc = std::chrono;
+
+namespace {
+
+double to_ms(const detail::FailureDetector::Clock::duration duration) {
+	return sc::duration<double, std::milli>(duration).count();
+}
+
+} // unnamed
+
+namespace detail {
+
+FailureDetector::FailureDetector(const Clock::time_point now)
+                                 : latest_(now.time_since_epoch().count()), recorded_(now) {
+	// seeded with a spread around the heartbeat interval so a peer that never speaks can still fail
+	const auto expected = to_ms(EXPECTED_INTERVAL);
+	record(expected * 0.75);
+	record(expected * 1.25);
+}
+
+// lock_ must be held by the caller, other than during construction
+void FailureDetector::record(const double interval) {
+	if(count_ == WINDOW) {
+		const auto oldest = intervals_[next_];
+		sum_ -= oldest;
+		sum_squares_ -= oldest * oldest;
+	} else {
+		++count_;
+	}
+
+	intervals_[next_] = interval;
+	next_ = (next_ + 1) % WINDOW;
+	sum_ += interval;
+	sum_squares_ += interval * interval;
+}
+
+void FailureDetector::arrival(const Clock::time_point now) {
+	latest_.store(now.time_since_epoch().count(), std::memory_order_relaxed);
+
+	if(now - recorded_ < MIN_INTERVAL) {
+		return;
+	}
+
+	const auto interval = to_ms(now - recorded_);
+	recorded_ = now;
+
+	std::lock_guard<std::mutex> guard(lock_);
+	record(interval);
+}
+
+/*
+ * Uses the logistic approximation of the normal CDF from Akka's
+ * implementation, which avoids needing erf and is accurate enough here
+ */
+double FailureDetector::phi(const Clock::time_point now) const {
+	const auto elapsed = to_ms(now - latest());
+	double mean = 0.0, variance = 0.0;
+
+	{
+		std::lock_guard<std::mutex> guard(lock_);
+		mean = sum_ / count_;
+		variance = (sum_squares_ / count_) - (mean * mean);
+	}
+
+	const auto stddev = std::max(std::sqrt(std::max(variance, 0.0)), to_ms(MIN_STDDEV));
+	mean += to_ms(ACCEPTABLE_PAUSE);
+
+	const auto y = (elapsed - mean) / stddev;
+	const auto e = std::exp(-y * (1.5976 + 0.070566 * y * y));
+
+	if(elapsed > mean) {
+		return -std::log10(e / (1.0 + e));
+	}
+
+	return -std::log10(1.0 - 1.0 / (1.0 + e));
+}
+
+auto FailureDetector::latest() const -> Clock::time_point {
+	return Clock::time_point(Clock::duration(latest_.load(std::memory_order_relaxed)));
+}
+
+} // detail
+
+} // spark, ember
\ No newline at end of file
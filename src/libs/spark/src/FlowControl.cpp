@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <spark/FlowControl.h>
+
+namespace ember::spark::inline v1 {
+
+// sets the window we grant to the peer, returning the initial grant
+std::uint32_t FlowControl::open(const std::uint32_t window) {
+	window_.store(window, std::memory_order_relaxed);
+	granted_.store(consumed_.load(std::memory_order_relaxed) + window, std::memory_order_relaxed);
+	return window;
+}
+
+/*
+ * Called once a message has been handled. Returns the new grant for the peer
+ * once it's used half of its window, otherwise there's nothing to send.
+ */
+std::optional<std::uint64_t> FlowControl::consume() {
+	const auto window = window_.load(std::memory_order_relaxed);
+
+	if(!window) {
+		return std::nullopt;
+	}
+
+	const auto consumed = consumed_.fetch_add(1, std::memory_order_relaxed) + 1;
+	const auto granted = granted_.load(std::memory_order_relaxed);
+
+	// a peer that overran its window gets topped up too, it's not worth dropping the link over
+	if(consumed < granted && granted - consumed > window / 2) {
+		return std::nullopt;
+	}
+
+	const auto limit = consumed + window;
+	granted_.store(limit, std::memory_order_relaxed);
+	return limit;
+}
+
+std::uint64_t FlowControl::granted() const {
+	return granted_.load(std::memory_order_relaxed);
+}
+
+auto FlowControl::stats() const -> Stats {
+	std::lock_guard<std::mutex> guard(lock_);
+
+	return {
+		.sent = sent_,
+		.limit = limit_,
+		.backlog = backlog_.size(),
+		.queued = queued_,
+		.would_block = would_block_,
+		.dropped = dropped_,
+		.consumed = consumed_.load(std::memory_order_relaxed),
+		.granted = granted_.load(std::memory_order_relaxed)
+	};
+}
+
+} // spark, ember
\ No newline at end of file
@@ -8,9 +8,14 @@
 
 #include <spark/HeartbeatService.h>
 #include <spark/Service.h>
+#include <spark/NetworkSession.h>
 #include <shared/FilterTypes.h>
 #include <boost/uuid/uuid_io.hpp>
+#include <algorithm>
+#include <cctype>
+#include <memory>
 #include <utility>
+#include <vector>
 
 namespace ember::spark::inline v1 {
 
@@ -18,78 +23,124 @@ namespace em = ember::messaging;
 namespace sc = std::chrono;
 using namespace std::placeholders;
 
+namespace {
+
+// peer descriptions can contain anything, metric keys can't
+std::string rtt_key(const Link& link) {
+	std::string key = "spark.heartbeat.rtt." + link.description;
+
+	std::replace_if(key.begin(), key.end(), [](const unsigned char c) {
+		return !std::isalnum(c) && c != '.' && c != '-' && c != '_';
+	}, '_');
+
+	return key;
+}
+
+} // unnamed
+
 HeartbeatService::HeartbeatService(boost::asio::io_context& io_context, const Service* service,
-                                   log::Logger* logger) : timer_(io_context),
-                                   service_(service), logger_(logger) {
-	REGISTER(em::core::Opcode::MSG_PING, em::core::Ping, HeartbeatService::handle_ping);
-	REGISTER(em::core::Opcode::MSG_PONG, em::core::Pong, HeartbeatService::handle_pong);
+                                   log::Logger* logger, Metrics* metrics) : timer_(io_context),
+                                   service_(service), logger_(logger),
+                                   metrics_(metrics? *metrics : Metrics::null()) {
+	handlers_.add<em::core::Opcode::MSG_PING, &HeartbeatService::handle_ping>(this);
+	handlers_.add<em::core::Opcode::MSG_PONG, &HeartbeatService::handle_pong>(this);
+	handlers_.add<em::core::Opcode::MSG_CREDIT, &HeartbeatService::handle_credit>(this);
 	set_timer();
 }
 
 void HeartbeatService::on_message(const Link& link, const Message& message) {
-	auto handler = handlers_.find(static_cast<messaging::core::Opcode>(message.opcode));
+	const auto result = handlers_.dispatch(link, message);
 
-	if(handler == handlers_.end()) {
+	if(result == em::core::DispatchTable::Result::UNHANDLED) {
 		LOG_WARN_FILTER(logger_, LF_SPARK)
-			<< "[spark] Unhandled message received by core from "
+			<< "[spark] Unhandled message received by core from "_lit
 			<< link.description << LOG_ASYNC;
-		return;
-	}
-
-	if(!handler->second.verify(message)) {
+	} else if(result == em::core::DispatchTable::Result::BAD_MESSAGE) {
 		LOG_WARN_FILTER(logger_, LF_SPARK)
-			<< "[spark] Bad message received by core from "
+			<< "[spark] Bad message received by core from "_lit
 			<< link.description << LOG_ASYNC;
-		return;
 	}
-
-	handler->second.handle(link, message);
 }
 
 void HeartbeatService::on_link_up(const Link& link) {
 	std::lock_guard<std::mutex> guard(lock_);
-	peers_.emplace_front(link);
+	peers_.emplace_front(Peer { link, rtt_key(link), sc::steady_clock::now() });
 }
 
 void HeartbeatService::on_link_down(const Link& link) {
 	std::lock_guard<std::mutex> guard(lock_);
-	peers_.remove(link);
+	peers_.remove_if([&](const Peer& peer) { return peer.link == link; });
 }
 
-void HeartbeatService::handle_ping(const Link& link, const Message& message) {
-	auto ping = flatbuffers::GetRoot<em::core::Ping>(message.data);
-	send_pong(link, ping->timestamp());
+void HeartbeatService::handle_ping(const Link& link, const Message& /*message*/,
+                                   const em::core::Ping& ping) {
+	apply_credit(link, ping.credits());
+	send_pong(link, ping.timestamp());
 }
 
-void HeartbeatService::handle_pong(const Link& link, const Message& message) {
-	auto pong = flatbuffers::GetRoot<em::core::Pong>(message.data);
-	auto time = sc::duration_cast<sc::milliseconds>(sc::steady_clock::now().time_since_epoch()).count();
+void HeartbeatService::handle_pong(const Link& link, const Message& /*message*/,
+                                   const em::core::Pong& pong) {
+	apply_credit(link, pong.credits());
+	auto time = sc::duration_cast<sc::microseconds>(sc::steady_clock::now().time_since_epoch()).count();
+
+	if(pong.timestamp()) {
+		const auto latency = sc::microseconds(time - pong.timestamp());
+
+		if(auto net = link.net.lock()) {
+			net->record_rtt(latency);
+		}
+
+		std::unique_lock<std::mutex> guard(lock_);
 
-	if(pong->timestamp()) {
-		auto latency = std::chrono::milliseconds(time - pong->timestamp());
+		const auto peer = std::find_if(peers_.begin(), peers_.end(), [&](const Peer& peer) {
+			return peer.link == link;
+		});
+
+		if(peer != peers_.end()) {
+			metrics_.timing(peer->rtt_key.c_str(), latency);
+		}
+
+		guard.unlock();
 
 		if(latency > LATENCY_WARN_THRESHOLD) {
 			LOG_WARN_FILTER(logger_, LF_SPARK)
-				<< "[spark] Detected high latency to " << link.description
-				<< ":" << boost::uuids::to_string(link.uuid) << LOG_ASYNC;
+				<< "[spark] Detected high latency to "_lit << link.description
+				<< ":"_lit << boost::uuids::to_string(link.uuid) << LOG_ASYNC;
 		}
 	}
 }
 
-void HeartbeatService::send_ping(const Link& link, std::uint64_t time) {
-	auto fbb = std::make_shared<flatbuffers::FlatBufferBuilder>();
-	std::uint16_t opcode = std::to_underlying(messaging::core::Opcode::MSG_PING);
-	auto msg = messaging::core::CreatePing(*fbb, time);
+void HeartbeatService::handle_credit(const Link& link, const Message& /*message*/,
+                                     const em::core::Credit& credit) {
+	apply_credit(link, credit.credits());
+}
+
+void HeartbeatService::apply_credit(const Link& link, std::uint64_t credits) {
+	if(auto net = link.net.lock()) {
+		net->grant(credits);
+	}
+}
+
+/* Core messages are written directly rather than through the service, as
+   they must not be held back by, or count against, the link's window */
+void HeartbeatService::send_ping(NetworkSession& net, std::uint64_t time) {
+	auto fbb = make_buffer();
+	auto msg = messaging::core::CreatePing(*fbb, time, net.flow().granted());
 	fbb->Finish(msg);
-	service_->send(link, opcode, fbb);
+	net.write(fbb);
 }
 
 void HeartbeatService::send_pong(const Link& link, std::uint64_t time) {
-	auto fbb = std::make_shared<flatbuffers::FlatBufferBuilder>();
-	std::uint16_t opcode = std::to_underlying(messaging::core::Opcode::MSG_PONG);
-	auto msg = messaging::core::CreatePong(*fbb, time);
+	auto net = link.net.lock();
+
+	if(!net) {
+		return;
+	}
+
+	auto fbb = make_buffer();
+	auto msg = messaging::core::CreatePong(*fbb, time, net->flow().granted());
 	fbb->Finish(msg);
-	service_->send(link, opcode, fbb);
+	net->write(fbb);
 }
 
 void HeartbeatService::trigger_pings(const boost::system::error_code& ec) {
@@ -99,20 +150,55 @@ void HeartbeatService::trigger_pings(const boost::system::error_code& ec) {
 
 	// generate the time once for all pings
 	// not quite as accurate as per-ping but slightly more efficient
-	auto time = sc::duration_cast<sc::milliseconds>(
-		sc::steady_clock::now().time_since_epoch()).count();
+	const auto now = sc::steady_clock::now();
+	auto time = sc::duration_cast<sc::microseconds>(now.time_since_epoch()).count();
 
-	std::lock_guard<std::mutex> guard(lock_);
+	// closed outside of the lock, the link down notifications come back through here
+	std::vector<std::shared_ptr<NetworkSession>> failed;
+
+	{
+		std::lock_guard<std::mutex> guard(lock_);
+
+		for(auto& peer : peers_) {
+			auto net = peer.link.net.lock();
+
+			if(!net) {
+				continue;
+			}
+
+			if(net->detector().phi(now) >= FAILURE_THRESHOLD) {
+				LOG_WARN_FILTER(logger_, LF_SPARK)
+					<< "[spark] Peer suspected dead, closing link to "_lit << peer.link.description
+					<< ":"_lit << boost::uuids::to_string(peer.link.uuid) << LOG_ASYNC;
+
+				metrics_.increment("spark.heartbeat.failures");
+				failed.emplace_back(std::move(net));
+				continue;
+			}
+
+			const auto idle = now - net->last_sent() >= IDLE_PERIOD && now - peer.last_ping >= IDLE_PERIOD;
+
+			if(idle || now - peer.last_ping >= PING_FREQUENCY) {
+				send_ping(*net, time);
+				peer.last_ping = now;
+			}
+		}
+
+		// only suspect each link once, it'll be going down shortly
+		peers_.remove_if([&](const Peer& peer) {
+			return std::find(failed.begin(), failed.end(), peer.link.net.lock()) != failed.end();
+		});
+	}
 
-	for(auto& link : peers_) {
-		send_ping(link, time);
+	for(auto& net : failed) {
+		net->close_session();
 	}
 
 	set_timer();
 }
 
 void HeartbeatService::set_timer() {
-	timer_.expires_from_now(PING_FREQUENCY);
+	timer_.expires_from_now(TICK_FREQUENCY);
 	timer_.async_wait([&](auto ec) {
 		trigger_pings(ec);
 	});
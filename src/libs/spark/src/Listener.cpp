@@ -16,11 +16,13 @@ namespace ember::spark::inline v1 {
 
 Listener::Listener(boost::asio::io_context& service, std::string interface, std::uint16_t port, 
                    SessionManager& sessions, const EventDispatcher& handlers, ServicesMap& services,
-                   const Link& link, log::Logger* logger)
+                   const Link& link, Transport transport, const CompressionPolicy& compression,
+                   const BatchPolicy& batching, log::Logger* logger)
                    : service_(service), acceptor_(service, boost::asio::ip::tcp::endpoint(
                      boost::asio::ip::address::from_string(interface), port)), link_(link),
                      socket_(boost::asio::make_strand(service_)), sessions_(sessions), logger_(logger),
-                     handlers_(handlers), services_(services) {
+                     handlers_(handlers), services_(services), transport_(transport),
+                     compression_(compression), batching_(batching) {
 	acceptor_.set_option(boost::asio::ip::tcp::no_delay(true));
 	acceptor_.set_option(boost::asio::ip::tcp::acceptor::reuse_address(true));
 	accept_connection();
@@ -39,10 +41,10 @@ void Listener::accept_connection() {
 
 			if(ec) {
 				LOG_DEBUG_FILTER(logger_, LF_SPARK)
-					<< "[spark] Aborted connection attempt" << LOG_ASYNC;
+					<< "[spark] Aborted connection attempt"_lit << LOG_ASYNC;
 			} else {
 				LOG_DEBUG_FILTER(logger_, LF_SPARK)
-					<< "[spark] Accepted connection from " << ep.address().to_string() << LOG_ASYNC;
+					<< "[spark] Accepted connection from "_lit << ep.address().to_string() << LOG_ASYNC;
 
 				start_session(std::move(socket_), ep);
 				socket_ = boost::asio::ip::tcp::socket(boost::asio::make_strand(service_));
@@ -55,13 +57,13 @@ void Listener::accept_connection() {
 
 void Listener::start_session(boost::asio::ip::tcp::socket socket, boost::asio::ip::tcp::endpoint ep) {
 	LOG_TRACE_FILTER(logger_, LF_SPARK) << __func__ << LOG_ASYNC;
-	MessageHandler m_handler(handlers_, services_, link_, false, logger_);
-	auto session = std::make_shared<NetworkSession>(sessions_, std::move(socket), ep, m_handler, logger_);
+	MessageHandler m_handler(handlers_, services_, link_, false, logger_, &compression_, &batching_);
+	auto session = make_session(transport_, sessions_, std::move(socket), ep, m_handler, logger_);
 	sessions_.start(session);
 }
 
 void Listener::shutdown() {
-	LOG_DEBUG_FILTER(logger_, LF_SPARK) << "[spark] Listener shutting down..." << LOG_ASYNC;
+	LOG_DEBUG_FILTER(logger_, LF_SPARK) << "[spark] Listener shutting down..."_lit << LOG_ASYNC;
 	acceptor_.close();
 }
 
@@ -0,0 +1,246 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <spark/LoadBalancer.h>
+#include <spark/NetworkSession.h>
+#include <shared/FilterTypes.h>
+#include <algorithm>
+#include <random>
+#include <utility>
+
+namespace ember::spark::inline v1 {
+
+namespace {
+
+std::size_t random_index(const std::size_t bound) {
+	thread_local std::minstd_rand engine(std::random_device{}());
+	return std::uniform_int_distribution<std::size_t>(0, bound - 1)(engine);
+}
+
+// zero until the link's first heartbeat round trip
+std::chrono::microseconds rtt(const Link& link) {
+	if(auto net = link.net.lock()) {
+		return net->rtt();
+	}
+
+	return std::chrono::microseconds::zero();
+}
+
+/*
+ * Expected wait for a new request if each in flight is served one after
+ * the other, which favours a nearby peer until its queue builds up. Falls
+ * back to comparing in-flight counts until both peers have been measured.
+ */
+bool less_loaded(const ServicesMap::Peer& lhs, const ServicesMap::Peer& rhs) {
+	const auto lhs_load = lhs.in_flight.load(std::memory_order_relaxed);
+	const auto rhs_load = rhs.in_flight.load(std::memory_order_relaxed);
+	const auto lhs_rtt = rtt(lhs.link);
+	const auto rhs_rtt = rtt(rhs.link);
+
+	if(lhs_rtt.count() && rhs_rtt.count()) {
+		return (lhs_load + 1) * lhs_rtt < (rhs_load + 1) * rhs_rtt;
+	}
+
+	return lhs_load < rhs_load;
+}
+
+} // unnamed
+
+LoadBalancer::LoadBalancer(Service& spark, messaging::Service service, log::Logger* logger)
+                           : spark_(spark), services_(*spark.services()), service_(service),
+                             logger_(logger) { }
+
+LoadBalancer::Lease::Lease(std::shared_ptr<ServicesMap::Peer> peer) : peer_(std::move(peer)) {
+	if(peer_) {
+		link_ = peer_->link;
+		peer_->in_flight.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+auto LoadBalancer::Lease::operator=(Lease&& rhs) noexcept -> Lease& {
+	if(this != &rhs) {
+		if(peer_) {
+			peer_->in_flight.fetch_sub(1, std::memory_order_relaxed);
+		}
+
+		peer_ = std::move(rhs.peer_);
+		link_ = std::move(rhs.link_);
+	}
+
+	return *this;
+}
+
+LoadBalancer::Lease::~Lease() {
+	if(peer_) {
+		peer_->in_flight.fetch_sub(1, std::memory_order_relaxed);
+	}
+}
+
+bool LoadBalancer::tried(const Tried& tried, const Peer* peer) {
+	return std::any_of(tried.begin(), tried.end(), [&](const auto& entry) {
+		return entry.get() == peer;
+	});
+}
+
+auto LoadBalancer::by_load(const ServicesMap::PeerSet& set, const Tried& excluded)
+                           -> std::shared_ptr<Peer> {
+	const auto count = set.peers.size();
+	std::shared_ptr<Peer> best;
+
+	// two distinct samples, unless there's only the one peer
+	const auto first = random_index(count);
+	const auto second = count > 1? (first + 1 + random_index(count - 1)) % count : first;
+
+	for(const auto start : { first, second }) {
+
+		// walk forward from the sample if it's already been tried
+		for(std::size_t i = 0; i < count; ++i) {
+			const auto& peer = set.peers[(start + i) % count];
+
+			if(tried(excluded, peer.get())) {
+				continue;
+			}
+
+			if(!best || less_loaded(*peer, *best)) {
+				best = peer;
+			}
+
+			break;
+		}
+	}
+
+	return best;
+}
+
+auto LoadBalancer::by_key(const ServicesMap::PeerSet& set, const std::uint64_t key,
+                          const Tried& excluded) -> std::shared_ptr<Peer> {
+	if(set.ring.empty()) {
+		return nullptr;
+	}
+
+	const auto point = ServicesMap::hash_point(key);
+	auto it = std::lower_bound(set.ring.begin(), set.ring.end(), point, [](const auto& lhs, auto rhs) {
+		return lhs.first < rhs;
+	});
+
+	// walk clockwise until reaching a peer that hasn't been tried
+	for(std::size_t i = 0; i < set.ring.size(); ++i, ++it) {
+		if(it == set.ring.end()) {
+			it = set.ring.begin();
+		}
+
+		const auto& peer = set.peers[it->second];
+
+		if(!tried(excluded, peer.get())) {
+			return peer;
+		}
+	}
+
+	return nullptr;
+}
+
+std::optional<Link> LoadBalancer::pick() const {
+	const auto set = services_.snapshot(service_, ServicesMap::Mode::SERVER);
+
+	if(set->peers.empty()) {
+		return std::nullopt;
+	}
+
+	return by_load(*set, {})->link;
+}
+
+std::optional<Link> LoadBalancer::pick(const std::uint64_t key) const {
+	const auto set = services_.snapshot(service_, ServicesMap::Mode::SERVER);
+	
+	if(auto peer = by_key(*set, key, {})) {
+		return peer->link;
+	}
+
+	return std::nullopt;
+}
+
+auto LoadBalancer::lease() const -> Lease {
+	const auto set = services_.snapshot(service_, ServicesMap::Mode::SERVER);
+
+	if(set->peers.empty()) {
+		return Lease();
+	}
+
+	return Lease(by_load(*set, {}));
+}
+
+auto LoadBalancer::lease(const std::uint64_t key) const -> Lease {
+	const auto set = services_.snapshot(service_, ServicesMap::Mode::SERVER);
+	return Lease(by_key(*set, key, {}));
+}
+
+std::size_t LoadBalancer::peers() const {
+	return services_.snapshot(service_, ServicesMap::Mode::SERVER)->peers.size();
+}
+
+auto LoadBalancer::send(const std::optional<std::uint64_t> key, const std::uint16_t opcode,
+                        const BufferHandle& fbb, const TrackingHandler& callback,
+                        const Resend resend, Tried excluded, std::size_t attempt) const
+                        -> Service::Result {
+	const auto set = services_.snapshot(service_, ServicesMap::Mode::SERVER);
+	auto result = Service::Result::LINK_GONE;
+
+	for(; attempt < MAX_ATTEMPTS; ++attempt) {
+		auto peer = key? by_key(*set, *key, excluded) : by_load(*set, excluded);
+
+		if(!peer) {
+			break;
+		}
+
+		// held rather than compared by address, a freed peer's address could be reused
+		excluded[attempt] = peer;
+		peer->in_flight.fetch_add(1, std::memory_order_relaxed);
+
+		result = spark_.send(peer->link, opcode, fbb,
+			[this, peer, key, opcode, fbb, callback, resend, excluded, attempt]
+			(const Link& link, std::optional<Message> message) {
+				peer->in_flight.fetch_sub(1, std::memory_order_relaxed);
+
+				// the link went down before replying, the set no longer contains it
+				if(!message && resend == Resend::ON_LINK_LOSS
+				   && !peer->healthy.load(std::memory_order_acquire)) {
+					LOG_DEBUG_FILTER(logger_, LF_SPARK)
+						<< "[spark] Lost link to "_lit << link.description
+						<< ", retrying request elsewhere"_lit << LOG_ASYNC;
+
+					// carry the peers already tried over, so none of them are picked again
+					if(Service::accepted(send(key, opcode, fbb, callback, resend, excluded, attempt + 1))) {
+						return;
+					}
+				}
+
+				callback(link, std::move(message));
+			}
+		);
+
+		if(Service::accepted(result)) {
+			break;
+		}
+
+		peer->in_flight.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	return result;
+}
+
+auto LoadBalancer::send(const std::uint16_t opcode, BufferHandle fbb, TrackingHandler callback,
+                        const Resend resend) const -> Service::Result {
+	return send(std::nullopt, opcode, fbb, callback, resend, {}, 0);
+}
+
+auto LoadBalancer::send(const std::uint64_t key, const std::uint16_t opcode, BufferHandle fbb,
+                        TrackingHandler callback, const Resend resend) const -> Service::Result {
+	return send(std::optional(key), opcode, fbb, callback, resend, {}, 0);
+}
+
+} // spark, ember
\ No newline at end of file
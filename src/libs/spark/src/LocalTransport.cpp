@@ -0,0 +1,205 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <spark/LocalTransport.h>
+#include <spark/LocalSession.h>
+#include <spark/ShmSession.h>
+#include <spark/MessageHandler.h>
+#include <spark/SessionManager.h>
+#include <shared/FilterTypes.h>
+#include <boost/asio/ip/address.hpp>
+#include <map>
+#include <mutex>
+#include <utility>
+
+namespace ember::spark::inline v1 {
+
+namespace {
+
+using Registry = std::map<std::pair<std::string, std::uint16_t>, LocalTransport*>;
+
+/*
+ * Every service in the process, keyed by the address it listens on. The
+ * lock is also held while a pair of sessions is set up, so neither service
+ * can go away part way through.
+ */
+std::mutex& registry_lock() {
+	static std::mutex lock;
+	return lock;
+}
+
+Registry& registry() {
+	static Registry services;
+	return services;
+}
+
+bool is_loopback(const std::string& host) {
+	if(host == "localhost") {
+		return true;
+	}
+
+	boost::system::error_code ec;
+	const auto address = boost::asio::ip::make_address(host, ec);
+	return !ec && address.is_loopback();
+}
+
+} // unnamed
+
+LocalTransport::LocalTransport(boost::asio::io_context& service, std::string interface,
+                               std::uint16_t port, SessionManager& sessions,
+                               const EventDispatcher& handlers, ServicesMap& services,
+                               const Link& link, log::Logger* logger)
+                               : service_(service), interface_(std::move(interface)), port_(port),
+                                 sessions_(sessions), handlers_(handlers), services_(services),
+                                 link_(link), logger_(logger), registered_(false) {
+	{
+		std::lock_guard guard(registry_lock());
+		registered_ = registry().try_emplace({ interface_, port_ }, this).second;
+	}
+
+#if defined __linux__
+	auto on_accept = [this](ShmAcceptor::LocalSocket socket, std::unique_ptr<detail::ShmSegment> segment) {
+		MessageHandler m_handler(handlers_, services_, link_, false, logger_);
+		auto session = std::make_shared<ShmSession>(sessions_, std::move(socket), std::move(segment),
+		                                            false, m_handler, logger_);
+		sessions_.start(session);
+	};
+
+	// not fatal, peers on this host will just have to use TCP
+	try {
+		shm_acceptor_ = std::make_unique<ShmAcceptor>(service_, port_, std::move(on_accept), logger_);
+	} catch(const boost::system::system_error& e) {
+		LOG_WARN_FILTER(logger_, LF_SPARK)
+			<< "[spark] Shared memory transport unavailable: "_lit << e.what() << LOG_ASYNC;
+	}
+#endif
+}
+
+LocalTransport::~LocalTransport() {
+	unregister();
+}
+
+void LocalTransport::unregister() {
+	std::lock_guard guard(registry_lock());
+
+	if(registered_) {
+		registry().erase({ interface_, port_ });
+		registered_ = false;
+	}
+}
+
+bool LocalTransport::connect(const std::string& host, const std::uint16_t port,
+                             ConnectHandler handler) {
+	LOG_TRACE_FILTER(logger_, LF_SPARK) << __func__ << LOG_ASYNC;
+
+	if(auto session = connect_in_process(host, port)) {
+		LOG_DEBUG_FILTER(logger_, LF_SPARK)
+			<< "[spark] Established in-process connection to "_lit << host << ":"_lit << port << LOG_ASYNC;
+		handler(std::move(session));
+		return true;
+	}
+
+	return connect_shared_memory(host, port, std::move(handler));
+}
+
+std::shared_ptr<NetworkSession> LocalTransport::connect_in_process(const std::string& host,
+                                                                   const std::uint16_t port) {
+	std::lock_guard guard(registry_lock());
+	auto it = registry().find({ host, port });
+
+	// a service listening on every interface is reachable through loopback
+	if(it == registry().end() && is_loopback(host)) {
+		it = registry().find({ "0.0.0.0", port });
+	}
+
+	if(it == registry().end()) {
+		return nullptr;
+	}
+
+	auto& remote = *it->second;
+	MessageHandler local_handler(handlers_, services_, link_, true, logger_);
+	MessageHandler remote_handler(remote.handlers_, remote.services_, remote.link_, false, remote.logger_);
+
+	auto local = std::make_shared<LocalSession>(sessions_, service_, local_handler, logger_);
+	auto peer = std::make_shared<LocalSession>(remote.sessions_, remote.service_,
+	                                           remote_handler, remote.logger_);
+	LocalSession::pair(local, peer);
+
+	remote.sessions_.start(peer);
+	sessions_.start(local);
+	return local;
+}
+
+bool LocalTransport::connect_shared_memory(const std::string& host, const std::uint16_t port,
+                                           ConnectHandler handler) {
+#if defined __linux__
+	if(!is_loopback(host)) {
+		return false;
+	}
+
+	auto socket = std::make_shared<ShmAcceptor::LocalSocket>(service_);
+
+	socket->async_connect(ShmAcceptor::endpoint(port),
+		[this, socket, host, port, handler = std::move(handler)](boost::system::error_code ec) {
+			if(ec) {
+				handler(nullptr);
+				return;
+			}
+
+			// anybody can bind the abstract name, so make sure it's one of ours
+			if(!detail::same_user(socket->native_handle())) {
+				LOG_WARN_FILTER(logger_, LF_SPARK)
+					<< "[spark] Shared memory listener for "_lit << host << ":"_lit << port
+					<< " belongs to another user, ignoring"_lit << LOG_ASYNC;
+				handler(nullptr);
+				return;
+			}
+
+			auto segment = detail::ShmSegment::create();
+
+			if(!segment) {
+				LOG_WARN_FILTER(logger_, LF_SPARK)
+					<< "[spark] Unable to create shared memory segment"_lit << LOG_ASYNC;
+				handler(nullptr);
+				return;
+			}
+
+			if(!detail::send_descriptors(socket->native_handle(), segment->descriptors())) {
+				handler(nullptr);
+				return;
+			}
+
+			MessageHandler m_handler(handlers_, services_, link_, true, logger_);
+			auto session = std::make_shared<ShmSession>(sessions_, std::move(*socket),
+			                                            std::move(segment), true, m_handler, logger_);
+			sessions_.start(session);
+
+			LOG_DEBUG_FILTER(logger_, LF_SPARK)
+				<< "[spark] Established shared memory connection to "_lit << host << ":"_lit << port << LOG_ASYNC;
+
+			handler(std::move(session));
+		});
+
+	return true;
+#else
+	return false;
+#endif
+}
+
+void LocalTransport::shutdown() {
+	LOG_DEBUG_FILTER(logger_, LF_SPARK) << "[spark] Local transport shutting down..."_lit << LOG_ASYNC;
+	unregister();
+
+#if defined __linux__
+	if(shm_acceptor_) {
+		shm_acceptor_->shutdown();
+	}
+#endif
+}
+
+} // spark, ember
\ No newline at end of file
@@ -8,6 +8,7 @@
 
 #include "Core_generated.h"
 #include <spark/Service.h>
+#include <spark/DispatchTable.h>
 #include <spark/MessageHandler.h>
 #include <spark/EventDispatcher.h>
 #include <spark/NetworkSession.h>
@@ -23,18 +24,38 @@
 namespace ember::spark::inline v1 {
 
 MessageHandler::MessageHandler(const EventDispatcher& dispatcher, ServicesMap& services, const Link& link,
-                               bool initiator, log::Logger* logger)
+                               bool initiator, log::Logger* logger,
+                               const CompressionPolicy* compression, const BatchPolicy* batching)
                                : dispatcher_(dispatcher), self_(link), initiator_(initiator),
-                                 logger_(logger), services_(services), peer_{} { }
+                                 logger_(logger), services_(services), peer_{},
+                                 compression_(compression), batching_(batching) { }
 
 
 void MessageHandler::send_negotiation(NetworkSession& net) {
 	LOG_TRACE_FILTER(logger_, LF_SPARK) << __func__ << LOG_ASYNC;
 
-	auto fbb = std::make_shared<flatbuffers::FlatBufferBuilder>();
+	auto fbb = make_buffer();
 	auto in = fbb->CreateVector(detail::services_to_underlying(dispatcher_.services(EventDispatcher::Mode::SERVER)));
 	auto out = fbb->CreateVector(detail::services_to_underlying(dispatcher_.services(EventDispatcher::Mode::CLIENT)));
-	auto msg = messaging::core::CreateNegotiate(*fbb, in, out);
+	std::vector<std::uint8_t> codecs;
+
+	if(compression_) {
+		for(const auto codec : compression_->codecs) {
+			codecs.emplace_back(std::to_underlying(codec));
+		}
+	}
+
+	auto compression = fbb->CreateVector(codecs);
+	const auto window = net.flow().open(dispatcher_.window());
+	const bool batching = batching_ && batching_->enabled;
+	auto msg = messaging::core::CreateNegotiate(*fbb, in, out, window, compression, batching);
+	fbb->Finish(msg);
+	net.write(fbb);
+}
+
+void MessageHandler::send_credit(NetworkSession& net, const std::uint64_t credits) {
+	auto fbb = make_buffer();
+	auto msg = messaging::core::CreateCredit(*fbb, credits);
 	fbb->Finish(msg);
 	net.write(fbb);
 }
@@ -42,7 +63,7 @@ void MessageHandler::send_negotiation(NetworkSession& net) {
 void MessageHandler::send_banner(NetworkSession& net) {
 	LOG_TRACE_FILTER(logger_, LF_SPARK) << __func__ << LOG_ASYNC;
 
-	auto fbb = std::make_shared<flatbuffers::FlatBufferBuilder>();
+	auto fbb = make_buffer();
 	auto desc = fbb->CreateString(self_.description);
 	auto uuid = fbb->CreateVector(self_.uuid.begin(), self_.uuid.size());
 	auto msg = messaging::core::CreateBanner(*fbb, desc, uuid);
@@ -55,7 +76,17 @@ bool MessageHandler::establish_link(NetworkSession& net, const Message& message)
 
 	if(static_cast<messaging::core::Opcode>(message.opcode) != messaging::core::Opcode::MSG_BANNER) {
 		LOG_WARN_FILTER(logger_, LF_SPARK)
-			<< "[spark] Link failed, peer did not send banner: "
+			<< "[spark] Link failed, peer did not send banner: "_lit
+			<< net.remote_host() << LOG_ASYNC;
+		return false;
+	}
+
+	// the handshake is verified under the same policy as everything that follows it
+	peer_.verification = net.verification();
+
+	if(!verify<messaging::core::Banner>(peer_, message)) {
+		LOG_WARN_FILTER(logger_, LF_SPARK)
+			<< "[spark] Link failed, bad banner: "_lit
 			<< net.remote_host() << LOG_ASYNC;
 		return false;
 	}
@@ -67,7 +98,7 @@ bool MessageHandler::establish_link(NetworkSession& net, const Message& message)
 	if(!uuid || uuid->size() != boost::uuids::uuid::static_size()
 	   || !banner->description()) {
 		LOG_WARN_FILTER(logger_, LF_SPARK)
-			<< "[spark] Link failed, incompatible banner: "
+			<< "[spark] Link failed, incompatible banner: "_lit
 			<< net.remote_host() << LOG_ASYNC;
 		return false;
 	}
@@ -77,7 +108,7 @@ bool MessageHandler::establish_link(NetworkSession& net, const Message& message)
 	peer_.net = std::weak_ptr<NetworkSession>(net.shared_from_this());
 
 	LOG_TRACE_FILTER(logger_, LF_SPARK)
-		<< "[spark] Peer banner: " << peer_.description << ":"
+		<< "[spark] Peer banner: "_lit << peer_.description << ":"_lit
 		<< boost::uuids::to_string(peer_.uuid) << LOG_ASYNC;
 
 	if(initiator_) {
@@ -95,7 +126,14 @@ bool MessageHandler::negotiate_protocols(NetworkSession& net, const Message& mes
 
 	if(static_cast<messaging::core::Opcode>(message.opcode) != messaging::core::Opcode::MSG_NEGOTIATE) {
 		LOG_WARN_FILTER(logger_, LF_SPARK)
-			<< "[spark] Link failed, peer did not negotiate: "
+			<< "[spark] Link failed, peer did not negotiate: "_lit
+			<< net.remote_host() << LOG_ASYNC;
+		return false;
+	}
+
+	if(!verify<messaging::core::Negotiate>(peer_, message)) {
+		LOG_WARN_FILTER(logger_, LF_SPARK)
+			<< "[spark] Link failed, bad negotiation: "_lit
 			<< net.remote_host() << LOG_ASYNC;
 		return false;
 	}
@@ -104,7 +142,7 @@ bool MessageHandler::negotiate_protocols(NetworkSession& net, const Message& mes
 	
 	if(!protocols->proto_in() || !protocols->proto_out()) {
 		LOG_WARN_FILTER(logger_, LF_SPARK)
-			<< "[spark] Link failed, incompatible negotiation: "
+			<< "[spark] Link failed, incompatible negotiation: "_lit
 			<< net.remote_host() << LOG_ASYNC;
 		return false;
 	}
@@ -138,7 +176,7 @@ bool MessageHandler::negotiate_protocols(NetworkSession& net, const Message& mes
 
 	if(!matches) {
 		LOG_DEBUG_FILTER(logger_, LF_SPARK)
-			<< "[spark] Peer did not match any supported protocols: "
+			<< "[spark] Peer did not match any supported protocols: "_lit
 			<< net.remote_host() << LOG_ASYNC;
 		return false;
 	}
@@ -147,20 +185,46 @@ bool MessageHandler::negotiate_protocols(NetworkSession& net, const Message& mes
 		send_negotiation(net);
 	}
 
+	// anything sent from here on, including by link up handlers, counts against the peer's window
+	net.peer_window(protocols->window());
+
+	if(compression_) {
+		const auto codec = detail::Compressor::select(*compression_, protocols->compression());
+
+		if(codec != messaging::core::Codec::NONE) {
+			compressor_ = std::make_shared<detail::Compressor>(*compression_, codec);
+
+			LOG_DEBUG_FILTER(logger_, LF_SPARK)
+				<< "[spark] Compressing messages to "_lit << net.remote_host() << " with "_lit
+				<< messaging::core::EnumNameCodec(codec) << LOG_ASYNC;
+		}
+	}
+
+	if(batching_ && batching_->enabled && protocols->batching()) {
+		batcher_ = std::make_shared<detail::Batcher>(*batching_);
+
+		LOG_DEBUG_FILTER(logger_, LF_SPARK)
+			<< "[spark] Batching messages to "_lit << net.remote_host() << LOG_ASYNC;
+	}
+
 	LOG_INFO_FILTER(logger_, LF_SPARK)
-		<< "[spark] Established link: " << peer_.description << ":"
+		<< "[spark] Established link: "_lit << peer_.description << ":"_lit
 		<< boost::uuids::to_string(peer_.uuid) << LOG_ASYNC;
 
-	// // register peer's services to allow for broadcasting
-	// for(const auto& i = protocols->proto_out()->begin(); i != protocols->proto_out()->end(); ++i) {
-	// 	services_.register_peer_service(peer_, static_cast<messaging::Service>(*i),
-	// 	                                ServicesMap::Mode::CLIENT);
-	// }
+	// register the peer's services for balancing & broadcasting before anybody hears about the link
+	for(const auto service : *protocols->proto_out()) {
+		if(matches_.contains(service)) {
+			services_.register_peer_service(peer_, static_cast<messaging::Service>(service),
+			                                ServicesMap::Mode::CLIENT);
+		}
+	}
 
-	// for(const auto& i = protocols->proto_in()->begin(); i != protocols->proto_in()->end(); ++i) {
-	// 	services_.register_peer_service(peer_, static_cast<messaging::Service>(*i),
-	// 									ServicesMap::Mode::SERVER);
-	// }
+	for(const auto service : *protocols->proto_in()) {
+		if(matches_.contains(service)) {
+			services_.register_peer_service(peer_, static_cast<messaging::Service>(service),
+			                                ServicesMap::Mode::SERVER);
+		}
+	}
 
 	// send the 'link up' event handlers for all matched services
 	for(auto& service : matches_) {
@@ -172,7 +236,7 @@ bool MessageHandler::negotiate_protocols(NetworkSession& net, const Message& mes
 }
 
 void MessageHandler::dispatch_message(const Message& message) {
-	// if there's a tracking UUID set in the message, route it through the tracking service
+	// if there's a tracking sequence set in the message, route it through the tracking service
 	if(message.token.tracked) {
 		dispatcher_.dispatch_message(messaging::Service::CORE_TRACKING, peer_, message);
 	} else {
@@ -180,18 +244,21 @@ void MessageHandler::dispatch_message(const Message& message) {
 	}
 }
 
-bool MessageHandler::handle_message(NetworkSession& net, const messaging::core::Header* header,
-                                    const std::uint8_t* data, std::uint32_t size) {
-	Beacon token;
+// core messages are exempt from flow control, so they aren't counted
+void MessageHandler::return_credit(NetworkSession& net, const Message& message) {
+	if(message.service == messaging::Service::CORE_HEARTBEAT) {
+		return;
+	}
 
-	if(header->uuid()) {
-		boost::uuids::uuid uuid;
-		std::copy(header->uuid()->begin(), header->uuid()->end(), uuid.data);
-		token.uuid = std::move(uuid);
-		token.tracked = true;
+	if(auto credits = net.flow().consume()) {
+		send_credit(net, *credits);
 	}
+}
 
-	const Message message { size, header->opcode(), header->service(), data, std::move(token) };
+bool MessageHandler::handle_message(NetworkSession& net, const messaging::core::Header* header,
+                                    const std::uint8_t* data, std::uint32_t size) {
+	const Beacon token { header->sequence() != 0, header->sequence() };
+	const Message message { size, header->opcode(), header->service(), data, token };
 
 	switch(state_) {
 		case State::HANDSHAKING:
@@ -200,12 +267,25 @@ bool MessageHandler::handle_message(NetworkSession& net, const messaging::core::
 			return negotiate_protocols(net, message);
 		case State::DISPATCHING:
 			dispatch_message(message);
+			return_credit(net, message);
 			return true;
 	}
 
 	return false;
 }
 
+BufferHandle MessageHandler::compress(const BufferHandle& fbb) const {
+	return compressor_? compressor_->compress(fbb) : fbb;
+}
+
+detail::Compressor* MessageHandler::compressor() const {
+	return compressor_.get();
+}
+
+detail::Batcher* MessageHandler::batcher() const {
+	return batcher_.get();
+}
+
 void MessageHandler::start(NetworkSession& net) {
 	LOG_TRACE_FILTER(logger_, LF_SPARK) << __func__ << LOG_ASYNC;
 	
@@ -221,6 +301,13 @@ MessageHandler::~MessageHandler() {
 
 	services_.remove_peer(peer_);
 
+	// requests still waiting on this link are failed now rather than left to time out
+	const auto tracking = std::to_underlying(messaging::Service::CORE_TRACKING);
+
+	if(!matches_.contains(tracking)) {
+		dispatcher_.notify_link_down(messaging::Service::CORE_TRACKING, peer_);
+	}
+
 	// send the link down event to any handlers
 	for(auto& service : matches_) {
 		dispatcher_.notify_link_down(static_cast<messaging::Service>(service), peer_);
@@ -0,0 +1,28 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <spark/NetworkSession.h>
+#include <spark/TcpSession.h>
+#include <spark/v2/PeerSession.h>
+
+namespace ember::spark::inline v1 {
+
+std::shared_ptr<NetworkSession> make_session(Transport transport, SessionManager& sessions,
+                                             boost::asio::ip::tcp::socket socket,
+                                             boost::asio::ip::tcp::endpoint ep,
+                                             MessageHandler handler, log::Logger* logger) {
+	if(transport == Transport::V2) {
+		return std::make_shared<v2::PeerSession>(sessions, std::move(socket), std::move(ep),
+		                                         std::move(handler), logger);
+	}
+
+	return std::make_shared<TcpSession>(sessions, std::move(socket), std::move(ep),
+	                                    std::move(handler), logger);
+}
+
+} // spark, ember
\ No newline at end of file
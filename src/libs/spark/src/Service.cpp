@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2015 - 2020 Ember
+ * Copyright (c) 2015 - 2022 Ember
  *
  * This Source Code Form is subject to the terms of the Mozilla Public
  * License, v. 2.0. If a copy of the MPL was not distributed with this
@@ -23,58 +23,143 @@ namespace ember::spark::inline v1 {
 
 namespace bai = boost::asio::ip;
 
+namespace {
+
+// compression reports to the service's metrics unless the policy names its own
+CompressionPolicy with_metrics(CompressionPolicy policy, Metrics* metrics) {
+	if(!policy.metrics) {
+		policy.metrics = metrics;
+	}
+
+	return policy;
+}
+
+} // unnamed
+
 Service::Service(std::string description, boost::asio::io_context& service, const std::string& interface,
-                 std::uint16_t port, log::Logger* logger)
-                 : service_(service), logger_(logger),
-                   listener_(service, interface, port, sessions_, dispatcher_, services_, link_, logger),
-                   hb_service_(service_, this, logger), 
+                 std::uint16_t port, log::Logger* logger, Transport transport,
+                 CompressionPolicy compression, BatchPolicy batching, Metrics* metrics)
+                 : service_(service), transport_(transport), compression_(with_metrics(std::move(compression), metrics)),
+                   batching_(batching),
+                   logger_(logger),
+                   listener_(service, interface, port, sessions_, dispatcher_, services_, link_,
+                             transport, compression_, batching_, logger),
+                   local_(service, interface, port, sessions_, dispatcher_, services_, link_, logger),
+                   hb_service_(service_, this, logger, metrics), 
                    track_service_(service_, logger),
                    link_ { boost::uuids::random_generator()(), std::move(description) } {
 	dispatcher_.register_handler(&hb_service_, messaging::Service::CORE_HEARTBEAT, EventDispatcher::Mode::BOTH);
-	dispatcher_.register_handler(&track_service_, messaging::Service::CORE_HEARTBEAT, EventDispatcher::Mode::CLIENT);
+	dispatcher_.register_handler(&track_service_, messaging::Service::CORE_TRACKING, EventDispatcher::Mode::CLIENT);
 }
 
 void Service::shutdown() {
-	LOG_DEBUG_FILTER(logger_, LF_SPARK) << "[spark] Service shutting down..." << LOG_ASYNC;
+	LOG_DEBUG_FILTER(logger_, LF_SPARK) << "[spark] Service shutting down..."_lit << LOG_ASYNC;
 	track_service_.shutdown();
 	hb_service_.shutdown();
 	listener_.shutdown();
+	local_.shutdown();
 	sessions_.stop_all();
 }
 
-void Service::start_session(boost::asio::ip::tcp::socket socket, boost::asio::ip::tcp::endpoint ep) {
+std::shared_ptr<NetworkSession> Service::start_session(boost::asio::ip::tcp::socket socket,
+                                                       boost::asio::ip::tcp::endpoint ep) {
 	LOG_TRACE_FILTER(logger_, LF_SPARK) << __func__ << LOG_ASYNC;
 
-	MessageHandler m_handler(dispatcher_, services_, link_, true, logger_);
-	auto session = std::make_shared<NetworkSession>(sessions_, std::move(socket), ep, m_handler, logger_);
+	MessageHandler m_handler(dispatcher_, services_, link_, true, logger_, &compression_, &batching_);
+	auto session = make_session(transport_, sessions_, std::move(socket), ep, m_handler, logger_);
 	sessions_.start(session);
+	return session;
 }
 
 void Service::do_connect(const std::string& host, std::uint16_t port) {
 	LOG_TRACE(logger_) << __func__ << LOG_ASYNC;
 	bai::tcp::resolver resolver(service_);
 	auto port_str = std::to_string(port);
-	auto endpoint_it = resolver.resolve({ host, port_str });
+	boost::system::error_code ec;
+	auto endpoint_it = resolver.resolve({ host, port_str }, ec);
+
+	if(ec) {
+		LOG_WARN_FILTER(logger_, LF_SPARK)
+			<< "[spark] Unable to resolve "_lit << host << ": "_lit << ec.message() << LOG_ASYNC;
+		connected(host, port, nullptr);
+		return;
+	}
+
 	auto socket = std::make_shared<boost::asio::ip::tcp::socket>(service_);
 
 	boost::asio::async_connect(*socket, endpoint_it,
 		[this, host, port, socket](boost::system::error_code ec, bai::tcp::endpoint ep) {
-			if(!ec) {
-				start_session(std::move(*socket), ep);
-			}
+			connected(host, port, ec? nullptr : start_session(std::move(*socket), ep));
 
 			LOG_DEBUG_FILTER(logger_, LF_SPARK)
-				<< "[spark] " << (ec? "Unable to establish" : "Established")
-				<< " connection to " << host << ":" << port << LOG_ASYNC;
+				<< "[spark] "_lit << (ec? "Unable to establish" : "Established")
+				<< " connection to "_lit << host << ":"_lit << port << LOG_ASYNC;
 		}
 	);
 }
 
+// a failed attempt is forgotten, so the next time the peer is located it's tried again
+void Service::connected(const std::string& host, const std::uint16_t port,
+                        std::shared_ptr<NetworkSession> session) {
+	std::lock_guard guard(outbound_lock_);
+
+	if(session) {
+		outbound_[{ host, port }] = { false, std::move(session) };
+	} else {
+		outbound_.erase({ host, port });
+	}
+}
+
+/*
+ * Does nothing if there's already a link (or an attempt at one) to the
+ * endpoint, so it's safe to call whenever a peer is located. Once the link
+ * goes down, the next call will reconnect.
+ */
 void Service::connect(const std::string& host, std::uint16_t port) {
 	LOG_TRACE_FILTER(logger_, LF_SPARK) << __func__ << LOG_ASYNC;
+
+	{
+		std::lock_guard guard(outbound_lock_);
+		auto [it, inserted] = outbound_.try_emplace({ host, port }, Outbound{ true });
+
+		if(!inserted) {
+			if(it->second.pending || !it->second.session.expired()) {
+				return;
+			}
+
+			it->second = { true };
+		}
+	}
+
+	auto on_connect = [this, host, port](std::shared_ptr<NetworkSession> session) {
+		if(session) {
+			connected(host, port, std::move(session));
+		} else {
+			do_connect(host, port);
+		}
+	};
+
+	// same process or same host, skip the network stack entirely
+	if(local_.connect(host, port, std::move(on_connect))) {
+		return;
+	}
+
 	do_connect(host, port);
 }
 
+auto Service::to_result(const FlowControl::Result result) -> Result {
+	switch(result) {
+		case FlowControl::Result::SENT:
+			return Result::OK;
+		case FlowControl::Result::QUEUED:
+			return Result::QUEUED;
+		case FlowControl::Result::WOULD_BLOCK:
+			return Result::WOULD_BLOCK;
+		default:
+			return Result::REJECTED;
+	}
+}
+
 auto Service::send(const Link& link, std::uint16_t opcode, BufferHandle fbb) const -> Result {
 	auto net = link.net.lock();
 
@@ -82,8 +167,7 @@ auto Service::send(const Link& link, std::uint16_t opcode, BufferHandle fbb) con
 		return Result::LINK_GONE;
 	}
 
-	net->write(fbb);
-	return Result::OK;
+	return to_result(net->send(fbb));
 }
 
 auto Service::send(const Link& link, std::uint16_t opcode, BufferHandle fbb,
@@ -94,10 +178,40 @@ auto Service::send(const Link& link, std::uint16_t opcode, BufferHandle fbb,
 		return Result::LINK_GONE;
 	}
 
-	auto uuid = generate_uuid();
-	track_service_.register_tracked(link, uuid, callback, 5s);
-	net->write(fbb);
-	return Result::OK;
+	const auto sequence = net->next_sequence();
+	track_service_.register_tracked(link, sequence, callback, DEFAULT_TIMEOUT);
+	const auto result = to_result(net->send(fbb));
+
+	if(!accepted(result)) {
+		track_service_.cancel(link, sequence);
+	}
+
+	return result;
+}
+
+/*
+ * The waiter is always completed, even if the message isn't sent. If the
+ * request can't be cancelled, it has already been completed by something
+ * else (the link going down, for instance) and mustn't be failed twice.
+ */
+auto Service::send(const Link& link, std::uint16_t opcode, BufferHandle fbb,
+                   detail::Waiter& waiter, std::chrono::milliseconds timeout) -> Result {
+	auto net = link.net.lock();
+
+	if(!net) {
+		waiter.fail(detail::Waiter::Failure::SEND_FAILED);
+		return Result::LINK_GONE;
+	}
+
+	const auto sequence = net->next_sequence();
+	track_service_.register_tracked(link, sequence, waiter, timeout);
+	const auto result = to_result(net->send(fbb));
+
+	if(!accepted(result) && track_service_.cancel(link, sequence)) {
+		waiter.fail(detail::Waiter::Failure::SEND_FAILED);
+	}
+
+	return result;
 }
 
 auto Service::send(const Link& link, std::uint16_t opcode, BufferHandle fbb,
@@ -108,8 +222,7 @@ auto Service::send(const Link& link, std::uint16_t opcode, BufferHandle fbb,
 		return Result::LINK_GONE;
 	}
 
-	net->write(fbb);
-	return Result::OK;
+	return to_result(net->send(fbb));
 }
 
 auto Service::send(const Link& link, std::uint16_t opcode, BufferHandle fbb,
@@ -120,25 +233,31 @@ auto Service::send(const Link& link, std::uint16_t opcode, BufferHandle fbb,
 		return Result::LINK_GONE;
 	}
 
-	track_service_.register_tracked(link, token.uuid, callback, 5s);
-	net->write(fbb);
-	return Result::OK;
+	track_service_.register_tracked(link, token.sequence, callback, DEFAULT_TIMEOUT);
+	const auto result = to_result(net->send(fbb));
+
+	if(!accepted(result)) {
+		track_service_.cancel(link, token.sequence);
+	}
+
+	return result;
 }
 
 void Service::broadcast(messaging::Service service, ServicesMap::Mode mode,
                         BufferHandle fbb) const {
 	LOG_TRACE_FILTER(logger_, LF_SPARK) << __func__ << LOG_ASYNC;
-	const auto& links = services_.peer_services(service, mode);
+	const auto peers = services_.snapshot(service, mode);
 
-	for(const auto& link : links) {
+	for(const auto& peer : peers->peers) {
 		/* The weak_ptr should never fail to lock as the link will be removed from the
 		   services map before the network session shared_ptr goes out of scope */
-		auto shared_net = link.net.lock();
+		auto shared_net = peer->link.net.lock();
 		
+		// a peer that's out of credit misses the broadcast, it shows in the link's flow stats
 		if(shared_net) {
-			shared_net->write(fbb);
+			shared_net->send(fbb);
 		} else {
-			LOG_WARN_FILTER(logger_, LF_SPARK) << "[spark] Unable to lock weak_ptr!" << LOG_ASYNC;
+			LOG_WARN_FILTER(logger_, LF_SPARK) << "[spark] Unable to lock weak_ptr!"_lit << LOG_ASYNC;
 		}
 	}
 }
@@ -147,6 +266,10 @@ EventDispatcher* Service::dispatcher() {
 	return &dispatcher_;
 }
 
+const ServicesMap* Service::services() const {
+	return &services_;
+}
+
 Service::~Service() {
 	dispatcher_.remove_handler(&hb_service_);
 	dispatcher_.remove_handler(&track_service_);
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2015 - 2021 Ember
+ * Copyright (c) 2015 - 2022 Ember
  *
  * This Source Code Form is subject to the terms of the Mozilla Public
  * License, v. 2.0. If a copy of the MPL was not distributed with this
@@ -13,6 +13,8 @@
 #include <spark/ServiceListener.h>
 #include <shared/FilterTypes.h>
 #include <boost/lexical_cast.hpp>
+#include <algorithm>
+#include <utility>
 
 namespace bai = boost::asio::ip;
 namespace mcast = ember::messaging::multicast;
@@ -25,23 +27,51 @@ ServiceDiscovery::ServiceDiscovery(boost::asio::io_context& service, std::string
                                    log::Logger* logger)
                                    : address_(std::move(address)), port_(port),
                                      socket_(service), logger_(logger), service_(service),
-                                     endpoint_(bai::address::from_string(mcast_group),
-                                     mcast_port) {
-	// boost::asio::ip::udp::endpoint listen_endpoint(bai::address::from_string(mcast_iface), mcast_port);
+                                     endpoint_(bai::address::from_string(mcast_group), mcast_port),
+                                     announce_timer_(service), jitter_(std::random_device{}()) {
+	const auto group = endpoint_.address();
 
-	// socket_.open(listen_endpoint.protocol());
-	// socket_.set_option(bai::udp::socket::reuse_address(true));
-	// socket_.bind(listen_endpoint);
-	
-	// socket_.set_option(bai::multicast::join_group(bai::address::from_string(mcast_group)));
+	// bound to the wildcard address rather than the interface, as datagrams are addressed to the group
+	const bai::udp::endpoint listen_endpoint(group.is_v4()? bai::address(bai::address_v4::any())
+	                                                      : bai::address(bai::address_v6::any()),
+	                                         mcast_port);
+
+	// not fatal, peers that already know where we are can still connect
+	try {
+		const auto iface = bai::address::from_string(mcast_iface);
+
+		socket_.open(listen_endpoint.protocol());
+		socket_.set_option(bai::udp::socket::reuse_address(true));
+		socket_.bind(listen_endpoint);
+
+		if(group.is_v4()) {
+			socket_.set_option(bai::multicast::join_group(group.to_v4(), iface.to_v4()));
+			socket_.set_option(bai::multicast::outbound_interface(iface.to_v4()));
+		} else {
+			socket_.set_option(bai::multicast::join_group(group));
+		}
+
+		// allows services on the same host (or in the same process) to find each other
+		socket_.set_option(bai::multicast::enable_loopback(true));
+	} catch(const boost::system::system_error& e) {
+		LOG_ERROR_FILTER(logger_, LF_SPARK)
+			<< "[spark] Unable to join multicast group "_lit << mcast_group << " on "_lit
+			<< mcast_iface << ", service discovery unavailable: "_lit << e.what() << LOG_ASYNC;
+
+		boost::system::error_code ec; // we don't care about any errors
+		socket_.close(ec);
+		return;
+	}
 
-	// receive();
+	receive();
+	schedule_announce();
 }
 
 void ServiceDiscovery::shutdown() {
-	LOG_DEBUG_FILTER(logger_, LF_SPARK) << "[spark] Discovery service shutting down..." << LOG_ASYNC;
+	LOG_DEBUG_FILTER(logger_, LF_SPARK) << "[spark] Discovery service shutting down..."_lit << LOG_ASYNC;
 	boost::system::error_code ec; // we don't care about any errors
-	socket_.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
+	announce_timer_.cancel();
+	socket_.shutdown(boost::asio::ip::udp::socket::shutdown_both, ec);
 	socket_.close(ec);
 }
 
@@ -65,35 +95,67 @@ void ServiceDiscovery::handle_receive(const boost::system::error_code& ec, std::
 }
 
 void ServiceDiscovery::handle_packet(std::size_t size) {
-	flatbuffers::Verifier verifier(buffer_.data(), size);
+	constexpr auto prefix_size = sizeof(flatbuffers::uoffset_t);
 
-	auto root = flatbuffers::GetSizePrefixedRoot<messaging::core::Header>(buffer_.data());
-	
-	if(!root->Verify(verifier)) {
+	if(size < prefix_size) {
+		LOG_WARN_FILTER(logger_, LF_SPARK)
+			<< "[spark] Undersized multicast message"_lit << LOG_ASYNC;
+		return;
+	}
+
+	// both the header and the body are size prefixed
+	const std::size_t header_size = flatbuffers::GetPrefixedSize(buffer_.data()) + prefix_size;
+
+	if(header_size > size) {
 		LOG_WARN_FILTER(logger_, LF_SPARK)
-			<< "[spark] Multicast message header failed validation" << LOG_ASYNC;
+			<< "[spark] Multicast message header exceeds datagram size"_lit << LOG_ASYNC;
 		return;
 	}
 
-	auto body = buffer_.data() + verifier.GetComputedSize();
+	flatbuffers::Verifier verifier(buffer_.data(), header_size);
+
+	if(!verifier.VerifySizePrefixedBuffer<messaging::core::Header>(nullptr)) {
+		LOG_WARN_FILTER(logger_, LF_SPARK)
+			<< "[spark] Multicast message header failed validation"_lit << LOG_ASYNC;
+		return;
+	}
+
+	const auto root = flatbuffers::GetSizePrefixedRoot<messaging::core::Header>(buffer_.data());
+	const auto body = buffer_.data() + header_size;
+	flatbuffers::Verifier body_verifier(body, size - header_size);
 	
 	switch(static_cast<mcast::Opcode>(root->opcode())) {
 		case mcast::Opcode::CMSG_LOCATE:
-			handle_locate(flatbuffers::GetRoot<mcast::Locate>(body));
+			if(body_verifier.VerifySizePrefixedBuffer<mcast::Locate>(nullptr)) {
+				handle_locate(flatbuffers::GetSizePrefixedRoot<mcast::Locate>(body));
+				return;
+			}
 			break;
 		case mcast::Opcode::SMSG_LOCATE:
-			handle_locate_answer(flatbuffers::GetRoot<mcast::LocateResponse>(body));
+			if(body_verifier.VerifySizePrefixedBuffer<mcast::LocateResponse>(nullptr)) {
+				handle_locate_answer(flatbuffers::GetSizePrefixedRoot<mcast::LocateResponse>(body));
+				return;
+			}
 			break;
 		default:
 			LOG_WARN_FILTER(logger_, LF_SPARK)
-				<< "[spark] Received an unknown multicast packet type from "
+				<< "[spark] Received an unknown multicast packet type from "_lit
 				<< boost::lexical_cast<std::string>(remote_ep_.address()) << LOG_ASYNC;
+			return;
 	}
+
+	LOG_WARN_FILTER(logger_, LF_SPARK)
+		<< "[spark] Multicast message from "_lit << boost::lexical_cast<std::string>(remote_ep_.address())
+		<< " failed validation"_lit << LOG_ASYNC;
 }
 
-void ServiceDiscovery::send(const std::shared_ptr<flatbuffers::FlatBufferBuilder>& msg,
+void ServiceDiscovery::send(const BufferHandle& msg,
 							mcast::Opcode opcode) {
-	auto fbb = std::make_shared<flatbuffers::FlatBufferBuilder>();
+	if(!socket_.is_open()) {
+		return;
+	}
+
+	auto fbb = make_buffer();
 	auto header = messaging::core::CreateHeader(*fbb, static_cast<std::uint16_t>(opcode),
 	                                            messaging::Service::CORE_DISCOVERY);
 	fbb->FinishSizePrefixed(header);
@@ -107,8 +169,8 @@ void ServiceDiscovery::send(const std::shared_ptr<flatbuffers::FlatBufferBuilder
 		[this, msg, fbb](const boost::system::error_code& ec, std::size_t size) {
 			if(ec) {
 				LOG_ERROR_FILTER(logger_, LF_SPARK)
-					<< "[spark] Error on sending service discovery packet: "
-					<< ec.message() << ", size " << size << LOG_ASYNC;
+					<< "[spark] Error on sending service discovery packet: "_lit
+					<< ec.message() << ", size "_lit << size << LOG_ASYNC;
 			}
 		}
 	);
@@ -128,21 +190,72 @@ std::unique_ptr<ServiceListener> ServiceDiscovery::listener(messaging::Service s
 	return listener;
 }
 
-void ServiceDiscovery::locate_service(messaging::Service service) {
-	auto fbb = std::make_shared<flatbuffers::FlatBufferBuilder>();
-	auto msg = mcast::CreateLocate(*fbb, service);
+/*
+ * Answers from the cache if any endpoints for the service are known,
+ * otherwise asks the group. Answers to the query arrive through
+ * handle_locate_answer as usual.
+ */
+void ServiceDiscovery::locate_service(const ServiceListener* listener) {
+	std::vector<BufferHandle> answers;
+
+	{
+		std::lock_guard<std::mutex> guard(lock_);
+		auto& entries = cache_[listener->service()];
+		expire(entries, Clock::now());
+
+		for(const auto& entry : entries) {
+			answers.emplace_back(entry.answer);
+		}
+	}
+
+	if(!answers.empty()) {
+		for(const auto& answer : answers) {
+			listener->cb_(flatbuffers::GetSizePrefixedRoot<mcast::LocateResponse>(
+				answer->GetBufferPointer()));
+		}
+
+		return;
+	}
+
+	auto fbb = make_buffer();
+	auto msg = mcast::CreateLocate(*fbb, listener->service());
 	fbb->FinishSizePrefixed(msg);
 	send(fbb, mcast::Opcode::CMSG_LOCATE);
 }
 
 void ServiceDiscovery::send_announce(messaging::Service service) {
-	auto fbb = std::make_shared<flatbuffers::FlatBufferBuilder>();
+	auto fbb = make_buffer();
 	auto ip = fbb->CreateString(address_);
-	auto msg = 	mcast::CreateLocateResponse(*fbb, ip, port_, service);
+	auto msg = mcast::CreateLocateResponse(*fbb, ip, port_, service,
+	                                       static_cast<std::uint32_t>(DEFAULT_TTL.count()));
 	fbb->FinishSizePrefixed(msg);
 	send(fbb, mcast::Opcode::SMSG_LOCATE);
 }
 
+void ServiceDiscovery::schedule_announce() {
+	// +/- 25% so that services started together don't announce together
+	const auto quarter = std::chrono::duration_cast<std::chrono::milliseconds>(ANNOUNCE_INTERVAL) / 4;
+	std::uniform_int_distribution<std::int64_t> dist(-quarter.count(), quarter.count());
+	const auto delay = ANNOUNCE_INTERVAL + std::chrono::milliseconds(dist(jitter_));
+
+	announce_timer_.expires_after(delay);
+	announce_timer_.async_wait([this](const boost::system::error_code& ec) {
+		if(ec) { // timer was cancelled
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> guard(lock_);
+
+			for(const auto service : services_) {
+				send_announce(service);
+			}
+		}
+
+		schedule_announce();
+	});
+}
+
 void ServiceDiscovery::handle_locate(const mcast::Locate* message) {
 	// check to see if we a matching service registered
 	std::lock_guard<std::mutex> guard(lock_);
@@ -156,19 +269,58 @@ void ServiceDiscovery::handle_locate(const mcast::Locate* message) {
 	send_announce(message->service());
 }
 
+// lock_ must be held by the caller
+void ServiceDiscovery::expire(std::vector<CacheEntry>& entries, const Clock::time_point now) {
+	entries.erase(std::remove_if(entries.begin(), entries.end(), [&](const auto& entry) {
+		return entry.expiry <= now;
+	}), entries.end());
+}
+
+// lock_ must be held by the caller
+void ServiceDiscovery::cache_answer(const mcast::LocateResponse* message) {
+	const auto now = Clock::now();
+	const auto ttl = message->ttl()? std::chrono::seconds(message->ttl()) : DEFAULT_TTL;
+	const auto ip = message->ip()->str();
+	auto& entries = cache_[message->type()];
+	expire(entries, now);
+
+	for(auto& entry : entries) {
+		if(entry.port == message->port() && entry.ip == ip) {
+			entry.expiry = now + ttl;
+			return;
+		}
+	}
+
+	// keep a copy of the answer so cache hits look the same as answers from the network
+	auto fbb = make_buffer();
+	auto fb_ip = fbb->CreateString(ip);
+	auto answer = mcast::CreateLocateResponse(*fbb, fb_ip, message->port(), message->type(),
+	                                          message->ttl());
+	fbb->FinishSizePrefixed(answer);
+	entries.emplace_back(CacheEntry{ ip, message->port(), now + ttl, std::move(fbb) });
+}
+
 void ServiceDiscovery::handle_locate_answer(const mcast::LocateResponse* message) {
-	if(message->type() != messaging::Service::CORE_DISCOVERY
-	   || !message->ip() || !message->port()) {
+	if(!message->ip() || !message->port()) {
 		LOG_WARN_FILTER(logger_, LF_SPARK)
-			<< "[spark] Received incompatible locate answer " << LOG_ASYNC;
+			<< "[spark] Received incompatible locate answer "_lit << LOG_ASYNC;
 		return;
 	}
 
-	std::lock_guard<std::mutex> guard(lock_);
-	auto& listeners = listeners_[message->type()];
+	std::vector<LocateCallback> callbacks;
+
+	{
+		std::lock_guard<std::mutex> guard(lock_);
+		cache_answer(message);
 
-	for(auto& listener : listeners) {
-		listener->cb_(message);
+		for(const auto& listener : listeners_[message->type()]) {
+			callbacks.emplace_back(listener->cb_);
+		}
+	}
+
+	// listeners will usually go on to connect, so they're called without the lock held
+	for(const auto& callback : callbacks) {
+		callback(message);
 	}
 }
 
@@ -183,4 +335,15 @@ void ServiceDiscovery::remove_service(messaging::Service service) {
 	services_.erase(std::remove(services_.begin(), services_.end(), service), services_.end());
 }
 
+bool ServiceDiscovery::joined() const {
+	return socket_.is_open();
+}
+
+std::size_t ServiceDiscovery::cached(messaging::Service service) {
+	std::lock_guard<std::mutex> guard(lock_);
+	auto& entries = cache_[service];
+	expire(entries, Clock::now());
+	return entries.size();
+}
+
 } // spark, ember
\ No newline at end of file
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2015 - 2021 Ember
+ * Copyright (c) 2015 - 2022 Ember
  *
  * This Source Code Form is subject to the terms of the Mozilla Public
  * License, v. 2.0. If a copy of the MPL was not distributed with this
@@ -16,7 +16,7 @@ ServiceListener::~ServiceListener() {
 }
 
 void ServiceListener::search() {
-	sd_client_->locate_service(service_);
+	sd_client_->locate_service(this);
 }
 
 } // spark, ember
\ No newline at end of file
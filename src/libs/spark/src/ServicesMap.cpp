@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2015 Ember
+ * Copyright (c) 2015 - 2022 Ember
  *
  * This Source Code Form is subject to the terms of the Mozilla Public
  * License, v. 2.0. If a copy of the MPL was not distributed with this
@@ -7,48 +7,114 @@
  */
 
 #include <spark/ServicesMap.h>
+#include <boost/uuid/uuid_hash.hpp>
+#include <algorithm>
 
 namespace ember::spark::inline v1 {
 
-std::vector<Link> ServicesMap::peer_services(messaging::Service service, Mode type) const {
-	std::lock_guard<std::mutex> guard(lock_);
+ServicesMap::ServicesMap() : empty_(std::make_shared<const PeerSet>()) {
+	for(auto& table : sets_) {
+		for(auto& set : table) {
+			set.store(empty_, std::memory_order_relaxed);
+		}
+	}
+}
+
+auto ServicesMap::slot(messaging::Service service, Mode type) -> std::atomic<Snapshot>* {
+	const auto index = static_cast<std::size_t>(std::to_underlying(service));
+	return index < MAX_SERVICES? &sets_[type == Mode::CLIENT? 0 : 1][index] : nullptr;
+}
+
+auto ServicesMap::slot(messaging::Service service, Mode type) const -> const std::atomic<Snapshot>* {
+	const auto index = static_cast<std::size_t>(std::to_underlying(service));
+	return index < MAX_SERVICES? &sets_[type == Mode::CLIENT? 0 : 1][index] : nullptr;
+}
+
+void ServicesMap::build_ring(PeerSet& set) {
+	set.ring.clear();
+	set.ring.reserve(set.peers.size() * VIRTUAL_NODES);
+
+	for(std::uint32_t i = 0; i < set.peers.size(); ++i) {
+		const std::uint64_t base = boost::uuids::hash_value(set.peers[i]->link.uuid);
+
+		for(std::uint64_t node = 0; node < VIRTUAL_NODES; ++node) {
+			set.ring.emplace_back(hash_point(base + node * 0x9E3779B97F4A7C15ull), i);
+		}
+	}
+
+	std::sort(set.ring.begin(), set.ring.end());
+}
 
-	auto& map = type == Mode::CLIENT? peer_clients_ : peer_servers_;
-	auto it = map.find(service);
+auto ServicesMap::snapshot(messaging::Service service, Mode type) const -> Snapshot {
+	const auto set = slot(service, type);
+	return set? set->load(std::memory_order_acquire) : empty_;
+}
+
+std::vector<Link> ServicesMap::peer_services(messaging::Service service, Mode type) const {
+	const auto set = snapshot(service, type);
+	std::vector<Link> links;
+	links.reserve(set->peers.size());
 
-	if(it != map.end()) {
-		return std::vector<Link>(it->second.begin(), it->second.end());
+	for(const auto& peer : set->peers) {
+		links.emplace_back(peer->link);
 	}
-	
-	return std::vector<Link>();
+
+	return links;
 }
 
 void ServicesMap::register_peer_service(const Link& link, messaging::Service service, Mode type) {
+	auto target = slot(service, type);
+
+	if(!target) {
+		return;
+	}
+
 	std::lock_guard<std::mutex> guard(lock_);
+	const auto current = target->load(std::memory_order_relaxed);
 
-	switch(type) {
-		case Mode::CLIENT:
-			peer_clients_[service].emplace_front(link);
-			break;
-		case Mode::SERVER:
-			peer_servers_[service].emplace_front(link);
-			break;
+	const auto exists = std::any_of(current->peers.begin(), current->peers.end(), [&](const auto& peer) {
+		return peer->link == link;
+	});
+
+	if(exists) {
+		return;
 	}
+
+	auto set = std::make_shared<PeerSet>();
+	set->peers = current->peers;
+	set->peers.emplace_back(std::make_shared<Peer>(link));
+	build_ring(*set);
+	target->store(std::move(set), std::memory_order_release);
 }
 
 void ServicesMap::remove_peer(const Link& link) {
 	std::lock_guard<std::mutex> guard(lock_);
 
-	for(auto& list : peer_servers_) {
-		list.second.erase_after(std::remove_if(list.second.begin(), list.second.end(), [&](const auto& arg) {
-			return link == arg;
-		}), list.second.end());
-	}
+	for(auto& table : sets_) {
+		for(auto& target : table) {
+			const auto current = target.load(std::memory_order_relaxed);
+
+			const auto it = std::find_if(current->peers.begin(), current->peers.end(), [&](const auto& peer) {
+				return peer->link == link;
+			});
+
+			if(it == current->peers.end()) {
+				continue;
+			}
+
+			(*it)->healthy.store(false, std::memory_order_release);
+
+			auto set = std::make_shared<PeerSet>();
+			set->peers.reserve(current->peers.size() - 1);
+			std::copy_if(current->peers.begin(), current->peers.end(), std::back_inserter(set->peers),
+				[&](const auto& peer) {
+					return peer->link != link;
+				}
+			);
 
-	for(auto& list : peer_clients_) {
-		list.second.erase_after(std::remove_if(list.second.begin(), list.second.end(), [&](const auto& arg) {
-			return link == arg;
-		}), list.second.end());
+			build_ring(*set);
+			target.store(std::move(set), std::memory_order_release);
+		}
 	}
 }
 
@@ -0,0 +1,250 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#if defined __linux__
+
+#include <spark/ShmSession.h>
+#include <string>
+#include <fcntl.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ember::spark::inline v1 {
+
+namespace detail {
+
+namespace {
+
+// stops either side resizing the segment while the other has it mapped
+constexpr int REQUIRED_SEALS = F_SEAL_SHRINK | F_SEAL_GROW;
+
+} // unnamed
+
+std::unique_ptr<ShmSegment> ShmSegment::create() {
+	std::unique_ptr<ShmSegment> segment(new ShmSegment());
+	segment->memfd_ = ::memfd_create("ember-spark", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+
+	if(segment->memfd_ == -1 || ::ftruncate(segment->memfd_, MAPPING_SIZE) == -1
+	   || ::fcntl(segment->memfd_, F_ADD_SEALS, REQUIRED_SEALS | F_SEAL_SEAL) == -1) {
+		return nullptr;
+	}
+
+	for(auto& fd : segment->eventfds_) {
+		fd = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+		if(fd == -1) {
+			return nullptr;
+		}
+	}
+
+	// ftruncate zero fills, so the rings start out empty
+	if(!segment->map()) {
+		return nullptr;
+	}
+
+	return segment;
+}
+
+std::unique_ptr<ShmSegment> ShmSegment::open(const std::array<int, DESCRIPTOR_COUNT>& fds) {
+	std::unique_ptr<ShmSegment> segment(new ShmSegment());
+	segment->memfd_ = fds[0];
+	segment->eventfds_ = { fds[1], fds[2] };
+
+	struct stat info{};
+
+	if(::fstat(segment->memfd_, &info) == -1
+	   || static_cast<std::size_t>(info.st_size) != MAPPING_SIZE) {
+		return nullptr;
+	}
+
+	const auto seals = ::fcntl(segment->memfd_, F_GET_SEALS);
+
+	if(seals == -1 || (seals & REQUIRED_SEALS) != REQUIRED_SEALS) {
+		return nullptr;
+	}
+
+	if(!segment->map()) {
+		return nullptr;
+	}
+
+	return segment;
+}
+
+bool ShmSegment::map() {
+	memory_ = ::mmap(nullptr, MAPPING_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, memfd_, 0);
+
+	if(memory_ == MAP_FAILED) {
+		memory_ = nullptr;
+		return false;
+	}
+
+	return true;
+}
+
+ShmSegment::~ShmSegment() {
+	if(memory_) {
+		::munmap(memory_, MAPPING_SIZE);
+	}
+
+	for(auto fd : descriptors()) {
+		if(fd != -1) {
+			::close(fd);
+		}
+	}
+}
+
+ShmRing ShmSegment::ring(const std::size_t index) const {
+	return ShmRing(static_cast<std::uint8_t*>(memory_) + (ShmRing::SEGMENT_SIZE * index));
+}
+
+std::array<int, ShmSegment::DESCRIPTOR_COUNT> ShmSegment::descriptors() const {
+	return { memfd_, eventfds_[0], eventfds_[1] };
+}
+
+bool send_descriptors(const int socket, const std::array<int, ShmSegment::DESCRIPTOR_COUNT>& fds) {
+	constexpr auto fds_size = sizeof(int) * ShmSegment::DESCRIPTOR_COUNT;
+	alignas(cmsghdr) char control[CMSG_SPACE(fds_size)]{};
+	char marker = 0;
+	iovec iov { &marker, sizeof(marker) };
+
+	msghdr msg{};
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+
+	auto cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(fds_size);
+	std::memcpy(CMSG_DATA(cmsg), fds.data(), fds_size);
+
+	return ::sendmsg(socket, &msg, MSG_NOSIGNAL) == sizeof(marker);
+}
+
+bool receive_descriptors(const int socket, std::array<int, ShmSegment::DESCRIPTOR_COUNT>& fds) {
+	constexpr auto fds_size = sizeof(int) * ShmSegment::DESCRIPTOR_COUNT;
+	alignas(cmsghdr) char control[CMSG_SPACE(fds_size)]{};
+	char marker = 0;
+	iovec iov { &marker, sizeof(marker) };
+
+	msghdr msg{};
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+
+	if(::recvmsg(socket, &msg, MSG_CMSG_CLOEXEC) != sizeof(marker)) {
+		return false;
+	}
+
+	auto cmsg = CMSG_FIRSTHDR(&msg);
+
+	if(!cmsg || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+		return false;
+	}
+
+	const auto received = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+	std::memcpy(fds.data(), CMSG_DATA(cmsg), received * sizeof(int));
+
+	if(received != ShmSegment::DESCRIPTOR_COUNT || (msg.msg_flags & MSG_CTRUNC)) {
+		for(std::size_t i = 0; i < received && i < fds.size(); ++i) {
+			::close(fds[i]);
+		}
+
+		return false;
+	}
+
+	return true;
+}
+
+bool same_user(const int socket) {
+	ucred credentials{};
+	socklen_t length = sizeof(credentials);
+
+	if(::getsockopt(socket, SOL_SOCKET, SO_PEERCRED, &credentials, &length) == -1) {
+		return false;
+	}
+
+	return length == sizeof(credentials) && credentials.uid == ::geteuid();
+}
+
+} // detail
+
+ShmAcceptor::ShmAcceptor(boost::asio::io_context& context, const std::uint16_t port,
+                         AcceptHandler handler, log::Logger* logger)
+                         : acceptor_(context, endpoint(port)), handler_(std::move(handler)),
+                           logger_(logger) {
+	accept();
+}
+
+boost::asio::local::stream_protocol::endpoint ShmAcceptor::endpoint(const std::uint16_t port) {
+	// abstract namespace, so nothing is left behind on the filesystem
+	const auto name = "ember-spark-" + std::to_string(port);
+	return { std::string(1, '\0') + name };
+}
+
+void ShmAcceptor::accept() {
+	acceptor_.async_accept([this](boost::system::error_code ec, LocalSocket socket) {
+		if(!acceptor_.is_open()) {
+			return;
+		}
+
+		if(!ec) {
+			if(detail::same_user(socket.native_handle())) {
+				receive_segment(std::make_shared<LocalSocket>(std::move(socket)));
+			} else {
+				LOG_WARN_FILTER(logger_, LF_SPARK)
+					<< "[spark] Rejected shared memory connection from another user"_lit << LOG_ASYNC;
+			}
+		}
+
+		accept();
+	});
+}
+
+void ShmAcceptor::receive_segment(std::shared_ptr<LocalSocket> socket) {
+	socket->async_wait(LocalSocket::wait_read, [this, socket](boost::system::error_code ec) {
+		if(ec || !acceptor_.is_open()) {
+			return;
+		}
+
+		std::array<int, detail::ShmSegment::DESCRIPTOR_COUNT> fds{};
+
+		if(!detail::receive_descriptors(socket->native_handle(), fds)) {
+			LOG_DEBUG_FILTER(logger_, LF_SPARK)
+				<< "[spark] Shared memory handshake failed"_lit << LOG_ASYNC;
+			return;
+		}
+
+		auto segment = detail::ShmSegment::open(fds);
+
+		if(!segment) {
+			LOG_WARN_FILTER(logger_, LF_SPARK)
+				<< "[spark] Unable to map shared memory segment from peer"_lit << LOG_ASYNC;
+			return;
+		}
+
+		LOG_DEBUG_FILTER(logger_, LF_SPARK)
+			<< "[spark] Accepted shared memory connection"_lit << LOG_ASYNC;
+
+		handler_(std::move(*socket), std::move(segment));
+	});
+}
+
+void ShmAcceptor::shutdown() {
+	boost::system::error_code ec;
+	acceptor_.close(ec);
+}
+
+} // spark, ember
+
+#endif
\ No newline at end of file
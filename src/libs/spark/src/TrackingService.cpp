@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2015 - 2020 Ember
+ * Copyright (c) 2015 - 2022 Ember
  *
  * This Source Code Form is subject to the terms of the Mozilla Public
  * License, v. 2.0. If a copy of the MPL was not distributed with this
@@ -8,67 +8,275 @@
 
 #include <spark/TrackingService.h>
 #include <shared/FilterTypes.h>
-#include <algorithm>
+#include <boost/uuid/uuid_hash.hpp>
 #include <optional>
+#include <utility>
 
 namespace sc = std::chrono;
 
 namespace ember::spark::inline v1 {
 
 TrackingService::TrackingService(boost::asio::io_context& io_context, log::Logger* logger)
-                                 : io_context_(io_context), logger_(logger) { }
+                                 : requests_(INITIAL_CAPACITY), active_(0), tick_(0),
+                                   ticking_(false), shutdown_(false), timer_(io_context),
+                                   logger_(logger) { }
 
-void TrackingService::on_message(const Link& link, const Message& message) try {
-	LOG_TRACE_FILTER(logger_, LF_SPARK) << __func__ << LOG_ASYNC;
+std::size_t TrackingService::home(const boost::uuids::uuid& link, std::uint64_t sequence) const {
+	// sequences are dense, so spread them before combining with the link
+	auto hash = sequence * 0x9E3779B97F4A7C15ull;
+	hash ^= boost::uuids::hash_value(link) + (hash >> 32);
+	return hash & (requests_.size() - 1);
+}
+
+std::size_t TrackingService::find(const boost::uuids::uuid& link, std::uint64_t sequence) const {
+	const auto mask = requests_.size() - 1;
+
+	for(auto i = home(link, sequence);; i = (i + 1) & mask) {
+		const auto& request = requests_[i];
+
+		if(!request.sequence) {
+			return npos;
+		}
+
+		if(request.sequence == sequence && request.link.uuid == link) {
+			return i;
+		}
+	}
+}
+
+// lock_ must be held by the caller
+void TrackingService::insert(Request request) {
+	// keep the load factor at or below 0.5 so probe sequences stay short
+	if((active_ + 1) * 2 > requests_.size()) {
+		grow();
+	}
+
+	const auto mask = requests_.size() - 1;
+	auto i = home(request.link.uuid, request.sequence);
+
+	while(requests_[i].sequence) {
+		i = (i + 1) & mask;
+	}
+
+	requests_[i] = std::move(request);
+	++active_;
+}
+
+/*
+ * Removes the request at the given index, shifting any following entries in
+ * the same probe run back so lookups never have to skip over tombstones.
+ * lock_ must be held by the caller.
+ */
+auto TrackingService::take(std::size_t index) -> Request {
+	const auto mask = requests_.size() - 1;
+	auto request = std::move(requests_[index]);
+	auto hole = index;
+
+	for(auto i = (hole + 1) & mask; requests_[i].sequence; i = (i + 1) & mask) {
+		const auto ideal = home(requests_[i].link.uuid, requests_[i].sequence);
+
+		// only move entries that would still be reachable from their home slot
+		if(((i - ideal) & mask) >= ((i - hole) & mask)) {
+			requests_[hole] = std::move(requests_[i]);
+			hole = i;
+		}
+	}
+
+	requests_[hole] = Request{};
+	--active_;
+	return request;
+}
+
+void TrackingService::grow() {
+	auto old = std::exchange(requests_, std::vector<Request>(requests_.size() * 2));
+	active_ = 0;
+
+	for(auto& request : old) {
+		if(request.sequence) {
+			insert(std::move(request));
+		}
+	}
+}
+
+// lock_ must be held by the caller
+void TrackingService::start_timer() {
+	ticking_ = true;
+	timer_.expires_after(TICK_INTERVAL);
+	timer_.async_wait([this](const boost::system::error_code& ec) {
+		tick(ec);
+	});
+}
 
+void TrackingService::tick(const boost::system::error_code& ec) {
+	if(ec) { // timer was cancelled
+		return;
+	}
+
+	std::vector<Request> expired;
 	std::unique_lock<std::mutex> guard(lock_);
-	auto handler = std::move(handlers_.at(message.token.uuid));
-	handlers_.erase(message.token.uuid);
-	guard.unlock();
 
-	if(link != handler->link) {
-		LOG_WARN_FILTER(logger_, LF_SPARK)
-			<< "[spark] Tracked message receipient != sender" << LOG_ASYNC;
+	if(shutdown_) {
 		return;
 	}
 
-	handler->handler(link, message);
-} catch(const std::out_of_range) {
-	LOG_DEBUG_FILTER(logger_, LF_SPARK)
-		<< "[spark] Received invalid or expired tracked message" << LOG_ASYNC;
+	++tick_;
+
+	// swap the slot out so requests that haven't expired yet can be put back
+	auto& slot = wheel_[tick_ & (WHEEL_SLOTS - 1)];
+	due_.swap(slot);
+
+	for(const auto& key : due_) {
+		const auto index = find(key.link, key.sequence);
+
+		if(index == npos) { // completed or cancelled
+			continue;
+		}
+
+		if(requests_[index].expiry > tick_) { // due on a later rotation
+			slot.emplace_back(key);
+			continue;
+		}
+
+		expired.emplace_back(take(index));
+	}
+
+	due_.clear();
+
+	if(active_) {
+		start_timer();
+	} else {
+		// anything left in the wheel refers to completed requests
+		for(auto& entries : wheel_) {
+			entries.clear();
+		}
+
+		ticking_ = false;
+	}
+
+	guard.unlock();
+
+	// inform the handlers that no response was received
+	for(auto& request : expired) {
+		fail(request, detail::Waiter::Failure::TIMED_OUT);
+	}
 }
 
-void TrackingService::register_tracked(const Link& link, boost::uuids::uuid id, TrackingHandler handler,
-                                       sc::milliseconds timeout) {
+void TrackingService::on_message(const Link& link, const Message& message) {
 	LOG_TRACE_FILTER(logger_, LF_SPARK) << __func__ << LOG_ASYNC;
 
-	auto request = std::make_unique<Request>(io_context_, id, link, handler);
-	request->timer.expires_from_now(timeout);
-	request->timer.async_wait(std::bind(&TrackingService::timeout, this, id, link, std::placeholders::_1));
+	std::unique_lock<std::mutex> guard(lock_);
+	const auto index = find(link.uuid, message.token.sequence);
 
-	std::lock_guard<std::mutex> guard(lock_);
-	handlers_[id] = std::move(request);
+	if(index == npos) {
+		guard.unlock();
+
+		LOG_DEBUG_FILTER(logger_, LF_SPARK)
+			<< "[spark] Received invalid or expired tracked message"_lit << LOG_ASYNC;
+		return;
+	}
+
+	auto request = take(index);
+	guard.unlock();
+
+	complete(request, link, message);
 }
 
-void TrackingService::timeout(const boost::uuids::uuid& id, Link link, const boost::system::error_code& ec) {
-	if(ec) { // timer was cancelled
+void TrackingService::complete(Request& request, const Link& link, const Message& message) {
+	if(request.waiter) {
+		request.waiter->complete(link, message);
+	} else {
+		request.handler(link, message);
+	}
+}
+
+void TrackingService::fail(Request& request, const detail::Waiter::Failure failure) {
+	if(request.waiter) {
+		request.waiter->fail(failure);
+	} else {
+		request.handler(request.link, std::nullopt);
+	}
+}
+
+void TrackingService::register_tracked(const Link& link, std::uint64_t sequence,
+                                       TrackingHandler handler, sc::milliseconds timeout) {
+	LOG_TRACE_FILTER(logger_, LF_SPARK) << __func__ << LOG_ASYNC;
+	track(Request{ sequence, 0, link, std::move(handler) }, timeout);
+}
+
+void TrackingService::register_tracked(const Link& link, std::uint64_t sequence,
+                                       detail::Waiter& waiter, sc::milliseconds timeout) {
+	LOG_TRACE_FILTER(logger_, LF_SPARK) << __func__ << LOG_ASYNC;
+	track(Request{ sequence, 0, link, nullptr, &waiter }, timeout);
+}
+
+void TrackingService::track(Request request, sc::milliseconds timeout) {
+	// one extra tick as the first may be due almost immediately
+	const auto ticks = (timeout + TICK_INTERVAL - sc::milliseconds(1)) / TICK_INTERVAL + 1;
+
+	std::unique_lock<std::mutex> guard(lock_);
+
+	if(shutdown_) {
+		guard.unlock();
+
+		if(request.waiter) {
+			request.waiter->fail(detail::Waiter::Failure::SHUTDOWN);
+		}
+
 		return;
 	}
 
-	// inform the handler that no response was received and erase
+	request.expiry = tick_ + ticks;
+	const Key key { request.link.uuid, request.sequence };
+	const auto slot = request.expiry & (WHEEL_SLOTS - 1);
+	insert(std::move(request));
+	wheel_[slot].emplace_back(key);
+
+	if(!ticking_) {
+		start_timer();
+	}
+}
+
+/*
+ * The handler will not be invoked for a cancelled request. Returns false if
+ * the request has already completed (or is in the middle of completing).
+ */
+bool TrackingService::cancel(const Link& link, std::uint64_t sequence) {
 	std::unique_lock<std::mutex> guard(lock_);
-	auto handler = std::move(handlers_.at(id));
-	handlers_.erase(id);
+	const auto index = find(link.uuid, sequence);
+
+	if(index == npos) {
+		return false;
+	}
+
+	auto request = take(index);
 	guard.unlock();
+	return true;
+}
 
-	handler->handler(link, std::nullopt);
+std::size_t TrackingService::outstanding() {
+	std::lock_guard<std::mutex> guard(lock_);
+	return active_;
 }
 
 void TrackingService::shutdown() {
-	std::lock_guard<std::mutex> guard(lock_);
+	std::vector<Request> waiting;
+	std::unique_lock<std::mutex> guard(lock_);
+	shutdown_ = true;
+	timer_.cancel();
 
-	for(auto& handler : handlers_) {
-		handler.second->timer.cancel();
+	for(auto& request : requests_) {
+		if(request.sequence && request.waiter) {
+			waiting.emplace_back(std::move(request));
+		}
+	}
+
+	requests_.assign(requests_.size(), Request{});
+	active_ = 0;
+	guard.unlock();
+
+	// handlers are dropped, but awaiting coroutines would never be resumed
+	for(auto& request : waiting) {
+		fail(request, detail::Waiter::Failure::SHUTDOWN);
 	}
 }
 
@@ -77,7 +285,24 @@ void TrackingService::on_link_up(const Link& link) {
 }
 
 void TrackingService::on_link_down(const Link& link) {
-	// we don't care about this
+	std::vector<Request> failed;
+	std::unique_lock<std::mutex> guard(lock_);
+
+	// take() shifts later entries back into the freed slot, so don't advance past it
+	for(std::size_t i = 0; i < requests_.size();) {
+		if(requests_[i].sequence && requests_[i].link == link) {
+			failed.emplace_back(take(i));
+		} else {
+			++i;
+		}
+	}
+
+	guard.unlock();
+
+	// no response is coming, so don't make the handlers wait for the timeout
+	for(auto& request : failed) {
+		fail(request, detail::Waiter::Failure::LINK_DOWN);
+	}
 }
 
 } // spark, ember
\ No newline at end of file
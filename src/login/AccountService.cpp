@@ -7,6 +7,7 @@
  */
 
 #include "AccountService.h"
+#include <spark/DispatchTable.h>
 #include <boost/uuid/uuid.hpp>
 #include <utility>
 
@@ -51,8 +52,7 @@ void AccountService::handle_register_reply(const spark::Link& link,
                                            const RegisterCB& cb) const {
 	LOG_TRACE(logger_) << __func__ << LOG_ASYNC;
 
-	// todo, validate
-	if(!message) {
+	if(!message || !spark::verify<em::account::Response>(link, *message)) {
 		cb(em::account::Status::SERVER_LINK_ERROR);
 		return;
 	}
@@ -66,8 +66,7 @@ void AccountService::handle_locate_reply(const spark::Link& link,
                                          const LocateCB& cb) const {
 	LOG_TRACE(logger_) << __func__ << LOG_ASYNC;
 
-	// todo, validate
-	if(!message) {
+	if(!message || !spark::verify<em::account::SessionResponse>(link, *message)) {
 		cb(em::account::Status::SERVER_LINK_ERROR, 0);
 		return;
 	}
@@ -87,7 +86,7 @@ void AccountService::locate_session(std::uint32_t account_id, LocateCB cb) const
 	LOG_TRACE(logger_) << __func__ << LOG_ASYNC;
 
 	auto opcode = std::to_underlying(em::account::Opcode::CMSG_ACCOUNT_LOOKUP);
-	auto fbb = std::make_shared<flatbuffers::FlatBufferBuilder>();
+	auto fbb = spark::make_buffer();
 
 	auto builder = em::account::SessionLookupBuilder(*fbb);
 	builder.add_account_id(account_id);
@@ -105,7 +104,7 @@ void AccountService::register_session(std::uint32_t account_id, const srp6::Sess
 	LOG_TRACE(logger_) << __func__ << LOG_ASYNC;
 
 	auto opcode = std::to_underlying(messaging::account::Opcode::CMSG_REGISTER_SESSION);
-	auto fbb = std::make_shared<flatbuffers::FlatBufferBuilder>();
+	auto fbb = spark::make_buffer();
 	auto f_key = fbb->CreateVector(key.t.data(), key.t.size());
 
 	auto builder = messaging::account::RegisterSessionBuilder(*fbb);
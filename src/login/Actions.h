@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2015 - 2018 Ember
+ * Copyright (c) 2015 - 2022 Ember
  *
  * This Source Code Form is subject to the terms of the Mozilla Public
  * License, v. 2.0. If a copy of the MPL was not distributed with this
@@ -24,6 +24,7 @@ namespace ember {
 class Action {
 public:
 	virtual void execute() = 0;
+	virtual const char* timing_key() const = 0; // metrics key for the time spent in execute()
 	virtual ~Action() = default;
 };
 
@@ -48,6 +49,10 @@ public:
 	RegisterSessionAction(const AccountService& account_svc, std::uint32_t account_id, srp6::SessionKey key)
 	                      : account_svc_(account_svc), account_id_(account_id), key_(key) { }
 
+	virtual const char* timing_key() const override {
+		return "account_register_session";
+	}
+
 	virtual void execute() override try {
 		res_ = do_register().get();
 	} catch(const std::exception&) {
@@ -85,6 +90,10 @@ public:
 	FetchSessionKeyAction(const AccountService& account_svc, std::uint32_t account_id)
 	                      : account_svc_(account_svc), account_id_(account_id) {}
 
+	virtual const char* timing_key() const override {
+		return "account_fetch_session_key";
+	}
+
 	virtual void execute() override try {
 		res_ = do_fetch().get();
 	} catch(const std::exception&) {
@@ -110,6 +119,10 @@ public:
 	FetchUserAction(utf8_string username, const dal::UserDAO& user_src)
 	                : username_(std::move(username)), user_src_(user_src) {}
 
+	virtual const char* timing_key() const override {
+		return "db_fetch_user";
+	}
+
 	virtual void execute() override try {
 		user_ = user_src_.user(username_);
 	} catch(const dal::exception&) {
@@ -140,6 +153,10 @@ public:
 	FetchCharacterCounts(std::uint32_t user_id, const dal::UserDAO& user_src, bool reconnect = false)
 	                     : user_id_(user_id), user_src_(user_src), reconnect_(reconnect) {}
 
+	virtual const char* timing_key() const override {
+		return "db_character_counts";
+	}
+
 	virtual void execute() override try {
 		counts_ = user_src_.character_counts(user_id_);
 	} catch(const dal::exception&) {
@@ -172,6 +189,10 @@ public:
 	                 std::string data) : user_src_(user_src), user_id_(user_id), survey_id_(survey_id),
 	                                     data_(std::move(data)), error_(false) { }
 
+	virtual const char* timing_key() const override {
+		return "db_save_survey";
+	}
+
 	virtual void execute() override try {
 		user_src_.save_survey(user_id_, survey_id_, data_);
 	} catch(const dal::exception& e) {
@@ -265,6 +265,7 @@ void LoginHandler::send_reconnect_proof(grunt::Result result) {
 
 	if(result == grunt::Result::SUCCESS) {
 		metrics_.increment("login_success");
+		record_handshake_time();
 	} else {
 		metrics_.increment("login_failure");
 	}
@@ -426,6 +427,12 @@ void LoginHandler::handle_login_proof(const grunt::Packet& packet) {
 	}
 }
 
+// from the connection being accepted to the client being told it's authenticated
+void LoginHandler::record_handshake_time() {
+	const auto elapsed = std::chrono::steady_clock::now() - started_;
+	metrics_.timing("login_handshake", std::chrono::duration_cast<std::chrono::milliseconds>(elapsed));
+}
+
 void LoginHandler::send_login_proof(grunt::Result result, bool survey) {
 	LOG_TRACE(logger_) << __func__ << LOG_ASYNC;
 
@@ -434,6 +441,7 @@ void LoginHandler::send_login_proof(grunt::Result result, bool survey) {
 
 	if(result == grunt::Result::SUCCESS) {
 		metrics_.increment("login_success");
+		record_handshake_time();
 		response.M2 = server_proof_;
 		response.survey_id = survey? patcher_.survey_id() : 0;
 	} else {
@@ -21,6 +21,7 @@
 #include <shared/database/daos/UserDAO.h>
 #include <botan/bigint.h>
 #include <botan/secmem.h>
+#include <chrono>
 #include <fstream>
 #include <functional>
 #include <memory>
@@ -81,6 +82,7 @@ class LoginHandler {
 	grunt::client::LoginChallenge challenge_;
 	TransferState transfer_state_;
 	const bool locale_enforce_;
+	const std::chrono::steady_clock::time_point started_ = std::chrono::steady_clock::now();
 
 	void initiate_login(const grunt::Packet& packet);
 	void initiate_file_transfer(const FileMeta& meta);
@@ -117,6 +119,7 @@ class LoginHandler {
 	void fetch_user(grunt::Opcode opcode, const utf8_string& username);
 	void fetch_session_key(const FetchUserAction& action);
 
+	void record_handshake_time();
 	void reject_client(const GameVersion& version);
 	void patch_client(const grunt::client::LoginChallenge& version);
 
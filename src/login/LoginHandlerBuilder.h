@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2015 - 2021 Ember
+ * Copyright (c) 2015 - 2022 Ember
  *
  * This Source Code Form is subject to the terms of the Mozilla Public
  * License, v. 2.0. If a copy of the MPL was not distributed with this
@@ -44,6 +44,10 @@ public:
 		return { user_dao_, acct_svc_, patcher_, exe_data_, logger_, realm_list_, std::move(source),
 		         metrics_, locale_enforce_ };
 	}
+
+	Metrics& metrics() const {
+		return metrics_;
+	}
 };
 
 } // ember
\ No newline at end of file
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2015 - 2020 Ember
+ * Copyright (c) 2015 - 2022 Ember
  *
  * This Source Code Form is subject to the terms of the Mozilla Public
  * License, v. 2.0. If a copy of the MPL was not distributed with this
@@ -12,18 +12,42 @@
 #include <shared/metrics/Metrics.h>
 #include <shared/threading/ThreadPool.h>
 #include <boost/asio/post.hpp>
+#include <chrono>
 #include <exception>
 #include <functional>
 #include <memory>
+#include <string>
+#include <unordered_map>
 #include <utility>
 
 namespace ember {
 
+namespace {
+
+// built once so handling a packet never has to put a metrics key together
+const auto handler_keys = [] {
+	std::unordered_map<std::uint8_t, std::string> keys;
+
+	for(const auto& [opcode, name] : grunt::Opcode_enum_names) {
+		keys.emplace(opcode, "handler_" + name);
+	}
+
+	return keys;
+}();
+
+const char* handler_key(const grunt::Opcode opcode) {
+	const auto it = handler_keys.find(std::to_underlying(opcode));
+	return it == handler_keys.end()? "handler_unknown" : it->second.c_str();
+}
+
+} // unnamed
+
 LoginSession::LoginSession(SessionManager& sessions, boost::asio::ip::tcp::socket socket,
                            boost::asio::ip::tcp::endpoint ep, log::Logger* logger,
                            ThreadPool& pool, const LoginHandlerBuilder& builder)
                            : handler_(builder.create(remote_address())),
-                             logger_(logger), pool_(pool), grunt_handler_(logger),
+                             logger_(logger), metrics_(builder.metrics()), pool_(pool),
+                             grunt_handler_(logger),
                              NetworkSession(sessions, std::move(socket), std::move(ep), logger) {
 	handler_.send = [&](auto& packet) {
 		write_chain(packet, false);
@@ -46,7 +70,13 @@ bool LoginSession::handle_packet(spark::Buffer& buffer) try {
 	if(packet) {
 		LOG_TRACE_FILTER(logger_, LF_NETWORK) << remote_address() << " -> "
 			<< grunt::to_string(packet->opcode) << LOG_ASYNC;
-		return handler_.update_state(*packet);
+
+		const auto start = std::chrono::steady_clock::now();
+		const auto result = handler_.update_state(*packet);
+		const auto elapsed = std::chrono::steady_clock::now() - start;
+		metrics_.timing(handler_key(packet->opcode),
+			std::chrono::duration_cast<std::chrono::microseconds>(elapsed));
+		return result;
 	}
 
 	return true;
@@ -60,13 +90,23 @@ void LoginSession::execute_async(const std::shared_ptr<Action>& action) {
 
 	auto self(shared_from_this());
 
-	pool_.run([action, this, self] {
+	const auto queued = pool_.run_blocking([action, this, self] {
+		const auto start = std::chrono::steady_clock::now();
 		action->execute();
+		const auto elapsed = std::chrono::steady_clock::now() - start;
+		metrics_.timing(action->timing_key(),
+			std::chrono::duration_cast<std::chrono::milliseconds>(elapsed));
 
 		boost::asio::post(get_executor(), [action, this, self] {
 			async_completion(action);
 		});
 	});
+
+	// the database isn't keeping up, so turn the client away rather than queue it
+	if(!queued) {
+		LOG_WARN(logger_) << "Blocking queue full, dropping " << remote_address() << LOG_ASYNC;
+		close_session();
+	}
 }
 
 void LoginSession::async_completion(const std::shared_ptr<Action>& action) try {
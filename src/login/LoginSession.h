@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2015 - 2021 Ember
+ * Copyright (c) 2015 - 2022 Ember
  *
  * This Source Code Form is subject to the terms of the Mozilla Public
  * License, v. 2.0. If a copy of the MPL was not distributed with this
@@ -21,6 +21,7 @@ namespace ember {
 
 class LoginHandlerBuilder;
 class ThreadPool;
+class Metrics;
 
 class LoginSession final : public NetworkSession {
 	void async_completion(const std::shared_ptr<Action>& action);
@@ -31,6 +32,7 @@ public:
 	ThreadPool& pool_;
 	LoginHandler handler_;
 	log::Logger* logger_;
+	Metrics& metrics_;
 	grunt::Handler grunt_handler_;
 
 	LoginSession(SessionManager& sessions, boost::asio::ip::tcp::socket socket,
@@ -17,7 +17,7 @@ namespace ember {
 RealmService::RealmService(RealmList& realms, spark::Service& spark,
                            spark::ServiceDiscovery& s_disc, log::Logger* logger)
                            : realms_(realms), spark_(spark), s_disc_(s_disc), logger_(logger) {
-	REGISTER(em::realm::Opcode::SMSG_REALM_STATUS, em::realm::RealmStatus, RealmService::handle_realm_status);
+	handlers_.add<em::realm::Opcode::SMSG_REALM_STATUS, &RealmService::handle_realm_status>(this);
 
 	spark_.dispatcher()->register_handler(
 		this, em::Service::GATEWAY,
@@ -35,51 +35,44 @@ RealmService::~RealmService() {
 }
 
 void RealmService::on_message(const spark::Link& link, const spark::Message& message) {
-	auto handler = handlers_.find(static_cast<messaging::realm::Opcode>(message.opcode));
+	const auto result = handlers_.dispatch(link, message);
 
-	if(handler == handlers_.end()) {
+	if(result == em::realm::DispatchTable::Result::UNHANDLED) {
 		LOG_WARN_FILTER(logger_, LF_SPARK)
 			<< "Unhandled realm message from "
 			<< link.description << LOG_ASYNC;
-		return;
-	}
-
-	if(!handler->second.verify(message)) {
+	} else if(result == em::realm::DispatchTable::Result::BAD_MESSAGE) {
 		LOG_WARN_FILTER(logger_, LF_SPARK)
 			<< "Bad message received from "
 			<< link.description << LOG_ASYNC;
-		return;
 	}
-
-	handler->second.handle(link, message);
 }
 
-void RealmService::handle_realm_status(const spark::Link& link, const spark::Message& message) {
+void RealmService::handle_realm_status(const spark::Link& link, const spark::Message& message,
+                                       const messaging::realm::RealmStatus& data) {
 	LOG_TRACE(logger_) << __func__ << LOG_ASYNC;
 
-	auto data = flatbuffers::GetRoot<messaging::realm::RealmStatus>(message.data);
-
-	if(!data->name() || !data->id() || !data->ip()) {
+	if(!data.name() || !data.id() || !data.ip()) {
 		LOG_WARN(logger_) << "Incompatible realm status update from " << link.description << LOG_ASYNC;
 		return;
 	}
 
 	// update everything rather than bothering to only set changed fields
 	Realm realm;
-	realm.id = data->id();
-	realm.ip = data->ip()->str();
-	realm.name = data->name()->str();
-	realm.population = data->population();
-	realm.type = static_cast<Realm::Type>(data->type());
-	realm.flags = static_cast<Realm::Flags>(data->flags());
-	realm.category = static_cast<dbc::Cfg_Categories::Category>(data->category());
-	realm.region = static_cast<dbc::Cfg_Categories::Region>(data->region());
+	realm.id = data.id();
+	realm.ip = data.ip()->str();
+	realm.name = data.name()->str();
+	realm.population = data.population();
+	realm.type = static_cast<Realm::Type>(data.type());
+	realm.flags = static_cast<Realm::Flags>(data.flags());
+	realm.category = static_cast<dbc::Cfg_Categories::Category>(data.category());
+	realm.region = static_cast<dbc::Cfg_Categories::Region>(data.region());
 	realms_.add_realm(realm);
 
 	LOG_INFO(logger_) << "Updated realm information for " << realm.name << LOG_ASYNC;
 
 	// keep track of this link's realm ID so we can mark it as offline if it disappears
-	known_realms_[link.uuid] = data->id();
+	known_realms_[link.uuid] = data.id();
 }
 
 void RealmService::on_link_up(const spark::Link& link) {
@@ -117,7 +110,7 @@ void RealmService::request_realm_status(const spark::Link& link) {
 	LOG_TRACE(logger_) << __func__ << LOG_ASYNC;
 
 	const auto opcode = std::to_underlying(messaging::realm::Opcode::CMSG_REALM_STATUS);
-	auto fbb = std::make_shared<flatbuffers::FlatBufferBuilder>();
+	auto fbb = spark::make_buffer();
 	messaging::realm::RequestRealmStatusBuilder msg(*fbb);
 	msg.Finish();
 
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2015 Ember
+ * Copyright (c) 2015 - 2022 Ember
  *
  * This Source Code Form is subject to the terms of the Mozilla Public
  * License, v. 2.0. If a copy of the MPL was not distributed with this
@@ -8,10 +8,9 @@
 
 #pragma once
 
-#include "RealmStatus_generated.h"
+#include "RealmStatus_dispatch.h"
 #include <spark/Service.h>
 #include <spark/ServiceDiscovery.h>
-#include <spark/Helpers.h>
 #include <logger/Logging.h>
 #include <boost/uuid/uuid.hpp>
 #include <boost/uuid/uuid_generators.hpp>
@@ -31,14 +30,15 @@ class RealmService final : public spark::EventHandler {
 	log::Logger* logger_;
 	std::unique_ptr<spark::ServiceListener> listener_;
 	std::unordered_map<boost::uuids::uuid, std::uint32_t, boost::hash<boost::uuids::uuid>> known_realms_;
-	std::unordered_map<messaging::realm::Opcode, spark::LocalDispatcher> handlers_;
+	messaging::realm::DispatchTable handlers_;
 
 	spark::Link link_;
 
 	void service_located(const messaging::multicast::LocateResponse* message);
 	void request_realm_status(const spark::Link& link);
 	void mark_realm_offline(const spark::Link& link);
-	void handle_realm_status(const spark::Link& link, const spark::Message& message);
+	void handle_realm_status(const spark::Link& link, const spark::Message& message,
+	                         const messaging::realm::RealmStatus& data);
 
 public:
 	RealmService(RealmList& realms, spark::Service& spark, spark::ServiceDiscovery& s_disc, log::Logger* logger);
@@ -26,9 +26,11 @@
 #include <shared/Banner.h>
 #include <shared/util/LogConfig.h>
 #include <shared/util/Utility.h>
+#include <shared/metrics/MetricsExporter.h>
 #include <shared/metrics/MetricsImpl.h>
 #include <shared/metrics/Monitor.h>
 #include <shared/metrics/MetricsPoll.h>
+#include <shared/metrics/PoolMetrics.h>
 #include <shared/threading/ThreadPool.h>
 #include <shared/database/daos/IPBanDAO.h>
 #include <shared/database/daos/PatchDAO.h>
@@ -177,9 +179,29 @@ int launch(const po::variables_map& args, el::Logger* logger) try {
 	// Start ASIO service
 	LOG_INFO(logger) << "Starting thread pool with " << concurrency << " threads..." << LOG_SYNC;
 
-	ember::ThreadPool thread_pool(concurrency);
+	ember::ThreadPool thread_pool(concurrency, max_conns);
 	boost::asio::io_context service(concurrency);
 
+	// Start metrics service
+	auto metrics = std::make_unique<ember::Metrics>();
+
+	if(args["metrics.enabled"].as<bool>()) {
+		LOG_INFO(logger) << "Starting metrics service..." << LOG_SYNC;
+		metrics = std::make_unique<ember::MetricsImpl>(
+			service, args["metrics.statsd_host"].as<std::string>(),
+			args["metrics.statsd_port"].as<std::uint16_t>()
+		);
+	}
+
+	if(const auto port = args["metrics.prometheus_port"].as<std::uint16_t>()) {
+		LOG_INFO(logger) << "Starting metrics exporter..." << LOG_SYNC;
+		metrics = std::make_unique<ember::MetricsExporter>(
+			service, args["metrics.prometheus_interface"].as<std::string>(), port, std::move(metrics)
+		);
+	}
+
+	ember::util::LogMetrics log_metrics(*logger, *metrics);
+
 	// Start Spark services
 	LOG_INFO(logger) << "Starting Spark service..." << LOG_SYNC;
 	auto s_address = args["spark.address"].as<std::string>();
@@ -189,24 +211,14 @@ int launch(const po::variables_map& args, el::Logger* logger) try {
 	auto mcast_port = args["spark.multicast_port"].as<std::uint16_t>();
 	auto spark_filter = el::Filter(ember::FilterType::LF_SPARK);
 
-	es::Service spark("login", service, s_address, s_port, logger);
+	es::Service spark("login", service, s_address, s_port, logger, es::Transport::V1,
+	                  es::CompressionPolicy::supported(), {}, metrics.get());
 	es::ServiceDiscovery discovery(service, s_address, s_port, mcast_iface, mcast_group,
 	                               mcast_port, logger);
 
 	ember::AccountService acct_svc(spark, discovery, logger);
 	ember::RealmService realm_svc(realm_list, spark, discovery, logger);
 
-	// Start metrics service
-	auto metrics = std::make_unique<ember::Metrics>();
-
-	if(args["metrics.enabled"].as<bool>()) {
-		LOG_INFO(logger) << "Starting metrics service..." << LOG_SYNC;
-		metrics = std::make_unique<ember::MetricsImpl>(
-			service, args["metrics.statsd_host"].as<std::string>(),
-			args["metrics.statsd_port"].as<std::uint16_t>()
-		);
-	}
-
 	// Start login server
 	ember::LoginHandlerBuilder builder(logger, patcher, exe_data.get(), *user_dao, acct_svc,
 	                                   realm_list, *metrics, args["locale.enforce"].as<bool>());
@@ -247,6 +259,12 @@ int launch(const po::variables_map& args, el::Logger* logger) try {
 		metrics.gauge("sessions", server.connection_count());
 	}, 5s);
 
+	ember::PoolMetrics pool_metrics(thread_pool);
+
+	poller.add_source([&pool_metrics](ember::Metrics& metrics) {
+		pool_metrics.report(metrics);
+	}, 5s);
+
 	service.dispatch([logger]() {
 		LOG_INFO(logger) << APP_NAME << " started successfully" << LOG_SYNC;
 	});
@@ -330,12 +348,19 @@ po::variables_map parse_arguments(int argc, const char* argv[]) {
 		("file_log.midnight_rotate", po::bool_switch()->required())
 		("file_log.log_timestamp", po::value<bool>()->required())
 		("file_log.log_severity", po::value<bool>()->required())
+		("file_log.fsync_severity", po::value<std::string>()->default_value("none"))
+		("file_log.compress", po::value<bool>()->default_value(false))
+		("file_log.retain_files", po::value<std::uint32_t>()->default_value(0))
+		("file_log.retain_days", po::value<std::uint32_t>()->default_value(0))
+		("file_log.retain_size", po::value<std::uint32_t>()->default_value(0))
 		("database.config_path", po::value<std::string>()->required())
 		("database.min_connections", po::value<unsigned short>()->required())
 		("database.max_connections", po::value<unsigned short>()->required())
 		("metrics.enabled", po::value<bool>()->required())
 		("metrics.statsd_host", po::value<std::string>()->required())
 		("metrics.statsd_port", po::value<std::uint16_t>()->required())
+		("metrics.prometheus_interface", po::value<std::string>()->default_value("127.0.0.1"))
+		("metrics.prometheus_port", po::value<std::uint16_t>()->default_value(0))
 		("monitor.enabled", po::value<bool>()->required())
 		("monitor.interface", po::value<std::string>()->required())
 		("monitor.port", po::value<std::uint16_t>()->required());
@@ -146,6 +146,11 @@ po::variables_map parse_arguments(int argc, const char* argv[]) {
 		("file_log.midnight_rotate", po::value<bool>()->required())
 		("file_log.log_timestamp", po::value<bool>()->required())
 		("file_log.log_severity", po::value<bool>()->required())
+		("file_log.fsync_severity", po::value<std::string>()->default_value("none"))
+		("file_log.compress", po::value<bool>()->default_value(false))
+		("file_log.retain_files", po::value<std::uint32_t>()->default_value(0))
+		("file_log.retain_days", po::value<std::uint32_t>()->default_value(0))
+		("file_log.retain_size", po::value<std::uint32_t>()->default_value(0))
 		("metrics.enabled", po::value<bool>()->required())
 		("metrics.statsd_host", po::value<std::string>()->required())
 		("metrics.statsd_port", po::value<std::uint16_t>()->required());
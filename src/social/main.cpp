@@ -14,6 +14,7 @@
 #include <spark/ServiceDiscovery.h>
 #include <shared/Banner.h>
 #include <shared/util/LogConfig.h>
+#include <shared/metrics/MetricsExporter.h>
 #include <shared/metrics/MetricsImpl.h>
 #include <shared/metrics/Monitor.h>
 #include <shared/threading/ThreadPool.h>
@@ -72,19 +73,7 @@ int launch(const po::variables_map& args, el::Logger* logger) try {
 	LOG_WARN(logger) << "Compiled with DEBUG_NO_THREADS!" << LOG_SYNC;
 #endif
 
-	// Start Spark services
-	LOG_INFO(logger) << "Starting Spark service..." << LOG_SYNC;
-	auto s_address = args["spark.address"].as<std::string>();
-	auto s_port = args["spark.port"].as<std::uint16_t>();
-	auto mcast_group = args["spark.multicast_group"].as<std::string>();
-	auto mcast_iface = args["spark.multicast_interface"].as<std::string>();
-	auto mcast_port = args["spark.multicast_port"].as<std::uint16_t>();
-	auto spark_filter = el::Filter(ember::FilterType::LF_SPARK);
-
 	boost::asio::io_context service;
-	es::Service spark("social", service, s_address, s_port, logger);
-	es::ServiceDiscovery discovery(service, s_address, s_port, mcast_iface, mcast_group,
-	                               mcast_port, logger);
 
 	// Start metrics service
 	auto metrics = std::make_unique<ember::Metrics>();
@@ -97,6 +86,29 @@ int launch(const po::variables_map& args, el::Logger* logger) try {
 		);
 	}
 
+	if(const auto port = args["metrics.prometheus_port"].as<std::uint16_t>()) {
+		LOG_INFO(logger) << "Starting metrics exporter..." << LOG_SYNC;
+		metrics = std::make_unique<ember::MetricsExporter>(
+			service, args["metrics.prometheus_interface"].as<std::string>(), port, std::move(metrics)
+		);
+	}
+
+	ember::util::LogMetrics log_metrics(*logger, *metrics);
+
+	// Start Spark services
+	LOG_INFO(logger) << "Starting Spark service..." << LOG_SYNC;
+	auto s_address = args["spark.address"].as<std::string>();
+	auto s_port = args["spark.port"].as<std::uint16_t>();
+	auto mcast_group = args["spark.multicast_group"].as<std::string>();
+	auto mcast_iface = args["spark.multicast_interface"].as<std::string>();
+	auto mcast_port = args["spark.multicast_port"].as<std::uint16_t>();
+	auto spark_filter = el::Filter(ember::FilterType::LF_SPARK);
+
+	es::Service spark("social", service, s_address, s_port, logger, es::Transport::V1,
+	                  es::CompressionPolicy::supported(), {}, metrics.get());
+	es::ServiceDiscovery discovery(service, s_address, s_port, mcast_iface, mcast_group,
+	                               mcast_port, logger);
+
 	// Start monitoring service
 	std::unique_ptr<ember::Monitor> monitor;
 
@@ -162,12 +174,19 @@ po::variables_map parse_arguments(int argc, const char* argv[]) {
 		("file_log.midnight_rotate", po::value<bool>()->required())
 		("file_log.log_timestamp", po::value<bool>()->required())
 		("file_log.log_severity", po::value<bool>()->required())
+		("file_log.fsync_severity", po::value<std::string>()->default_value("none"))
+		("file_log.compress", po::value<bool>()->default_value(false))
+		("file_log.retain_files", po::value<std::uint32_t>()->default_value(0))
+		("file_log.retain_days", po::value<std::uint32_t>()->default_value(0))
+		("file_log.retain_size", po::value<std::uint32_t>()->default_value(0))
 		("database.config_path", po::value<std::string>()->required())
 		("database.min_connections", po::value<unsigned short>()->required())
 		("database.max_connections", po::value<unsigned short>()->required())
 		("metrics.enabled", po::value<bool>()->required())
 		("metrics.statsd_host", po::value<std::string>()->required())
 		("metrics.statsd_port", po::value<std::uint16_t>()->required())
+		("metrics.prometheus_interface", po::value<std::string>()->default_value("127.0.0.1"))
+		("metrics.prometheus_port", po::value<std::uint16_t>()->default_value(0))
 		("monitor.enabled", po::value<bool>()->required())
 		("monitor.interface", po::value<std::string>()->required())
 		("monitor.port", po::value<std::uint16_t>()->required());
@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "DispatchGenerator.h"
+#include "Printer.h"
+#include <boost/algorithm/string/join.hpp>
+#include <boost/algorithm/string/replace.hpp>
+#include <boost/algorithm/string/split.hpp>
+#include <algorithm>
+
+namespace ember {
+
+namespace {
+
+std::string cpp_namespace(const std::string& name_space) {
+	return boost::algorithm::replace_all_copy(name_space, ".", "::");
+}
+
+// matches the closing comments used throughout, e.g. "} // core, messaging, ember"
+std::string closing_comment(const std::string& name_space) {
+	std::vector<std::string> parts;
+	boost::algorithm::split(parts, name_space, [](const char c) { return c == '.'; });
+	std::reverse(parts.begin(), parts.end());
+	return boost::algorithm::join(parts, ", ");
+}
+
+void generate_service(Printer& printer, const ServiceSchema& service) {
+	const auto ns = cpp_namespace(service.name_space);
+
+	for(const auto& [opcode, message] : service.opcodes) {
+		printer.print("template<>");
+		printer.print("struct MessageType<" + ns + "::Opcode::" + opcode + "> {");
+		printer.indent();
+		printer.print("using type = " + ns + "::" + message + ";");
+		printer.outdent();
+		printer.print("};");
+		printer.print("");
+	}
+}
+
+} // unnamed
+
+std::string generate_dispatch(const std::string& schema_name,
+                              const std::vector<ServiceSchema>& services) {
+	Printer printer;
+	printer.print("// automatically generated by sparkc from " + schema_name + ".bfbs, do not modify");
+	printer.print("");
+	printer.print("#pragma once");
+	printer.print("");
+	printer.print("#include \"" + schema_name + "_generated.h\"");
+	printer.print("#include <spark/DispatchTable.h>");
+	printer.print("");
+	printer.print("namespace ember::spark::inline v1 {");
+	printer.print("");
+
+	for(const auto& service : services) {
+		generate_service(printer, service);
+	}
+
+	printer.print("} // spark, ember");
+
+	for(const auto& service : services) {
+		printer.print("");
+		printer.print("namespace " + cpp_namespace(service.name_space) + " {");
+		printer.print("");
+		printer.print("using DispatchTable = spark::DispatchTable<Opcode>;");
+		printer.print("");
+		printer.print("} // " + closing_comment(service.name_space));
+	}
+
+	return printer.output();
+}
+
+} // ember
\ No newline at end of file
@@ -0,0 +1,24 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include "SchemaParser.h"
+#include <string>
+#include <vector>
+
+namespace ember {
+
+/*
+ * Generates the opcode to message mappings used by spark::DispatchTable,
+ * alongside the header produced by flatc for the same schema
+ */
+std::string generate_dispatch(const std::string& schema_name,
+                              const std::vector<ServiceSchema>& services);
+
+} // ember
\ No newline at end of file
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2021 Ember
+ * Copyright (c) 2021 - 2022 Ember
  *
  * This Source Code Form is subject to the terms of the Mozilla Public
  * License, v. 2.0. If a copy of the MPL was not distributed with this
@@ -7,19 +7,33 @@
  */
 
 #include "SchemaParser.h"
+#include <logger/Logging.h>
 #include <flatbuffers/reflection.h>
 #include <flatbuffers/reflection_generated.h>
 #include <stdexcept>
-#include <iostream>
+#include <string_view>
+#include <utility>
 
 namespace ember {
 
+namespace {
+
+constexpr std::string_view OPCODE_ENUM = "Opcode";
+constexpr std::string_view MESSAGE_ATTRIBUTE = "message";
+
+const char* message_attribute(const reflection::EnumVal& value) {
+	if(!value.attributes()) {
+		return nullptr;
+	}
+
+	const auto attribute = value.attributes()->LookupByKey(MESSAGE_ATTRIBUTE.data());
+	return attribute && attribute->value()? attribute->value()->c_str() : nullptr;
+}
+
+} // unnamed
+
 SchemaParser::SchemaParser(std::vector<std::uint8_t> buffer) : buffer_(std::move(buffer)) {
 	verify();
-
-	auto& s = *reflection::GetSchema(buffer_.data());
-	auto root_table = s.root_table();
-	std::cout << root_table->name()->c_str();
 }
 
 void SchemaParser::verify() {
@@ -30,4 +44,49 @@ void SchemaParser::verify() {
 	}
 }
 
+/*
+ * Reflection names are fully qualified, so a service's Opcode enum is
+ * ember.messaging.foo.Opcode and the tables it names are expected to be
+ * declared in the same namespace.
+ */
+std::vector<ServiceSchema> SchemaParser::services() const {
+	const auto schema = reflection::GetSchema(buffer_.data());
+	std::vector<ServiceSchema> services;
+
+	for(const auto enum_ : *schema->enums()) {
+		const std::string_view name = enum_->name()->string_view();
+		const auto pos = name.rfind('.');
+
+		if(pos == std::string_view::npos || name.substr(pos + 1) != OPCODE_ENUM) {
+			continue;
+		}
+
+		ServiceSchema service { std::string(name.substr(0, pos)) };
+
+		for(const auto value : *enum_->values()) {
+			const auto message = message_attribute(*value);
+
+			if(!message) {
+				LOG_WARN_GLOB << name << "::" << value->name()->str()
+				              << " has no message attribute, skipping" << LOG_SYNC;
+				continue;
+			}
+
+			const auto qualified = service.name_space + "." + message;
+			const auto object = schema->objects()->LookupByKey(qualified.c_str());
+
+			if(!object || object->is_struct()) {
+				throw std::runtime_error("Unknown table " + qualified + " for "
+				                         + std::string(name) + "::" + value->name()->str());
+			}
+
+			service.opcodes.emplace_back(value->name()->str(), message);
+		}
+
+		services.emplace_back(std::move(service));
+	}
+
+	return services;
+}
+
 } // ember
\ No newline at end of file
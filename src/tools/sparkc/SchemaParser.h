@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2021 Ember
+ * Copyright (c) 2021 - 2022 Ember
  *
  * This Source Code Form is subject to the terms of the Mozilla Public
  * License, v. 2.0. If a copy of the MPL was not distributed with this
@@ -8,16 +8,29 @@
 
 #pragma once
 
-#include "Printer.h"
+#include <string>
 #include <vector>
 #include <cstdint>
 
 namespace ember {
 
+struct OpcodeMapping {
+	std::string opcode;
+	std::string message;
+};
+
+// a service's Opcode enum, along with the table each opcode carries
+struct ServiceSchema {
+	std::string name_space;
+	std::vector<OpcodeMapping> opcodes;
+};
+
 class SchemaParser {
 public:
 	explicit SchemaParser(std::vector<std::uint8_t> buffer);
 
+	std::vector<ServiceSchema> services() const;
+
 private:
 	std::vector<std::uint8_t> buffer_;
 
@@ -1,16 +1,18 @@
 /*
- * Copyright (c) 2021 Ember
+ * Copyright (c) 2021 - 2022 Ember
  *
  * This Source Code Form is subject to the terms of the Mozilla Public
  * License, v. 2.0. If a copy of the MPL was not distributed with this
  * file, You can obtain one at http://mozilla.org/MPL/2.0/.
  */
 
+#include "DispatchGenerator.h"
 #include "SchemaParser.h"
 #include <logger/Logging.h>
 #include <logger/ConsoleSink.h>
 #include <logger/FileSink.h>
 #include <boost/program_options.hpp>
+#include <filesystem>
 #include <iostream>
 #include <string>
 #include <fstream>
@@ -18,9 +20,10 @@
 
 namespace po = boost::program_options;
 namespace el = ember::log;
+namespace fs = std::filesystem;
 
 int launch(const po::variables_map& args);
-void process_schema(const std::string& schema);
+void process_schema(const std::string& schema, const std::string& output);
 void init_logger(ember::log::Logger* logger, const po::variables_map& args);
 po::variables_map parse_arguments(int argc, const char* argv[]);
 
@@ -39,7 +42,7 @@ int launch(const po::variables_map& args) try {
 
 	for(const auto& schema : args["schemas"].as<std::vector<std::string>>()) {
 		LOG_INFO_GLOB << "Processing " << schema << LOG_SYNC;
-		process_schema(schema);
+		process_schema(schema, output);
 	}
 
 	return EXIT_SUCCESS;
@@ -48,7 +51,7 @@ int launch(const po::variables_map& args) try {
 	return EXIT_FAILURE;
 }
 
-void process_schema(const std::string& schema) {
+void process_schema(const std::string& schema, const std::string& output) {
 	std::vector<std::uint8_t> buffer;
 	std::ifstream file(schema, std::ios::in | std::ios::binary | std::ios::ate);
 
@@ -65,6 +68,29 @@ void process_schema(const std::string& schema) {
 	}
 
 	ember::SchemaParser parser(buffer);
+	const auto services = parser.services();
+
+	// nothing to dispatch, e.g. schemas that are only included by others
+	if(services.empty()) {
+		LOG_DEBUG_GLOB << "No opcodes found in " << schema << LOG_SYNC;
+		return;
+	}
+
+	const auto name = fs::path(schema).stem().string();
+	const auto path = fs::path(output) / (name + "_dispatch.h");
+	std::ofstream out(path, std::ios::out | std::ios::trunc);
+
+	if(!out.is_open()) {
+		throw std::runtime_error("Unable to open " + path.string() + " for writing");
+	}
+
+	out << ember::generate_dispatch(name, services);
+
+	if(!out) {
+		throw std::runtime_error("Unable to write " + path.string());
+	}
+
+	LOG_INFO_GLOB << "Generated " << path.string() << LOG_SYNC;
 }
 
 void init_logger(ember::log::Logger* logger, const po::variables_map& args) {
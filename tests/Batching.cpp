@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "Core_generated.h"
+#include <spark/Batching.h>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace spark = ember::spark;
+namespace em = ember::messaging;
+using spark::BatchPolicy;
+using spark::detail::Batcher;
+using Result = Batcher::Result;
+
+namespace {
+
+spark::BufferHandle banner(const std::string& description) {
+	auto fbb = spark::make_buffer();
+	auto desc = fbb->CreateString(description);
+	auto msg = em::core::CreateBanner(*fbb, desc);
+	fbb->Finish(msg);
+	return fbb;
+}
+
+struct Writer {
+	std::vector<spark::BufferHandle> written;
+	bool accept = true;
+
+	bool operator()(const spark::BufferHandle& fbb) {
+		if(accept) {
+			written.emplace_back(fbb);
+		}
+
+		return accept;
+	}
+};
+
+BatchPolicy policy() {
+	BatchPolicy policy;
+	policy.enabled = true;
+	policy.max_message = 128;
+	policy.flush_size = 1024;
+	return policy;
+}
+
+std::vector<std::string> unpack(const spark::BufferHandle& fbb) {
+	std::vector<std::string> descriptions;
+	const auto batch = em::core::GetBatch(fbb->GetBufferPointer());
+
+	for(const auto entry : *batch->frames()) {
+		const auto msg = flatbuffers::GetRoot<em::core::Banner>(entry->frame()->data());
+		descriptions.emplace_back(msg->description()->str());
+	}
+
+	return descriptions;
+}
+
+} // unnamed
+
+TEST(Batching, HoldsUntilFlushed) {
+	Batcher batcher(policy());
+	Writer writer;
+
+	ASSERT_EQ(Result::HELD_FIRST, batcher.write(banner("a"), writer));
+	ASSERT_EQ(Result::HELD, batcher.write(banner("b"), writer));
+	ASSERT_EQ(Result::HELD, batcher.write(banner("c"), writer));
+	ASSERT_TRUE(writer.written.empty());
+
+	ASSERT_TRUE(batcher.flush(writer));
+	ASSERT_EQ(1, writer.written.size());
+
+	const auto& out = writer.written.front();
+	ASSERT_TRUE(Batcher::batched(out->GetBufferPointer(), out->GetSize()));
+
+	flatbuffers::Verifier verifier(out->GetBufferPointer(), out->GetSize());
+	ASSERT_TRUE(em::core::VerifyBatchBuffer(verifier));
+	ASSERT_EQ((std::vector<std::string>{ "a", "b", "c" }), unpack(out));
+
+	// nothing left to send
+	ASSERT_TRUE(batcher.flush(writer));
+	ASSERT_EQ(1, writer.written.size());
+	ASSERT_EQ(1, batcher.stats().batches);
+}
+
+TEST(Batching, SingleMessageNotWrapped) {
+	Batcher batcher(policy());
+	Writer writer;
+	const auto msg = banner("a");
+
+	ASSERT_EQ(Result::HELD_FIRST, batcher.write(msg, writer));
+	ASSERT_TRUE(batcher.flush(writer));
+	ASSERT_EQ(1, writer.written.size());
+	ASSERT_EQ(msg.get(), writer.written.front().get());
+	ASSERT_FALSE(Batcher::batched(msg->GetBufferPointer(), msg->GetSize()));
+}
+
+TEST(Batching, LargeMessageKeepsOrder) {
+	Batcher batcher(policy());
+	Writer writer;
+	const auto large = banner(std::string(256, 'x'));
+
+	batcher.write(banner("a"), writer);
+	batcher.write(banner("b"), writer);
+	ASSERT_EQ(Result::WRITTEN, batcher.write(large, writer));
+
+	// whatever was held back has to go out ahead of it
+	ASSERT_EQ(2, writer.written.size());
+	ASSERT_EQ((std::vector<std::string>{ "a", "b" }), unpack(writer.written[0]));
+	ASSERT_EQ(large.get(), writer.written[1].get());
+	ASSERT_EQ(1, batcher.stats().bypassed);
+}
+
+TEST(Batching, FlushesBySize) {
+	Batcher batcher(policy());
+	Writer writer;
+	auto result = Result::HELD_FIRST;
+	std::size_t held = 0;
+
+	while(writer.written.empty()) {
+		result = batcher.write(banner(std::string(80, 'x')), writer);
+		++held;
+	}
+
+	ASSERT_EQ(Result::WRITTEN, result);
+	ASSERT_EQ(held, unpack(writer.written.front()).size());
+
+	// the next message starts a new batch
+	ASSERT_EQ(Result::HELD_FIRST, batcher.write(banner("a"), writer));
+}
+
+TEST(Batching, FailedWriteCounted) {
+	Batcher batcher(policy());
+	Writer writer;
+	writer.accept = false;
+
+	batcher.write(banner("a"), writer);
+	batcher.write(banner("b"), writer);
+	ASSERT_FALSE(batcher.flush(writer));
+	ASSERT_EQ(2, batcher.stats().dropped);
+}
\ No newline at end of file
@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <spark/BufferPool.h>
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace spark = ember::spark;
+
+TEST(BufferPoolTest, BuilderReuse) {
+	auto fbb = spark::make_buffer();
+	const auto builder = fbb.get();
+	fbb->Finish(fbb->CreateString("The quick brown fox jumps over the lazy dog"));
+	ASSERT_NE(0, fbb->GetSize()) << "Builder produced no output";
+
+	fbb = spark::BufferHandle();
+	auto reused = spark::make_buffer();
+	ASSERT_EQ(builder, reused.get()) << "Builder was not returned to the pool";
+	ASSERT_EQ(0, reused->GetSize()) << "Pooled builder was not cleared";
+}
+
+TEST(BufferPoolTest, HandleLifetime) {
+	auto fbb = spark::make_buffer();
+	const auto builder = fbb.get();
+
+	{
+		auto copy = fbb;
+		fbb = spark::BufferHandle();
+		ASSERT_FALSE(fbb) << "Handle should be empty";
+		ASSERT_EQ(builder, copy.get()) << "Copy refers to the wrong builder";
+
+		// builder is still referenced, so it must not be handed out again
+		auto other = spark::make_buffer();
+		ASSERT_NE(builder, other.get()) << "Referenced builder was reused";
+		other = spark::BufferHandle();
+
+		auto moved = std::move(copy);
+		ASSERT_FALSE(copy) << "Moved-from handle should be empty";
+		ASSERT_EQ(builder, moved.get()) << "Move lost the builder";
+	}
+
+	auto reused = spark::make_buffer();
+	ASSERT_EQ(builder, reused.get()) << "Builder was not returned to the pool";
+}
+
+TEST(BufferPoolTest, CrossThreadRelease) {
+	std::vector<spark::BufferHandle> handles;
+
+	for(int i = 0; i < 100; ++i) {
+		auto fbb = spark::make_buffer();
+		fbb->Finish(fbb->CreateString(std::string(i * 100, 'x')));
+		handles.emplace_back(std::move(fbb));
+	}
+
+	// builders dropped by another thread go back to this thread's pool
+	std::thread thread([handles = std::move(handles)]() mutable {
+		handles.clear();
+		auto fbb = spark::make_buffer();
+		ASSERT_EQ(0, fbb->GetSize()) << "Pooled builder was not cleared";
+	});
+
+	thread.join();
+
+	auto fbb = spark::make_buffer();
+	ASSERT_EQ(0, fbb->GetSize()) << "Returned builder was not cleared";
+}
+
+TEST(BufferPoolTest, ReturnsToOwner) {
+	auto fbb = spark::make_buffer();
+	const auto builder = fbb.get();
+
+	std::thread thread([builder, fbb = std::move(fbb)]() mutable {
+		fbb = spark::BufferHandle();
+		auto other = spark::make_buffer();
+		ASSERT_NE(builder, other.get()) << "Builder was kept by the releasing thread";
+	});
+
+	thread.join();
+
+	// the return list is only drained once the local cache runs dry
+	std::vector<spark::BufferHandle> handles;
+	bool returned = false;
+
+	for(int i = 0; i < 100 && !returned; ++i) {
+		handles.emplace_back(spark::make_buffer());
+		returned = handles.back().get() == builder;
+	}
+
+	ASSERT_TRUE(returned) << "Builder was not returned to its owner";
+}
+
+TEST(BufferPoolTest, OwnerExit) {
+	spark::BufferHandle fbb;
+
+	// the builder outlives its thread and is freed once released
+	std::thread thread([&]() {
+		fbb = spark::make_buffer();
+		fbb->Finish(fbb->CreateString("The quick brown fox jumps over the lazy dog"));
+	});
+
+	thread.join();
+	ASSERT_NE(0, fbb->GetSize()) << "Builder lost its contents";
+	fbb = spark::BufferHandle();
+}
\ No newline at end of file
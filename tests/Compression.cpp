@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "Core_generated.h"
+#include <spark/Compression.h>
+#include <shared/metrics/Metrics.h>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace spark = ember::spark;
+namespace em = ember::messaging;
+using spark::CompressionPolicy;
+using spark::detail::Compressor;
+
+namespace {
+
+spark::BufferHandle banner(const std::string& description) {
+	auto fbb = spark::make_buffer();
+	auto desc = fbb->CreateString(description);
+	auto msg = em::core::CreateBanner(*fbb, desc);
+	fbb->Finish(msg);
+	return fbb;
+}
+
+std::string noise(std::size_t size) {
+	std::mt19937 gen(42);
+	std::uniform_int_distribution<int> dist(0, 255);
+	std::string data(size, '\0');
+	std::generate(data.begin(), data.end(), [&] { return static_cast<char>(dist(gen)); });
+	return data;
+}
+
+class TimingMetrics final : public ember::Metrics {
+public:
+	std::vector<std::string> timings;
+	std::vector<std::string> increments;
+
+	void timing(const char* key, const std::chrono::microseconds&) override {
+		timings.emplace_back(key);
+	}
+
+	void increment(const char* key, std::intmax_t) override {
+		increments.emplace_back(key);
+	}
+};
+
+CompressionPolicy zlib_policy() {
+	CompressionPolicy policy;
+	policy.codecs = { em::core::Codec::ZLIB };
+	policy.threshold = 256;
+	return policy;
+}
+
+} // unnamed
+
+TEST(Compression, SelectsFirstCommonCodec) {
+	auto fbb = spark::make_buffer();
+	auto offered = fbb->CreateVector(std::vector<std::uint8_t> {
+		std::to_underlying(em::core::Codec::ZSTD), std::to_underlying(em::core::Codec::ZLIB)
+	});
+	fbb->Finish(em::core::CreateNegotiate(*fbb, 0, 0, 0, offered));
+
+	const auto negotiate = flatbuffers::GetRoot<em::core::Negotiate>(fbb->GetBufferPointer());
+	ASSERT_EQ(em::core::Codec::ZLIB, Compressor::select(zlib_policy(), negotiate->compression()));
+
+	CompressionPolicy none;
+	ASSERT_EQ(em::core::Codec::NONE, Compressor::select(none, negotiate->compression()));
+	ASSERT_EQ(em::core::Codec::NONE, Compressor::select(zlib_policy(), nullptr));
+}
+
+TEST(Compression, RoundTrip) {
+	Compressor sender(zlib_policy(), em::core::Codec::ZLIB);
+	Compressor receiver(zlib_policy(), em::core::Codec::ZLIB);
+
+	// run several through the same contexts to check they're reset between messages
+	for(std::size_t size : { 1024, 8192, 65536 }) {
+		const auto original = banner(std::string(size, 'x'));
+		const auto out = sender.compress(original);
+
+		ASSERT_NE(original.get(), out.get());
+		ASSERT_LT(out->GetSize(), original->GetSize());
+		ASSERT_TRUE(Compressor::compressed(out->GetBufferPointer(), out->GetSize()));
+		ASSERT_FALSE(Compressor::compressed(original->GetBufferPointer(), original->GetSize()));
+
+		const auto frame = receiver.decompress(out->GetBufferPointer(), out->GetSize(), 1024 * 1024);
+		ASSERT_EQ(original->GetSize(), frame.size());
+		ASSERT_TRUE(std::equal(frame.begin(), frame.end(), original->GetBufferPointer()));
+	}
+
+	const auto stats = sender.stats();
+	ASSERT_EQ(3, stats.compressed);
+	ASSERT_GT(stats.bytes_in, stats.bytes_out);
+}
+
+TEST(Compression, ReportsTimings) {
+	TimingMetrics metrics;
+	auto policy = zlib_policy();
+	policy.metrics = &metrics;
+
+	Compressor sender(policy, em::core::Codec::ZLIB);
+	Compressor receiver(policy, em::core::Codec::ZLIB);
+	const auto out = sender.compress(banner(std::string(4096, 'x')));
+	receiver.decompress(out->GetBufferPointer(), out->GetSize(), 1024 * 1024);
+
+	const std::vector<std::string> expected {
+		"spark.compression.compress", "spark.compression.decompress"
+	};
+
+	ASSERT_EQ(expected, metrics.timings);
+	ASSERT_EQ(0, std::count_if(metrics.increments.begin(), metrics.increments.end(),
+	                           [](const std::string& key) { return key.ends_with("_us"); }));
+}
+
+TEST(Compression, SmallAndIncompressiblePassThrough) {
+	Compressor compressor(zlib_policy(), em::core::Codec::ZLIB);
+
+	const auto small = banner("hello");
+	ASSERT_EQ(small.get(), compressor.compress(small).get());
+
+	const auto random = banner(noise(4096));
+	ASSERT_EQ(random.get(), compressor.compress(random).get());
+	ASSERT_EQ(1, compressor.stats().skipped);
+}
+
+TEST(Compression, RejectsOversizedAndCorrupt) {
+	Compressor sender(zlib_policy(), em::core::Codec::ZLIB);
+	Compressor receiver(zlib_policy(), em::core::Codec::ZLIB);
+
+	const auto original = banner(std::string(8192, 'x'));
+	const auto out = sender.compress(original);
+
+	// claims to be larger than the receiver allows
+	ASSERT_TRUE(receiver.decompress(out->GetBufferPointer(), out->GetSize(), 1024).empty());
+
+	std::vector<std::uint8_t> corrupt(out->GetBufferPointer(), out->GetBufferPointer() + out->GetSize());
+	std::fill(corrupt.end() - 16, corrupt.end(), 0xFF);
+	ASSERT_TRUE(receiver.decompress(corrupt.data(), corrupt.size(), 1024 * 1024).empty());
+
+	// and the receiver still works afterwards
+	ASSERT_FALSE(receiver.decompress(out->GetBufferPointer(), out->GetSize(), 1024 * 1024).empty());
+}
\ No newline at end of file
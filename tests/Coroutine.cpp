@@ -0,0 +1,263 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "Core_generated.h"
+#include <spark/Coroutine.h>
+#include <spark/EventDispatcher.h>
+#include <spark/NetworkSession.h>
+#include <spark/ServicesMap.h>
+#include <spark/SessionManager.h>
+#include <spark/Service.h>
+#include <logger/Logging.h>
+#include <boost/asio/io_context.hpp>
+#include <boost/uuid/uuid_generators.hpp>
+#include <gtest/gtest.h>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include <cstdint>
+
+namespace spark = ember::spark;
+namespace em = ember::messaging;
+using namespace std::chrono_literals;
+
+namespace {
+
+// swallows writes so requests can be answered by hand
+class CaptureSession final : public spark::NetworkSession {
+	void stop() override { }
+
+public:
+	std::vector<spark::BufferHandle> written;
+
+	CaptureSession(spark::SessionManager& sessions, spark::MessageHandler handler,
+	               ember::log::Logger* logger)
+	               : spark::NetworkSession(sessions, std::move(handler), logger) { }
+
+	void start() override { }
+
+	bool write(const spark::BufferHandle& fbb) override {
+		written.emplace_back(fbb);
+		return true;
+	}
+
+	std::size_t queued_messages() override { return 0; }
+	std::string remote_host() const override { return "test"; }
+};
+
+} // unnamed
+
+class CoroutineTest : public ::testing::Test {
+public:
+	virtual void SetUp() override {
+		logger = std::make_unique<ember::log::Logger>();
+		service = std::make_unique<spark::Service>("test", io_context, "127.0.0.1", 0, logger.get());
+
+		spark::MessageHandler handler(dispatcher, services, link, true, logger.get());
+		session = std::make_shared<CaptureSession>(sessions, std::move(handler), logger.get());
+
+		link.uuid = boost::uuids::random_generator()();
+		link.description = "peer";
+		link.net = session;
+	}
+
+	virtual void TearDown() override {
+		service->shutdown();
+	}
+
+	spark::BufferHandle ping() {
+		auto fbb = spark::make_buffer();
+		fbb->Finish(em::core::CreatePing(*fbb, 1234));
+		return fbb;
+	}
+
+	// answers the first request sent over the link
+	void reply(std::uint64_t timestamp) {
+		auto fbb = spark::make_buffer();
+		fbb->Finish(em::core::CreatePong(*fbb, timestamp));
+
+		const spark::Message message {
+			fbb->GetSize(), std::to_underlying(em::core::Opcode::MSG_PONG),
+			em::Service::CORE_HEARTBEAT, fbb->GetBufferPointer(), { true, 1 }
+		};
+
+		service->dispatcher()->dispatch_message(em::Service::CORE_TRACKING, link, message);
+	}
+
+	template<typename Predicate>
+	void run_until(Predicate predicate) {
+		for(auto i = 0; i < 100 && !predicate(); ++i) {
+			io_context.run_for(10ms);
+		}
+	}
+
+	boost::asio::io_context io_context;
+	std::unique_ptr<ember::log::Logger> logger;
+	std::unique_ptr<spark::Service> service;
+	spark::EventDispatcher dispatcher;
+	spark::ServicesMap services;
+	spark::SessionManager sessions;
+	std::shared_ptr<CaptureSession> session;
+	spark::Link link;
+};
+
+TEST_F(CoroutineTest, Reply) {
+	std::optional<spark::CallStatus> status;
+	std::uint64_t timestamp = 0;
+
+	auto request = [&]() -> spark::Task {
+		const auto opcode = std::to_underlying(em::core::Opcode::MSG_PING);
+		auto pong = co_await service->call<em::core::Pong>(link, opcode, ping());
+		status = pong.status();
+
+		if(pong) {
+			timestamp = pong->timestamp();
+		}
+	};
+
+	spark::spawn(io_context, request());
+	io_context.poll();
+	io_context.restart();
+
+	ASSERT_EQ(1, session->written.size());
+	ASSERT_FALSE(status);
+
+	// answered outside of the io_context, the coroutine must not resume here
+	reply(1234);
+	ASSERT_FALSE(status);
+
+	run_until([&] { return status.has_value(); });
+	ASSERT_EQ(spark::CallStatus::OK, status);
+	ASSERT_EQ(1234, timestamp);
+}
+
+// a reply that fails verification is only accepted from a link that skips it
+TEST_F(CoroutineTest, Verification) {
+	std::vector<spark::CallStatus> statuses;
+
+	auto request = [&]() -> spark::Task {
+		const auto opcode = std::to_underlying(em::core::Opcode::MSG_PING);
+		auto pong = co_await service->call<em::core::Pong>(link, opcode, ping());
+		statuses.emplace_back(pong.status());
+
+		link.verification = spark::Verification::SKIP;
+		pong = co_await service->call<em::core::Pong>(link, opcode, ping());
+		statuses.emplace_back(pong.status());
+	};
+
+	const auto garbage = [&](std::uint64_t sequence) {
+		const std::uint8_t data[] { 0xff, 0xff, 0xff, 0x7f };
+
+		const spark::Message message {
+			sizeof(data), std::to_underlying(em::core::Opcode::MSG_PONG),
+			em::Service::CORE_HEARTBEAT, data, { true, sequence }
+		};
+
+		service->dispatcher()->dispatch_message(em::Service::CORE_TRACKING, link, message);
+	};
+
+	spark::spawn(io_context, request());
+	io_context.poll();
+	io_context.restart();
+	garbage(1);
+
+	run_until([&] { return statuses.size() == 1 && session->written.size() == 2; });
+	garbage(2);
+
+	run_until([&] { return statuses.size() == 2; });
+	ASSERT_EQ(2, statuses.size());
+	ASSERT_EQ(spark::CallStatus::BAD_MESSAGE, statuses[0]);
+	ASSERT_EQ(spark::CallStatus::OK, statuses[1]);
+}
+
+TEST_F(CoroutineTest, Timeout) {
+	std::optional<spark::CallStatus> status;
+
+	auto request = [&]() -> spark::Task {
+		const auto opcode = std::to_underlying(em::core::Opcode::MSG_PING);
+		auto pong = co_await service->call<em::core::Pong>(link, opcode, ping(), 100ms);
+		status = pong.status();
+	};
+
+	spark::spawn(io_context, request());
+	run_until([&] { return status.has_value(); });
+	ASSERT_EQ(spark::CallStatus::TIMED_OUT, status);
+}
+
+TEST_F(CoroutineTest, LinkDown) {
+	std::optional<spark::CallStatus> status;
+
+	auto request = [&]() -> spark::Task {
+		const auto opcode = std::to_underlying(em::core::Opcode::MSG_PING);
+		auto pong = co_await service->call<em::core::Pong>(link, opcode, ping());
+		status = pong.status();
+	};
+
+	spark::spawn(io_context, request());
+	io_context.poll();
+	io_context.restart();
+
+	service->dispatcher()->notify_link_down(em::Service::CORE_TRACKING, link);
+	run_until([&] { return status.has_value(); });
+	ASSERT_EQ(spark::CallStatus::LINK_DOWN, status);
+}
+
+TEST_F(CoroutineTest, Shutdown) {
+	std::vector<spark::CallStatus> statuses;
+
+	auto request = [&]() -> spark::Task {
+		const auto opcode = std::to_underlying(em::core::Opcode::MSG_PING);
+		auto pong = co_await service->call<em::core::Pong>(link, opcode, ping());
+		statuses.emplace_back(pong.status());
+
+		// anything sent after shutdown fails straight away rather than hanging
+		pong = co_await service->call<em::core::Pong>(link, opcode, ping());
+		statuses.emplace_back(pong.status());
+	};
+
+	spark::spawn(io_context, request());
+	io_context.poll();
+	io_context.restart();
+
+	service->shutdown();
+	run_until([&] { return statuses.size() == 2; });
+	ASSERT_EQ(2, statuses.size());
+	ASSERT_EQ(spark::CallStatus::SHUTDOWN, statuses[0]);
+	ASSERT_EQ(spark::CallStatus::SHUTDOWN, statuses[1]);
+}
+
+// the frame must still be freed, which the sanitizers will check
+TEST_F(CoroutineTest, Exception) {
+	auto request = [&]() -> spark::Task {
+		const auto opcode = std::to_underlying(em::core::Opcode::MSG_PING);
+		auto pong = co_await service->call<em::core::Pong>(link, opcode, ping(), 100ms);
+		throw std::runtime_error("oops");
+	};
+
+	spark::spawn(io_context, request());
+	ASSERT_THROW(run_until([] { return false; }), std::runtime_error);
+}
+
+TEST_F(CoroutineTest, SendFailed) {
+	std::optional<spark::CallStatus> status;
+	spark::Link gone { link.uuid, "gone" };
+
+	auto request = [&]() -> spark::Task {
+		const auto opcode = std::to_underlying(em::core::Opcode::MSG_PING);
+		auto pong = co_await service->call<em::core::Pong>(gone, opcode, ping());
+		status = pong.status();
+	};
+
+	// never suspends, so it's finished as soon as it's been started
+	spark::spawn(io_context, request());
+	io_context.poll();
+	ASSERT_EQ(spark::CallStatus::SEND_FAILED, status);
+}
\ No newline at end of file
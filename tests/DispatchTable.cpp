@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "Core_dispatch.h"
+#include <spark/BufferPool.h>
+#include <spark/Link.h>
+#include <gtest/gtest.h>
+#include <string>
+#include <utility>
+#include <vector>
+#include <cstdint>
+
+namespace spark = ember::spark;
+namespace em = ember::messaging;
+using Result = em::core::DispatchTable::Result;
+
+namespace {
+
+struct Handler {
+	std::vector<std::uint64_t> pings;
+	std::vector<std::string> banners;
+
+	void handle_ping(const spark::Link&, const spark::Message&, const em::core::Ping& ping) {
+		pings.emplace_back(ping.timestamp());
+	}
+
+	void handle_banner(const spark::Link&, const spark::Message&, const em::core::Banner& banner) {
+		banners.emplace_back(banner.description()->str());
+	}
+};
+
+spark::Message message(em::core::Opcode opcode, const spark::BufferHandle& fbb) {
+	return {
+		fbb->GetSize(), std::to_underlying(opcode), em::Service::CORE_HEARTBEAT,
+		fbb->GetBufferPointer(), { false, 0 }
+	};
+}
+
+} // unnamed
+
+TEST(DispatchTable, TypedHandlers) {
+	Handler handler;
+	em::core::DispatchTable table;
+	table.add<em::core::Opcode::MSG_PING, &Handler::handle_ping>(&handler);
+	table.add<em::core::Opcode::MSG_BANNER, &Handler::handle_banner>(&handler);
+
+	auto ping = spark::make_buffer();
+	ping->Finish(em::core::CreatePing(*ping, 1234));
+
+	auto banner = spark::make_buffer();
+	banner->Finish(em::core::CreateBanner(*banner, banner->CreateString("peer")));
+
+	const spark::Link link {};
+	ASSERT_EQ(Result::OK, table.dispatch(link, message(em::core::Opcode::MSG_PING, ping)));
+	ASSERT_EQ(Result::OK, table.dispatch(link, message(em::core::Opcode::MSG_BANNER, banner)));
+	ASSERT_EQ(std::vector<std::uint64_t>{ 1234 }, handler.pings);
+	ASSERT_EQ(std::vector<std::string>{ "peer" }, handler.banners);
+}
+
+TEST(DispatchTable, Unhandled) {
+	Handler handler;
+	em::core::DispatchTable table;
+	table.add<em::core::Opcode::MSG_PING, &Handler::handle_ping>(&handler);
+
+	auto fbb = spark::make_buffer();
+	fbb->Finish(em::core::CreatePong(*fbb, 1234));
+
+	const spark::Link link {};
+	ASSERT_EQ(Result::UNHANDLED, table.dispatch(link, message(em::core::Opcode::MSG_PONG, fbb)));
+
+	// out of range for the enum entirely
+	auto bad = message(em::core::Opcode::MSG_PONG, fbb);
+	bad.opcode = 0xFFFF;
+	ASSERT_EQ(Result::UNHANDLED, table.dispatch(link, bad));
+	ASSERT_TRUE(handler.pings.empty());
+}
+
+TEST(DispatchTable, VerificationPolicy) {
+	Handler handler;
+	em::core::DispatchTable table;
+	table.add<em::core::Opcode::MSG_PING, &Handler::handle_ping>(&handler);
+
+	// offsets that point well outside of the buffer
+	std::vector<std::uint8_t> garbage(16, 0xFF);
+	const spark::Message msg {
+		static_cast<std::uint32_t>(garbage.size()), std::to_underlying(em::core::Opcode::MSG_PING),
+		em::Service::CORE_HEARTBEAT, garbage.data(), { false, 0 }
+	};
+
+	spark::Link untrusted;
+	ASSERT_EQ(Result::BAD_MESSAGE, table.dispatch(untrusted, msg));
+	ASSERT_TRUE(handler.pings.empty());
+
+	// trusted links skip verification, so a valid message must still get through
+	auto fbb = spark::make_buffer();
+	fbb->Finish(em::core::CreatePing(*fbb, 1234));
+
+	spark::Link trusted;
+	trusted.verification = spark::Verification::SKIP;
+	ASSERT_EQ(Result::OK, table.dispatch(trusted, message(em::core::Opcode::MSG_PING, fbb)));
+	ASSERT_EQ(1, handler.pings.size());
+}
\ No newline at end of file
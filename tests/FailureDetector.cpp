@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <spark/FailureDetector.h>
+#include <gtest/gtest.h>
+#include <chrono>
+
+using ember::spark::detail::FailureDetector;
+using namespace std::chrono_literals;
+
+namespace {
+
+constexpr double THRESHOLD = 8.0;
+
+} // unnamed
+
+TEST(FailureDetector, NeverHeardFrom) {
+	const auto start = FailureDetector::Clock::now();
+	FailureDetector detector(start);
+
+	ASSERT_LT(detector.phi(start + 2s), 1.0);
+	ASSERT_GE(detector.phi(start + 15s), THRESHOLD);
+}
+
+TEST(FailureDetector, RegularHeartbeats) {
+	auto now = FailureDetector::Clock::now();
+	FailureDetector detector(now);
+
+	for(auto i = 0; i < 50; ++i) {
+		now += 2s;
+		detector.arrival(now);
+	}
+
+	ASSERT_LT(detector.phi(now + 2s), 1.0);
+	ASSERT_LT(detector.phi(now + 5s), THRESHOLD);
+	ASSERT_GE(detector.phi(now + 10s), THRESHOLD);
+}
+
+TEST(FailureDetector, SuspicionGrows) {
+	auto now = FailureDetector::Clock::now();
+	FailureDetector detector(now);
+
+	for(auto i = 0; i < 20; ++i) {
+		now += 2s;
+		detector.arrival(now);
+	}
+
+	auto last = detector.phi(now);
+
+	for(auto elapsed = 1s; elapsed < 10s; elapsed += 1s) {
+		const auto phi = detector.phi(now + elapsed);
+		ASSERT_GE(phi, last);
+		last = phi;
+	}
+}
+
+// a link going quiet after heavy traffic waits for the idle ping rather than being suspected
+TEST(FailureDetector, BusyThenIdle) {
+	auto now = FailureDetector::Clock::now();
+	FailureDetector detector(now);
+
+	for(auto i = 0; i < 20'000; ++i) {
+		now += 1ms;
+		detector.arrival(now);
+	}
+
+	ASSERT_EQ(now, detector.latest());
+	ASSERT_LT(detector.phi(now + 3s), 1.0);
+	ASSERT_GE(detector.phi(now + 6s), THRESHOLD);
+}
\ No newline at end of file
@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <spark/FlowControl.h>
+#include <gtest/gtest.h>
+#include <vector>
+#include <cstdint>
+
+namespace spark = ember::spark;
+using spark::FlowControl;
+
+namespace {
+
+// records every message handed to the transport
+struct Wire {
+	std::vector<spark::BufferHandle> written;
+	bool accept = true;
+
+	bool operator()(const spark::BufferHandle& fbb) {
+		if(accept) {
+			written.emplace_back(fbb);
+		}
+
+		return accept;
+	}
+};
+
+} // unnamed
+
+TEST(FlowControl, UnlimitedUntilNegotiated) {
+	FlowControl flow(4);
+	Wire wire;
+
+	for(int i = 0; i < 100; ++i) {
+		ASSERT_EQ(FlowControl::Result::SENT, flow.send(spark::make_buffer(), wire));
+	}
+
+	// grants from a peer that never opened a window are ignored
+	flow.grant(1, wire);
+	ASSERT_EQ(FlowControl::Result::SENT, flow.send(spark::make_buffer(), wire));
+	ASSERT_EQ(101, wire.written.size());
+}
+
+TEST(FlowControl, QueueThenWouldBlock) {
+	FlowControl flow(2);
+	Wire wire;
+	flow.peer_window(3, wire);
+
+	for(int i = 0; i < 3; ++i) {
+		ASSERT_EQ(FlowControl::Result::SENT, flow.send(spark::make_buffer(), wire));
+	}
+
+	ASSERT_EQ(FlowControl::Result::QUEUED, flow.send(spark::make_buffer(), wire));
+	ASSERT_EQ(FlowControl::Result::QUEUED, flow.send(spark::make_buffer(), wire));
+	ASSERT_EQ(FlowControl::Result::WOULD_BLOCK, flow.send(spark::make_buffer(), wire));
+
+	const auto stats = flow.stats();
+	ASSERT_EQ(3, stats.sent);
+	ASSERT_EQ(2, stats.backlog);
+	ASSERT_EQ(2, stats.queued);
+	ASSERT_EQ(1, stats.would_block);
+	ASSERT_EQ(3, wire.written.size());
+}
+
+TEST(FlowControl, GrantReleasesBacklogInOrder) {
+	FlowControl flow(8);
+	Wire wire;
+	flow.peer_window(1, wire);
+
+	std::vector<spark::BufferHandle> messages;
+
+	for(int i = 0; i < 4; ++i) {
+		messages.emplace_back(spark::make_buffer());
+		flow.send(messages.back(), wire);
+	}
+
+	ASSERT_EQ(1, wire.written.size());
+
+	// only enough credit for two of the three waiting
+	flow.grant(3, wire);
+	ASSERT_EQ(3, wire.written.size());
+
+	// stale grants change nothing
+	flow.grant(2, wire);
+	ASSERT_EQ(3, wire.written.size());
+
+	flow.grant(10, wire);
+	ASSERT_EQ(4, wire.written.size());
+
+	for(std::size_t i = 0; i < messages.size(); ++i) {
+		ASSERT_EQ(messages[i].get(), wire.written[i].get());
+	}
+
+	// with the backlog clear, sends go straight out again
+	ASSERT_EQ(FlowControl::Result::SENT, flow.send(spark::make_buffer(), wire));
+}
+
+TEST(FlowControl, RejectedSendKeepsCredit) {
+	FlowControl flow;
+	Wire wire;
+	flow.peer_window(1, wire);
+
+	wire.accept = false;
+	ASSERT_EQ(FlowControl::Result::REJECTED, flow.send(spark::make_buffer(), wire));
+
+	wire.accept = true;
+	ASSERT_EQ(FlowControl::Result::SENT, flow.send(spark::make_buffer(), wire));
+	ASSERT_EQ(FlowControl::Result::QUEUED, flow.send(spark::make_buffer(), wire));
+}
+
+TEST(FlowControl, ReceiverGrantsAtHalfWindow) {
+	FlowControl flow;
+	ASSERT_EQ(8, flow.open(8));
+	ASSERT_EQ(8, flow.granted());
+
+	for(int i = 0; i < 3; ++i) {
+		ASSERT_FALSE(flow.consume());
+	}
+
+	// the fourth message leaves the peer with half of its window
+	const auto credits = flow.consume();
+	ASSERT_TRUE(credits);
+	ASSERT_EQ(12, *credits);
+	ASSERT_EQ(12, flow.granted());
+
+	for(int i = 0; i < 3; ++i) {
+		ASSERT_FALSE(flow.consume());
+	}
+
+	ASSERT_EQ(16, flow.consume());
+}
+
+TEST(FlowControl, ReceiverWithoutWindow) {
+	FlowControl flow;
+
+	for(int i = 0; i < 10; ++i) {
+		ASSERT_FALSE(flow.consume());
+	}
+
+	ASSERT_EQ(0, flow.granted());
+}
+
+TEST(FlowControl, EndToEnd) {
+	FlowControl sender(16), receiver;
+	Wire wire;
+	sender.peer_window(receiver.open(8), wire);
+
+	std::size_t delivered = 0;
+
+	for(int i = 0; i < 64; ++i) {
+		const auto result = sender.send(spark::make_buffer(), wire);
+		ASSERT_NE(FlowControl::Result::WOULD_BLOCK, result);
+
+		// the receiver handles whatever has arrived and returns credit as it goes
+		for(; delivered < wire.written.size(); ++delivered) {
+			if(auto credits = receiver.consume()) {
+				sender.grant(*credits, wire);
+			}
+		}
+	}
+
+	ASSERT_EQ(64, wire.written.size());
+	ASSERT_EQ(0, sender.stats().backlog);
+	ASSERT_LE(sender.stats().sent, receiver.granted());
+}
\ No newline at end of file
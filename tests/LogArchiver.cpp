@@ -0,0 +1,225 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <logger/Archiver.h>
+#include <logger/FileSink.h>
+#include <shared/metrics/Metrics.h>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <zlib.h>
+
+namespace el = ember::log;
+namespace fs = std::filesystem;
+using namespace std::chrono_literals;
+
+namespace {
+
+class RecordingMetrics final : public ember::Metrics {
+	std::mutex lock_;
+	std::vector<std::string> keys_;
+
+public:
+	void increment(const char* key, std::intmax_t) override {
+		std::lock_guard<std::mutex> guard(lock_);
+		keys_.emplace_back(key);
+	}
+
+	void timing(const char* key, const std::chrono::milliseconds&) override {
+		std::lock_guard<std::mutex> guard(lock_);
+		keys_.emplace_back(key);
+	}
+
+	std::size_t count(const std::string& key) {
+		std::lock_guard<std::mutex> guard(lock_);
+		return std::count(keys_.begin(), keys_.end(), key);
+	}
+};
+
+class LogArchiver : public ::testing::Test {
+protected:
+	fs::path dir_;
+
+	void SetUp() override {
+		const auto name = ::testing::UnitTest::GetInstance()->current_test_info()->name();
+		dir_ = fs::temp_directory_path() / (std::string("ember_archiver_") + name);
+		fs::remove_all(dir_);
+		fs::create_directories(dir_);
+	}
+
+	void TearDown() override {
+		fs::remove_all(dir_);
+	}
+
+	std::string write_file(const std::string& name, const std::string& contents) {
+		const auto path = (dir_ / name).string();
+		std::ofstream(path, std::ios::binary) << contents;
+		return path;
+	}
+};
+
+// the archiver works in the background, so give it a moment
+bool wait_for(const std::function<bool()>& condition) {
+	for(auto waited = 0ms; waited < 5s; waited += 10ms) {
+		if(condition()) {
+			return true;
+		}
+
+		std::this_thread::sleep_for(10ms);
+	}
+
+	return condition();
+}
+
+std::string gunzip(const std::string& path) {
+	std::string contents;
+	char buffer[4096];
+	gzFile gz = gzopen(path.c_str(), "rb");
+
+	if(!gz) {
+		return contents;
+	}
+
+	int read = 0;
+
+	while((read = gzread(gz, buffer, sizeof(buffer))) > 0) {
+		contents.append(buffer, read);
+	}
+
+	gzclose(gz);
+	return contents;
+}
+
+} // unnamed
+
+TEST_F(LogArchiver, Compresses) {
+	RecordingMetrics metrics;
+	std::string contents;
+
+	for(int i = 0; i < 10'000; ++i) {
+		contents += "[info] record " + std::to_string(i) + "\n";
+	}
+
+	const auto path = write_file("test.log0", contents);
+
+	{
+		el::Archiver archiver;
+		archiver.metrics(&metrics);
+		archiver.compress(true);
+		archiver.archive(path);
+
+		ASSERT_TRUE(wait_for([&] { return !fs::exists(path); }));
+	}
+
+	ASSERT_TRUE(fs::exists(path + ".gz"));
+	ASSERT_LT(fs::file_size(path + ".gz"), contents.size());
+	ASSERT_EQ(contents, gunzip(path + ".gz"));
+	ASSERT_EQ(1, metrics.count("logging.rotation.compress"));
+}
+
+TEST_F(LogArchiver, RetainsByCount) {
+	el::Archiver archiver;
+	archiver.retention({ .max_files = 2 });
+
+	const auto first = write_file("test.log0", "first");
+	const auto second = write_file("test.log1", "second");
+	const auto third = write_file("test.log2", "third");
+
+	archiver.archive(first);
+	archiver.archive(second);
+	archiver.archive(third);
+
+	ASSERT_TRUE(wait_for([&] { return !fs::exists(first); }));
+	ASSERT_TRUE(fs::exists(second));
+	ASSERT_TRUE(fs::exists(third));
+}
+
+TEST_F(LogArchiver, RetainsBySize) {
+	el::Archiver archiver;
+	archiver.retention({ .max_size = 250 });
+
+	const auto first = write_file("test.log0", std::string(100, 'a'));
+	const auto second = write_file("test.log1", std::string(100, 'b'));
+
+	// files from before a restart count towards the limit
+	archiver.track(first);
+	archiver.archive(second);
+
+	std::this_thread::sleep_for(50ms);
+	ASSERT_TRUE(fs::exists(first));
+
+	const auto third = write_file("test.log2", std::string(100, 'c'));
+	archiver.archive(third);
+
+	ASSERT_TRUE(wait_for([&] { return !fs::exists(first); }));
+	ASSERT_TRUE(fs::exists(second));
+	ASSERT_TRUE(fs::exists(third));
+}
+
+// retention has already removed test.log0, which mustn't send rotation back to the start
+TEST_F(LogArchiver, RestartAfterRetention) {
+	const auto first = write_file("test.log1", "first");
+	const auto second = write_file("test.log2.gz", "second");
+	write_file("test.log", std::string(1024 * 1024, 'a'));
+
+	{
+		el::FileSink sink(el::Severity::INFO, el::Filter(0), (dir_ / "test.log").string(),
+		                  el::FileSink::Mode::APPEND);
+		sink.size_limit(1);
+		sink.retention({ .max_files = 2 });
+		sink.write(el::Severity::INFO, el::Filter(0), { 'b' }, true);
+
+		ASSERT_TRUE(wait_for([&] { return !fs::exists(first); }));
+	}
+
+	ASSERT_FALSE(fs::exists(dir_ / "test.log0"));
+	ASSERT_TRUE(fs::exists(dir_ / "test.log3"));
+	ASSERT_EQ(1024u * 1024, fs::file_size(dir_ / "test.log3"));
+	ASSERT_EQ(6u, fs::file_size(second));
+}
+
+TEST_F(LogArchiver, SinkMetrics) {
+	const auto first = write_file("test.log0", "first");
+	write_file("test.log", std::string(1024 * 1024, 'a'));
+	RecordingMetrics metrics;
+
+	{
+		el::FileSink sink(el::Severity::INFO, el::Filter(0), (dir_ / "test.log").string(),
+		                  el::FileSink::Mode::APPEND);
+		sink.size_limit(1);
+		sink.retention({ .max_files = 1 });
+
+		el::Sink& base = sink;
+		base.metrics(&metrics);
+		sink.write(el::Severity::INFO, el::Filter(0), { 'b' }, true);
+
+		ASSERT_TRUE(wait_for([&] { return metrics.count("logging.rotation.removed") == 1; }));
+		base.metrics(nullptr);
+	}
+
+	ASSERT_FALSE(fs::exists(first));
+}
+
+TEST_F(LogArchiver, DisabledLeavesFiles) {
+	const auto path = write_file("test.log0", "contents");
+
+	{
+		el::Archiver archiver;
+		archiver.archive(path);
+	}
+
+	ASSERT_TRUE(fs::exists(path));
+	ASSERT_FALSE(fs::exists(path + ".gz"));
+}
\ No newline at end of file
@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <logger/Logging.h>
+#include <logger/Sink.h>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace el = ember::log;
+
+namespace {
+
+// outlives the sink, which is destroyed along with the logger
+struct Collected {
+	std::mutex lock;
+	std::vector<std::pair<el::Severity, std::string>> records;
+};
+
+class CollectingSink final : public el::Sink {
+	Collected& collected_;
+
+public:
+	CollectingSink(Collected& collected, el::Filter filter = el::Filter(0))
+		: Sink(el::Severity::INFO, filter), collected_(collected) {}
+
+	void write(el::Severity severity, el::Filter type, const std::vector<char>& record, bool) override {
+		if(this->severity() > severity || (this->filter() & type)) {
+			return;
+		}
+
+		std::lock_guard<std::mutex> guard(collected_.lock);
+		collected_.records.emplace_back(severity, std::string(record.begin(), record.end()));
+	}
+
+	void batch_write(const std::vector<std::pair<el::RecordDetail, std::vector<char>>>& batch) override {
+		for(const auto& [detail, record] : batch) {
+			write(detail.severity, detail.type, record, false);
+		}
+	}
+};
+
+std::size_t count_prefix(const Collected& collected, const std::string& prefix) {
+	return std::count_if(collected.records.begin(), collected.records.end(), [&](const auto& record) {
+		return record.second.starts_with(prefix);
+	});
+}
+
+// sums the counts from any summaries for the given severity
+std::uint64_t suppressed(const Collected& collected, el::Severity severity) {
+	std::uint64_t total = 0;
+
+	for(const auto& [record_severity, record] : collected.records) {
+		if(record_severity == severity && record.starts_with("suppressed ")) {
+			total += std::stoull(record.substr(11));
+			EXPECT_NE(std::string::npos, record.find("LogRateLimit.cpp:"));
+		}
+	}
+
+	return total;
+}
+
+int formatted = 0;
+
+int format_counter() {
+	return ++formatted;
+}
+
+} // unnamed
+
+TEST(LogRateLimit, Burst) {
+	constexpr int RECORDS = 1000;
+
+	Collected collected;
+	auto logger = std::make_unique<el::Logger>();
+	logger->add_sink(std::make_unique<CollectingSink>(collected));
+	formatted = 0;
+
+	// one per second after the burst, so only the burst gets through in a tight loop
+	for(int i = 0; i < RECORDS; ++i) {
+		LOG_LIMIT(logger, WARN, 1, 10) << "limited " << format_counter() << LOG_ASYNC;
+	}
+
+	logger.reset();
+
+	const auto logged = count_prefix(collected, "limited ");
+	ASSERT_GE(logged, 10);
+	ASSERT_LT(logged, 20);
+
+	// suppressed records are never formatted and the summary accounts for all of them
+	ASSERT_EQ(logged, formatted);
+	ASSERT_EQ(RECORDS - logged, suppressed(collected, el::Severity::WARN));
+}
+
+TEST(LogRateLimit, Sample) {
+	Collected collected;
+	auto logger = std::make_unique<el::Logger>();
+	logger->add_sink(std::make_unique<CollectingSink>(collected));
+
+	for(int i = 0; i < 100; ++i) {
+		LOG_SAMPLE(logger, ERROR_, 10) << "sampled " << i << LOG_ASYNC;
+	}
+
+	logger.reset();
+
+	ASSERT_EQ(10, count_prefix(collected, "sampled "));
+	ASSERT_EQ(1, count_prefix(collected, "sampled 0\n"));
+	ASSERT_EQ(1, count_prefix(collected, "sampled 90\n"));
+	ASSERT_EQ(90, suppressed(collected, el::Severity::ERROR_));
+}
+
+TEST(LogRateLimit, FilteredNotCounted) {
+	Collected collected;
+	auto logger = std::make_unique<el::Logger>();
+	logger->add_sink(std::make_unique<CollectingSink>(collected, el::Filter(1)));
+
+	// below the logger's severity or filtered out, so the limiter is never consulted
+	for(int i = 0; i < 100; ++i) {
+		LOG_SAMPLE(logger, DEBUG, 10) << "debug" << LOG_ASYNC;
+		LOG_SAMPLE_FILTER(logger, INFO, 1, 10) << "filtered" << LOG_ASYNC;
+	}
+
+	logger.reset();
+	ASSERT_TRUE(collected.records.empty());
+}
\ No newline at end of file
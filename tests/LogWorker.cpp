@@ -0,0 +1,210 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <logger/Logging.h>
+#include <logger/Sink.h>
+#include <logger/Worker.h>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace el = ember::log;
+using namespace std::chrono_literals;
+
+namespace {
+
+// outlives the sink, which is destroyed along with the logger
+struct Collected {
+	std::mutex lock;
+	std::vector<std::string> records;
+};
+
+class CollectingSink final : public el::Sink {
+	Collected& collected_;
+	std::shared_future<void> gate_;
+
+public:
+	CollectingSink(Collected& collected, std::shared_future<void> gate = {})
+		: Sink(el::Severity::TRACE, el::Filter(0)), collected_(collected), gate_(std::move(gate)) {}
+
+	void write(el::Severity, el::Filter, const std::vector<char>& record, bool) override {
+		if(gate_.valid()) {
+			gate_.wait();
+		}
+
+		std::lock_guard<std::mutex> guard(collected_.lock);
+		collected_.records.emplace_back(record.begin(), record.end());
+	}
+
+	void batch_write(const std::vector<std::pair<el::RecordDetail, std::vector<char>>>& batch) override {
+		for(const auto& [detail, record] : batch) {
+			write(detail.severity, detail.type, record, false);
+		}
+	}
+};
+
+std::size_t count_prefix(const std::vector<std::string>& records, const std::string& prefix) {
+	return std::count_if(records.begin(), records.end(), [&](const auto& record) {
+		return record.starts_with(prefix);
+	});
+}
+
+} // unnamed
+
+TEST(LogWorker, MultipleProducers) {
+	constexpr int THREADS = 4;
+	constexpr int RECORDS = 10'000;
+
+	Collected collected;
+	auto logger = std::make_unique<el::Logger>();
+	logger->add_sink(std::make_unique<CollectingSink>(collected));
+	logger->overflow(el::Overflow::BLOCK);
+	std::vector<std::thread> threads;
+
+	for(int t = 0; t < THREADS; ++t) {
+		threads.emplace_back([&, t]() {
+			for(int i = 0; i < RECORDS; ++i) {
+				LOG_INFO(logger) << t << " " << i << LOG_ASYNC;
+			}
+		});
+	}
+
+	for(auto& thread : threads) {
+		thread.join();
+	}
+
+	// destroying the logger flushes anything still queued
+	logger.reset();
+	ASSERT_EQ(std::size_t(THREADS * RECORDS), collected.records.size());
+
+	// each thread's records arrive in the order they were logged
+	std::vector<int> next(THREADS, 0);
+
+	for(const auto& record : collected.records) {
+		const auto t = std::stoi(record);
+		ASSERT_LT(t, THREADS);
+		ASSERT_EQ(next[t]++, std::stoi(record.substr(record.find(' ') + 1)));
+	}
+}
+
+// a sync record has to wait for more than a single batch of the thread's earlier records
+TEST(LogWorker, SyncAfterAsync) {
+	constexpr std::size_t RECORDS = el::Worker::BATCH_SIZE * 8;
+
+	Collected collected;
+	std::promise<void> release;
+	auto logger = std::make_unique<el::Logger>();
+	logger->add_sink(std::make_unique<CollectingSink>(collected, release.get_future().share()));
+
+	// the worker is held up by the sink until everything has been queued
+	for(std::size_t i = 0; i < RECORDS; ++i) {
+		LOG_INFO(logger) << "async " << i << LOG_ASYNC;
+	}
+
+	std::thread releaser([&]() {
+		std::this_thread::sleep_for(100ms);
+		release.set_value();
+	});
+
+	LOG_INFO(logger) << "sync" << LOG_SYNC;
+	releaser.join();
+
+	std::lock_guard<std::mutex> guard(collected.lock);
+	ASSERT_EQ(RECORDS + 1, collected.records.size());
+	ASSERT_EQ("sync\n", collected.records.back());
+}
+
+TEST(LogWorker, DropNewest) {
+	constexpr std::size_t RECORDS = el::Worker::RING_CAPACITY * 2;
+
+	std::promise<void> open;
+	Collected collected;
+	auto logger = std::make_unique<el::Logger>();
+	logger->add_sink(std::make_unique<CollectingSink>(collected, open.get_future().share()));
+	logger->overflow(el::Overflow::DROP_NEWEST);
+
+	// the sink is held shut, so the ring fills up and never blocks the caller
+	for(std::size_t i = 0; i < RECORDS; ++i) {
+		LOG_INFO(logger) << "record " << i << LOG_ASYNC;
+	}
+
+	const auto dropped = logger->dropped();
+	ASSERT_GT(dropped, 0);
+
+	open.set_value();
+	logger.reset();
+
+	ASSERT_EQ(RECORDS - dropped, count_prefix(collected.records, "record "));
+
+	// the worker may report the drops across more than one notice
+	std::uint64_t reported = 0;
+
+	for(const auto& record : collected.records) {
+		if(record.find(" log record(s) dropped") != std::string::npos) {
+			reported += std::stoull(record);
+		}
+	}
+
+	ASSERT_EQ(dropped, reported);
+}
+
+TEST(LogWorker, DropBySeverity) {
+	constexpr std::size_t RECORDS = el::Worker::RING_CAPACITY * 2;
+
+	std::promise<void> open;
+	Collected collected;
+	auto logger = std::make_unique<el::Logger>();
+	logger->add_sink(std::make_unique<CollectingSink>(collected, open.get_future().share()));
+	logger->overflow(el::Overflow::DROP_BY_SEVERITY, el::Severity::WARN);
+
+	for(std::size_t i = 0; i < RECORDS; ++i) {
+		LOG_INFO(logger) << "info " << i << LOG_ASYNC;
+	}
+
+	ASSERT_GT(logger->dropped(), 0);
+
+	// errors wait for room rather than being dropped
+	auto opener = std::async(std::launch::async, [&]() {
+		std::this_thread::sleep_for(50ms);
+		open.set_value();
+	});
+
+	LOG_ERROR(logger) << "error" << LOG_ASYNC;
+	opener.get();
+	logger.reset();
+
+	ASSERT_EQ(1, count_prefix(collected.records, "error"));
+}
+
+TEST(LogWorker, DefaultOverflow) {
+	constexpr std::size_t RECORDS = el::Worker::RING_CAPACITY * 2;
+
+	std::promise<void> open;
+	Collected collected;
+	auto logger = std::make_unique<el::Logger>();
+	logger->add_sink(std::make_unique<CollectingSink>(collected, open.get_future().share()));
+
+	// nothing configured, so a full ring must not block the caller
+	for(std::size_t i = 0; i < RECORDS; ++i) {
+		LOG_INFO(logger) << "info " << i << LOG_ASYNC;
+	}
+
+	const auto dropped = logger->dropped();
+	ASSERT_GT(dropped, 0);
+
+	open.set_value();
+	logger.reset();
+
+	ASSERT_EQ(RECORDS - dropped, count_prefix(collected.records, "info "));
+}
\ No newline at end of file
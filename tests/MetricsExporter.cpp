@@ -0,0 +1,199 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <shared/metrics/MetricsExporter.h>
+#include <shared/metrics/Histogram.h>
+#include <boost/asio.hpp>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace bai = boost::asio::ip;
+using namespace std::chrono_literals;
+
+namespace {
+
+class RecordingMetrics final : public ember::Metrics {
+public:
+	std::intmax_t increments = 0;
+
+	void increment(const char*, std::intmax_t value) override {
+		increments += value;
+	}
+};
+
+bool contains(const std::string& text, const std::string& line) {
+	return text.find(line + "\n") != std::string::npos;
+}
+
+} // unnamed
+
+TEST(Histogram, BucketBoundaries) {
+	for(std::uint32_t value : { 0u, 1u, 63u, 64u, 65u, 1000u, 123'456u, 0xFFFFFFFFu }) {
+		const auto index = ember::Histogram::index(value);
+		ASSERT_LT(index, ember::Histogram::BUCKETS);
+		ASSERT_LE(ember::Histogram::lowest(index), value);
+		ASSERT_GE(ember::Histogram::highest(index), value);
+
+		// no wider than ~3% of the values it holds
+		const auto width = ember::Histogram::highest(index) - ember::Histogram::lowest(index);
+		ASSERT_LE(width, ember::Histogram::lowest(index) / 32);
+	}
+
+	ASSERT_EQ(ember::Histogram::BUCKETS - 1, ember::Histogram::index(0xFFFFFFFFu));
+}
+
+TEST(Histogram, Quantiles) {
+	ember::Histogram histogram;
+	std::vector<std::uint32_t> values;
+	std::mt19937 rng(42);
+	std::exponential_distribution<> dist(1.0 / 500);
+
+	for(int i = 0; i < 100'000; ++i) {
+		values.emplace_back(static_cast<std::uint32_t>(dist(rng)));
+		histogram.record(values.back());
+	}
+
+	std::sort(values.begin(), values.end());
+	ember::Histogram::Snapshot snapshot;
+	snapshot.merge(histogram);
+	ASSERT_EQ(values.size(), snapshot.count());
+
+	for(const auto quantile : { 0.5, 0.9, 0.99, 0.999 }) {
+		const auto exact = values[static_cast<std::size_t>(quantile * values.size()) - 1];
+		const auto estimate = snapshot.value_at(quantile);
+		ASSERT_GE(estimate, exact);
+		ASSERT_LE(estimate, exact + exact / 32 + 1);
+	}
+}
+
+TEST(MetricsExporter, Scrape) {
+	boost::asio::io_context service;
+	auto forward = std::make_unique<RecordingMetrics>();
+	auto& recorded = *forward;
+	ember::MetricsExporter exporter(service, "127.0.0.1", 0, std::move(forward));
+
+	std::vector<std::thread> threads;
+
+	for(int i = 0; i < 4; ++i) {
+		threads.emplace_back([&]() {
+			for(int j = 0; j < 1000; ++j) {
+				exporter.increment("login.success");
+			}
+
+			exporter.timing("db.query", 2ms);
+		});
+	}
+
+	for(auto& thread : threads) {
+		thread.join();
+	}
+
+	exporter.timing("db.query", 100ms);
+	exporter.gauge("sessions", 10);
+	exporter.gauge("sessions", 3, ember::Metrics::Adjustment::POSITIVE);
+
+	const auto text = exporter.scrape();
+
+	ASSERT_TRUE(contains(text, "# TYPE login_success_total counter"));
+	ASSERT_TRUE(contains(text, "login_success_total 4000"));
+	ASSERT_TRUE(contains(text, "# TYPE sessions gauge"));
+	ASSERT_TRUE(contains(text, "sessions 13"));
+	ASSERT_TRUE(contains(text, "# TYPE db_query_seconds histogram"));
+	ASSERT_TRUE(contains(text, "db_query_seconds_bucket{le=\"0.001\"} 0"));
+	ASSERT_TRUE(contains(text, "db_query_seconds_bucket{le=\"0.0025\"} 4"));
+	ASSERT_TRUE(contains(text, "db_query_seconds_bucket{le=\"0.25\"} 5"));
+	ASSERT_TRUE(contains(text, "db_query_seconds_bucket{le=\"60\"} 5"));
+	ASSERT_TRUE(contains(text, "db_query_seconds_bucket{le=\"+Inf\"} 5"));
+	ASSERT_TRUE(contains(text, "db_query_seconds_sum 0.108"));
+	ASSERT_TRUE(contains(text, "db_query_seconds_count 5"));
+	ASSERT_EQ(4000, recorded.increments);
+}
+
+// the shard of an exited thread is dropped, but what it recorded mustn't be
+TEST(MetricsExporter, ExitedThreads) {
+	boost::asio::io_context service;
+	ember::MetricsExporter exporter(service, "127.0.0.1", 0);
+
+	std::thread([&]() {
+		exporter.increment("logins", 10);
+		exporter.timing("db.query", 2ms);
+	}).join();
+
+	exporter.increment("logins", 5);
+
+	for(int i = 0; i < 2; ++i) {
+		const auto text = exporter.scrape();
+		ASSERT_TRUE(contains(text, "logins_total 15"));
+		ASSERT_TRUE(contains(text, "db_query_seconds_count 1"));
+	}
+}
+
+TEST(MetricsExporter, MicrosecondTiming) {
+	boost::asio::io_context service;
+	ember::MetricsExporter exporter(service, "127.0.0.1", 0);
+	exporter.timing("spark.rtt", 40us);
+	exporter.timing("spark.rtt", 40us);
+
+	const auto text = exporter.scrape();
+	ASSERT_TRUE(contains(text, "# TYPE spark_rtt_seconds histogram"));
+	ASSERT_TRUE(contains(text, "spark_rtt_seconds_bucket{le=\"0.00005\"} 2"));
+	ASSERT_TRUE(contains(text, "spark_rtt_seconds_sum 8e-05"));
+	ASSERT_TRUE(contains(text, "spark_rtt_seconds_count 2"));
+}
+
+TEST(MetricsExporter, HTTP) {
+	boost::asio::io_context service;
+	ember::MetricsExporter exporter(service, "127.0.0.1", 0);
+	exporter.increment("requests", 5);
+	std::thread worker([&]() { service.run(); });
+
+	const auto fetch = [&](const std::string& target) {
+		bai::tcp::iostream stream("127.0.0.1", std::to_string(exporter.port()));
+		stream << "GET " << target << " HTTP/1.1\r\nHost: localhost\r\n\r\n" << std::flush;
+		return std::string(std::istreambuf_iterator<char>(stream), {});
+	};
+
+	const auto response = fetch("/metrics");
+	ASSERT_TRUE(response.starts_with("HTTP/1.1 200 OK\r\n"));
+	ASSERT_NE(std::string::npos, response.find("Content-Type: text/plain; version=0.0.4\r\n"));
+	ASSERT_NE(std::string::npos, response.find("\r\n\r\n# TYPE requests_total counter\nrequests_total 5\n"));
+
+	ASSERT_TRUE(fetch("/").starts_with("HTTP/1.1 404 Not Found\r\n"));
+
+	service.stop();
+	worker.join();
+}
+
+// a client that never finishes its request is disconnected
+TEST(MetricsExporter, RequestTimeout) {
+	boost::asio::io_context service;
+	ember::MetricsExporter exporter(service, "127.0.0.1", 0);
+	std::thread worker([&]() { service.run(); });
+
+	bai::tcp::socket socket(service);
+	socket.connect(bai::tcp::endpoint(bai::address_v4::loopback(), exporter.port()));
+	boost::asio::write(socket, boost::asio::buffer(std::string("GET /metrics HTTP/1.1\r\n")));
+
+	const auto start = std::chrono::steady_clock::now();
+	char buffer[1];
+	boost::system::error_code ec;
+	socket.read_some(boost::asio::buffer(buffer), ec);
+
+	ASSERT_TRUE(ec);
+	ASSERT_LT(std::chrono::steady_clock::now() - start, 30s);
+
+	service.stop();
+	worker.join();
+}
\ No newline at end of file
@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <shared/metrics/MetricsImpl.h>
+#include <boost/asio.hpp>
+#include <gtest/gtest.h>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cmath>
+#include <cstdint>
+
+namespace bai = boost::asio::ip;
+using namespace std::chrono_literals;
+
+namespace {
+
+struct Received {
+	std::size_t datagrams = 0;
+	std::size_t largest = 0;
+	std::map<std::string, std::vector<std::string>> samples; // key -> value|type
+};
+
+// reads datagrams until the socket has been quiet for a while
+Received receive(bai::udp::socket& socket) {
+	Received received;
+	char buffer[2048];
+	socket.non_blocking(true);
+
+	for(auto quiet = 0ms; quiet < 500ms;) {
+		boost::system::error_code ec;
+		const auto size = socket.receive(boost::asio::buffer(buffer), 0, ec);
+
+		if(ec == boost::asio::error::would_block) {
+			std::this_thread::sleep_for(10ms);
+			quiet += 10ms;
+			continue;
+		}
+
+		quiet = 0ms;
+		++received.datagrams;
+		received.largest = std::max(received.largest, size);
+
+		std::istringstream lines(std::string(buffer, size));
+		std::string line;
+
+		// key:value|type[:value|type...]
+		while(std::getline(lines, line)) {
+			std::istringstream fields(line);
+			std::string key, sample;
+			std::getline(fields, key, ':');
+
+			while(std::getline(fields, sample, ':')) {
+				received.samples[key].emplace_back(sample);
+			}
+		}
+	}
+
+	return received;
+}
+
+// the number of samples a timing line stands for, given its sample rate
+std::uint64_t sample_count(const std::string& sample) {
+	const auto rate = sample.find("|@");
+	return rate == std::string::npos? 1 : std::llround(1 / std::stod(sample.substr(rate + 2)));
+}
+
+std::uint64_t sample_count(const std::vector<std::string>& samples) {
+	std::uint64_t count = 0;
+
+	for(const auto& sample : samples) {
+		count += sample_count(sample);
+	}
+
+	return count;
+}
+
+class MetricsImplTest : public ::testing::Test {
+protected:
+	boost::asio::io_context service_;
+	bai::udp::socket collector_ { service_, bai::udp::endpoint(bai::address_v4::loopback(), 0) };
+	std::unique_ptr<ember::MetricsImpl> metrics_;
+
+	void SetUp() override {
+		// long enough that everything below lands in a single interval
+		metrics_ = std::make_unique<ember::MetricsImpl>(service_, "127.0.0.1",
+			collector_.local_endpoint().port(), 10s);
+	}
+};
+
+} // unnamed
+
+TEST_F(MetricsImplTest, CountersAggregate) {
+	constexpr int THREADS = 4;
+	constexpr int INCREMENTS = 10'000;
+	std::vector<std::thread> threads;
+
+	for(int i = 0; i < THREADS; ++i) {
+		threads.emplace_back([&]() {
+			for(int j = 0; j < INCREMENTS; ++j) {
+				metrics_->increment("packets");
+			}
+
+			metrics_->increment("bytes", 100);
+		});
+	}
+
+	for(auto& thread : threads) {
+		thread.join();
+	}
+
+	metrics_.reset();
+	const auto received = receive(collector_);
+
+	ASSERT_EQ(1, received.datagrams);
+	ASSERT_EQ(std::vector<std::string>{ std::to_string(THREADS * INCREMENTS) + "|c" }, received.samples.at("packets"));
+	ASSERT_EQ(std::vector<std::string>{ std::to_string(THREADS * 100) + "|c" }, received.samples.at("bytes"));
+}
+
+TEST_F(MetricsImplTest, GaugeLastValue) {
+	metrics_->gauge("sessions", 10);
+	metrics_->gauge("sessions", 25);
+	metrics_->gauge("queue", 5, ember::Metrics::Adjustment::POSITIVE);
+	metrics_->gauge("queue", 2, ember::Metrics::Adjustment::NEGATIVE);
+	metrics_.reset();
+
+	const auto received = receive(collector_);
+	ASSERT_EQ(std::vector<std::string>{ "25|g" }, received.samples.at("sessions"));
+	ASSERT_EQ(std::vector<std::string>{ "+3|g" }, received.samples.at("queue"));
+}
+
+TEST_F(MetricsImplTest, TimingHistogram) {
+	for(int i = 0; i < 100; ++i) {
+		metrics_->timing("exact", 5ms);
+	}
+
+	metrics_->timing("approx", 1000ms);
+	metrics_.reset();
+
+	const auto received = receive(collector_);
+	ASSERT_EQ(std::vector<std::string>{ "5|ms|@0.01" }, received.samples.at("exact"));
+
+	const auto& approx = received.samples.at("approx");
+	ASSERT_EQ(1, approx.size());
+	ASSERT_NEAR(1000, std::stoi(approx.front()), 1000 * 0.0625);
+}
+
+TEST_F(MetricsImplTest, MicrosecondTiming) {
+	metrics_->timing("fine", 12us);
+	metrics_->timing("fine", 12us);
+	metrics_->timing("coarse", 1500us);
+	metrics_.reset();
+
+	const auto received = receive(collector_);
+	ASSERT_EQ(std::vector<std::string>{ "0.012|ms|@0.5" }, received.samples.at("fine"));
+
+	const auto& coarse = received.samples.at("coarse");
+	ASSERT_EQ(1, coarse.size());
+	ASSERT_NEAR(1.5, std::stod(coarse.front()), 1.5 * 0.0625);
+}
+
+TEST_F(MetricsImplTest, DatagramsFitMTU) {
+	for(int i = 0; i < 500; ++i) {
+		metrics_->increment(("key." + std::to_string(i)).c_str());
+		metrics_->timing("latency", std::chrono::milliseconds(i));
+	}
+
+	metrics_.reset();
+	const auto received = receive(collector_);
+
+	ASSERT_GT(received.datagrams, 1);
+	ASSERT_LE(received.largest, ember::MetricsImpl::MAX_DATAGRAM);
+	ASSERT_EQ(501, received.samples.size());
+
+	// one line per histogram bucket rather than per sample
+	ASSERT_LT(received.samples.at("latency").size(), 100);
+	ASSERT_EQ(500, sample_count(received.samples.at("latency")));
+}
+
+TEST(MetricsImpl, PeriodicFlush) {
+	boost::asio::io_context service;
+	bai::udp::socket collector(service, bai::udp::endpoint(bai::address_v4::loopback(), 0));
+	ember::MetricsImpl metrics(service, "127.0.0.1", collector.local_endpoint().port(), 20ms);
+	std::thread worker([&]() { service.run(); });
+
+	metrics.increment("first");
+	char buffer[2048];
+	auto size = collector.receive(boost::asio::buffer(buffer));
+	ASSERT_EQ("first:1|c", std::string(buffer, size));
+
+	metrics.increment("second", 2);
+	size = collector.receive(boost::asio::buffer(buffer));
+	ASSERT_EQ("second:2|c", std::string(buffer, size));
+
+	service.stop();
+	worker.join();
+}
\ No newline at end of file
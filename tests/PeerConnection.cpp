@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <spark/v2/PeerConnection.h>
+#include <spark/v2/Dispatcher.h>
+#include <spark/BufferPool.h>
+#include <boost/asio.hpp>
+#include <gtest/gtest.h>
+#include <memory>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+
+namespace spark = ember::spark;
+using Socket = boost::asio::ip::tcp::socket;
+
+namespace {
+
+struct FrameCollector final : spark::v2::Dispatcher {
+	std::vector<std::vector<std::uint8_t>> frames;
+	std::size_t expected = 0;
+	bool closed = false;
+	boost::asio::io_context* context = nullptr;
+
+	bool receive(std::span<const std::uint8_t> frame) override {
+		frames.emplace_back(frame.begin(), frame.end());
+
+		if(frames.size() == expected) {
+			context->stop();
+		}
+
+		return true;
+	}
+
+	void connection_closed() override {
+		closed = true;
+		context->stop();
+	}
+};
+
+void connect_pair(boost::asio::io_context& context, Socket& a, Socket& b) {
+	const auto loopback = boost::asio::ip::address_v4::loopback();
+	boost::asio::ip::tcp::acceptor acceptor(context, { loopback, 0 });
+	a.connect(acceptor.local_endpoint());
+	acceptor.accept(b);
+}
+
+std::vector<std::uint8_t> payload(const spark::BufferHandle& fbb) {
+	const auto data = fbb->GetBufferPointer();
+	return { data, data + fbb->GetSize() };
+}
+
+} // unnamed
+
+TEST(PeerConnection, FramesArriveIntact) {
+	boost::asio::io_context context;
+	Socket a(context), b(context);
+	connect_pair(context, a, b);
+
+	FrameCollector sender, receiver;
+	sender.context = receiver.context = &context;
+
+	auto out = std::make_shared<spark::v2::PeerConnection<Socket>>(sender, std::move(a));
+	auto in = std::make_shared<spark::v2::PeerConnection<Socket>>(receiver, std::move(b));
+	out->start(out);
+	in->start(in);
+
+	// mix of sizes to force partial frames, compaction and buffer growth
+	const std::vector<std::size_t> sizes { 1, 17, 4096, 70000, 3, 200000, 65533, 8, 1024 * 1024 - 64 };
+	std::vector<std::vector<std::uint8_t>> sent;
+
+	for(std::size_t i = 0; i < sizes.size(); ++i) {
+		auto fbb = spark::make_buffer();
+		fbb->CreateString(std::string(sizes[i], static_cast<char>('a' + i)));
+		fbb->Finish(flatbuffers::Offset<void>());
+		sent.emplace_back(payload(fbb));
+		ASSERT_TRUE(out->send(fbb));
+	}
+
+	receiver.expected = sent.size();
+	context.run();
+
+	ASSERT_FALSE(receiver.closed);
+	ASSERT_EQ(sent, receiver.frames);
+	out->close();
+	in->close();
+}
+
+TEST(PeerConnection, FragmentedFrames) {
+	boost::asio::io_context context;
+	Socket a(context), b(context);
+	connect_pair(context, a, b);
+
+	FrameCollector receiver;
+	receiver.context = &context;
+	receiver.expected = 3;
+
+	auto in = std::make_shared<spark::v2::PeerConnection<Socket>>(receiver, std::move(b));
+	in->start(in);
+
+	// three frames written a byte at a time
+	const std::vector<std::uint8_t> stream {
+		0x02, 0x00, 0x00, 0x00, 'h', 'i',
+		0x00, 0x00, 0x00, 0x00,
+		0x03, 0x00, 0x00, 0x00, 'f', 'o', 'o'
+	};
+
+	std::thread writer([&]() {
+		for(auto byte : stream) {
+			boost::asio::write(a, boost::asio::buffer(&byte, 1));
+		}
+	});
+
+	context.run();
+	writer.join();
+
+	const std::vector<std::vector<std::uint8_t>> expected {
+		{ 'h', 'i' }, {}, { 'f', 'o', 'o' }
+	};
+
+	ASSERT_EQ(expected, receiver.frames);
+	in->close();
+}
+
+TEST(PeerConnection, OversizedFrameCloses) {
+	boost::asio::io_context context;
+	Socket a(context), b(context);
+	connect_pair(context, a, b);
+
+	FrameCollector receiver;
+	receiver.context = &context;
+
+	auto in = std::make_shared<spark::v2::PeerConnection<Socket>>(receiver, std::move(b));
+	in->start(in);
+
+	const std::uint8_t prefix[] { 0xff, 0xff, 0xff, 0x7f };
+	boost::asio::write(a, boost::asio::buffer(prefix));
+	context.run();
+
+	ASSERT_TRUE(receiver.closed);
+	ASSERT_TRUE(receiver.frames.empty());
+	in->close();
+}
\ No newline at end of file
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <shared/metrics/PoolMetrics.h>
+#include <shared/metrics/Metrics.h>
+#include <shared/threading/ThreadPool.h>
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <map>
+#include <string>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+namespace {
+
+class GaugeMetrics final : public ember::Metrics {
+public:
+	std::map<std::string, std::uintmax_t> gauges;
+
+	void gauge(const char* key, std::uintmax_t value, Adjustment) override {
+		gauges[key] = value;
+	}
+};
+
+} // unnamed
+
+TEST(PoolMetrics, ReportsSinceLastReport) {
+	constexpr int TASKS = 10;
+	std::atomic<int> count { 0 };
+	std::promise<void> done;
+	ember::ThreadPool pool(1, 1);
+	ember::PoolMetrics reporter(pool);
+	GaugeMetrics metrics;
+
+	for(int i = 0; i < TASKS; ++i) {
+		ASSERT_TRUE(pool.run_blocking([&] {
+			std::this_thread::sleep_for(1ms);
+
+			if(++count == TASKS) {
+				done.set_value();
+			}
+		}));
+	}
+
+	ASSERT_EQ(std::future_status::ready, done.get_future().wait_for(10s));
+	pool.shutdown(); // the last task's run time is recorded after it signals
+
+	reporter.report(metrics);
+	ASSERT_EQ(TASKS, metrics.gauges["thread_pool.blocking.tasks"]);
+	ASSERT_EQ(0u, metrics.gauges["thread_pool.blocking.depth"]);
+	ASSERT_EQ(0u, metrics.gauges["thread_pool.blocking.rejected"]);
+	ASSERT_LE(1000u, metrics.gauges["thread_pool.blocking.run_p50_us"]);
+	ASSERT_LE(metrics.gauges["thread_pool.blocking.run_p50_us"],
+	          metrics.gauges["thread_pool.blocking.run_p99_us"]);
+	ASSERT_EQ(0u, metrics.gauges["thread_pool.interactive.tasks"]);
+
+	// nothing has run since, so there's nothing to take percentiles of
+	reporter.report(metrics);
+	ASSERT_EQ(0u, metrics.gauges["thread_pool.blocking.tasks"]);
+	ASSERT_EQ(0u, metrics.gauges["thread_pool.blocking.run_p99_us"]);
+}
\ No newline at end of file
@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <spark/ServiceDiscovery.h>
+#include <logger/Logging.h>
+#include <boost/asio/io_context.hpp>
+#include <gtest/gtest.h>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include <cstdint>
+
+namespace spark = ember::spark;
+namespace em = ember::messaging;
+using namespace std::chrono_literals;
+
+namespace {
+
+constexpr auto LOOPBACK = "127.0.0.1";
+constexpr auto GROUP = "239.255.0.1";
+constexpr std::uint16_t MCAST_PORT = 46001;
+
+using Located = std::vector<std::pair<std::string, std::uint16_t>>;
+
+} // unnamed
+
+class ServiceDiscoveryTest : public ::testing::Test {
+public:
+	virtual void SetUp() override {
+		logger = std::make_unique<ember::log::Logger>();
+		provider = make_discovery(1000);
+
+		if(!provider->joined()) {
+			GTEST_SKIP() << "Loopback multicast unavailable";
+		}
+	}
+
+	virtual void TearDown() override {
+		for(auto& discovery : { provider.get(), consumer.get() }) {
+			if(discovery) {
+				discovery->shutdown();
+			}
+		}
+	}
+
+	std::unique_ptr<spark::ServiceDiscovery> make_discovery(std::uint16_t port) {
+		return std::make_unique<spark::ServiceDiscovery>(io_context, LOOPBACK, port, LOOPBACK,
+		                                                 GROUP, MCAST_PORT, logger.get());
+	}
+
+	spark::LocateCallback collect(Located& located) {
+		return [&](const em::multicast::LocateResponse* message) {
+			located.emplace_back(message->ip()->str(), message->port());
+			io_context.stop();
+		};
+	}
+
+	boost::asio::io_context io_context;
+	std::unique_ptr<ember::log::Logger> logger;
+	std::unique_ptr<spark::ServiceDiscovery> provider, consumer;
+};
+
+TEST_F(ServiceDiscoveryTest, Announce) {
+	Located located;
+	consumer = make_discovery(2000);
+	auto listener = consumer->listener(em::Service::ACCOUNT, collect(located));
+
+	provider->register_service(em::Service::ACCOUNT);
+	io_context.run_for(5s);
+
+	ASSERT_EQ(1, located.size());
+	ASSERT_EQ(LOOPBACK, located[0].first);
+	ASSERT_EQ(1000, located[0].second);
+	ASSERT_EQ(1, consumer->cached(em::Service::ACCOUNT));
+}
+
+TEST_F(ServiceDiscoveryTest, SearchThenCacheHit) {
+	// registered before the consumer exists, so it misses the announcement
+	provider->register_service(em::Service::CHARACTER);
+	io_context.run_for(100ms);
+	io_context.restart();
+
+	Located located;
+	consumer = make_discovery(2000);
+	auto listener = consumer->listener(em::Service::CHARACTER, collect(located));
+	ASSERT_EQ(0, consumer->cached(em::Service::CHARACTER));
+
+	listener->search();
+	io_context.run_for(5s);
+	io_context.restart();
+
+	ASSERT_EQ(1, located.size());
+	ASSERT_EQ(1, consumer->cached(em::Service::CHARACTER));
+
+	// a cache hit is answered immediately, without touching the network
+	located.clear();
+	listener->search();
+	ASSERT_EQ(1, located.size());
+	ASSERT_EQ(1000, located[0].second);
+}
+
+// listeners hear about refreshes too, so they can reconnect to a peer after losing the link
+TEST_F(ServiceDiscoveryTest, RefreshNotifies) {
+	Located located;
+	consumer = make_discovery(2000);
+	auto listener = consumer->listener(em::Service::ACCOUNT, collect(located));
+
+	provider->register_service(em::Service::ACCOUNT);
+	io_context.run_for(5s);
+	io_context.restart();
+
+	provider->register_service(em::Service::ACCOUNT);
+	io_context.run_for(5s);
+
+	ASSERT_EQ(2, located.size());
+	ASSERT_EQ(located[0], located[1]);
+	ASSERT_EQ(1, consumer->cached(em::Service::ACCOUNT));
+}
+
+TEST(ServiceDiscovery, JoinFailure) {
+	boost::asio::io_context io_context;
+	ember::log::Logger logger;
+
+	// not a valid interface address, so joining the group fails
+	spark::ServiceDiscovery discovery(io_context, LOOPBACK, 1000, "not-an-address",
+	                                  GROUP, MCAST_PORT, &logger);
+	ASSERT_FALSE(discovery.joined());
+
+	// still usable, it just doesn't do anything
+	discovery.register_service(em::Service::ACCOUNT);
+	auto listener = discovery.listener(em::Service::ACCOUNT, [](auto) {});
+	listener->search();
+	ASSERT_EQ(0, discovery.cached(em::Service::ACCOUNT));
+	discovery.shutdown();
+}
\ No newline at end of file
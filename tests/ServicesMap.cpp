@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <spark/ServicesMap.h>
+#include <spark/LoadBalancer.h>
+#include <boost/uuid/uuid_generators.hpp>
+#include <gtest/gtest.h>
+#include <map>
+#include <vector>
+#include <cstdint>
+
+namespace spark = ember::spark;
+namespace em = ember::messaging;
+using Mode = spark::ServicesMap::Mode;
+
+namespace {
+
+std::vector<spark::Link> make_links(std::size_t count) {
+	boost::uuids::random_generator uuid_gen;
+	std::vector<spark::Link> links(count);
+
+	for(std::size_t i = 0; i < count; ++i) {
+		links[i].uuid = uuid_gen();
+		links[i].description = "peer " + std::to_string(i);
+	}
+
+	return links;
+}
+
+} // unnamed
+
+TEST(ServicesMap, RegisterRemove) {
+	spark::ServicesMap services;
+	const auto links = make_links(3);
+
+	for(const auto& link : links) {
+		services.register_peer_service(link, em::Service::ACCOUNT, Mode::SERVER);
+	}
+
+	// duplicates are ignored & modes are tracked separately
+	services.register_peer_service(links[0], em::Service::ACCOUNT, Mode::SERVER);
+	services.register_peer_service(links[0], em::Service::ACCOUNT, Mode::CLIENT);
+
+	ASSERT_EQ(3, services.peer_services(em::Service::ACCOUNT, Mode::SERVER).size());
+	ASSERT_EQ(1, services.peer_services(em::Service::ACCOUNT, Mode::CLIENT).size());
+	ASSERT_TRUE(services.peer_services(em::Service::CHARACTER, Mode::SERVER).empty());
+
+	services.remove_peer(links[0]);
+	const auto remaining = services.peer_services(em::Service::ACCOUNT, Mode::SERVER);
+	ASSERT_EQ(2, remaining.size());
+	ASSERT_EQ(remaining.end(), std::find(remaining.begin(), remaining.end(), links[0]));
+	ASSERT_TRUE(services.peer_services(em::Service::ACCOUNT, Mode::CLIENT).empty());
+}
+
+TEST(ServicesMap, SnapshotOutlivesRemoval) {
+	spark::ServicesMap services;
+	const auto links = make_links(2);
+	services.register_peer_service(links[0], em::Service::ACCOUNT, Mode::SERVER);
+	services.register_peer_service(links[1], em::Service::ACCOUNT, Mode::SERVER);
+
+	const auto snapshot = services.snapshot(em::Service::ACCOUNT, Mode::SERVER);
+	auto peer = snapshot->peers[0];
+	ASSERT_TRUE(peer->healthy);
+
+	// the snapshot is unaffected, but the peer is flagged for anybody holding it
+	services.remove_peer(peer->link);
+	ASSERT_EQ(2, snapshot->peers.size());
+	ASSERT_FALSE(peer->healthy);
+	ASSERT_EQ(1, services.snapshot(em::Service::ACCOUNT, Mode::SERVER)->peers.size());
+}
+
+TEST(LoadBalancer, LeastLoaded) {
+	spark::ServicesMap services;
+	const auto links = make_links(2);
+	services.register_peer_service(links[0], em::Service::ACCOUNT, Mode::SERVER);
+	services.register_peer_service(links[1], em::Service::ACCOUNT, Mode::SERVER);
+
+	const auto set = services.snapshot(em::Service::ACCOUNT, Mode::SERVER);
+	set->peers[0]->in_flight = 10;
+
+	// either both samples land on the idle peer or it wins the comparison
+	for(int i = 0; i < 100; ++i) {
+		const auto peer = spark::LoadBalancer::by_load(*set);
+		ASSERT_EQ(set->peers[1], peer);
+	}
+
+	// already tried peers are skipped, however idle
+	const auto peer = spark::LoadBalancer::by_load(*set, { set->peers[1] });
+	ASSERT_EQ(set->peers[0], peer);
+}
+
+TEST(LoadBalancer, LeaseInFlight) {
+	spark::ServicesMap services;
+	const auto links = make_links(1);
+	services.register_peer_service(links[0], em::Service::ACCOUNT, Mode::SERVER);
+
+	const auto set = services.snapshot(em::Service::ACCOUNT, Mode::SERVER);
+	const auto& peer = set->peers[0];
+
+	{
+		spark::LoadBalancer::Lease lease(peer);
+		ASSERT_EQ(links[0], lease.link());
+		ASSERT_EQ(1, peer->in_flight);
+
+		// moving the lease doesn't count the request twice
+		auto moved = std::move(lease);
+		ASSERT_EQ(1, peer->in_flight);
+
+		moved = spark::LoadBalancer::Lease();
+		ASSERT_EQ(0, peer->in_flight);
+	}
+
+	ASSERT_EQ(0, peer->in_flight);
+	ASSERT_FALSE(spark::LoadBalancer::Lease());
+}
+
+TEST(LoadBalancer, KeyAffinity) {
+	constexpr std::uint64_t KEYS = 10'000;
+	spark::ServicesMap services;
+	const auto links = make_links(5);
+
+	for(std::size_t i = 0; i < 4; ++i) {
+		services.register_peer_service(links[i], em::Service::CHARACTER, Mode::SERVER);
+	}
+
+	std::map<std::uint64_t, spark::Link> before;
+	std::map<boost::uuids::uuid, std::size_t> spread;
+
+	{
+		const auto set = services.snapshot(em::Service::CHARACTER, Mode::SERVER);
+
+		for(std::uint64_t key = 0; key < KEYS; ++key) {
+			const auto peer = spark::LoadBalancer::by_key(*set, key);
+			ASSERT_TRUE(peer);
+			ASSERT_EQ(peer, spark::LoadBalancer::by_key(*set, key));
+			before.emplace(key, peer->link);
+			++spread[peer->link.uuid];
+		}
+	}
+
+	// every peer should receive a reasonable share of the keys
+	ASSERT_EQ(4, spread.size());
+
+	for(const auto& [uuid, count] : spread) {
+		ASSERT_GT(count, KEYS / 8);
+	}
+
+	// adding a peer should only move keys on to the new peer
+	services.register_peer_service(links[4], em::Service::CHARACTER, Mode::SERVER);
+	const auto set = services.snapshot(em::Service::CHARACTER, Mode::SERVER);
+	std::size_t moved = 0;
+
+	for(std::uint64_t key = 0; key < KEYS; ++key) {
+		const auto peer = spark::LoadBalancer::by_key(*set, key);
+
+		if(peer->link != before[key]) {
+			ASSERT_EQ(links[4], peer->link);
+			++moved;
+		}
+	}
+
+	ASSERT_GT(moved, 0);
+	ASSERT_LT(moved, KEYS / 3);
+}
\ No newline at end of file
@@ -0,0 +1,221 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#if defined __linux__
+
+#include <spark/ShmSession.h>
+#include <gtest/gtest.h>
+#include <array>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace spark = ember::spark;
+using spark::detail::ShmRing;
+using spark::detail::ShmSegment;
+
+namespace {
+
+std::vector<std::uint8_t> pattern(std::size_t size, std::uint8_t seed) {
+	std::vector<std::uint8_t> data(size);
+
+	for(std::size_t i = 0; i < size; ++i) {
+		data[i] = static_cast<std::uint8_t>(seed + i);
+	}
+
+	return data;
+}
+
+std::vector<std::vector<std::uint8_t>> drain_all(ShmRing& ring) {
+	std::vector<std::vector<std::uint8_t>> records;
+
+	while(ring.drain([&](const std::uint8_t* data, std::size_t size) {
+		records.emplace_back(data, data + size);
+		return true;
+	}, 16) > 0);
+
+	return records;
+}
+
+} // unnamed
+
+TEST(ShmRing, PushDrain) {
+	auto segment = ShmSegment::create();
+	ASSERT_TRUE(segment);
+	auto ring = segment->ring(0);
+
+	ASSERT_TRUE(ring.empty());
+
+	for(std::size_t i = 0; i < 10; ++i) {
+		const auto data = pattern(i * 13 + 1, static_cast<std::uint8_t>(i));
+		ASSERT_TRUE(ring.push(data.data(), data.size()));
+	}
+
+	const auto records = drain_all(ring);
+	ASSERT_EQ(10, records.size());
+
+	for(std::size_t i = 0; i < records.size(); ++i) {
+		ASSERT_EQ(pattern(i * 13 + 1, static_cast<std::uint8_t>(i)), records[i]);
+	}
+
+	ASSERT_TRUE(ring.empty());
+	ASSERT_EQ(10, ring.consumed());
+}
+
+TEST(ShmRing, Wraparound) {
+	auto segment = ShmSegment::create();
+	ASSERT_TRUE(segment);
+	auto ring = segment->ring(1);
+
+	// odd sizes so records straddle the end of the ring at varying offsets
+	const std::size_t size = 300'007;
+	const auto iterations = (ShmRing::CAPACITY / size) * 5;
+
+	for(std::size_t i = 0; i < iterations; ++i) {
+		const auto data = pattern(size, static_cast<std::uint8_t>(i));
+		ASSERT_TRUE(ring.push(data.data(), data.size()));
+
+		const auto records = drain_all(ring);
+		ASSERT_EQ(1, records.size());
+		ASSERT_EQ(data, records[0]);
+	}
+}
+
+TEST(ShmRing, Full) {
+	auto segment = ShmSegment::create();
+	ASSERT_TRUE(segment);
+	auto ring = segment->ring(0);
+
+	const auto data = pattern(ShmRing::max_payload(), 0);
+	ASSERT_TRUE(ring.push(data.data(), data.size()));
+	ASSERT_FALSE(ring.push(data.data(), ShmRing::max_payload() + 1));
+
+	std::size_t pushed = 1;
+
+	while(ring.push(data.data(), 1024)) {
+		++pushed;
+	}
+
+	// consuming a record frees space for the next
+	int drained = ring.drain([](const std::uint8_t*, std::size_t) { return true; }, 1);
+	ASSERT_EQ(1, drained);
+	ASSERT_TRUE(ring.push(data.data(), 1024));
+	ASSERT_EQ(pushed, drain_all(ring).size());
+}
+
+TEST(ShmRing, ParkWake) {
+	auto segment = ShmSegment::create();
+	ASSERT_TRUE(segment);
+	auto ring = segment->ring(0);
+	const std::uint8_t byte = 1;
+
+	// nothing to do, consumer parks and the next push must wake it
+	ASSERT_TRUE(ring.park());
+	ASSERT_TRUE(ring.push(&byte, sizeof(byte)));
+	ASSERT_TRUE(ring.consumer_parked());
+
+	// the wakeup is only owed once
+	ASSERT_FALSE(ring.consumer_parked());
+
+	// data is pending, so the consumer must not park
+	ASSERT_FALSE(ring.park());
+	ASSERT_TRUE(ring.push(&byte, sizeof(byte)));
+	ASSERT_FALSE(ring.consumer_parked());
+	ASSERT_EQ(2, drain_all(ring).size());
+}
+
+TEST(ShmRing, SharedSegment) {
+	auto segment = ShmSegment::create();
+	ASSERT_TRUE(segment);
+
+	int sockets[2];
+	ASSERT_EQ(0, ::socketpair(AF_UNIX, SOCK_STREAM, 0, sockets));
+	ASSERT_TRUE(spark::detail::send_descriptors(sockets[0], segment->descriptors()));
+
+	std::array<int, ShmSegment::DESCRIPTOR_COUNT> fds{};
+	ASSERT_TRUE(spark::detail::receive_descriptors(sockets[1], fds));
+	::close(sockets[0]);
+	::close(sockets[1]);
+
+	auto remote = ShmSegment::open(fds);
+	ASSERT_TRUE(remote);
+
+	auto producer = segment->ring(0);
+	auto consumer = remote->ring(0);
+	const auto data = pattern(512, 7);
+	ASSERT_TRUE(producer.push(data.data(), data.size()));
+
+	const auto records = drain_all(consumer);
+	ASSERT_EQ(1, records.size());
+	ASSERT_EQ(data, records[0]);
+}
+
+// the peer shares the memory, so the ring has to survive it writing garbage
+TEST(ShmRing, CorruptIndices) {
+	auto segment = ShmSegment::create();
+	ASSERT_TRUE(segment);
+	auto ring = segment->ring(0);
+
+	auto memory = ::mmap(nullptr, ShmSegment::MAPPING_SIZE, PROT_READ | PROT_WRITE,
+	                     MAP_SHARED, segment->descriptors()[0], 0);
+	ASSERT_NE(MAP_FAILED, memory);
+	auto control = static_cast<spark::detail::RingControl*>(memory);
+	auto data = static_cast<std::uint8_t*>(memory) + sizeof(spark::detail::RingControl);
+	const auto noop = [](const std::uint8_t*, std::size_t) { return true; };
+
+	// padding that claims to run past the tail
+	std::memcpy(data, &ShmRing::PADDING, sizeof(ShmRing::PADDING));
+	control->tail = ShmRing::RECORD_HEADER;
+	ASSERT_EQ(-1, ring.drain(noop, 16));
+
+	// tail further ahead of head than the ring can hold
+	control->tail = ShmRing::CAPACITY + ShmRing::RECORD_HEADER;
+	ASSERT_EQ(-1, ring.drain(noop, 16));
+
+	::munmap(memory, ShmSegment::MAPPING_SIZE);
+}
+
+TEST(ShmSegment, Sealed) {
+	auto segment = ShmSegment::create();
+	ASSERT_TRUE(segment);
+
+	const auto memfd = segment->descriptors()[0];
+	ASSERT_EQ(-1, ::ftruncate(memfd, 0));
+	ASSERT_EQ(-1, ::ftruncate(memfd, ShmSegment::MAPPING_SIZE * 2));
+}
+
+TEST(ShmSegment, RejectsUnsealed) {
+	std::array<int, ShmSegment::DESCRIPTOR_COUNT> fds {
+		::memfd_create("ember-spark-test", MFD_CLOEXEC),
+		::eventfd(0, EFD_CLOEXEC),
+		::eventfd(0, EFD_CLOEXEC)
+	};
+
+	for(auto fd : fds) {
+		ASSERT_NE(-1, fd);
+	}
+
+	ASSERT_EQ(0, ::ftruncate(fds[0], ShmSegment::MAPPING_SIZE));
+	ASSERT_FALSE(ShmSegment::open(fds)); // takes ownership of the descriptors
+}
+
+TEST(ShmSegment, SameUser) {
+	int sockets[2];
+	ASSERT_EQ(0, ::socketpair(AF_UNIX, SOCK_STREAM, 0, sockets));
+	ASSERT_TRUE(spark::detail::same_user(sockets[0]));
+	ASSERT_TRUE(spark::detail::same_user(sockets[1]));
+	::close(sockets[0]);
+	::close(sockets[1]);
+}
+
+#endif
\ No newline at end of file
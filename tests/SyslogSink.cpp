@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <logger/SyslogSink.h>
+#include <boost/asio.hpp>
+#include <gtest/gtest.h>
+#include <chrono>
+#include <regex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace el = ember::log;
+namespace bai = boost::asio::ip;
+using namespace std::chrono_literals;
+
+namespace {
+
+using Batch = std::vector<std::pair<el::RecordDetail, std::vector<char>>>;
+
+std::vector<char> record(const std::string& text) {
+	return { text.begin(), text.end() };
+}
+
+Batch batch(const std::vector<std::string>& texts) {
+	Batch records;
+
+	for(const auto& text : texts) {
+		records.emplace_back(el::RecordDetail{ el::Severity::WARN, el::Filter(0) }, record(text + "\n"));
+	}
+
+	return records;
+}
+
+// <PRI>1 TIMESTAMP HOSTNAME APP-NAME PROCID MSGID SD MSG, LOCAL_USE_0 + warning = 16 * 8 + 4
+const std::regex RFC5424(R"(<132>1 \d{4}-\d\d-\d\dT\d\d:\d\d:\d\d\.\d{3}Z \S+ test \d+ - - (.*))");
+
+std::string message(const std::string& frame) {
+	std::smatch match;
+	return std::regex_match(frame, match, RFC5424)? match[1].str() : "<malformed> " + frame;
+}
+
+} // unnamed
+
+TEST(SyslogSink, UDP) {
+	boost::asio::io_context service;
+	bai::udp::socket collector(service, bai::udp::endpoint(bai::address_v4::loopback(), 0));
+	const auto port = collector.local_endpoint().port();
+
+	el::SyslogSink sink(el::Severity::INFO, el::Filter(0), "127.0.0.1", port,
+	                    el::SyslogSink::Facility::LOCAL_USE_0, "test");
+
+	sink.write(el::Severity::WARN, el::Filter(0), record("single\n"), false);
+	sink.write(el::Severity::DEBUG, el::Filter(0), record("filtered\n"), false);
+	sink.batch_write(batch({ "first", "second" }));
+
+	// one message per datagram
+	std::vector<std::string> received;
+	char buffer[2048];
+
+	for(int i = 0; i < 3; ++i) {
+		const auto size = collector.receive(boost::asio::buffer(buffer));
+		received.emplace_back(message(std::string(buffer, size)));
+	}
+
+	ASSERT_EQ((std::vector<std::string>{ "single", "first", "second" }), received);
+	ASSERT_EQ(0, sink.dropped());
+}
+
+TEST(SyslogSink, TCPOctetCounting) {
+	boost::asio::io_context service;
+	bai::tcp::acceptor acceptor(service, bai::tcp::endpoint(bai::address_v4::loopback(), 0));
+	const auto port = acceptor.local_endpoint().port();
+
+	el::SyslogSink sink(el::Severity::INFO, el::Filter(0), "127.0.0.1", port,
+	                    el::SyslogSink::Facility::LOCAL_USE_0, "test",
+	                    el::SyslogSink::Transport::TCP);
+
+	sink.batch_write(batch({ "first", "second with spaces", "third" }));
+
+	bai::tcp::socket socket(service);
+	acceptor.accept(socket);
+
+	boost::asio::streambuf stream;
+	std::vector<std::string> received;
+
+	while(received.size() < 3) {
+		boost::asio::read_until(socket, stream, ' ');
+		std::istream input(&stream);
+		std::string length;
+		std::getline(input, length, ' ');
+
+		const auto size = std::stoul(length);
+
+		if(stream.size() < size) {
+			boost::asio::read(socket, stream, boost::asio::transfer_exactly(size - stream.size()));
+		}
+
+		std::string frame(size, '\0');
+		input.read(frame.data(), size);
+		received.emplace_back(message(frame));
+	}
+
+	ASSERT_EQ((std::vector<std::string>{ "first", "second with spaces", "third" }), received);
+}
+
+// the collector accepts but never reads, so the sink's thread is stuck writing when it's destroyed
+TEST(SyslogSink, TCPStalledCollector) {
+	boost::asio::io_context service;
+	bai::tcp::acceptor acceptor(service);
+	acceptor.open(bai::tcp::v4());
+	acceptor.set_option(boost::asio::socket_base::receive_buffer_size(1024));
+	acceptor.bind(bai::tcp::endpoint(bai::address_v4::loopback(), 0));
+	acceptor.listen();
+	const auto port = acceptor.local_endpoint().port();
+	bai::tcp::socket socket(service);
+	std::chrono::steady_clock::time_point start;
+
+	{
+		el::SyslogSink sink(el::Severity::INFO, el::Filter(0), "127.0.0.1", port,
+		                    el::SyslogSink::Facility::LOCAL_USE_0, "test",
+		                    el::SyslogSink::Transport::TCP);
+
+		const std::vector<std::string> texts(1000, std::string(1000, 'x'));
+		sink.batch_write(batch(texts));
+		acceptor.accept(socket);
+
+		for(int i = 0; i < 16; ++i) {
+			sink.batch_write(batch(texts));
+			std::this_thread::sleep_for(10ms);
+		}
+
+		start = std::chrono::steady_clock::now();
+	}
+
+	ASSERT_LT(std::chrono::steady_clock::now() - start, 5s);
+}
\ No newline at end of file
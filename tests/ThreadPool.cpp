@@ -0,0 +1,242 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <shared/threading/ThreadPool.h>
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+using Lane = ember::ThreadPool::Lane;
+
+TEST(ThreadPool, RunsEveryTask) {
+	constexpr std::size_t TASKS = 3000;
+	std::atomic<std::size_t> count { 0 };
+	std::promise<void> done;
+	ember::ThreadPool pool(4, 2);
+
+	for(std::size_t i = 0; i < TASKS; ++i) {
+		pool.run([&] {
+			if(++count == TASKS) {
+				done.set_value();
+			}
+		}, static_cast<Lane>(i % 3));
+	}
+
+	ASSERT_EQ(std::future_status::ready, done.get_future().wait_for(10s));
+	pool.shutdown();
+
+	std::size_t total = 0;
+
+	for(auto lane : { Lane::INTERACTIVE, Lane::BACKGROUND, Lane::BLOCKING }) {
+		const auto stats = pool.stats(lane);
+		ASSERT_EQ(0u, stats.depth);
+		ASSERT_EQ(TASKS / 3, stats.wait.count());
+		ASSERT_EQ(TASKS / 3, stats.run.count());
+		total += stats.run.count();
+	}
+
+	ASSERT_EQ(TASKS, total);
+}
+
+TEST(ThreadPool, InteractiveFirst) {
+	std::mutex lock;
+	std::vector<Lane> order;
+	std::promise<void> done;
+	std::promise<void> started;
+	std::promise<void> release;
+	auto gate = release.get_future().share();
+
+	ember::ThreadPool pool(1);
+
+	pool.run([&, gate] {
+		started.set_value();
+		gate.wait();
+	});
+
+	ASSERT_EQ(std::future_status::ready, started.get_future().wait_for(10s));
+
+	for(int i = 0; i < 10; ++i) {
+		const auto lane = i < 5? Lane::BACKGROUND : Lane::INTERACTIVE;
+
+		pool.run([&, lane] {
+			std::lock_guard<std::mutex> guard(lock);
+			order.emplace_back(lane);
+
+			if(order.size() == 10) {
+				done.set_value();
+			}
+		}, lane);
+	}
+
+	ASSERT_EQ(5u, pool.stats(Lane::BACKGROUND).depth);
+	ASSERT_EQ(5u, pool.stats(Lane::INTERACTIVE).depth);
+
+	release.set_value();
+	ASSERT_EQ(std::future_status::ready, done.get_future().wait_for(10s));
+
+	for(std::size_t i = 0; i < order.size(); ++i) {
+		ASSERT_EQ(i < 5? Lane::INTERACTIVE : Lane::BACKGROUND, order[i]);
+	}
+}
+
+// the inner task lands on the outer task's deque, so only a thief can run it
+TEST(ThreadPool, Steal) {
+	std::promise<bool> result;
+	ember::ThreadPool pool(2);
+
+	pool.run([&] {
+		auto inner = std::make_shared<std::promise<void>>();
+		auto ran = inner->get_future();
+		pool.run([inner] { inner->set_value(); });
+		result.set_value(ran.wait_for(10s) == std::future_status::ready);
+	});
+
+	auto future = result.get_future();
+	ASSERT_EQ(std::future_status::ready, future.wait_for(20s));
+	ASSERT_TRUE(future.get());
+}
+
+TEST(ThreadPool, BlockingLaneIsolated) {
+	std::promise<void> release;
+	auto gate = release.get_future().share();
+	std::atomic<int> running { 0 };
+	std::atomic<int> peak { 0 };
+	std::promise<void> cpu;
+	std::promise<void> drained;
+	ember::ThreadPool pool(1, 2);
+
+	for(int i = 0; i < 4; ++i) {
+		pool.run_blocking([&, gate] {
+			const auto now = ++running;
+			int expected = peak;
+
+			while(now > expected && !peak.compare_exchange_weak(expected, now)) {}
+
+			gate.wait();
+			--running;
+		});
+	}
+
+	// CPU work carries on while every blocking thread is stuck
+	pool.run([&] { cpu.set_value(); });
+	ASSERT_EQ(std::future_status::ready, cpu.get_future().wait_for(10s));
+
+	while(running != 2) {
+		std::this_thread::yield();
+	}
+
+	ASSERT_EQ(2u, pool.stats(Lane::BLOCKING).depth);
+
+	release.set_value();
+	pool.run_blocking([&] { drained.set_value(); });
+	ASSERT_EQ(std::future_status::ready, drained.get_future().wait_for(10s));
+	ASSERT_EQ(2, peak);
+}
+
+TEST(ThreadPool, BlockingLaneBounded) {
+	std::promise<void> started;
+	std::promise<void> release;
+	auto gate = release.get_future().share();
+	std::atomic<int> count { 0 };
+	std::promise<void> done;
+	ember::ThreadPool pool(1, 1, 2);
+
+	ASSERT_TRUE(pool.run_blocking([&, gate] {
+		started.set_value();
+		gate.wait();
+	}));
+
+	ASSERT_EQ(std::future_status::ready, started.get_future().wait_for(10s));
+
+	for(int i = 0; i < 2; ++i) {
+		ASSERT_TRUE(pool.run_blocking([&] {
+			if(++count == 2) {
+				done.set_value();
+			}
+		}));
+	}
+
+	// the queue is full, the worker's busy and the CPU lanes don't count towards the limit
+	ASSERT_FALSE(pool.run_blocking([&] { ++count; }));
+	ASSERT_TRUE(pool.run([] {}));
+	ASSERT_EQ(1u, pool.stats(Lane::BLOCKING).rejected);
+
+	release.set_value();
+	ASSERT_EQ(std::future_status::ready, done.get_future().wait_for(10s));
+	pool.shutdown();
+	ASSERT_EQ(2, count);
+}
+
+TEST(ThreadPool, Exception) {
+	std::atomic<int> errors { 0 };
+	std::promise<void> done;
+	ember::ThreadPool pool(1);
+
+	pool.log_callback([&](auto severity, auto) {
+		if(severity == ember::ThreadPool::Severity::ERROR) {
+			++errors;
+		}
+	});
+
+	pool.run([] { throw std::runtime_error("oops"); });
+
+	pool.run([&] { done.set_value(); });
+	ASSERT_EQ(std::future_status::ready, done.get_future().wait_for(10s));
+	ASSERT_EQ(1, errors);
+}
+
+TEST(ThreadPool, MoveOnlyTask) {
+	std::promise<int> done;
+	auto result = done.get_future();
+	ember::ThreadPool pool(1);
+
+	pool.run([value = std::make_unique<int>(42), done = std::move(done)]() mutable {
+		done.set_value(*value);
+	});
+
+	ASSERT_EQ(std::future_status::ready, result.wait_for(10s));
+	ASSERT_EQ(42, result.get());
+}
+
+// each task is posted once the last has finished, so the workers have gone back to sleep
+TEST(ThreadPool, WakesSleepingWorkers) {
+	constexpr int PRODUCERS = 4;
+	constexpr int TASKS = 500;
+	std::atomic<int> timeouts { 0 };
+	ember::ThreadPool pool(4);
+	std::vector<std::thread> producers;
+
+	for(int p = 0; p < PRODUCERS; ++p) {
+		producers.emplace_back([&] {
+			for(int i = 0; i < TASKS; ++i) {
+				std::promise<void> done;
+				auto result = done.get_future();
+				pool.run([&done] { done.set_value(); });
+
+				if(result.wait_for(10s) != std::future_status::ready) {
+					++timeouts;
+					return;
+				}
+			}
+		});
+	}
+
+	for(auto& producer : producers) {
+		producer.join();
+	}
+
+	ASSERT_EQ(0, timeouts);
+	ASSERT_EQ(0u, pool.stats(Lane::INTERACTIVE).depth);
+}
\ No newline at end of file
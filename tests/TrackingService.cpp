@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <spark/TrackingService.h>
+#include <logger/Logging.h>
+#include <boost/asio/io_context.hpp>
+#include <boost/uuid/uuid_generators.hpp>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <random>
+#include <vector>
+#include <cstdint>
+
+namespace spark = ember::spark;
+using namespace std::chrono_literals;
+
+class TrackingServiceTest : public ::testing::Test {
+public:
+	virtual void SetUp() override {
+		logger = std::make_unique<ember::log::Logger>();
+		tracking = std::make_unique<spark::TrackingService>(io_context, logger.get());
+		link_a.uuid = uuid_gen();
+		link_b.uuid = uuid_gen();
+	}
+
+	virtual void TearDown() override {
+		tracking->shutdown();
+	}
+
+	spark::Message response(std::uint64_t sequence) {
+		spark::Message message{};
+		message.token = { true, sequence };
+		return message;
+	}
+
+	boost::uuids::random_generator uuid_gen;
+	boost::asio::io_context io_context;
+	std::unique_ptr<ember::log::Logger> logger;
+	std::unique_ptr<spark::TrackingService> tracking;
+	spark::Link link_a, link_b;
+};
+
+TEST_F(TrackingServiceTest, Response) {
+	int responses = 0;
+	int timeouts = 0;
+
+	auto handler = [&](const spark::Link&, std::optional<spark::Message> message) {
+		message? ++responses : ++timeouts;
+	};
+
+	tracking->register_tracked(link_a, 1, handler, 5s);
+	tracking->register_tracked(link_a, 2, handler, 5s);
+	ASSERT_EQ(2, tracking->outstanding());
+
+	tracking->on_message(link_a, response(2));
+	ASSERT_EQ(1, responses);
+	ASSERT_EQ(1, tracking->outstanding());
+
+	// duplicate responses should be discarded
+	tracking->on_message(link_a, response(2));
+	ASSERT_EQ(1, responses);
+	ASSERT_EQ(0, timeouts);
+}
+
+TEST_F(TrackingServiceTest, SequencesArePerLink) {
+	std::optional<spark::Link> responder;
+
+	tracking->register_tracked(link_a, 1, [&](const spark::Link& link, auto) {
+		responder = link;
+	}, 5s);
+
+	// same sequence from a different link must not complete the request
+	tracking->on_message(link_b, response(1));
+	ASSERT_FALSE(responder);
+
+	tracking->on_message(link_a, response(1));
+	ASSERT_TRUE(responder);
+	ASSERT_EQ(link_a, *responder);
+}
+
+TEST_F(TrackingServiceTest, Timeout) {
+	int responses = 0;
+	int timeouts = 0;
+
+	auto handler = [&](const spark::Link&, std::optional<spark::Message> message) {
+		message? ++responses : ++timeouts;
+	};
+
+	tracking->register_tracked(link_a, 1, handler, 10ms);
+	tracking->register_tracked(link_b, 1, handler, 10ms);
+	tracking->register_tracked(link_a, 2, handler, 10ms);
+	tracking->on_message(link_a, response(2));
+
+	// the wheel stops ticking once nothing is outstanding, so this returns
+	io_context.run();
+
+	ASSERT_EQ(1, responses);
+	ASSERT_EQ(2, timeouts);
+	ASSERT_EQ(0, tracking->outstanding());
+}
+
+TEST_F(TrackingServiceTest, Cancel) {
+	bool invoked = false;
+
+	tracking->register_tracked(link_a, 1, [&](auto&, auto) { invoked = true; }, 10ms);
+	tracking->cancel(link_a, 1);
+	ASSERT_EQ(0, tracking->outstanding());
+
+	tracking->on_message(link_a, response(1));
+	io_context.run();
+	ASSERT_FALSE(invoked);
+}
+
+TEST_F(TrackingServiceTest, ManyOutstanding) {
+	const std::uint64_t count = 20000;
+	std::vector<std::uint64_t> completed;
+	std::vector<std::uint64_t> sequences;
+
+	for(std::uint64_t i = 1; i <= count; ++i) {
+		sequences.emplace_back(i);
+		tracking->register_tracked(i % 2? link_a : link_b, i,
+			[&, i](auto&, auto) { completed.emplace_back(i); }, 5s);
+	}
+
+	ASSERT_EQ(count, tracking->outstanding());
+
+	// complete in random order to exercise removal from the middle of probe runs
+	std::shuffle(sequences.begin(), sequences.end(), std::mt19937(42));
+
+	for(auto sequence : sequences) {
+		tracking->on_message(sequence % 2? link_a : link_b, response(sequence));
+	}
+
+	ASSERT_EQ(0, tracking->outstanding());
+	ASSERT_EQ(sequences, completed);
+}
+
+TEST_F(TrackingServiceTest, LinkDown) {
+	std::vector<spark::Link> failed;
+	int responses = 0;
+
+	auto handler = [&](const spark::Link& link, std::optional<spark::Message> message) {
+		message? ++responses : (failed.emplace_back(link), 0);
+	};
+
+	for(std::uint64_t i = 1; i <= 100; ++i) {
+		tracking->register_tracked(link_a, i, handler, 5s);
+		tracking->register_tracked(link_b, i, handler, 5s);
+	}
+
+	// requests on the lost link fail immediately, the others are untouched
+	tracking->on_link_down(link_a);
+	ASSERT_EQ(100, failed.size());
+	ASSERT_TRUE(std::all_of(failed.begin(), failed.end(), [&](const auto& link) {
+		return link == link_a;
+	}));
+	ASSERT_EQ(100, tracking->outstanding());
+
+	for(std::uint64_t i = 1; i <= 100; ++i) {
+		tracking->on_message(link_b, response(i));
+	}
+
+	ASSERT_EQ(100, responses);
+	ASSERT_EQ(0, tracking->outstanding());
+}
\ No newline at end of file
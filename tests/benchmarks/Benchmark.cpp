@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "Benchmark.h"
+#include <algorithm>
+#include <iostream>
+#include <exception>
+#include <string_view>
+#include <cstdlib>
+
+namespace ember::bench {
+
+namespace {
+
+std::uint64_t percentile(const std::vector<std::uint64_t>& sorted, double pct) {
+	if(sorted.empty()) {
+		return 0;
+	}
+
+	const auto index = static_cast<std::size_t>(pct * (sorted.size() - 1));
+	return sorted[index];
+}
+
+} // unnamed
+
+Registrar::Registrar(const char* name, Function function) {
+	Runner::add(name, std::move(function));
+}
+
+auto Runner::registry() -> std::vector<Entry>& {
+	static std::vector<Entry> entries;
+	return entries;
+}
+
+void Runner::add(const char* name, Function function) {
+	registry().emplace_back(Entry{ name, std::move(function) });
+}
+
+int Runner::run(const std::string& filter, Format format, std::size_t scale) {
+	auto& entries = registry();
+
+	std::sort(entries.begin(), entries.end(), [](const auto& lhs, const auto& rhs) {
+		return lhs.name < rhs.name;
+	});
+
+	for(auto& entry : entries) {
+		if(!filter.empty() && entry.name.find(filter) == std::string::npos) {
+			continue;
+		}
+
+		State state(scale);
+		entry.function(state);
+
+		auto& samples = state.samples_;
+		std::sort(samples.begin(), samples.end());
+
+		const auto secs = std::chrono::duration<double>(state.elapsed_).count();
+		const auto ops_per_sec = secs > 0? state.operations_ / secs : 0.0;
+
+		if(format == Format::JSON) {
+			// one object per line, for diffing against a stored baseline
+			std::cout << "{\"name\":\"" << entry.name << "\""
+			          << ",\"operations\":" << state.operations_
+			          << ",\"elapsed_ns\":" << state.elapsed_.count()
+			          << ",\"ops_per_sec\":" << static_cast<std::uint64_t>(ops_per_sec)
+			          << ",\"samples\":" << samples.size()
+			          << ",\"p50_ns\":" << percentile(samples, 0.5)
+			          << ",\"p99_ns\":" << percentile(samples, 0.99)
+			          << ",\"p999_ns\":" << percentile(samples, 0.999);
+
+			for(auto& [key, value] : state.counters_) {
+				std::cout << ",\"" << key << "\":" << value;
+			}
+
+			std::cout << "}\n";
+		} else {
+			std::cout << entry.name << "\n"
+			          << "  ops/sec: " << static_cast<std::uint64_t>(ops_per_sec)
+			          << " (" << state.operations_ << " in " << secs << "s)\n";
+
+			if(!samples.empty()) {
+				std::cout << "  latency p50/p99/p999: " << percentile(samples, 0.5) << "/"
+				          << percentile(samples, 0.99) << "/"
+				          << percentile(samples, 0.999) << " ns\n";
+			}
+
+			for(auto& [key, value] : state.counters_) {
+				std::cout << "  " << key << ": " << value << "\n";
+			}
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
+
+} // bench, ember
+
+int main(int argc, const char* argv[]) try {
+	namespace eb = ember::bench;
+
+	std::string filter;
+	auto format = eb::Runner::Format::TEXT;
+	std::size_t scale = 1;
+
+	for(int i = 1; i < argc; ++i) {
+		const std::string_view arg(argv[i]);
+
+		if(arg == "--json") {
+			format = eb::Runner::Format::JSON;
+		} else if(arg == "--scale" && i + 1 < argc) {
+			scale = std::max(1, std::atoi(argv[++i]));
+		} else if(arg == "--filter" && i + 1 < argc) {
+			filter = argv[++i];
+		} else {
+			std::cerr << "Usage: " << argv[0] << " [--filter name] [--scale n] [--json]\n";
+			return EXIT_FAILURE;
+		}
+	}
+
+	return eb::Runner::run(filter, format, scale);
+} catch(const std::exception& e) {
+	std::cerr << e.what() << "\n";
+	return EXIT_FAILURE;
+}
\ No newline at end of file
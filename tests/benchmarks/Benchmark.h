@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace ember::bench {
+
+/*
+ * Collects the results of a single benchmark run. Latency samples may be
+ * recorded from multiple threads; the owning benchmark is responsible for
+ * reporting the wall clock time and the number of operations performed.
+ */
+class State final {
+	std::mutex lock_;
+	std::vector<std::uint64_t> samples_;
+	std::map<std::string, double> counters_;
+	std::chrono::nanoseconds elapsed_ {};
+	std::uint64_t operations_ = 0;
+
+public:
+	const std::size_t scale;
+
+	explicit State(std::size_t scale) : scale(scale) {}
+
+	// merges a batch of latency samples, in nanoseconds
+	void samples(const std::vector<std::uint64_t>& samples) {
+		std::lock_guard<std::mutex> guard(lock_);
+		samples_.insert(samples_.end(), samples.begin(), samples.end());
+	}
+
+	void counter(const std::string& key, double value) {
+		std::lock_guard<std::mutex> guard(lock_);
+		counters_[key] = value;
+	}
+
+	void elapsed(std::chrono::nanoseconds elapsed, std::uint64_t operations) {
+		elapsed_ = elapsed;
+		operations_ = operations;
+	}
+
+	friend class Runner;
+};
+
+typedef std::function<void(State&)> Function;
+
+struct Registrar {
+	Registrar(const char* name, Function function);
+};
+
+// nanosecond timestamp for recording latency samples
+inline std::uint64_t now() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+class Runner final {
+	struct Entry {
+		std::string name;
+		Function function;
+	};
+
+	static std::vector<Entry>& registry();
+
+public:
+	enum class Format { TEXT, JSON };
+
+	static void add(const char* name, Function function);
+	static int run(const std::string& filter, Format format, std::size_t scale);
+};
+
+} // bench, ember
+
+#define BENCHMARK(name) \
+	static void name(ember::bench::State&); \
+	static ember::bench::Registrar name##_registrar(#name, name); \
+	static void name
\ No newline at end of file
@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "Benchmark.h"
+#include <logger/Logging.h>
+#include <logger/Sink.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace bench = ember::bench;
+namespace el = ember::log;
+
+namespace {
+
+constexpr std::size_t STATEMENTS = 500'000;
+constexpr std::size_t SAMPLE_INTERVAL = 16;
+
+class NullSink final : public el::Sink {
+public:
+	NullSink() : Sink(el::Severity::TRACE, el::Filter(0)) {}
+
+	void write(el::Severity, el::Filter, const std::vector<char>&, bool) override {}
+	void batch_write(const std::vector<std::pair<el::RecordDetail, std::vector<char>>>&) override {}
+};
+
+// roughly what a spark trace statement looks like
+void statement(el::Logger* logger, const std::string& peer, const std::size_t i) {
+	LOG_TRACE(logger) << "[spark] Received message " << i << " from " << peer
+		<< ", " << 1024u << " bytes, window " << -16 << ", rtt " << 0.75 << LOG_ASYNC;
+}
+
+void statement_literal(el::Logger* logger, const std::string& peer, const std::size_t i) {
+	LOG_TRACE(logger) << el::Literal("[spark] Received message ") << i << el::Literal(" from ") << peer
+		<< el::Literal(", ") << 1024u << el::Literal(" bytes, window ") << -16
+		<< el::Literal(", rtt ") << 0.75 << LOG_ASYNC;
+}
+
+template<typename Statement>
+void run(bench::State& state, const el::Capture mode, Statement statement) {
+	const auto statements = STATEMENTS * state.scale;
+	const std::string peer("gateway-1.realm (127.0.0.1:6000)");
+
+	std::vector<std::uint64_t> samples;
+	samples.reserve(statements / SAMPLE_INTERVAL + 1);
+
+	el::Logger logger;
+	logger.add_sink(std::make_unique<NullSink>());
+	logger.capture(mode);
+
+	// caller side cost only, the worker is left to drain in the background
+	const auto start = std::chrono::steady_clock::now();
+
+	for(std::size_t i = 0; i < statements; ++i) {
+		if(i % SAMPLE_INTERVAL) {
+			statement(&logger, peer, i);
+			continue;
+		}
+
+		const auto begin = bench::now();
+		statement(&logger, peer, i);
+		samples.emplace_back(bench::now() - begin);
+	}
+
+	state.elapsed(std::chrono::steady_clock::now() - start, statements);
+	state.samples(samples);
+}
+
+} // unnamed
+
+BENCHMARK(logging_capture_text)(bench::State& state) {
+	run(state, el::Capture::TEXT, statement);
+}
+
+BENCHMARK(logging_capture_binary)(bench::State& state) {
+	run(state, el::Capture::BINARY, statement);
+}
+
+BENCHMARK(logging_capture_binary_literal)(bench::State& state) {
+	run(state, el::Capture::BINARY, statement_literal);
+}
\ No newline at end of file
@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "Benchmark.h"
+#include <logger/FileSink.h>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace bench = ember::bench;
+namespace el = ember::log;
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr std::size_t RECORDS = 1'000'000;
+constexpr std::size_t BATCH_SIZE = 256;
+constexpr std::size_t WARN_INTERVAL = 1024; // one warning every four batches
+
+using Batch = std::vector<std::pair<el::RecordDetail, std::vector<char>>>;
+
+Batch make_batch(const std::size_t offset) {
+	const std::string text("[spark] Received message from gateway-1.realm (127.0.0.1:6000), 1024 bytes\n");
+	Batch batch;
+
+	for(std::size_t i = 0; i < BATCH_SIZE; ++i) {
+		const auto severity = (offset + i) % WARN_INTERVAL? el::Severity::INFO : el::Severity::WARN;
+		batch.emplace_back(el::RecordDetail{ severity, el::Filter(0) },
+		                   std::vector<char>(text.begin(), text.end()));
+	}
+
+	return batch;
+}
+
+std::unique_ptr<el::FileSink> make_sink(const fs::path& path) {
+	auto sink = std::make_unique<el::FileSink>(el::Severity::TRACE, el::Filter(0), path.string(),
+	                                           el::FileSink::Mode::TRUNCATE);
+	sink->log_date(true);
+	sink->log_severity(true);
+	return sink;
+}
+
+void run_batched(bench::State& state, const el::Severity sync) {
+	const auto records = RECORDS * state.scale;
+	const auto path = fs::temp_directory_path() / "ember_bench_filesink.log";
+	std::vector<std::uint64_t> samples;
+	std::vector<Batch> batches;
+
+	for(std::size_t i = 0; i < WARN_INTERVAL; i += BATCH_SIZE) {
+		batches.emplace_back(make_batch(i));
+	}
+
+	{
+		auto sink = make_sink(path);
+		sink->sync_severity(sync);
+
+		const auto start = std::chrono::steady_clock::now();
+
+		for(std::size_t i = 0; i < records; i += BATCH_SIZE) {
+			const auto& batch = batches[(i / BATCH_SIZE) % batches.size()];
+			const auto begin = bench::now();
+			sink->batch_write(batch);
+			samples.emplace_back(bench::now() - begin);
+		}
+
+		state.elapsed(std::chrono::steady_clock::now() - start, records);
+	}
+
+	state.samples(samples);
+	state.counter("batch", BATCH_SIZE);
+	fs::remove(path);
+}
+
+} // unnamed
+
+BENCHMARK(logging_filesink_batch)(bench::State& state) {
+	run_batched(state, el::Severity::DISABLED);
+}
+
+BENCHMARK(logging_filesink_batch_fsync_warn)(bench::State& state) {
+	run_batched(state, el::Severity::WARN);
+}
+
+BENCHMARK(logging_filesink_single)(bench::State& state) {
+	const auto records = RECORDS * state.scale;
+	const auto path = fs::temp_directory_path() / "ember_bench_filesink.log";
+	const std::string text("[spark] Received message from gateway-1.realm (127.0.0.1:6000), 1024 bytes\n");
+	const std::vector<char> record(text.begin(), text.end());
+
+	{
+		auto sink = make_sink(path);
+		const auto start = std::chrono::steady_clock::now();
+
+		for(std::size_t i = 0; i < records; ++i) {
+			sink->write(el::Severity::INFO, el::Filter(0), record, false);
+		}
+
+		state.elapsed(std::chrono::steady_clock::now() - start, records);
+	}
+
+	fs::remove(path);
+}
\ No newline at end of file
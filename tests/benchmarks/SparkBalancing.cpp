@@ -0,0 +1,263 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "Benchmark.h"
+#include <spark/LoadBalancer.h>
+#include <spark/ServicesMap.h>
+#include <spark/Link.h>
+#include <boost/uuid/uuid_generators.hpp>
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <forward_list>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace spark = ember::spark;
+namespace bench = ember::bench;
+namespace em = ember::messaging;
+using Mode = spark::ServicesMap::Mode;
+
+namespace {
+
+constexpr std::size_t PICKS_PER_THREAD = 200'000;
+constexpr std::size_t SAMPLE_INTERVAL = 16;
+constexpr std::size_t PEERS = 8;
+constexpr std::size_t REQUESTS = 200'000;
+
+std::vector<spark::Link> make_links(std::size_t count) {
+	boost::uuids::random_generator uuid_gen;
+	std::vector<spark::Link> links(count);
+
+	for(auto& link : links) {
+		link.uuid = uuid_gen();
+	}
+
+	return links;
+}
+
+// the list + lock map that was replaced, kept as a baseline
+class LockedServices {
+	std::forward_list<spark::Link> peers_;
+	mutable std::mutex lock_;
+
+public:
+	void add(const spark::Link& link) {
+		std::lock_guard<std::mutex> guard(lock_);
+		peers_.emplace_front(link);
+	}
+
+	std::vector<spark::Link> peer_services() const {
+		std::lock_guard<std::mutex> guard(lock_);
+		return std::vector<spark::Link>(peers_.begin(), peers_.end());
+	}
+};
+
+template<typename Pick>
+void contend(bench::State& state, Pick pick, const std::size_t threads) {
+	const auto picks = PICKS_PER_THREAD * state.scale;
+	std::atomic<bool> go { false };
+	std::vector<std::thread> workers;
+
+	for(std::size_t i = 0; i < threads; ++i) {
+		workers.emplace_back([&]() {
+			std::vector<std::uint64_t> samples;
+			samples.reserve(picks / SAMPLE_INTERVAL + 1);
+
+			while(!go.load(std::memory_order_acquire)) {
+				std::this_thread::yield();
+			}
+
+			for(std::size_t j = 0; j < picks; ++j) {
+				if(j % SAMPLE_INTERVAL) {
+					pick(j);
+					continue;
+				}
+
+				const auto start = bench::now();
+				pick(j);
+				samples.emplace_back(bench::now() - start);
+			}
+
+			state.samples(samples);
+		});
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+	go.store(true, std::memory_order_release);
+
+	for(auto& worker : workers) {
+		worker.join();
+	}
+
+	state.elapsed(std::chrono::steady_clock::now() - start, picks * threads);
+	state.counter("threads", static_cast<double>(threads));
+	state.counter("peers", static_cast<double>(PEERS));
+}
+
+void pick_locked(bench::State& state, const std::size_t threads) {
+	LockedServices services;
+
+	for(const auto& link : make_links(PEERS)) {
+		services.add(link);
+	}
+
+	contend(state, [&](std::size_t i) {
+		const auto links = services.peer_services();
+		return links[i % links.size()].uuid.data[0];
+	}, threads);
+}
+
+void pick_snapshot(bench::State& state, const std::size_t threads, const bool keyed) {
+	spark::ServicesMap services;
+
+	for(const auto& link : make_links(PEERS)) {
+		services.register_peer_service(link, em::Service::ACCOUNT, Mode::SERVER);
+	}
+
+	contend(state, [&](std::size_t i) {
+		const auto set = services.snapshot(em::Service::ACCOUNT, Mode::SERVER);
+		const auto peer = keyed? spark::LoadBalancer::by_key(*set, i)
+		                       : spark::LoadBalancer::by_load(*set);
+		return peer->link.uuid.data[0];
+	}, threads);
+}
+
+std::size_t contending_threads() {
+	return std::max(2u, std::thread::hardware_concurrency());
+}
+
+/*
+ * Simulated peers in virtual time, each serving requests one at a time in
+ * order. One peer is four times slower than the rest, as if overloaded.
+ * Requests arrive at 75% of the total capacity and are assigned by the
+ * strategy; recorded latency is the time from arrival until completion,
+ * with one time unit reported as one microsecond.
+ */
+enum class Strategy { LATCHED, RANDOM, LEAST_LOADED };
+
+void balance(bench::State& state, const Strategy strategy) {
+	constexpr double UNIT_NS = 1000.0;
+	const std::vector<double> service_time { 4.0, 1.0, 1.0, 1.0 };
+
+	spark::ServicesMap services;
+	const auto links = make_links(service_time.size());
+
+	for(const auto& link : links) {
+		services.register_peer_service(link, em::Service::ACCOUNT, Mode::SERVER);
+	}
+
+	const auto set = services.snapshot(em::Service::ACCOUNT, Mode::SERVER);
+	std::vector<std::deque<double>> completions(set->peers.size());
+	std::vector<double> service(set->peers.size());
+
+	for(std::size_t i = 0; i < set->peers.size(); ++i) {
+		const auto index = std::find(links.begin(), links.end(), set->peers[i]->link) - links.begin();
+		service[i] = service_time[index];
+	}
+
+	double capacity = 0.0;
+
+	for(auto time : service_time) {
+		capacity += 1.0 / time;
+	}
+
+	std::mt19937_64 rng(42);
+	std::exponential_distribution<double> arrivals(capacity * 0.75);
+	std::uniform_int_distribution<std::size_t> random_peer(0, set->peers.size() - 1);
+
+	const auto total = REQUESTS * state.scale;
+	std::vector<std::uint64_t> samples;
+	samples.reserve(total);
+	std::size_t max_queue = 0;
+	double clock = 0.0;
+
+	const auto start = std::chrono::steady_clock::now();
+
+	for(std::size_t i = 0; i < total; ++i) {
+		clock += arrivals(rng);
+
+		for(std::size_t p = 0; p < completions.size(); ++p) {
+			auto& queue = completions[p];
+
+			while(!queue.empty() && queue.front() <= clock) {
+				queue.pop_front();
+			}
+
+			set->peers[p]->in_flight.store(static_cast<std::uint32_t>(queue.size()),
+			                               std::memory_order_relaxed);
+		}
+
+		std::size_t target = 0;
+
+		switch(strategy) {
+			case Strategy::LATCHED:
+				target = 0; // the slow peer happened to come up first
+				break;
+			case Strategy::RANDOM:
+				target = random_peer(rng);
+				break;
+			case Strategy::LEAST_LOADED: {
+				const auto peer = spark::LoadBalancer::by_load(*set);
+				target = std::find(set->peers.begin(), set->peers.end(), peer) - set->peers.begin();
+				break;
+			}
+		}
+
+		auto& queue = completions[target];
+		const auto begin = queue.empty()? clock : std::max(clock, queue.back());
+		queue.emplace_back(begin + service[target]);
+		max_queue = std::max(max_queue, queue.size());
+		samples.emplace_back(static_cast<std::uint64_t>((queue.back() - clock) * UNIT_NS));
+	}
+
+	state.elapsed(std::chrono::steady_clock::now() - start, total);
+	state.samples(samples);
+	state.counter("peers", static_cast<double>(service_time.size()));
+	state.counter("max_queue", static_cast<double>(max_queue));
+}
+
+} // unnamed
+
+BENCHMARK(spark_balance_pick_locked_1)(bench::State& state) {
+	pick_locked(state, 1);
+}
+
+BENCHMARK(spark_balance_pick_locked_n)(bench::State& state) {
+	pick_locked(state, contending_threads());
+}
+
+BENCHMARK(spark_balance_pick_p2c_1)(bench::State& state) {
+	pick_snapshot(state, 1, false);
+}
+
+BENCHMARK(spark_balance_pick_p2c_n)(bench::State& state) {
+	pick_snapshot(state, contending_threads(), false);
+}
+
+BENCHMARK(spark_balance_pick_hash_1)(bench::State& state) {
+	pick_snapshot(state, 1, true);
+}
+
+BENCHMARK(spark_balance_pick_hash_n)(bench::State& state) {
+	pick_snapshot(state, contending_threads(), true);
+}
+
+BENCHMARK(spark_balance_sim_latched)(bench::State& state) {
+	balance(state, Strategy::LATCHED);
+}
+
+BENCHMARK(spark_balance_sim_random)(bench::State& state) {
+	balance(state, Strategy::RANDOM);
+}
+
+BENCHMARK(spark_balance_sim_p2c)(bench::State& state) {
+	balance(state, Strategy::LEAST_LOADED);
+}
\ No newline at end of file
@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "Benchmark.h"
+#include <spark/EventDispatcher.h>
+#include <spark/EventHandler.h>
+#include <spark/Common.h>
+#include <spark/Link.h>
+#include <algorithm>
+#include <atomic>
+#include <shared_mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace spark = ember::spark;
+namespace bench = ember::bench;
+namespace em = ember::messaging;
+
+namespace {
+
+constexpr std::size_t DISPATCHES_PER_THREAD = 200'000;
+constexpr std::size_t SAMPLE_INTERVAL = 16;
+
+class NullHandler final : public spark::EventHandler {
+public:
+	std::atomic<std::uint64_t> count { 0 };
+
+	void on_message(const spark::Link&, const spark::Message&) override {
+		count.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void on_link_up(const spark::Link&) override {}
+	void on_link_down(const spark::Link&) override {}
+};
+
+// the map + exclusive lock dispatcher that was replaced, kept as a baseline
+class LockedDispatcher {
+	std::unordered_map<em::Service, spark::EventHandler*> handlers_;
+	mutable std::shared_mutex lock_;
+
+public:
+	void register_handler(spark::EventHandler* handler, em::Service service) {
+		std::unique_lock<std::shared_mutex> guard(lock_);
+		handlers_[service] = handler;
+	}
+
+	void dispatch_message(em::Service service, const spark::Link& link,
+	                      const spark::Message& message) const {
+		std::unique_lock<std::shared_mutex> guard(lock_);
+		auto it = handlers_.find(service);
+
+		if(it != handlers_.end()) {
+			it->second->on_message(link, message);
+		}
+	}
+};
+
+template<typename Dispatcher>
+void contend(bench::State& state, const Dispatcher& dispatcher, const std::size_t threads) {
+	const auto dispatches = DISPATCHES_PER_THREAD * state.scale;
+	std::atomic<bool> go { false };
+	std::vector<std::thread> workers;
+
+	for(std::size_t i = 0; i < threads; ++i) {
+		workers.emplace_back([&]() {
+			spark::Link link{};
+			spark::Message message{};
+			message.service = em::Service::ACCOUNT;
+
+			std::vector<std::uint64_t> samples;
+			samples.reserve(dispatches / SAMPLE_INTERVAL + 1);
+
+			while(!go.load(std::memory_order_acquire)) {
+				std::this_thread::yield();
+			}
+
+			for(std::size_t j = 0; j < dispatches; ++j) {
+				if(j % SAMPLE_INTERVAL) {
+					dispatcher.dispatch_message(message.service, link, message);
+					continue;
+				}
+
+				const auto start = bench::now();
+				dispatcher.dispatch_message(message.service, link, message);
+				samples.emplace_back(bench::now() - start);
+			}
+
+			state.samples(samples);
+		});
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+	go.store(true, std::memory_order_release);
+
+	for(auto& worker : workers) {
+		worker.join();
+	}
+
+	state.elapsed(std::chrono::steady_clock::now() - start, dispatches * threads);
+	state.counter("threads", static_cast<double>(threads));
+}
+
+std::size_t contending_threads() {
+	return std::max(2u, std::thread::hardware_concurrency());
+}
+
+} // unnamed
+
+BENCHMARK(spark_dispatch_snapshot_1)(bench::State& state) {
+	NullHandler handler;
+	spark::EventDispatcher dispatcher;
+	dispatcher.register_handler(&handler, em::Service::ACCOUNT,
+	                            spark::EventDispatcher::Mode::BOTH);
+	contend(state, dispatcher, 1);
+}
+
+BENCHMARK(spark_dispatch_snapshot_n)(bench::State& state) {
+	NullHandler handler;
+	spark::EventDispatcher dispatcher;
+	dispatcher.register_handler(&handler, em::Service::ACCOUNT,
+	                            spark::EventDispatcher::Mode::BOTH);
+	contend(state, dispatcher, contending_threads());
+}
+
+BENCHMARK(spark_dispatch_locked_1)(bench::State& state) {
+	NullHandler handler;
+	LockedDispatcher dispatcher;
+	dispatcher.register_handler(&handler, em::Service::ACCOUNT);
+	contend(state, dispatcher, 1);
+}
+
+BENCHMARK(spark_dispatch_locked_n)(bench::State& state) {
+	NullHandler handler;
+	LockedDispatcher dispatcher;
+	dispatcher.register_handler(&handler, em::Service::ACCOUNT);
+	contend(state, dispatcher, contending_threads());
+}
\ No newline at end of file
@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "Benchmark.h"
+#include <spark/TrackingService.h>
+#include <logger/Logging.h>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/uuid/uuid.hpp>
+#include <boost/uuid/uuid_generators.hpp>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace spark = ember::spark;
+namespace bench = ember::bench;
+using namespace std::chrono_literals;
+
+namespace {
+
+constexpr std::size_t IN_FLIGHT = 100'000;
+
+// the per-request timer & random UUID scheme that was replaced, kept as a baseline
+class LegacyTracking {
+	struct Request {
+		Request(boost::asio::io_context& service, spark::TrackingHandler handler)
+		        : timer(service), handler(std::move(handler)) { }
+
+		boost::asio::steady_timer timer;
+		spark::TrackingHandler handler;
+	};
+
+	std::unordered_map<boost::uuids::uuid, std::unique_ptr<Request>,
+	                   boost::hash<boost::uuids::uuid>> handlers_;
+	boost::uuids::random_generator generate_uuid_;
+	boost::asio::io_context& io_context_;
+	std::mutex lock_;
+
+public:
+	explicit LegacyTracking(boost::asio::io_context& io_context) : io_context_(io_context) {}
+
+	boost::uuids::uuid register_tracked(spark::TrackingHandler handler,
+	                                    std::chrono::milliseconds timeout) {
+		const auto id = generate_uuid_();
+		auto request = std::make_unique<Request>(io_context_, std::move(handler));
+		request->timer.expires_from_now(timeout);
+		request->timer.async_wait([](const boost::system::error_code&) {});
+
+		std::lock_guard<std::mutex> guard(lock_);
+		handlers_[id] = std::move(request);
+		return id;
+	}
+
+	void on_message(const spark::Link& link, const boost::uuids::uuid& id) {
+		std::unique_lock<std::mutex> guard(lock_);
+		auto it = handlers_.find(id);
+		auto request = std::move(it->second);
+		handlers_.erase(it);
+		guard.unlock();
+
+		request->timer.cancel();
+		request->handler(link, std::nullopt);
+	}
+};
+
+void record(bench::State& state, std::chrono::steady_clock::time_point start,
+            std::size_t completed, std::size_t expected) {
+	state.elapsed(std::chrono::steady_clock::now() - start, completed);
+	state.counter("in_flight", static_cast<double>(expected));
+}
+
+} // unnamed
+
+BENCHMARK(spark_tracking_wheel_100k)(bench::State& state) {
+	boost::asio::io_context io_context;
+	ember::log::Logger logger;
+	spark::TrackingService tracking(io_context, &logger);
+	spark::Link link { boost::uuids::random_generator()(), "bench" };
+
+	const auto in_flight = IN_FLIGHT * state.scale;
+	std::size_t completed = 0;
+	std::vector<std::uint64_t> samples;
+	samples.reserve(in_flight * 2);
+
+	spark::Message response{};
+	const auto start = std::chrono::steady_clock::now();
+
+	for(std::uint64_t i = 1; i <= in_flight; ++i) {
+		const auto begin = bench::now();
+		tracking.register_tracked(link, i, [&](auto&, auto) { ++completed; }, 5s);
+		samples.emplace_back(bench::now() - begin);
+	}
+
+	for(std::uint64_t i = 1; i <= in_flight; ++i) {
+		response.token = { true, i };
+		const auto begin = bench::now();
+		tracking.on_message(link, response);
+		samples.emplace_back(bench::now() - begin);
+	}
+
+	record(state, start, completed, in_flight);
+	state.samples(samples);
+	tracking.shutdown();
+}
+
+BENCHMARK(spark_tracking_legacy_100k)(bench::State& state) {
+	boost::asio::io_context io_context;
+	LegacyTracking tracking(io_context);
+	spark::Link link { boost::uuids::random_generator()(), "bench" };
+
+	const auto in_flight = IN_FLIGHT * state.scale;
+	std::size_t completed = 0;
+	std::vector<boost::uuids::uuid> ids;
+	std::vector<std::uint64_t> samples;
+	ids.reserve(in_flight);
+	samples.reserve(in_flight * 2);
+
+	const auto start = std::chrono::steady_clock::now();
+
+	for(std::size_t i = 0; i < in_flight; ++i) {
+		const auto begin = bench::now();
+		ids.emplace_back(tracking.register_tracked([&](auto&, auto) { ++completed; }, 5s));
+		samples.emplace_back(bench::now() - begin);
+	}
+
+	for(const auto& id : ids) {
+		const auto begin = bench::now();
+		tracking.on_message(link, id);
+		samples.emplace_back(bench::now() - begin);
+	}
+
+	record(state, start, completed, in_flight);
+	state.samples(samples);
+}
+
+BENCHMARK(spark_tracking_wheel_timeout_100k)(bench::State& state) {
+	boost::asio::io_context io_context;
+	ember::log::Logger logger;
+	spark::TrackingService tracking(io_context, &logger);
+	spark::Link link { boost::uuids::random_generator()(), "bench" };
+
+	const auto in_flight = IN_FLIGHT * state.scale;
+	std::size_t expired = 0;
+	const auto start = std::chrono::steady_clock::now();
+
+	for(std::uint64_t i = 1; i <= in_flight; ++i) {
+		tracking.register_tracked(link, i, [&](auto&, auto) { ++expired; }, 1ms);
+	}
+
+	io_context.run();
+	record(state, start, expired, in_flight);
+}
\ No newline at end of file
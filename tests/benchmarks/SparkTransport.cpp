@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2022 Ember
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "Benchmark.h"
+#include <spark/NetworkSession.h>
+#include <spark/EventDispatcher.h>
+#include <spark/MessageHandler.h>
+#include <spark/ServicesMap.h>
+#include <spark/SessionManager.h>
+#include <spark/TcpSession.h>
+#include <spark/LocalSession.h>
+#include <spark/ShmSession.h>
+#include <spark/v2/PeerSession.h>
+#include <spark/BufferPool.h>
+#include <logger/Logging.h>
+#include <boost/asio.hpp>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#if defined __linux__
+#include <unistd.h>
+#endif
+
+namespace spark = ember::spark;
+namespace bench = ember::bench;
+namespace bai = boost::asio::ip;
+
+namespace {
+
+constexpr std::size_t MESSAGES = 100'000;
+
+/*
+ * Skips the spark handshake and header processing so only the transport
+ * is measured - every frame is handed straight to the callback
+ */
+template<typename Session>
+class RawSession final : public Session {
+	std::function<void()> on_frame_;
+
+	bool handle_frame(const std::uint8_t*, std::uint32_t) override {
+		on_frame_();
+		return true;
+	}
+
+public:
+	template<typename... Args>
+	RawSession(std::function<void()> on_frame, Args&&... args)
+		: Session(std::forward<Args>(args)...), on_frame_(std::move(on_frame)) {}
+};
+
+/*
+ * Everything a pair of sessions needs, with the client & server sharing the
+ * same io_context so each transport is measured without thread hand-offs
+ */
+struct Environment {
+	boost::asio::io_context context;
+	ember::log::Logger logger;
+	spark::EventDispatcher dispatcher;
+	spark::ServicesMap services;
+	spark::SessionManager sessions;
+	spark::Link self{};
+
+	spark::MessageHandler handler(bool initiator) {
+		return spark::MessageHandler(dispatcher, services, self, initiator, &logger);
+	}
+};
+
+using Callback = std::function<void()>;
+using SessionPtr = std::shared_ptr<spark::NetworkSession>;
+
+template<typename Session>
+std::pair<SessionPtr, SessionPtr> tcp_pair(Environment& env, Callback client_cb, Callback server_cb) {
+	bai::tcp::acceptor acceptor(env.context, { bai::address_v4::loopback(), 0 });
+	bai::tcp::socket client_sock(env.context), server_sock(env.context);
+	client_sock.connect(acceptor.local_endpoint());
+	acceptor.accept(server_sock);
+	client_sock.set_option(bai::tcp::no_delay(true));
+	server_sock.set_option(bai::tcp::no_delay(true));
+	const auto ep = acceptor.local_endpoint();
+
+	auto client = std::make_shared<RawSession<Session>>(std::move(client_cb), env.sessions,
+		std::move(client_sock), ep, env.handler(false), &env.logger);
+	auto server = std::make_shared<RawSession<Session>>(std::move(server_cb), env.sessions,
+		std::move(server_sock), ep, env.handler(false), &env.logger);
+	return { client, server };
+}
+
+std::pair<SessionPtr, SessionPtr> local_pair(Environment& env, Callback client_cb, Callback server_cb) {
+	using Session = RawSession<spark::LocalSession>;
+	auto client = std::make_shared<Session>(std::move(client_cb), env.sessions, env.context,
+	                                        env.handler(false), &env.logger);
+	auto server = std::make_shared<Session>(std::move(server_cb), env.sessions, env.context,
+	                                        env.handler(false), &env.logger);
+	spark::LocalSession::pair(client, server);
+	return { client, server };
+}
+
+#if defined __linux__
+std::pair<SessionPtr, SessionPtr> shm_pair(Environment& env, Callback client_cb, Callback server_cb) {
+	using Session = RawSession<spark::ShmSession>;
+	using LocalSocket = boost::asio::local::stream_protocol::socket;
+
+	LocalSocket client_sock(env.context), server_sock(env.context);
+	boost::asio::local::connect_pair(client_sock, server_sock);
+
+	// both ends live in this process, so the server maps its own copy of the segment
+	auto segment = spark::detail::ShmSegment::create();
+	auto fds = segment->descriptors();
+
+	for(auto& fd : fds) {
+		fd = ::dup(fd);
+	}
+
+	auto remote = spark::detail::ShmSegment::open(fds);
+
+	auto client = std::make_shared<Session>(std::move(client_cb), env.sessions, std::move(client_sock),
+	                                        std::move(segment), true, env.handler(false), &env.logger);
+	auto server = std::make_shared<Session>(std::move(server_cb), env.sessions, std::move(server_sock),
+	                                        std::move(remote), false, env.handler(false), &env.logger);
+	return { client, server };
+}
+#endif
+
+/*
+ * The client keeps 'window' messages in flight and the server echoes each
+ * one back, so window = 1 measures round trip latency and larger windows
+ * measure throughput
+ */
+template<typename Factory>
+void loopback(bench::State& state, Factory factory, const std::size_t size, const std::size_t window) {
+	Environment env;
+
+	auto message = spark::make_buffer();
+	message->CreateString(std::string(size, 'x'));
+	message->Finish(flatbuffers::Offset<void>());
+
+	const auto total = MESSAGES * state.scale;
+	std::size_t sent = 0, received = 0;
+	std::deque<std::uint64_t> sent_at;
+	std::vector<std::uint64_t> samples;
+	samples.reserve(total);
+
+	SessionPtr client, server;
+
+	auto send = [&]() {
+		sent_at.emplace_back(bench::now());
+		client->write(message);
+		++sent;
+	};
+
+	std::tie(client, server) = factory(env, [&]() {
+		samples.emplace_back(bench::now() - sent_at.front());
+		sent_at.pop_front();
+
+		if(++received == total) {
+			env.context.stop();
+		} else if(sent < total) {
+			send();
+		}
+	}, [&]() {
+		server->write(message);
+	});
+
+	env.sessions.start(server);
+	env.sessions.start(client);
+
+	const auto start = std::chrono::steady_clock::now();
+
+	for(std::size_t i = 0; i < window && i < total; ++i) {
+		send();
+	}
+
+	env.context.run();
+
+	state.elapsed(std::chrono::steady_clock::now() - start, received);
+	state.samples(samples);
+	state.counter("size", static_cast<double>(size));
+	state.counter("window", static_cast<double>(window));
+	env.sessions.stop_all();
+}
+
+const auto v1 = tcp_pair<spark::TcpSession>;
+const auto v2 = tcp_pair<spark::v2::PeerSession>;
+
+const bench::Registrar registrars[] {
+	{ "spark_transport_v1_64b_w1",       [](auto& state) { loopback(state, v1, 64, 1); } },
+	{ "spark_transport_v2_64b_w1",       [](auto& state) { loopback(state, v2, 64, 1); } },
+	{ "spark_transport_v1_64b_w256",     [](auto& state) { loopback(state, v1, 64, 256); } },
+	{ "spark_transport_v2_64b_w256",     [](auto& state) { loopback(state, v2, 64, 256); } },
+	{ "spark_transport_v1_4k_w256",      [](auto& state) { loopback(state, v1, 4096, 256); } },
+	{ "spark_transport_v2_4k_w256",      [](auto& state) { loopback(state, v2, 4096, 256); } },
+	{ "spark_transport_local_64b_w1",    [](auto& state) { loopback(state, local_pair, 64, 1); } },
+	{ "spark_transport_local_64b_w256",  [](auto& state) { loopback(state, local_pair, 64, 256); } },
+	{ "spark_transport_local_4k_w256",   [](auto& state) { loopback(state, local_pair, 4096, 256); } },
+#if defined __linux__
+	{ "spark_transport_shm_64b_w1",      [](auto& state) { loopback(state, shm_pair, 64, 1); } },
+	{ "spark_transport_shm_64b_w256",    [](auto& state) { loopback(state, shm_pair, 64, 256); } },
+	{ "spark_transport_shm_4k_w256",     [](auto& state) { loopback(state, shm_pair, 4096, 256); } },
+#endif
+};
+
+} // unnamed
\ No newline at end of file